@@ -0,0 +1,578 @@
+extern "C" {
+#include <curses.h>
+#include <signal.h>
+#include <sys/epoll.h>
+#include <sys/ioctl.h>
+#include <sys/signalfd.h>
+#include <sys/timerfd.h>
+#include <unistd.h>
+}
+
+#include <fmt/core.h>
+
+#include <algorithm>
+#include <array>
+#include <cerrno>
+#include <chrono>
+#include <clocale>
+#include <cmath>
+#include <cstdint>
+#include <cstdlib>
+#include <exception>
+#include <iostream>
+#include <numbers>
+#include <span>
+#include <stdexcept>
+#include <string>
+#include <string_view>
+#include <system_error>
+#include <type_traits>
+#include <utility>
+
+namespace helpers {
+
+template<std::size_t Offset, std::size_t... Is>
+constexpr std::index_sequence<(Offset + Is)...> add_offset(std::index_sequence<Is...>) {
+  return {};
+}
+
+template<std::size_t Offset, std::size_t N>
+constexpr auto make_index_sequence_with_offset() {
+  return add_offset<Offset>(std::make_index_sequence<N>{});
+}
+
+/// Generate an array with offset indexes as values, at compile-time.
+template<typename T, std::size_t N, std::size_t Offset>
+constexpr auto make_array_with_indices() {
+  return []<std::size_t... Is>(std::index_sequence<Is...>) { return std::array<T, N>{Is...}; }(make_index_sequence_with_offset<Offset, N>());
+}
+
+} // namespace helpers
+
+constexpr int          WALL_COLOR_X          = 10; // Black/background.
+constexpr unsigned int NUMBER_OF_WALL_SHADES = 16;
+constexpr auto         WALL_SHADES           = helpers::make_array_with_indices<int, NUMBER_OF_WALL_SHADES, 11>(); // 11, 12, 13, ...
+
+constexpr float PI        = std::numbers::pi_v<float>;
+constexpr float PI2       = PI * 2.0f;
+constexpr float FOV       = PI / 3.0f; // Field of view in [radians].
+constexpr float MAX_DEPTH = 15.0f;     // Maximum visible depth in [map block units].
+
+constexpr std::chrono::microseconds MIN_FRAME_TIME{16'667}; // Frame pacing: render at most ~60 frames per second.
+
+/// Any arithmetic type (scalar or floating-point).
+template<typename T>
+concept arithmetic = std::is_arithmetic_v<T>;
+
+/// 2D position.
+template<arithmetic T>
+struct Position {
+  constexpr Position(T x, T y)
+    : x{x}
+    , y{y} {
+  }
+
+  template<arithmetic U>
+  constexpr Position(U x, U y)
+    : x{static_cast<T>(std::round(x))}
+    , y{static_cast<T>(std::round(y))} {
+  }
+
+  template<arithmetic U>
+  constexpr Position(const Position<U>& p) // NOLINT(hicpp-explicit-conversions)
+    : x{static_cast<T>(std::round(p.x))}
+    , y{static_cast<T>(std::round(p.y))} {
+  }
+
+  constexpr Position<T> adjusted(T dx, T dy) {
+    return Position(x + dx, y + dy);
+  }
+
+  T x, y;
+};
+
+/// Wrapper around the default 'stdscr' window in ncurses.
+struct Screen {
+private:
+  const WINDOW* const window_;
+
+public:
+  enum class Key : uint8_t { Up, Down, Left, Right, Quit, Other, None };
+
+  Screen()
+    : window_{initscr()}
+    , width{static_cast<unsigned int>(getmaxx(stdscr))}
+    , height{static_cast<unsigned int>(getmaxy(stdscr))} {
+    cbreak();    // Break on character input (i.e. don't wait for enter).
+    noecho();    // Don't echo input keys.
+    curs_set(0); // Disable cursor.
+
+    if (!window_) {
+      throw std::runtime_error{"failed to initialize screen"};
+    }
+
+    // Delay-less operation of ncurses: waiting for input is done by the event loop, not by ncurses.
+    nodelay(stdscr, TRUE);
+
+    if (has_colors() == FALSE) {
+      throw std::runtime_error{"your terminal does not support color"};
+    }
+
+    start_color();
+
+    init_color(COLOR_BLACK, 0, 0, 0); // Reinitialize black to be really dark.
+    init_pair(WALL_COLOR_X, COLOR_BLACK, COLOR_BLACK);
+
+    // Note: we overlap the IDs for colors and color pairs. Not as ncurses intended, but OK for this example.
+    for (unsigned int i = 0; i < WALL_SHADES.size(); i++) {
+      const int v     = 1000 - static_cast<int>(i * (1000 / WALL_SHADES.size()));
+      const int shade = WALL_SHADES.at(i);
+      init_extended_color(shade, v, v, v);
+      init_extended_pair(shade, shade, COLOR_BLACK);
+    }
+
+    // Override default foreground/background colors as white on black.
+    init_pair(1, COLOR_WHITE, COLOR_BLACK);
+    attron(COLOR_PAIR(1));
+  }
+
+  ~Screen() {
+    endwin();
+  }
+
+  Screen(Screen&&) noexcept            = default;
+  Screen& operator=(Screen&&) noexcept = delete;
+
+  /// Write console buffer to screen.
+  void update() {
+    refresh();
+  }
+
+  /// Print string to specific coordinates in console buffer.
+  void print(const Position<int>& p, std::string_view s) const {
+    mvaddstr(p.y, p.x, s.data());
+  }
+
+  /// Capture input key, returns `Key::None` if no (more) input is available.
+  [[nodiscard]] Key get_key() const {
+    switch (getch()) {
+    case ERR: return Key::None;
+    case 'w': return Key::Up;
+    case 's': return Key::Down;
+    case 'a': return Key::Left;
+    case 'd': return Key::Right;
+    case 'q': return Key::Quit;
+    default: return Key::Other;
+    }
+  }
+
+  /// Adopt the current terminal dimensions after a resize.
+  void resize() {
+    winsize ws{};
+    if (ioctl(STDOUT_FILENO, TIOCGWINSZ, &ws) == 0) {
+      resizeterm(ws.ws_row, ws.ws_col);
+    }
+
+    width  = static_cast<unsigned int>(getmaxx(stdscr));
+    height = static_cast<unsigned int>(getmaxy(stdscr));
+
+    clear();
+  }
+
+  unsigned int width;
+  unsigned int height;
+};
+
+// Screen should be stationary resource handle (tests will fail at build time).
+static_assert(std::is_nothrow_destructible_v<Screen>);
+static_assert(std::is_default_constructible_v<Screen>);
+static_assert(!std::is_copy_constructible_v<Screen>);
+static_assert(!std::is_copy_assignable_v<Screen>);
+static_assert(std::is_nothrow_move_constructible_v<Screen>);
+static_assert(!std::is_nothrow_move_assignable_v<Screen>);
+
+/// Owning handle for a POSIX file descriptor.
+struct FileDescriptor {
+  FileDescriptor(int fd_, const char* what)
+    : fd{fd_} {
+    if (fd < 0) {
+      throw std::system_error{errno, std::generic_category(), what};
+    }
+  }
+
+  ~FileDescriptor() {
+    close(fd);
+  }
+
+  FileDescriptor(const FileDescriptor&)            = delete;
+  FileDescriptor& operator=(const FileDescriptor&) = delete;
+
+  const int fd;
+};
+
+/// Blocking wait for keyboard input, timer expiry and terminal resizes all at once, using epoll.
+struct EventLoop {
+private:
+  /// Block SIGWINCH for normal delivery, and create a signal file descriptor for it instead.
+  [[nodiscard]] static int make_resize_signal_fd() {
+    sigset_t mask;
+    sigemptyset(&mask);
+    sigaddset(&mask, SIGWINCH);
+
+    if (sigprocmask(SIG_BLOCK, &mask, nullptr) != 0) {
+      throw std::system_error{errno, std::generic_category(), "failed to block resize signal"};
+    }
+
+    return signalfd(-1, &mask, SFD_NONBLOCK | SFD_CLOEXEC);
+  }
+
+  void watch(int fd) const {
+    epoll_event event{};
+    event.events  = EPOLLIN;
+    event.data.fd = fd;
+
+    if (epoll_ctl(epoll_.fd, EPOLL_CTL_ADD, fd, &event) != 0) {
+      throw std::system_error{errno, std::generic_category(), "failed to add file descriptor to epoll"};
+    }
+  }
+
+  const FileDescriptor signal_;
+  const FileDescriptor timer_;
+  const FileDescriptor epoll_;
+
+public:
+  /// The set of events that woke up a single wait.
+  struct Events {
+    bool input  = false; // Keyboard input available on stdin.
+    bool hangup = false; // End of input, or stdin hung up: no more keys will come, and stdin is no longer watched.
+    bool tick   = false; // Timer expired.
+    bool resize = false; // Terminal was resized.
+
+    std::chrono::steady_clock::time_point wake_time; // Time of wake-up.
+  };
+
+  /// Constructor. Must be called before the screen is initialized, so that ncurses does not handle SIGWINCH itself.
+  EventLoop()
+    : signal_{make_resize_signal_fd(), "failed to create signal file descriptor"}
+    , timer_{timerfd_create(CLOCK_MONOTONIC, TFD_NONBLOCK | TFD_CLOEXEC), "failed to create timer file descriptor"}
+    , epoll_{epoll_create1(EPOLL_CLOEXEC), "failed to create epoll file descriptor"} {
+    watch(STDIN_FILENO);
+    watch(signal_.fd);
+    watch(timer_.fd);
+  }
+
+  /// Arm the timer to expire once after the given delay. Re-arming replaces any pending expiry.
+  void schedule_tick(std::chrono::nanoseconds delay) const {
+    const auto s = std::chrono::duration_cast<std::chrono::seconds>(delay);
+
+    itimerspec spec{};
+    spec.it_value.tv_sec  = static_cast<time_t>(s.count());
+    spec.it_value.tv_nsec = std::max(static_cast<long>((delay - s).count()), 1L); // A zero value would disarm the timer.
+
+    if (timerfd_settime(timer_.fd, 0, &spec, nullptr) != 0) {
+      throw std::system_error{errno, std::generic_category(), "failed to arm timer"};
+    }
+  }
+
+  /// Block until at least one event occurred. This is where the program spends its idle time, without using the CPU.
+  [[nodiscard]] Events wait() const {
+    std::array<epoll_event, 3> ready{};
+
+    int n = 0;
+    do {
+      n = epoll_wait(epoll_.fd, ready.data(), static_cast<int>(ready.size()), -1);
+    } while (n < 0 && errno == EINTR);
+
+    if (n < 0) {
+      throw std::system_error{errno, std::generic_category(), "failed to wait for events"};
+    }
+
+    Events events{.wake_time = std::chrono::steady_clock::now()};
+
+    for (const auto& e : std::span{ready}.first(static_cast<std::size_t>(n))) {
+      if (e.data.fd == STDIN_FILENO) {
+        events.input = true;
+
+        // At end of input or on a hang-up, stdin stays readable with nothing to read, and every wait would return at once.
+        if ((e.events & (EPOLLHUP | EPOLLERR)) != 0) {
+          events.hangup = true;
+          epoll_ctl(epoll_.fd, EPOLL_CTL_DEL, STDIN_FILENO, nullptr);
+        }
+      } else if (e.data.fd == timer_.fd) {
+        std::uint64_t expirations{};
+        events.tick = read(timer_.fd, &expirations, sizeof(expirations)) == sizeof(expirations);
+      } else if (e.data.fd == signal_.fd) {
+        signalfd_siginfo info{};
+        while (read(signal_.fd, &info, sizeof(info)) == sizeof(info)) {
+          events.resize = true; // Drain all pending resize signals, we only need to handle the last one.
+        }
+      }
+    }
+
+    return events;
+  }
+};
+
+/// Abstraction over a rectangular ASCII art level map definition.
+struct LevelMap {
+  /// Constructor. Takes an ASCII art map definition where '#' are walls.
+  explicit LevelMap(std::string&& format_)
+    : format{std::move(format_)}
+    , width{static_cast<unsigned int>(format.find_first_of('\n'))}
+    , height{static_cast<unsigned int>(format.find_last_of('\n')) / width} {
+    if (width < 3 || height < 3) {
+      throw std::invalid_argument{"invalid level dimensions -- must at least be 3x3 units"};
+    }
+
+    if ((width + 1) * height != format.size()) {
+      throw std::invalid_argument{"invalid level dimensions -- must be rectangular"};
+    }
+  }
+
+  /// Check if a coordinate on the map is out-of-bounds (OOB).
+  [[nodiscard]] bool is_oob(const Position<int>& p) const {
+    return p.x < 0 || p.y < 0 || p.x >= static_cast<int>(width) || p.y >= static_cast<int>(height);
+  }
+
+  /// Check if a coordinate on the map is a wall element.
+  [[nodiscard]] bool is_wall(const Position<int>& p) const {
+    return !is_oob(p) && format.at((width + 1) * static_cast<unsigned int>(p.y) + static_cast<unsigned int>(p.x)) == '#';
+  }
+
+  const std::string  format;
+  const unsigned int width;
+  const unsigned int height;
+};
+
+/// Player state manager.
+struct Player {
+  Player(const Position<float>& p, float a)
+    : pos{p}
+    , angle{a} {
+  }
+
+  void move_up_if(std::invocable<Position<float>> auto&& pred) {
+    const auto pos_new = pos.adjusted(0.1f * std::sin(angle), 0.1f * std::cos(angle));
+    if (pred(pos_new)) {
+      pos = pos_new;
+    }
+  }
+
+  void move_down_if(std::invocable<Position<float>> auto&& pred) {
+    const auto pos_new = pos.adjusted(-0.1f * std::sin(angle), -0.1f * std::cos(angle));
+    if (pred(pos_new)) {
+      pos = pos_new;
+    }
+  }
+
+  void turn_ccw() {
+    angle = std::fmod(angle - 0.1f + PI2, PI2);
+  }
+
+  void turn_cw() {
+    angle = std::fmod(angle + 0.1f, PI2);
+  }
+
+  Position<float> pos;   // Current position in [map block units].
+  float           angle; // Current orientation angle in [radians].
+};
+
+namespace {
+
+[[nodiscard]] constexpr int distance_to_wall_shade(float d) {
+  if (d < MAX_DEPTH) {
+    const float shade = std::clamp(MAX_DEPTH - (2.0f * d), 0.0f, MAX_DEPTH);
+    return WALL_SHADES.at(WALL_SHADES.size() - 1 - static_cast<std::size_t>(shade * (WALL_SHADES.size() / MAX_DEPTH)));
+  } else {
+    return WALL_COLOR_X;
+  }
+}
+
+[[nodiscard]] constexpr std::string angle_to_char(float a) {
+  constexpr float D = PI / 8.0f;
+
+  if (a > (PI2 - D) || a <= D) {
+    return "\u21D3"; // Downwards arrow.
+  } else if (a > D && a <= (D * 3.0f)) {
+    return "\u21D8"; // South East arrow.
+  } else if (a > (D * 3.0f) && a <= (D * 5.0f)) {
+    return "\u21D2"; // Rightwards arrow.
+  } else if (a > (D * 5.0f) && a <= (PI - D)) {
+    return "\u21D7"; // North East arrow.
+  } else if (a > (PI - D) && a <= (PI + D)) {
+    return "\u21D1"; // Upwards arrow.
+  } else if (a > (PI + D) && a <= (PI + (D * 3.0f))) {
+    return "\u21D6"; // North West arrow.
+  } else if (a > (PI + (D * 3.0f)) && a <= (PI + (D * 5.0f))) {
+    return "\u21D0"; // Leftwards arrow.
+  } else {
+    return "\u21D9"; // South West arrow.
+  }
+}
+
+} // namespace
+
+int main() {
+  try {
+    if (std::setlocale(LC_ALL, "") == nullptr) { // Required for Unicode support.
+      throw std::runtime_error{"failed to set locale"};
+    }
+
+    const LevelMap MAP{"####################\n"
+                       "#   ##             #\n"
+                       "#   ##             #\n"
+                       "#                  #\n"
+                       "#         ##########\n"
+                       "#                  #\n"
+                       "######             #\n"
+                       "#    #      ###    #\n"
+                       "#    #      ###    #\n"
+                       "#                  #\n"
+                       "#                  #\n"
+                       "####################\n"};
+
+    const EventLoop loop; // Must be created before the screen, see constructor.
+    Screen          s;
+    Player          p{{7.0f, 1.0f}, 0.0f};
+
+    bool dirty        = true;                                    // Indicates whether a new frame must be rendered.
+    auto t_dirty      = std::chrono::steady_clock::now();        // Wake-up time of the event that made the frame dirty.
+    auto t_last_frame = std::chrono::steady_clock::time_point{}; // Start time of the last rendered frame.
+
+    while (true) {
+      const auto t_start = std::chrono::steady_clock::now();
+
+      if (!dirty || (t_start - t_last_frame) < MIN_FRAME_TIME) {
+        if (dirty) {
+          loop.schedule_tick(MIN_FRAME_TIME - (t_start - t_last_frame)); // Too soon after the last frame, defer it.
+        }
+
+        const auto events    = loop.wait();
+        const bool was_dirty = dirty;
+
+        if (events.resize) {
+          s.resize();
+          dirty = true;
+        }
+
+        if (events.input) {
+          for (auto key = s.get_key(); key != Screen::Key::None; key = s.get_key()) { // Drain all pending input.
+            switch (key) {
+              using enum Screen::Key;
+            case Up: p.move_up_if([&](const auto& pos) { return !MAP.is_wall(pos); }); break;
+            case Down: p.move_down_if([&](const auto& pos) { return !MAP.is_wall(pos); }); break;
+            case Left: p.turn_ccw(); break;
+            case Right: p.turn_cw(); break;
+            case Other:
+            case None: continue;
+            case Quit: return EXIT_SUCCESS;
+            }
+
+            dirty = true;
+          }
+        }
+
+        if (events.hangup) {
+          return EXIT_SUCCESS; // Without input there is no other way to quit.
+        }
+
+        // Note: a timer tick by itself changes nothing here, it only wakes us up to render a deferred frame.
+
+        if (dirty && !was_dirty) {
+          t_dirty = events.wake_time;
+        }
+
+        continue;
+      }
+
+      // Display mini-map and player location / orientation.
+      s.print({0, 0}, MAP.format);
+      s.print(p.pos, angle_to_char(p.angle));
+
+      for (unsigned int x = 0; x < s.width; x++) {
+        const float ray_angle = p.angle - (FOV / 2) + (static_cast<float>(x) * FOV) / static_cast<float>(s.width);
+        const float norm_x    = std::sin(ray_angle);
+        const float norm_y    = std::cos(ray_angle);
+
+        float dist_wall = 0.0f;
+        bool  hit       = false; // Indicates 'ray hit'.
+        bool  bound     = false; // Indicates wall block boundary.
+        while (!hit && (dist_wall < MAX_DEPTH)) {
+          dist_wall += 0.1f;
+
+          const int xx = static_cast<int>(std::round(p.pos.x + norm_x * dist_wall));
+          const int yy = static_cast<int>(std::round(p.pos.y + norm_y * dist_wall));
+
+          const bool hit_wall = MAP.is_wall({xx, yy});
+          hit                 = MAP.is_oob({xx, yy}) || hit_wall;
+
+          if (hit_wall) {
+            std::array<std::pair<float, float>, 4> corners; // Distances and dot products per wall block corner.
+
+            for (int tx = 0; tx < 2; tx++) {
+              for (int ty = 0; ty < 2; ty++) {
+                const float vx                                    = static_cast<float>(xx + tx) - p.pos.x;
+                const float vy                                    = static_cast<float>(yy + ty) - p.pos.y;
+                const float d                                     = std::sqrt(vx * vx + vy * vy);
+                corners.at(static_cast<std::size_t>(ty * 2 + tx)) = std::make_pair(d, (norm_x * vx / d) + (norm_y * vy / d));
+              }
+            }
+
+            std::ranges::sort(corners, [](const auto& a, const auto& b) { return a.first < b.first; });
+
+            bound = (std::acos(corners.at(0).second) < 0.01f) || (std::acos(corners.at(1).second) < 0.01f);
+          }
+        }
+
+        const long dist_ceiling = static_cast<long>(std::round((static_cast<float>(s.height) / 2.0f) - (static_cast<float>(s.height) / dist_wall)));
+        const long dist_floor   = static_cast<long>(std::round(s.height - dist_ceiling));
+        const int  wall_shade   = distance_to_wall_shade(dist_wall);
+
+        for (unsigned int y = 0; y < s.height; y++) {
+          if (x >= MAP.width || y >= MAP.height) {
+            if (y < dist_ceiling) {
+              s.print({x, y}, " "); // Ceiling.
+            } else if (y > dist_ceiling && y <= dist_floor) {
+              attron(COLOR_PAIR(wall_shade));
+              if (bound) {
+                s.print({x, y}, "\u2593"); // Wall bound.
+              } else {
+                s.print({x, y}, "\u2588"); // Wall.
+              }
+              attroff(COLOR_PAIR(wall_shade));
+            } else {
+              const float d = 1.0f - ((static_cast<float>(y) - (static_cast<float>(s.height) / 2.0f)) / (static_cast<float>(s.height) / 2.0f));
+              s.print({x, y}, [&] { // Floor.
+                if (d < 0.25f) {
+                  return "#";
+                } else if (d < 0.5f) {
+                  return "x";
+                } else if (d < 0.75f) {
+                  return "-";
+                } else if (d < 0.9f) {
+                  return ".";
+                } else {
+                  return " ";
+                }
+              }());
+            }
+          }
+        }
+      }
+
+      const auto t_end     = std::chrono::steady_clock::now();
+      const auto t_elapsed = std::chrono::duration_cast<std::chrono::microseconds>(t_end - t_start);
+      const auto t_latency = std::chrono::duration_cast<std::chrono::microseconds>(t_end - t_dirty);
+      s.print({0u, s.height - 1},
+              fmt::format("Frame rate: {:.0f} FPS, wake-up-to-frame latency: {} us", 1e6f / static_cast<float>(t_elapsed.count()), t_latency.count()));
+
+      s.update();
+
+      dirty        = false;
+      t_last_frame = t_start;
+    }
+  } catch (const std::exception& e) {
+    std::cerr << "Error: " << e.what() << '\n';
+    return EXIT_FAILURE;
+  }
+}
@@ -0,0 +1,1017 @@
+extern "C" {
+#include <curses.h>
+#include <signal.h>
+#include <sys/epoll.h>
+#include <sys/ioctl.h>
+#include <sys/signalfd.h>
+#include <sys/timerfd.h>
+#include <unistd.h>
+}
+
+#include <fmt/core.h>
+
+#include <algorithm>
+#include <array>
+#include <barrier>
+#include <bit>
+#include <cerrno>
+#include <chrono>
+#include <clocale>
+#include <cmath>
+#include <cstdint>
+#include <cstdlib>
+#include <exception>
+#include <fstream>
+#include <functional>
+#include <iostream>
+#include <numbers>
+#include <optional>
+#include <span>
+#include <sstream>
+#include <stdexcept>
+#include <string>
+#include <string_view>
+#include <system_error>
+#include <thread>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+namespace helpers {
+
+template<std::size_t Offset, std::size_t... Is>
+constexpr std::index_sequence<(Offset + Is)...> add_offset(std::index_sequence<Is...>) {
+  return {};
+}
+
+template<std::size_t Offset, std::size_t N>
+constexpr auto make_index_sequence_with_offset() {
+  return add_offset<Offset>(std::make_index_sequence<N>{});
+}
+
+/// Generate an array with offset indexes as values, at compile-time.
+template<typename T, std::size_t N, std::size_t Offset>
+constexpr auto make_array_with_indices() {
+  return []<std::size_t... Is>(std::index_sequence<Is...>) { return std::array<T, N>{Is...}; }(make_index_sequence_with_offset<Offset, N>());
+}
+
+} // namespace helpers
+
+constexpr int          WALL_COLOR_X          = 10; // Black/background.
+constexpr unsigned int NUMBER_OF_WALL_SHADES = 16;
+constexpr auto         WALL_SHADES           = helpers::make_array_with_indices<int, NUMBER_OF_WALL_SHADES, 11>(); // 11, 12, 13, ...
+
+constexpr float PI        = std::numbers::pi_v<float>;
+constexpr float PI2       = PI * 2.0f;
+constexpr float FOV       = PI / 3.0f; // Field of view in [radians].
+constexpr float MAX_DEPTH = 15.0f;     // Maximum visible depth in [map block units].
+
+constexpr std::chrono::microseconds MIN_FRAME_TIME{16'667}; // Frame pacing: render at most ~60 frames per second.
+
+constexpr unsigned int MINIMAP_WIDTH    = 24; // Braille mini-map width in [screen cells].
+constexpr unsigned int MINIMAP_HEIGHT   = 8;  // Braille mini-map height in [screen cells].
+constexpr unsigned int MINIMAP_MAX_ZOOM = 64; // Maximum number of map block units per braille dot (horizontally and vertically).
+
+/// Any arithmetic type (scalar or floating-point).
+template<typename T>
+concept arithmetic = std::is_arithmetic_v<T>;
+
+/// 2D position.
+template<arithmetic T>
+struct Position {
+  constexpr Position(T x, T y)
+    : x{x}
+    , y{y} {
+  }
+
+  template<arithmetic U>
+  constexpr Position(U x, U y)
+    : x{static_cast<T>(std::round(x))}
+    , y{static_cast<T>(std::round(y))} {
+  }
+
+  template<arithmetic U>
+  constexpr Position(const Position<U>& p) // NOLINT(hicpp-explicit-conversions)
+    : x{static_cast<T>(std::round(p.x))}
+    , y{static_cast<T>(std::round(p.y))} {
+  }
+
+  constexpr Position<T> adjusted(T dx, T dy) {
+    return Position(x + dx, y + dy);
+  }
+
+  T x, y;
+};
+
+/// Wrapper around the default 'stdscr' window in ncurses.
+struct Screen {
+private:
+  const WINDOW* const window_;
+
+public:
+  enum class Key : uint8_t { Up, Down, Left, Right, MiniMapMode, ZoomIn, ZoomOut, Quit, Other, None };
+
+  Screen()
+    : window_{initscr()}
+    , width{static_cast<unsigned int>(getmaxx(stdscr))}
+    , height{static_cast<unsigned int>(getmaxy(stdscr))} {
+    cbreak();    // Break on character input (i.e. don't wait for enter).
+    noecho();    // Don't echo input keys.
+    curs_set(0); // Disable cursor.
+
+    if (!window_) {
+      throw std::runtime_error{"failed to initialize screen"};
+    }
+
+    // Delay-less operation of ncurses: waiting for input is done by the event loop, not by ncurses.
+    nodelay(stdscr, TRUE);
+
+    if (has_colors() == FALSE) {
+      throw std::runtime_error{"your terminal does not support color"};
+    }
+
+    start_color();
+
+    init_color(COLOR_BLACK, 0, 0, 0); // Reinitialize black to be really dark.
+    init_pair(WALL_COLOR_X, COLOR_BLACK, COLOR_BLACK);
+
+    // Note: we overlap the IDs for colors and color pairs. Not as ncurses intended, but OK for this example.
+    for (unsigned int i = 0; i < WALL_SHADES.size(); i++) {
+      const int v     = 1000 - static_cast<int>(i * (1000 / WALL_SHADES.size()));
+      const int shade = WALL_SHADES.at(i);
+      init_extended_color(shade, v, v, v);
+      init_extended_pair(shade, shade, COLOR_BLACK);
+    }
+
+    // Override default foreground/background colors as white on black.
+    init_pair(1, COLOR_WHITE, COLOR_BLACK);
+    attron(COLOR_PAIR(1));
+  }
+
+  ~Screen() {
+    endwin();
+  }
+
+  Screen(Screen&&) noexcept            = default;
+  Screen& operator=(Screen&&) noexcept = delete;
+
+  /// Write console buffer to screen.
+  void update() {
+    refresh();
+  }
+
+  /// Print string to specific coordinates in console buffer.
+  void print(const Position<int>& p, std::string_view s) const {
+    mvaddstr(p.y, p.x, s.data());
+  }
+
+  /// Capture input key, returns `Key::None` if no (more) input is available.
+  [[nodiscard]] Key get_key() const {
+    switch (getch()) {
+    case ERR: return Key::None;
+    case 'w': return Key::Up;
+    case 's': return Key::Down;
+    case 'a': return Key::Left;
+    case 'd': return Key::Right;
+    case 'm': return Key::MiniMapMode;
+    case '+': return Key::ZoomIn;
+    case '-': return Key::ZoomOut;
+    case 'q': return Key::Quit;
+    default: return Key::Other;
+    }
+  }
+
+  /// Adopt the current terminal dimensions after a resize.
+  void resize() {
+    winsize ws{};
+    if (ioctl(STDOUT_FILENO, TIOCGWINSZ, &ws) == 0) {
+      resizeterm(ws.ws_row, ws.ws_col);
+    }
+
+    width  = static_cast<unsigned int>(getmaxx(stdscr));
+    height = static_cast<unsigned int>(getmaxy(stdscr));
+
+    clear();
+  }
+
+  unsigned int width;
+  unsigned int height;
+};
+
+// Screen should be stationary resource handle (tests will fail at build time).
+static_assert(std::is_nothrow_destructible_v<Screen>);
+static_assert(std::is_default_constructible_v<Screen>);
+static_assert(!std::is_copy_constructible_v<Screen>);
+static_assert(!std::is_copy_assignable_v<Screen>);
+static_assert(std::is_nothrow_move_constructible_v<Screen>);
+static_assert(!std::is_nothrow_move_assignable_v<Screen>);
+
+/// Owning handle for a POSIX file descriptor.
+struct FileDescriptor {
+  FileDescriptor(int fd_, const char* what)
+    : fd{fd_} {
+    if (fd < 0) {
+      throw std::system_error{errno, std::generic_category(), what};
+    }
+  }
+
+  ~FileDescriptor() {
+    close(fd);
+  }
+
+  FileDescriptor(const FileDescriptor&)            = delete;
+  FileDescriptor& operator=(const FileDescriptor&) = delete;
+
+  const int fd;
+};
+
+/// Blocking wait for keyboard input, timer expiry and terminal resizes all at once, using epoll.
+struct EventLoop {
+private:
+  /// Block SIGWINCH for normal delivery, and create a signal file descriptor for it instead.
+  [[nodiscard]] static int make_resize_signal_fd() {
+    sigset_t mask;
+    sigemptyset(&mask);
+    sigaddset(&mask, SIGWINCH);
+
+    if (sigprocmask(SIG_BLOCK, &mask, nullptr) != 0) {
+      throw std::system_error{errno, std::generic_category(), "failed to block resize signal"};
+    }
+
+    return signalfd(-1, &mask, SFD_NONBLOCK | SFD_CLOEXEC);
+  }
+
+  void watch(int fd) const {
+    epoll_event event{};
+    event.events  = EPOLLIN;
+    event.data.fd = fd;
+
+    if (epoll_ctl(epoll_.fd, EPOLL_CTL_ADD, fd, &event) != 0) {
+      throw std::system_error{errno, std::generic_category(), "failed to add file descriptor to epoll"};
+    }
+  }
+
+  const FileDescriptor signal_;
+  const FileDescriptor timer_;
+  const FileDescriptor epoll_;
+
+public:
+  /// The set of events that woke up a single wait.
+  struct Events {
+    bool input  = false; // Keyboard input available on stdin.
+    bool hangup = false; // End of input, or stdin hung up: no more keys will come, and stdin is no longer watched.
+    bool tick   = false; // Timer expired.
+    bool resize = false; // Terminal was resized.
+
+    std::chrono::steady_clock::time_point wake_time; // Time of wake-up.
+  };
+
+  /// Constructor. Must be called before the screen is initialized, so that ncurses does not handle SIGWINCH itself.
+  EventLoop()
+    : signal_{make_resize_signal_fd(), "failed to create signal file descriptor"}
+    , timer_{timerfd_create(CLOCK_MONOTONIC, TFD_NONBLOCK | TFD_CLOEXEC), "failed to create timer file descriptor"}
+    , epoll_{epoll_create1(EPOLL_CLOEXEC), "failed to create epoll file descriptor"} {
+    watch(STDIN_FILENO);
+    watch(signal_.fd);
+    watch(timer_.fd);
+  }
+
+  /// Arm the timer to expire once after the given delay. Re-arming replaces any pending expiry.
+  void schedule_tick(std::chrono::nanoseconds delay) const {
+    const auto s = std::chrono::duration_cast<std::chrono::seconds>(delay);
+
+    itimerspec spec{};
+    spec.it_value.tv_sec  = static_cast<time_t>(s.count());
+    spec.it_value.tv_nsec = std::max(static_cast<long>((delay - s).count()), 1L); // A zero value would disarm the timer.
+
+    if (timerfd_settime(timer_.fd, 0, &spec, nullptr) != 0) {
+      throw std::system_error{errno, std::generic_category(), "failed to arm timer"};
+    }
+  }
+
+  /// Block until at least one event occurred. This is where the program spends its idle time, without using the CPU.
+  [[nodiscard]] Events wait() const {
+    std::array<epoll_event, 3> ready{};
+
+    int n = 0;
+    do {
+      n = epoll_wait(epoll_.fd, ready.data(), static_cast<int>(ready.size()), -1);
+    } while (n < 0 && errno == EINTR);
+
+    if (n < 0) {
+      throw std::system_error{errno, std::generic_category(), "failed to wait for events"};
+    }
+
+    Events events{.wake_time = std::chrono::steady_clock::now()};
+
+    for (const auto& e : std::span{ready}.first(static_cast<std::size_t>(n))) {
+      if (e.data.fd == STDIN_FILENO) {
+        events.input = true;
+
+        // At end of input or on a hang-up, stdin stays readable with nothing to read, and every wait would return at once.
+        if ((e.events & (EPOLLHUP | EPOLLERR)) != 0) {
+          events.hangup = true;
+          epoll_ctl(epoll_.fd, EPOLL_CTL_DEL, STDIN_FILENO, nullptr);
+        }
+      } else if (e.data.fd == timer_.fd) {
+        std::uint64_t expirations{};
+        events.tick = read(timer_.fd, &expirations, sizeof(expirations)) == sizeof(expirations);
+      } else if (e.data.fd == signal_.fd) {
+        signalfd_siginfo info{};
+        while (read(signal_.fd, &info, sizeof(info)) == sizeof(info)) {
+          events.resize = true; // Drain all pending resize signals, we only need to handle the last one.
+        }
+      }
+    }
+
+    return events;
+  }
+};
+
+/// Rectangular grid of bits, packed per row in 64-bit words.
+struct BitGrid {
+  BitGrid(unsigned int width_, unsigned int height_)
+    : width{width_}
+    , height{height_}
+    , words_per_row{(width_ + 63) / 64}
+    , words(static_cast<std::size_t>(words_per_row) * height_) {
+  }
+
+  [[nodiscard]] bool test(unsigned int x, unsigned int y) const {
+    return ((words[index(x, y)] >> (x % 64)) & 1) != 0;
+  }
+
+  void set(unsigned int x, unsigned int y) {
+    words[index(x, y)] |= std::uint64_t{1} << (x % 64);
+  }
+
+  ///
+  /// Check if any bit in the given rectangle is set, using word-wide bit masks. Parts of the rectangle outside of the grid are ignored.
+  /// If a filter grid of equal dimensions is given, only bits that are set in both grids count.
+  ///
+  [[nodiscard]] bool any(unsigned int x, unsigned int y, unsigned int w, unsigned int h, const BitGrid* filter = nullptr) const {
+    const unsigned int x_end = std::min(x + w, width);
+    const unsigned int y_end = std::min(y + h, height);
+
+    for (unsigned int yy = y; yy < y_end; yy++) {
+      for (unsigned int xx = x; xx < x_end; xx = (xx / 64 + 1) * 64) { // One iteration per 64-bit word.
+        const unsigned int  n    = std::min(x_end - xx, 64 - (xx % 64));
+        const std::uint64_t mask = (n == 64) ? ~std::uint64_t{0} : ((std::uint64_t{1} << n) - 1) << (xx % 64);
+        const std::size_t   i    = index(xx, yy);
+
+        if ((words[i] & (filter != nullptr ? filter->words[i] : ~std::uint64_t{0}) & mask) != 0) {
+          return true;
+        }
+      }
+    }
+
+    return false;
+  }
+
+  /// Merge (OR) another grid of equal dimensions into this one and clear the other grid. Calls `on_set` for each newly set bit.
+  void merge_from(BitGrid& other, std::invocable<unsigned int, unsigned int> auto&& on_set) {
+    for (std::size_t i = 0; i < words.size(); i++) {
+      std::uint64_t added = other.words[i] & ~words[i];
+
+      words[i] |= added;
+      other.words[i] = 0;
+
+      while (added != 0) {
+        const auto bit = static_cast<unsigned int>(std::countr_zero(added));
+        on_set(static_cast<unsigned int>((i % words_per_row) * 64) + bit, static_cast<unsigned int>(i / words_per_row));
+        added &= added - 1; // Clear the lowest set bit.
+      }
+    }
+  }
+
+  unsigned int               width;
+  unsigned int               height;
+  unsigned int               words_per_row;
+  std::vector<std::uint64_t> words;
+
+private:
+  [[nodiscard]] std::size_t index(unsigned int x, unsigned int y) const {
+    return (static_cast<std::size_t>(words_per_row) * y) + (x / 64);
+  }
+};
+
+/// Abstraction over a rectangular ASCII art level map definition.
+struct LevelMap {
+  /// Constructor. Takes an ASCII art map definition where '#' are walls.
+  explicit LevelMap(std::string&& format_)
+    : format{std::move(format_)}
+    , width{static_cast<unsigned int>(format.find_first_of('\n'))}
+    , height{static_cast<unsigned int>(format.find_last_of('\n')) / width} {
+    if (width < 3 || height < 3) {
+      throw std::invalid_argument{"invalid level dimensions -- must at least be 3x3 units"};
+    }
+
+    if ((width + 1) * height != format.size()) {
+      throw std::invalid_argument{"invalid level dimensions -- must be rectangular"};
+    }
+
+    // Pack the wall elements into an occupancy grid, one bit per map block.
+    walls_ = BitGrid{width, height};
+    for (unsigned int y = 0; y < height; y++) {
+      for (unsigned int x = 0; x < width; x++) {
+        if (format[(width + 1) * y + x] == '#') {
+          walls_.set(x, y);
+        }
+      }
+    }
+  }
+
+  /// Check if any map block in the given rectangle is a wall element, optionally only counting blocks set in `filter`.
+  [[nodiscard]] bool any_wall(unsigned int x, unsigned int y, unsigned int w, unsigned int h, const BitGrid* filter = nullptr) const {
+    return walls_.any(x, y, w, h, filter);
+  }
+
+  /// Check if a coordinate on the map is out-of-bounds (OOB).
+  [[nodiscard]] bool is_oob(const Position<int>& p) const {
+    return p.x < 0 || p.y < 0 || p.x >= static_cast<int>(width) || p.y >= static_cast<int>(height);
+  }
+
+  /// Check if a coordinate on the map is a wall element.
+  [[nodiscard]] bool is_wall(const Position<int>& p) const {
+    return !is_oob(p) && format.at((width + 1) * static_cast<unsigned int>(p.y) + static_cast<unsigned int>(p.x)) == '#';
+  }
+
+  const std::string  format;
+  const unsigned int width;
+  const unsigned int height;
+
+private:
+  BitGrid walls_{0, 0}; // Wall occupancy grid.
+};
+
+/// Player state manager.
+struct Player {
+  Player(const Position<float>& p, float a)
+    : pos{p}
+    , angle{a} {
+  }
+
+  void move_up_if(std::invocable<Position<float>> auto&& pred) {
+    const auto pos_new = pos.adjusted(0.1f * std::sin(angle), 0.1f * std::cos(angle));
+    if (pred(pos_new)) {
+      pos = pos_new;
+    }
+  }
+
+  void move_down_if(std::invocable<Position<float>> auto&& pred) {
+    const auto pos_new = pos.adjusted(-0.1f * std::sin(angle), -0.1f * std::cos(angle));
+    if (pred(pos_new)) {
+      pos = pos_new;
+    }
+  }
+
+  void turn_ccw() {
+    angle = std::fmod(angle - 0.1f + PI2, PI2);
+  }
+
+  void turn_cw() {
+    angle = std::fmod(angle + 0.1f, PI2);
+  }
+
+  Position<float> pos;   // Current position in [map block units].
+  float           angle; // Current orientation angle in [radians].
+};
+
+/// Result of casting a single ray.
+struct RayHit {
+  float dist  = 0.0f;  // Distance to the wall (or maximum depth) in [map block units].
+  bool  bound = false; // Indicates wall block boundary.
+};
+
+namespace {
+
+///
+/// Cast a single ray from a position until it hits a wall, the level edge or the maximum depth.
+/// As a side effect, all map blocks the ray passes through are marked in `visited`.
+///
+[[nodiscard]] RayHit cast_ray(const LevelMap& map, const Position<float>& pos, float ray_angle, BitGrid& visited) {
+  const float norm_x = std::sin(ray_angle);
+  const float norm_y = std::cos(ray_angle);
+
+  RayHit result;
+  bool   hit = false; // Indicates 'ray hit'.
+  while (!hit && (result.dist < MAX_DEPTH)) {
+    result.dist += 0.1f;
+
+    const int xx = static_cast<int>(std::round(pos.x + norm_x * result.dist));
+    const int yy = static_cast<int>(std::round(pos.y + norm_y * result.dist));
+
+    const bool oob      = map.is_oob({xx, yy});
+    const bool hit_wall = map.is_wall({xx, yy});
+    hit                 = oob || hit_wall;
+
+    if (!oob) {
+      visited.set(static_cast<unsigned int>(xx), static_cast<unsigned int>(yy));
+    }
+
+    if (hit_wall) {
+      std::array<std::pair<float, float>, 4> corners; // Distances and dot products per wall block corner.
+
+      for (int tx = 0; tx < 2; tx++) {
+        for (int ty = 0; ty < 2; ty++) {
+          const float vx                                    = static_cast<float>(xx + tx) - pos.x;
+          const float vy                                    = static_cast<float>(yy + ty) - pos.y;
+          const float d                                     = std::sqrt(vx * vx + vy * vy);
+          corners.at(static_cast<std::size_t>(ty * 2 + tx)) = std::make_pair(d, (norm_x * vx / d) + (norm_y * vy / d));
+        }
+      }
+
+      std::ranges::sort(corners, [](const auto& a, const auto& b) { return a.first < b.first; });
+
+      result.bound = (std::acos(corners.at(0).second) < 0.01f) || (std::acos(corners.at(1).second) < 0.01f);
+    }
+  }
+
+  return result;
+}
+
+///
+/// Persistent pool of worker threads, to run a job in parallel for every frame without starting threads for each.
+///
+/// The calling thread takes part as worker 0, so a pool of n workers has n - 1 threads of its own. The threads meet at a barrier to
+/// start a job, and at another one when it is done.
+///
+class WorkerPool {
+public:
+  explicit WorkerPool(std::size_t workers)
+    : start_{static_cast<std::ptrdiff_t>(workers)}
+    , done_{static_cast<std::ptrdiff_t>(workers)} {
+    for (std::size_t worker = 1; worker < workers; worker++) {
+      threads_.emplace_back([this, worker] {
+        for (start_.arrive_and_wait(); !stop_; start_.arrive_and_wait()) {
+          (*job_)(worker);
+          done_.arrive_and_wait();
+        }
+      });
+    }
+  }
+
+  ~WorkerPool() {
+    stop_ = true;
+    start_.arrive_and_wait(); // The threads are joined after this.
+  }
+
+  WorkerPool(const WorkerPool&)            = delete;
+  WorkerPool& operator=(const WorkerPool&) = delete;
+
+  /// Run a job on all workers, with the worker index as argument, and wait until all are done.
+  void run(const std::function<void(std::size_t)>& job) {
+    job_ = &job;
+    start_.arrive_and_wait();
+    job(0);
+    done_.arrive_and_wait();
+  }
+
+private:
+  std::barrier<>                          start_;
+  std::barrier<>                          done_;
+  const std::function<void(std::size_t)>* job_  = nullptr;
+  bool                                    stop_ = false; // Written before, and read after the start barrier.
+  std::vector<std::jthread>               threads_;      // Last, so these are joined before the barriers go.
+};
+
+[[nodiscard]] constexpr int distance_to_wall_shade(float d) {
+  if (d < MAX_DEPTH) {
+    const float shade = std::clamp(MAX_DEPTH - (2.0f * d), 0.0f, MAX_DEPTH);
+    return WALL_SHADES.at(WALL_SHADES.size() - 1 - static_cast<std::size_t>(shade * (WALL_SHADES.size() / MAX_DEPTH)));
+  } else {
+    return WALL_COLOR_X;
+  }
+}
+
+[[nodiscard]] constexpr std::string angle_to_char(float a) {
+  constexpr float D = PI / 8.0f;
+
+  if (a > (PI2 - D) || a <= D) {
+    return "\u21D3"; // Downwards arrow.
+  } else if (a > D && a <= (D * 3.0f)) {
+    return "\u21D8"; // South East arrow.
+  } else if (a > (D * 3.0f) && a <= (D * 5.0f)) {
+    return "\u21D2"; // Rightwards arrow.
+  } else if (a > (D * 5.0f) && a <= (PI - D)) {
+    return "\u21D7"; // North East arrow.
+  } else if (a > (PI - D) && a <= (PI + D)) {
+    return "\u21D1"; // Upwards arrow.
+  } else if (a > (PI + D) && a <= (PI + (D * 3.0f))) {
+    return "\u21D6"; // North West arrow.
+  } else if (a > (PI + (D * 3.0f)) && a <= (PI + (D * 5.0f))) {
+    return "\u21D0"; // Leftwards arrow.
+  } else {
+    return "\u21D9"; // South West arrow.
+  }
+}
+
+/// Append the UTF-8 encoding of the Unicode braille pattern with the given dots (U+2800 to U+28FF) to a string.
+void append_braille(std::string& s, std::uint8_t dots) {
+  s += static_cast<char>(0xE2);
+  s += static_cast<char>(0xA0 | (dots >> 6));
+  s += static_cast<char>(0x80 | (dots & 0x3F));
+}
+
+///
+/// Save the session state (player state and explored map blocks) to a file on disk.
+///
+/// The file format is plain text: a header line, the level dimensions, the player state and the explored bit grid words in hexadecimal.
+///
+void save_session(const std::string& path, const Player& p, const BitGrid& explored) {
+  std::ofstream file{path};
+  if (!file) {
+    throw std::runtime_error{fmt::format("failed to open session file '{}' for writing", path)};
+  }
+
+  file << fmt::format("raycasting-session 1\n{} {}\n{} {} {}\n", explored.width, explored.height, p.pos.x, p.pos.y, p.angle);
+
+  for (std::size_t i = 0; i < explored.words.size(); i++) {
+    file << fmt::format("{:016x}{}", explored.words[i], ((i + 1) % explored.words_per_row == 0) ? '\n' : ' ');
+  }
+
+  if (!file) {
+    throw std::runtime_error{fmt::format("failed to write session file '{}'", path)};
+  }
+}
+
+///
+/// Load the session state from a file on disk, see `save_session`.
+///
+/// \returns False if there is no such session file, true if it was loaded.
+///
+/// \throws An exception if the session file is invalid or doesn't match the level dimensions.
+///
+[[nodiscard]] bool load_session(const std::string& path, Player& p, BitGrid& explored) {
+  std::ifstream file{path};
+  if (!file) {
+    return false;
+  }
+
+  std::string  magic;
+  unsigned int version{}, width{}, height{};
+  file >> magic >> version >> width >> height >> p.pos.x >> p.pos.y >> p.angle;
+
+  if (!file || magic != "raycasting-session" || version != 1) {
+    throw std::runtime_error{fmt::format("invalid session file '{}'", path)};
+  }
+
+  if (width != explored.width || height != explored.height) {
+    throw std::runtime_error{fmt::format("session file '{}' does not match the level dimensions", path)};
+  }
+
+  // The position must round to a map block, written so that NaN fails too.
+  if (!(p.pos.x >= 0.0f && p.pos.y >= 0.0f && p.pos.x <= static_cast<float>(width - 1) && p.pos.y <= static_cast<float>(height - 1))) {
+    throw std::runtime_error{fmt::format("session file '{}' puts the player outside the level", path)};
+  }
+
+  for (auto& word : explored.words) {
+    file >> std::hex >> word;
+  }
+
+  if (!file) {
+    throw std::runtime_error{fmt::format("invalid session file '{}'", path)};
+  }
+
+  return true;
+}
+
+/// Read a level map definition from a file on disk.
+[[nodiscard]] std::string read_level_file(const char* path) {
+  std::ifstream file{path};
+  if (!file) {
+    throw std::runtime_error{fmt::format("failed to open level map file '{}'", path)};
+  }
+
+  std::stringstream contents;
+  contents << file.rdbuf();
+
+  return contents.str();
+}
+
+} // namespace
+
+/// Mini-map renderer, showing the explored part of the level map as plain text, or as Unicode braille glyphs of 2x4 dots per screen cell.
+struct MiniMap {
+  enum class Mode : uint8_t { Text, Braille };
+
+private:
+  /// Braille pattern bit per dot row (top to bottom) for the left and right dot column.
+  static constexpr std::array<std::array<std::uint8_t, 2>, 4> DOT_BITS{{{0x01, 0x08}, {0x02, 0x10}, {0x04, 0x20}, {0x40, 0x80}}};
+
+  const LevelMap& map_;
+  const BitGrid&  explored_;
+  unsigned int    zoom_ = 1; // Number of map block units per braille dot (horizontally and vertically).
+  Mode            mode_;
+
+  std::vector<std::optional<std::uint8_t>> glyphs_;            // Braille dot patterns for the current zoom level, computed on first use.
+  unsigned int                             glyphs_width_  = 0; // Braille mini-map width for the whole level in [screen cells].
+  unsigned int                             glyphs_height_ = 0; // Braille mini-map height for the whole level in [screen cells].
+
+  /// Get the braille dot pattern at the given glyph coordinates. A dot is set if any explored map block it covers is a wall element.
+  [[nodiscard]] std::uint8_t glyph(unsigned int gx, unsigned int gy) {
+    auto& g = glyphs_[(glyphs_width_ * gy) + gx];
+
+    if (!g) {
+      std::uint8_t dots = 0;
+      for (unsigned int dy = 0; dy < 4; dy++) {
+        for (unsigned int dx = 0; dx < 2; dx++) {
+          if (map_.any_wall(((gx * 2) + dx) * zoom_, ((gy * 4) + dy) * zoom_, zoom_, zoom_, &explored_)) {
+            dots |= DOT_BITS.at(dy).at(dx);
+          }
+        }
+      }
+
+      g = dots;
+    }
+
+    return *g;
+  }
+
+  void reset_glyphs() {
+    glyphs_width_  = (map_.width + (2 * zoom_) - 1) / (2 * zoom_);
+    glyphs_height_ = (map_.height + (4 * zoom_) - 1) / (4 * zoom_);
+    glyphs_.assign(static_cast<std::size_t>(glyphs_width_) * glyphs_height_, std::nullopt);
+  }
+
+public:
+  /// Constructor. Defaults to braille mode when the level map is too large to show as text in the mini-map area.
+  MiniMap(const LevelMap& map, const BitGrid& explored)
+    : map_{map}
+    , explored_{explored}
+    , mode_{(map.width <= 2 * MINIMAP_WIDTH && map.height <= 4 * MINIMAP_HEIGHT) ? Mode::Text : Mode::Braille} {
+    reset_glyphs();
+  }
+
+  /// Invalidate the cached glyph covering the given map block, e.g. because it was newly explored.
+  void invalidate(unsigned int x, unsigned int y) {
+    glyphs_[(glyphs_width_ * (y / (4 * zoom_))) + (x / (2 * zoom_))].reset();
+  }
+
+  void toggle_mode() {
+    mode_ = (mode_ == Mode::Text) ? Mode::Braille : Mode::Text;
+  }
+
+  void zoom_in() {
+    if (zoom_ > 1) {
+      zoom_ /= 2;
+      reset_glyphs();
+    }
+  }
+
+  void zoom_out() {
+    if (zoom_ < MINIMAP_MAX_ZOOM) {
+      zoom_ *= 2;
+      reset_glyphs();
+    }
+  }
+
+  /// Size of the screen area covered by the mini-map in [screen cells].
+  [[nodiscard]] Position<unsigned int> size(const Screen& s) const {
+    if (mode_ == Mode::Text) {
+      return {std::min(map_.width, s.width), std::min(map_.height, s.height)};
+    } else {
+      return {std::min({MINIMAP_WIDTH, glyphs_width_, s.width}), std::min({MINIMAP_HEIGHT, glyphs_height_, s.height})};
+    }
+  }
+
+  /// Draw the mini-map in the top left corner of the screen. The braille mini-map view follows the player.
+  void draw(const Screen& s, const Player& p) {
+    const auto [w, h] = size(s);
+
+    if (mode_ == Mode::Text) {
+      std::string row;
+      for (unsigned int y = 0; y < h; y++) {
+        row = map_.format.substr((map_.width + 1) * y, w);
+        for (unsigned int x = 0; x < w; x++) {
+          if (!explored_.test(x, y)) {
+            row[x] = ' ';
+          }
+        }
+
+        s.print({0u, y}, row);
+      }
+
+      s.print(p.pos, angle_to_char(p.angle));
+      return;
+    }
+
+    const Position<int> player{p.pos};
+    const unsigned int  player_gx = static_cast<unsigned int>(std::max(player.x, 0)) / (2 * zoom_);
+    const unsigned int  player_gy = static_cast<unsigned int>(std::max(player.y, 0)) / (4 * zoom_);
+    const unsigned int  origin_gx = std::min(player_gx - std::min(player_gx, w / 2), glyphs_width_ - w);
+    const unsigned int  origin_gy = std::min(player_gy - std::min(player_gy, h / 2), glyphs_height_ - h);
+
+    std::string row;
+    for (unsigned int y = 0; y < h; y++) {
+      row.clear();
+
+      for (unsigned int x = 0; x < w; x++) {
+        const unsigned int gx = origin_gx + x;
+        const unsigned int gy = origin_gy + y;
+
+        if (gx == player_gx && gy == player_gy) {
+          row += angle_to_char(p.angle);
+        } else {
+          append_braille(row, glyph(gx, gy));
+        }
+      }
+
+      s.print({0u, y}, row);
+    }
+  }
+};
+
+int main(int argc, char** argv) {
+  try {
+    if (std::setlocale(LC_ALL, "") == nullptr) { // Required for Unicode support.
+      throw std::runtime_error{"failed to set locale"};
+    }
+
+    constexpr std::string_view DEFAULT_LEVEL{"####################\n"
+                                             "#   ##             #\n"
+                                             "#   ##             #\n"
+                                             "#                  #\n"
+                                             "#         ##########\n"
+                                             "#                  #\n"
+                                             "######             #\n"
+                                             "#    #      ###    #\n"
+                                             "#    #      ###    #\n"
+                                             "#                  #\n"
+                                             "#                  #\n"
+                                             "####################\n"};
+
+    // Command-line arguments: [--session <session file>] [<level file>]
+    std::optional<std::string> level_path;
+    std::optional<std::string> session_path;
+    for (const std::string_view arg : std::span{argv, static_cast<std::size_t>(argc)}.subspan(1)) {
+      if (arg == "--session") {
+        session_path = "";
+      } else if (session_path && session_path->empty()) {
+        session_path = arg;
+      } else {
+        level_path = arg;
+      }
+    }
+
+    const LevelMap MAP{level_path ? read_level_file(level_path->c_str()) : std::string{DEFAULT_LEVEL}};
+
+    Player  p{{7.0f, 1.0f}, 0.0f};
+    BitGrid explored{MAP.width, MAP.height}; // Map blocks seen by any ray so far.
+
+    if (session_path && !session_path->empty()) {
+      static_cast<void>(load_session(*session_path, p, explored)); // A missing session file simply starts a new session.
+    }
+
+    if (MAP.is_oob(p.pos) || MAP.is_wall(p.pos)) {
+      throw std::invalid_argument{"invalid level -- the player start position is out of bounds or a wall element"};
+    }
+
+    // Per-worker bit grids for the map blocks visited by rays, merged into the explored map after each frame.
+    std::vector<BitGrid> visited(std::max(1u, std::thread::hardware_concurrency()), BitGrid{MAP.width, MAP.height});
+    WorkerPool           pool{visited.size()};
+    std::vector<RayHit>  hits;
+
+    const EventLoop loop; // Must be created before the screen, see constructor.
+    Screen          s;
+    MiniMap         mini_map{MAP, explored};
+
+    bool dirty        = true;                                    // Indicates whether a new frame must be rendered.
+    auto t_dirty      = std::chrono::steady_clock::now();        // Wake-up time of the event that made the frame dirty.
+    auto t_last_frame = std::chrono::steady_clock::time_point{}; // Start time of the last rendered frame.
+
+    while (true) {
+      const auto t_start = std::chrono::steady_clock::now();
+
+      if (!dirty || (t_start - t_last_frame) < MIN_FRAME_TIME) {
+        if (dirty) {
+          loop.schedule_tick(MIN_FRAME_TIME - (t_start - t_last_frame)); // Too soon after the last frame, defer it.
+        }
+
+        const auto events    = loop.wait();
+        const bool was_dirty = dirty;
+
+        if (events.resize) {
+          s.resize();
+          dirty = true;
+        }
+
+        if (events.input) {
+          for (auto key = s.get_key(); key != Screen::Key::None; key = s.get_key()) { // Drain all pending input.
+            switch (key) {
+              using enum Screen::Key;
+            case Up: p.move_up_if([&](const auto& pos) { return !MAP.is_wall(pos); }); break;
+            case Down: p.move_down_if([&](const auto& pos) { return !MAP.is_wall(pos); }); break;
+            case Left: p.turn_ccw(); break;
+            case Right: p.turn_cw(); break;
+            case MiniMapMode: mini_map.toggle_mode(); break;
+            case ZoomIn: mini_map.zoom_in(); break;
+            case ZoomOut: mini_map.zoom_out(); break;
+            case Other:
+            case None: continue;
+            case Quit:
+              if (session_path && !session_path->empty()) {
+                save_session(*session_path, p, explored);
+              }
+
+              return EXIT_SUCCESS;
+            }
+
+            dirty = true;
+          }
+        }
+
+        // Without input there is no other way to quit, so quit like with the key.
+        if (events.hangup) {
+          if (session_path && !session_path->empty()) {
+            save_session(*session_path, p, explored);
+          }
+
+          return EXIT_SUCCESS;
+        }
+
+        // Note: a timer tick by itself changes nothing here, it only wakes us up to render a deferred frame.
+
+        if (dirty && !was_dirty) {
+          t_dirty = events.wake_time;
+        }
+
+        continue;
+      }
+
+      // Cast all rays in parallel bands of screen columns. Each worker marks the map blocks its rays pass through in its own bit grid.
+      hits.resize(s.width);
+
+      const auto cast_band = [&](std::size_t worker) {
+        const std::size_t band = (hits.size() + visited.size() - 1) / visited.size();
+        for (std::size_t x = worker * band; x < std::min((worker + 1) * band, hits.size()); x++) {
+          const float ray_angle = p.angle - (FOV / 2) + (static_cast<float>(x) * FOV) / static_cast<float>(s.width);
+          hits[x]               = cast_ray(MAP, p.pos, ray_angle, visited[worker]);
+        }
+      };
+
+      pool.run(cast_band);
+
+      for (auto& v : visited) {
+        explored.merge_from(v, [&](unsigned int x, unsigned int y) { mini_map.invalidate(x, y); });
+      }
+
+      // Display mini-map and player location / orientation.
+      mini_map.draw(s, p);
+      const auto mini_map_size = mini_map.size(s);
+
+      for (unsigned int x = 0; x < s.width; x++) {
+        const auto [dist_wall, bound] = hits[x];
+
+        const long dist_ceiling = static_cast<long>(std::round((static_cast<float>(s.height) / 2.0f) - (static_cast<float>(s.height) / dist_wall)));
+        const long dist_floor   = static_cast<long>(std::round(s.height - dist_ceiling));
+        const int  wall_shade   = distance_to_wall_shade(dist_wall);
+
+        for (unsigned int y = 0; y < s.height; y++) {
+          if (x >= mini_map_size.x || y >= mini_map_size.y) {
+            if (y < dist_ceiling) {
+              s.print({x, y}, " "); // Ceiling.
+            } else if (y > dist_ceiling && y <= dist_floor) {
+              attron(COLOR_PAIR(wall_shade));
+              if (bound) {
+                s.print({x, y}, "\u2593"); // Wall bound.
+              } else {
+                s.print({x, y}, "\u2588"); // Wall.
+              }
+              attroff(COLOR_PAIR(wall_shade));
+            } else {
+              const float d = 1.0f - ((static_cast<float>(y) - (static_cast<float>(s.height) / 2.0f)) / (static_cast<float>(s.height) / 2.0f));
+              s.print({x, y}, [&] { // Floor.
+                if (d < 0.25f) {
+                  return "#";
+                } else if (d < 0.5f) {
+                  return "x";
+                } else if (d < 0.75f) {
+                  return "-";
+                } else if (d < 0.9f) {
+                  return ".";
+                } else {
+                  return " ";
+                }
+              }());
+            }
+          }
+        }
+      }
+
+      const auto t_end     = std::chrono::steady_clock::now();
+      const auto t_elapsed = std::chrono::duration_cast<std::chrono::microseconds>(t_end - t_start);
+      const auto t_latency = std::chrono::duration_cast<std::chrono::microseconds>(t_end - t_dirty);
+      s.print({0u, s.height - 1},
+              fmt::format("Frame rate: {:.0f} FPS, wake-up-to-frame latency: {} us", 1e6f / static_cast<float>(t_elapsed.count()), t_latency.count()));
+
+      s.update();
+
+      dirty        = false;
+      t_last_frame = t_start;
+    }
+  } catch (const std::exception& e) {
+    std::cerr << "Error: " << e.what() << '\n';
+    return EXIT_FAILURE;
+  }
+}
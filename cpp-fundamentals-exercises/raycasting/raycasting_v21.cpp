@@ -0,0 +1,1486 @@
+extern "C" {
+#include <curses.h>
+#include <signal.h>
+#include <sys/epoll.h>
+#include <sys/ioctl.h>
+#include <sys/signalfd.h>
+#include <sys/timerfd.h>
+#include <unistd.h>
+}
+
+#include <fmt/core.h>
+
+#include <algorithm>
+#include <array>
+#include <barrier>
+#include <bit>
+#include <cerrno>
+#include <chrono>
+#include <clocale>
+#include <cmath>
+#include <cstdint>
+#include <cstdlib>
+#include <exception>
+#include <fstream>
+#include <functional>
+#include <iostream>
+#include <numbers>
+#include <optional>
+#include <random>
+#include <span>
+#include <sstream>
+#include <stdexcept>
+#include <string>
+#include <string_view>
+#include <system_error>
+#include <thread>
+#include <type_traits>
+#include <utility>
+#include <variant>
+#include <vector>
+
+namespace helpers {
+
+template<std::size_t Offset, std::size_t... Is>
+constexpr std::index_sequence<(Offset + Is)...> add_offset(std::index_sequence<Is...>) {
+  return {};
+}
+
+template<std::size_t Offset, std::size_t N>
+constexpr auto make_index_sequence_with_offset() {
+  return add_offset<Offset>(std::make_index_sequence<N>{});
+}
+
+/// Generate an array with offset indexes as values, at compile-time.
+template<typename T, std::size_t N, std::size_t Offset>
+constexpr auto make_array_with_indices() {
+  return []<std::size_t... Is>(std::index_sequence<Is...>) { return std::array<T, N>{Is...}; }(make_index_sequence_with_offset<Offset, N>());
+}
+
+} // namespace helpers
+
+constexpr int          WALL_COLOR_X          = 10; // Black/background.
+constexpr unsigned int NUMBER_OF_WALL_SHADES = 16;
+constexpr auto         WALL_SHADES           = helpers::make_array_with_indices<int, NUMBER_OF_WALL_SHADES, 11>(); // 11, 12, 13, ...
+
+constexpr float PI        = std::numbers::pi_v<float>;
+constexpr float PI2       = PI * 2.0f;
+constexpr float FOV       = PI / 3.0f; // Field of view in [radians].
+constexpr float MAX_DEPTH = 15.0f;     // Maximum visible depth in [map block units].
+
+constexpr std::chrono::microseconds MIN_FRAME_TIME{16'667}; // Frame pacing: render at most ~60 frames per second.
+
+constexpr unsigned int MINIMAP_WIDTH    = 24; // Braille mini-map width in [screen cells].
+constexpr unsigned int MINIMAP_HEIGHT   = 8;  // Braille mini-map height in [screen cells].
+constexpr unsigned int MINIMAP_MAX_ZOOM = 64; // Maximum number of map block units per braille dot (horizontally and vertically).
+
+constexpr unsigned int HEADLESS_WIDTH  = 160; // Headless rendering framebuffer width in [screen cells].
+constexpr unsigned int HEADLESS_HEIGHT = 48;  // Headless rendering framebuffer height in [screen cells].
+
+/// Any arithmetic type (scalar or floating-point).
+template<typename T>
+concept arithmetic = std::is_arithmetic_v<T>;
+
+/// 2D position.
+template<arithmetic T>
+struct Position {
+  constexpr Position(T x, T y)
+    : x{x}
+    , y{y} {
+  }
+
+  template<arithmetic U>
+  constexpr Position(U x, U y)
+    : x{static_cast<T>(std::round(x))}
+    , y{static_cast<T>(std::round(y))} {
+  }
+
+  template<arithmetic U>
+  constexpr Position(const Position<U>& p) // NOLINT(hicpp-explicit-conversions)
+    : x{static_cast<T>(std::round(p.x))}
+    , y{static_cast<T>(std::round(p.y))} {
+  }
+
+  constexpr Position<T> adjusted(T dx, T dy) {
+    return Position(x + dx, y + dy);
+  }
+
+  T x, y;
+};
+
+/// A single character cell on screen.
+struct Cell {
+  const char* glyph = " "; // UTF-8 encoded glyph, always a string literal.
+  int         color = 0;   // Color pair, or zero for the default colors.
+
+  bool operator==(const Cell&) const = default;
+};
+
+/// Off-screen buffer of character cells, stored column by column so every screen column is a single contiguous run of cells.
+struct Framebuffer {
+  Framebuffer(unsigned int w, unsigned int h)
+    : width{w}
+    , height{h}
+    , cells(static_cast<std::size_t>(w) * h) {
+  }
+
+  void resize(unsigned int w, unsigned int h) {
+    width  = w;
+    height = h;
+    cells.assign(static_cast<std::size_t>(w) * h, Cell{});
+  }
+
+  [[nodiscard]] std::span<Cell> column(unsigned int x) {
+    return std::span{cells}.subspan(static_cast<std::size_t>(height) * x, height);
+  }
+
+  [[nodiscard]] const Cell& at(unsigned int x, unsigned int y) const {
+    return cells[(static_cast<std::size_t>(height) * x) + y];
+  }
+
+  unsigned int      width;
+  unsigned int      height;
+  std::vector<Cell> cells;
+};
+
+/// Wrapper around the default 'stdscr' window in ncurses.
+struct Screen {
+private:
+  const WINDOW* const window_;
+
+public:
+  enum class Key : uint8_t { Up, Down, Left, Right, MiniMapMode, ZoomIn, ZoomOut, Quit, Other, None };
+
+  Screen()
+    : window_{initscr()}
+    , width{static_cast<unsigned int>(getmaxx(stdscr))}
+    , height{static_cast<unsigned int>(getmaxy(stdscr))} {
+    cbreak();    // Break on character input (i.e. don't wait for enter).
+    noecho();    // Don't echo input keys.
+    curs_set(0); // Disable cursor.
+
+    if (!window_) {
+      throw std::runtime_error{"failed to initialize screen"};
+    }
+
+    // Delay-less operation of ncurses: waiting for input is done by the event loop, not by ncurses.
+    nodelay(stdscr, TRUE);
+
+    if (has_colors() == FALSE) {
+      throw std::runtime_error{"your terminal does not support color"};
+    }
+
+    start_color();
+
+    init_color(COLOR_BLACK, 0, 0, 0); // Reinitialize black to be really dark.
+    init_pair(WALL_COLOR_X, COLOR_BLACK, COLOR_BLACK);
+
+    // Note: we overlap the IDs for colors and color pairs. Not as ncurses intended, but OK for this example.
+    for (unsigned int i = 0; i < WALL_SHADES.size(); i++) {
+      const int v     = 1000 - static_cast<int>(i * (1000 / WALL_SHADES.size()));
+      const int shade = WALL_SHADES.at(i);
+      init_extended_color(shade, v, v, v);
+      init_extended_pair(shade, shade, COLOR_BLACK);
+    }
+
+    // Override default foreground/background colors as white on black.
+    init_pair(1, COLOR_WHITE, COLOR_BLACK);
+    attron(COLOR_PAIR(1));
+  }
+
+  ~Screen() {
+    endwin();
+  }
+
+  Screen(Screen&&) noexcept            = default;
+  Screen& operator=(Screen&&) noexcept = delete;
+
+  /// Write console buffer to screen.
+  void update() {
+    refresh();
+  }
+
+  /// Print string to specific coordinates in console buffer.
+  void print(const Position<int>& p, std::string_view s) const {
+    mvaddstr(p.y, p.x, s.data());
+  }
+
+  /// Copy a framebuffer to the console buffer.
+  void draw(const Framebuffer& fb) const {
+    for (unsigned int y = 0; y < std::min(fb.height, height); y++) {
+      for (unsigned int x = 0; x < std::min(fb.width, width); x++) {
+        const Cell& cell = fb.at(x, y);
+        if (cell.color != 0) {
+          attron(COLOR_PAIR(cell.color));
+        }
+
+        mvaddstr(static_cast<int>(y), static_cast<int>(x), cell.glyph);
+
+        if (cell.color != 0) {
+          attroff(COLOR_PAIR(cell.color));
+        }
+      }
+    }
+  }
+
+  /// Capture input key, returns `Key::None` if no (more) input is available.
+  [[nodiscard]] Key get_key() const {
+    switch (getch()) {
+    case ERR: return Key::None;
+    case 'w': return Key::Up;
+    case 's': return Key::Down;
+    case 'a': return Key::Left;
+    case 'd': return Key::Right;
+    case 'm': return Key::MiniMapMode;
+    case '+': return Key::ZoomIn;
+    case '-': return Key::ZoomOut;
+    case 'q': return Key::Quit;
+    default: return Key::Other;
+    }
+  }
+
+  /// Adopt the current terminal dimensions after a resize.
+  void resize() {
+    winsize ws{};
+    if (ioctl(STDOUT_FILENO, TIOCGWINSZ, &ws) == 0) {
+      resizeterm(ws.ws_row, ws.ws_col);
+    }
+
+    width  = static_cast<unsigned int>(getmaxx(stdscr));
+    height = static_cast<unsigned int>(getmaxy(stdscr));
+
+    clear();
+  }
+
+  unsigned int width;
+  unsigned int height;
+};
+
+// Screen should be stationary resource handle (tests will fail at build time).
+static_assert(std::is_nothrow_destructible_v<Screen>);
+static_assert(std::is_default_constructible_v<Screen>);
+static_assert(!std::is_copy_constructible_v<Screen>);
+static_assert(!std::is_copy_assignable_v<Screen>);
+static_assert(std::is_nothrow_move_constructible_v<Screen>);
+static_assert(!std::is_nothrow_move_assignable_v<Screen>);
+
+/// Owning handle for a POSIX file descriptor.
+struct FileDescriptor {
+  FileDescriptor(int fd_, const char* what)
+    : fd{fd_} {
+    if (fd < 0) {
+      throw std::system_error{errno, std::generic_category(), what};
+    }
+  }
+
+  ~FileDescriptor() {
+    close(fd);
+  }
+
+  FileDescriptor(const FileDescriptor&)            = delete;
+  FileDescriptor& operator=(const FileDescriptor&) = delete;
+
+  const int fd;
+};
+
+/// Blocking wait for keyboard input, timer expiry and terminal resizes all at once, using epoll.
+struct EventLoop {
+private:
+  /// Block SIGWINCH for normal delivery, and create a signal file descriptor for it instead.
+  [[nodiscard]] static int make_resize_signal_fd() {
+    sigset_t mask;
+    sigemptyset(&mask);
+    sigaddset(&mask, SIGWINCH);
+
+    if (sigprocmask(SIG_BLOCK, &mask, nullptr) != 0) {
+      throw std::system_error{errno, std::generic_category(), "failed to block resize signal"};
+    }
+
+    return signalfd(-1, &mask, SFD_NONBLOCK | SFD_CLOEXEC);
+  }
+
+  void watch(int fd) const {
+    epoll_event event{};
+    event.events  = EPOLLIN;
+    event.data.fd = fd;
+
+    if (epoll_ctl(epoll_.fd, EPOLL_CTL_ADD, fd, &event) != 0) {
+      throw std::system_error{errno, std::generic_category(), "failed to add file descriptor to epoll"};
+    }
+  }
+
+  const FileDescriptor signal_;
+  const FileDescriptor timer_;
+  const FileDescriptor epoll_;
+
+public:
+  /// The set of events that woke up a single wait.
+  struct Events {
+    bool input  = false; // Keyboard input available on stdin.
+    bool hangup = false; // End of input, or stdin hung up: no more keys will come, and stdin is no longer watched.
+    bool tick   = false; // Timer expired.
+    bool resize = false; // Terminal was resized.
+
+    std::chrono::steady_clock::time_point wake_time; // Time of wake-up.
+  };
+
+  /// Constructor. Must be called before the screen is initialized, so that ncurses does not handle SIGWINCH itself.
+  EventLoop()
+    : signal_{make_resize_signal_fd(), "failed to create signal file descriptor"}
+    , timer_{timerfd_create(CLOCK_MONOTONIC, TFD_NONBLOCK | TFD_CLOEXEC), "failed to create timer file descriptor"}
+    , epoll_{epoll_create1(EPOLL_CLOEXEC), "failed to create epoll file descriptor"} {
+    watch(STDIN_FILENO);
+    watch(signal_.fd);
+    watch(timer_.fd);
+  }
+
+  /// Arm the timer to expire once after the given delay. Re-arming replaces any pending expiry.
+  void schedule_tick(std::chrono::nanoseconds delay) const {
+    const auto s = std::chrono::duration_cast<std::chrono::seconds>(delay);
+
+    itimerspec spec{};
+    spec.it_value.tv_sec  = static_cast<time_t>(s.count());
+    spec.it_value.tv_nsec = std::max(static_cast<long>((delay - s).count()), 1L); // A zero value would disarm the timer.
+
+    if (timerfd_settime(timer_.fd, 0, &spec, nullptr) != 0) {
+      throw std::system_error{errno, std::generic_category(), "failed to arm timer"};
+    }
+  }
+
+  /// Block until at least one event occurred. This is where the program spends its idle time, without using the CPU.
+  [[nodiscard]] Events wait() const {
+    std::array<epoll_event, 3> ready{};
+
+    int n = 0;
+    do {
+      n = epoll_wait(epoll_.fd, ready.data(), static_cast<int>(ready.size()), -1);
+    } while (n < 0 && errno == EINTR);
+
+    if (n < 0) {
+      throw std::system_error{errno, std::generic_category(), "failed to wait for events"};
+    }
+
+    Events events{.wake_time = std::chrono::steady_clock::now()};
+
+    for (const auto& e : std::span{ready}.first(static_cast<std::size_t>(n))) {
+      if (e.data.fd == STDIN_FILENO) {
+        events.input = true;
+
+        // At end of input or on a hang-up, stdin stays readable with nothing to read, and every wait would return at once.
+        if ((e.events & (EPOLLHUP | EPOLLERR)) != 0) {
+          events.hangup = true;
+          epoll_ctl(epoll_.fd, EPOLL_CTL_DEL, STDIN_FILENO, nullptr);
+        }
+      } else if (e.data.fd == timer_.fd) {
+        std::uint64_t expirations{};
+        events.tick = read(timer_.fd, &expirations, sizeof(expirations)) == sizeof(expirations);
+      } else if (e.data.fd == signal_.fd) {
+        signalfd_siginfo info{};
+        while (read(signal_.fd, &info, sizeof(info)) == sizeof(info)) {
+          events.resize = true; // Drain all pending resize signals, we only need to handle the last one.
+        }
+      }
+    }
+
+    return events;
+  }
+};
+
+/// Rectangular grid of bits, packed per row in 64-bit words.
+struct BitGrid {
+  BitGrid(unsigned int width_, unsigned int height_)
+    : width{width_}
+    , height{height_}
+    , words_per_row{(width_ + 63) / 64}
+    , words(static_cast<std::size_t>(words_per_row) * height_) {
+  }
+
+  [[nodiscard]] bool test(unsigned int x, unsigned int y) const {
+    return ((words[index(x, y)] >> (x % 64)) & 1) != 0;
+  }
+
+  void set(unsigned int x, unsigned int y) {
+    words[index(x, y)] |= std::uint64_t{1} << (x % 64);
+  }
+
+  /// Get the word holding the bits for columns [64 * wx, 64 * wx + 64) of row y.
+  [[nodiscard]] std::uint64_t word(unsigned int wx, unsigned int y) const {
+    return words[(static_cast<std::size_t>(words_per_row) * y) + wx];
+  }
+
+  [[nodiscard]] std::size_t memory_usage() const {
+    return words.size() * sizeof(std::uint64_t);
+  }
+
+  unsigned int               width;
+  unsigned int               height;
+  unsigned int               words_per_row;
+  std::vector<std::uint64_t> words;
+
+private:
+  [[nodiscard]] std::size_t index(unsigned int x, unsigned int y) const {
+    return (static_cast<std::size_t>(words_per_row) * y) + (x / 64);
+  }
+};
+
+///
+/// Sparse alternative to a dense `BitGrid` for large levels: a directory of 64x64 bit tiles.
+/// All tiles that are completely empty or completely solid share a single tile, so open areas and solid rock cost only a directory entry.
+///
+/// Writing to a shared tile gives it its own copy first, so a grid that starts empty only holds the tiles that were actually touched.
+///
+struct TiledBitGrid {
+  static constexpr unsigned int TILE_SIZE = 64; // Tile size in bits, equal to the word size so a tile row is a single word.
+
+  using Tile = std::array<std::uint64_t, TILE_SIZE>;
+
+  static constexpr std::uint32_t EMPTY_TILE     = 0; // Index of the shared all-empty tile.
+  static constexpr std::uint32_t SOLID_TILE     = 1; // Index of the shared all-solid tile.
+  static constexpr std::uint32_t FIRST_OWN_TILE = 2; // Index of the first tile that is not shared.
+
+  /// Constructor. Creates an empty grid, holding no tiles of its own.
+  TiledBitGrid(unsigned int width_, unsigned int height_)
+    : width{width_}
+    , height{height_}
+    , tiles_per_row{(width_ + TILE_SIZE - 1) / TILE_SIZE}
+    , directory(static_cast<std::size_t>(tiles_per_row) * ((height_ + TILE_SIZE - 1) / TILE_SIZE), EMPTY_TILE)
+    , tiles{Tile{}, [] {
+              Tile t;
+              t.fill(~std::uint64_t{0});
+              return t;
+            }()} {
+  }
+
+  /// Constructor. Packs the bits given by `is_set(x, y)` tile by tile, sharing all uniform tiles.
+  TiledBitGrid(unsigned int width_, unsigned int height_, std::invocable<unsigned int, unsigned int> auto&& is_set)
+    : TiledBitGrid{width_, height_} {
+    for (std::size_t position = 0; position < directory.size(); position++) {
+      const auto tx = static_cast<unsigned int>(position % tiles_per_row);
+      const auto ty = static_cast<unsigned int>(position / tiles_per_row);
+
+      Tile tile{};
+      for (unsigned int row = 0; row < TILE_SIZE && (ty * TILE_SIZE) + row < height; row++) {
+        for (unsigned int col = 0; col < TILE_SIZE && (tx * TILE_SIZE) + col < width; col++) {
+          if (is_set((tx * TILE_SIZE) + col, (ty * TILE_SIZE) + row)) {
+            tile.at(row) |= std::uint64_t{1} << col;
+          }
+        }
+      }
+
+      if (tile == tiles[SOLID_TILE]) {
+        directory[position] = SOLID_TILE;
+      } else if (tile != tiles[EMPTY_TILE]) {
+        directory[position] = static_cast<std::uint32_t>(tiles.size());
+        tiles.push_back(tile);
+        positions.push_back(static_cast<std::uint32_t>(position));
+      }
+    }
+  }
+
+  [[nodiscard]] bool test(unsigned int x, unsigned int y) const {
+    return ((word(x / TILE_SIZE, y) >> (x % TILE_SIZE)) & 1) != 0;
+  }
+
+  void set(unsigned int x, unsigned int y) {
+    set_bits(x / TILE_SIZE, y, std::uint64_t{1} << (x % TILE_SIZE));
+  }
+
+  /// Set (OR) the given bits in the word holding columns [64 * wx, 64 * wx + 64) of row y.
+  void set_bits(unsigned int wx, unsigned int y, std::uint64_t bits) {
+    mutable_word(wx, y) |= bits;
+  }
+
+  /// Get the word holding the bits for columns [64 * wx, 64 * wx + 64) of row y.
+  [[nodiscard]] std::uint64_t word(unsigned int wx, unsigned int y) const {
+    return tiles[directory[(static_cast<std::size_t>(tiles_per_row) * (y / TILE_SIZE)) + wx]][y % TILE_SIZE];
+  }
+
+  /// Clear a grid that started empty, returning its own tiles to the shared empty tile. Only touches the tiles that were written to.
+  void clear() {
+    for (const auto position : positions) {
+      directory[position] = EMPTY_TILE;
+    }
+
+    tiles.resize(FIRST_OWN_TILE);
+    positions.clear();
+  }
+
+  ///
+  /// Merge (OR) another empty-started grid of equal dimensions into this one and clear the other grid. Calls `on_set` for each newly set bit.
+  /// Only the tiles the other grid holds of its own are visited, so the cost follows the number of touched tiles rather than the level size.
+  ///
+  void merge_from(TiledBitGrid& other, std::invocable<unsigned int, unsigned int> auto&& on_set) {
+    for (std::size_t i = FIRST_OWN_TILE; i < other.tiles.size(); i++) {
+      const std::uint32_t position = other.positions[i - FIRST_OWN_TILE];
+      const unsigned int  wx       = position % tiles_per_row;
+      const unsigned int  y0       = (position / tiles_per_row) * TILE_SIZE;
+
+      for (unsigned int row = 0; row < TILE_SIZE; row++) {
+        std::uint64_t added = other.tiles[i][row] & ~word(wx, y0 + row);
+        if (added == 0) {
+          continue;
+        }
+
+        set_bits(wx, y0 + row, added);
+
+        while (added != 0) {
+          const auto bit = static_cast<unsigned int>(std::countr_zero(added));
+          on_set((wx * TILE_SIZE) + bit, y0 + row);
+          added &= added - 1; // Clear the lowest set bit.
+        }
+      }
+    }
+
+    other.clear();
+  }
+
+  [[nodiscard]] std::size_t memory_usage() const {
+    return (directory.size() * sizeof(std::uint32_t)) + (tiles.size() * sizeof(Tile)) + (positions.size() * sizeof(std::uint32_t));
+  }
+
+  unsigned int               width;
+  unsigned int               height;
+  unsigned int               tiles_per_row;
+  std::vector<std::uint32_t> directory; // Tile index per tile position, row-major.
+  std::vector<Tile>          tiles;     // Tile storage, starting with the shared all-empty and all-solid tiles.
+  std::vector<std::uint32_t> positions; // Tile position per tile of its own, i.e. for `tiles[FIRST_OWN_TILE...]`.
+
+private:
+  /// Get a writable word, giving the tile holding it its own copy first if it is one of the shared tiles.
+  [[nodiscard]] std::uint64_t& mutable_word(unsigned int wx, unsigned int y) {
+    const std::size_t position = (static_cast<std::size_t>(tiles_per_row) * (y / TILE_SIZE)) + wx;
+
+    auto& tile = directory[position];
+    if (tile < FIRST_OWN_TILE) [[unlikely]] {
+      tile = copy_tile(tile, position);
+    }
+
+    return tiles[tile][y % TILE_SIZE];
+  }
+
+  /// Give a tile position its own copy of a shared tile, returning the index of the copy. Kept out of line, off the path of every ray step.
+  [[gnu::noinline]] [[nodiscard]] std::uint32_t copy_tile(std::uint32_t shared, std::size_t position) {
+    tiles.push_back(tiles[shared]);
+    positions.push_back(static_cast<std::uint32_t>(position));
+    return static_cast<std::uint32_t>(tiles.size() - 1);
+  }
+};
+
+/// Any grid of bits with word-wise access to its rows.
+template<typename G>
+concept bit_grid = requires(const G& g, unsigned int i) {
+  { g.width } -> std::convertible_to<unsigned int>;
+  { g.height } -> std::convertible_to<unsigned int>;
+  { g.word(i, i) } -> std::same_as<std::uint64_t>;
+};
+
+///
+/// Check if any bit in the given rectangle of a grid is set, using word-wide bit masks. Parts of the rectangle outside of the grid are ignored.
+/// If a filter grid of equal dimensions is given, only bits that are set in both grids count.
+///
+template<bit_grid G>
+[[nodiscard]] bool any_set(const G& grid, unsigned int x, unsigned int y, unsigned int w, unsigned int h, const TiledBitGrid* filter = nullptr) {
+  const unsigned int x_end = std::min(x + w, grid.width);
+  const unsigned int y_end = std::min(y + h, grid.height);
+
+  for (unsigned int yy = y; yy < y_end; yy++) {
+    for (unsigned int xx = x; xx < x_end; xx = (xx / 64 + 1) * 64) { // One iteration per 64-bit word.
+      const unsigned int  n    = std::min(x_end - xx, 64 - (xx % 64));
+      const std::uint64_t mask = (n == 64) ? ~std::uint64_t{0} : ((std::uint64_t{1} << n) - 1) << (xx % 64);
+
+      if ((grid.word(xx / 64, yy) & (filter != nullptr ? filter->word(xx / 64, yy) : ~std::uint64_t{0}) & mask) != 0) {
+        return true;
+      }
+    }
+  }
+
+  return false;
+}
+
+/// Abstraction over a rectangular ASCII art level map definition.
+struct LevelMap {
+  /// Wall occupancy grid backend selection.
+  enum class Backend : uint8_t { Automatic, Dense, Tiled };
+
+  ///
+  /// Constructor. Takes an ASCII art map definition where '#' are walls.
+  ///
+  /// The walls are stored in a dense bit grid, or in a tiled bit grid if that takes less memory (i.e. for large levels with big
+  /// uniform areas). The level definition itself is not kept.
+  ///
+  explicit LevelMap(std::string&& format, Backend backend = Backend::Automatic)
+    : width{static_cast<unsigned int>(format.find_first_of('\n'))}
+    , height{static_cast<unsigned int>(format.find_last_of('\n')) / width} {
+    if (width < 3 || height < 3) {
+      throw std::invalid_argument{"invalid level dimensions -- must at least be 3x3 units"};
+    }
+
+    if ((width + 1) * height != format.size()) {
+      throw std::invalid_argument{"invalid level dimensions -- must be rectangular"};
+    }
+
+    // Pack the wall elements into an occupancy grid, one bit per map block. The tiled grid is packed straight from the level definition,
+    // so a dense grid of the whole level is only built if it is the backend in use.
+    const auto is_wall_at = [&](unsigned int x, unsigned int y) { return format[(width + 1) * y + x] == '#'; };
+
+    const auto pack_dense = [&] {
+      BitGrid dense{width, height};
+      for (unsigned int y = 0; y < height; y++) {
+        for (unsigned int x = 0; x < width; x++) {
+          if (is_wall_at(x, y)) {
+            dense.set(x, y);
+          }
+        }
+      }
+
+      return dense;
+    };
+
+    const std::size_t dense_memory_usage = static_cast<std::size_t>((width + 63) / 64) * height * sizeof(std::uint64_t);
+
+    if (backend == Backend::Dense) {
+      walls_ = pack_dense();
+    } else if (TiledBitGrid tiled{width, height, is_wall_at}; backend == Backend::Tiled || tiled.memory_usage() < dense_memory_usage) {
+      walls_ = std::move(tiled);
+    } else {
+      walls_ = pack_dense();
+    }
+
+    format = {}; // Release the level definition memory as soon as possible.
+  }
+
+  /// Check if any map block in the given rectangle is a wall element, optionally only counting blocks set in `filter`.
+  [[nodiscard]] bool any_wall(unsigned int x, unsigned int y, unsigned int w, unsigned int h, const TiledBitGrid* filter = nullptr) const {
+    return std::visit([&](const auto& walls) { return any_set(walls, x, y, w, h, filter); }, walls_);
+  }
+
+  /// Name of the wall occupancy grid backend in use.
+  [[nodiscard]] std::string_view backend_name() const {
+    return std::holds_alternative<BitGrid>(walls_) ? "dense" : "tiled";
+  }
+
+  /// Memory used by the wall occupancy grid in [bytes].
+  [[nodiscard]] std::size_t memory_usage() const {
+    return std::visit([](const auto& walls) { return walls.memory_usage(); }, walls_);
+  }
+
+  /// Check if a coordinate on the map is out-of-bounds (OOB).
+  [[nodiscard]] bool is_oob(const Position<int>& p) const {
+    return p.x < 0 || p.y < 0 || p.x >= static_cast<int>(width) || p.y >= static_cast<int>(height);
+  }
+
+  /// Check if a coordinate on the map is a wall element.
+  [[nodiscard]] bool is_wall(const Position<int>& p) const {
+    return !is_oob(p) && std::visit([&](const auto& walls) { return walls.test(static_cast<unsigned int>(p.x), static_cast<unsigned int>(p.y)); }, walls_);
+  }
+
+  const unsigned int width;
+  const unsigned int height;
+
+private:
+  std::variant<BitGrid, TiledBitGrid> walls_{BitGrid{0, 0}}; // Wall occupancy grid.
+};
+
+/// Player state manager.
+struct Player {
+  Player(const Position<float>& p, float a)
+    : pos{p}
+    , angle{a} {
+  }
+
+  void move_up_if(std::invocable<Position<float>> auto&& pred) {
+    const auto pos_new = pos.adjusted(0.1f * std::sin(angle), 0.1f * std::cos(angle));
+    if (pred(pos_new)) {
+      pos = pos_new;
+    }
+  }
+
+  void move_down_if(std::invocable<Position<float>> auto&& pred) {
+    const auto pos_new = pos.adjusted(-0.1f * std::sin(angle), -0.1f * std::cos(angle));
+    if (pred(pos_new)) {
+      pos = pos_new;
+    }
+  }
+
+  void turn_ccw() {
+    angle = std::fmod(angle - 0.1f + PI2, PI2);
+  }
+
+  void turn_cw() {
+    angle = std::fmod(angle + 0.1f, PI2);
+  }
+
+  Position<float> pos;   // Current position in [map block units].
+  float           angle; // Current orientation angle in [radians].
+};
+
+/// Result of casting a single ray.
+struct RayHit {
+  float dist  = 0.0f;  // Distance to the wall (or maximum depth) in [map block units].
+  bool  bound = false; // Indicates wall block boundary.
+};
+
+///
+/// Cache of pre-rasterized screen columns. Many columns in a frame show a wall of the same projected height and shade, and therefore
+/// consist of the exact same cells. Drawing such a column comes down to a lookup and a copy of the cached cells into the framebuffer.
+/// The cells depend on the screen height, so changing it empties the cache.
+///
+struct ColumnCache {
+  explicit ColumnCache(unsigned int height) {
+    reset(height);
+  }
+
+  /// Empty the cache if the screen height changed.
+  void reset(unsigned int height) {
+    if (height != height_ || runs_.empty()) {
+      height_ = height;
+      runs_.assign(static_cast<std::size_t>(height + 2) * (NUMBER_OF_WALL_SHADES + 1) * 2, {});
+    }
+  }
+
+  /// Get the cells for a column with the given distance from the top of the screen to the wall (may be negative), wall shade and bound.
+  [[nodiscard]] std::span<const Cell> get(long dist_ceiling, int wall_shade, bool bound) {
+    // Walls reaching beyond the top of the screen fill the whole column, and walls starting below it are not visible at all.
+    dist_ceiling = std::clamp(dist_ceiling, -1L, static_cast<long>(height_));
+
+    const auto        c     = static_cast<std::size_t>(dist_ceiling + 1);
+    const std::size_t shade = (wall_shade == WALL_COLOR_X) ? 0 : static_cast<std::size_t>(wall_shade - WALL_SHADES.front()) + 1;
+
+    auto& run = runs_[(((c * (NUMBER_OF_WALL_SHADES + 1)) + shade) * 2) + (bound ? 1 : 0)];
+    if (run.size() != height_) {
+      run.resize(height_);
+      rasterize(run, dist_ceiling, wall_shade, bound);
+      misses++;
+    } else {
+      hits++;
+    }
+
+    return run;
+  }
+
+  /// Draw the ceiling, wall and floor cells of a single screen column.
+  static void rasterize(std::span<Cell> column, long dist_ceiling, int wall_shade, bool bound) {
+    const auto height     = static_cast<float>(column.size());
+    const long dist_floor = static_cast<long>(std::round(height - static_cast<float>(dist_ceiling)));
+
+    for (unsigned int y = 0; y < column.size(); y++) {
+      if (y < dist_ceiling) {
+        column[y] = {" ", 0}; // Ceiling.
+      } else if (y > dist_ceiling && y <= dist_floor) {
+        column[y] = {bound ? "\u2593" : "\u2588", wall_shade}; // Wall bound or wall.
+      } else {
+        const float d = 1.0f - ((static_cast<float>(y) - (height / 2.0f)) / (height / 2.0f));
+        column[y]     = {[&] { // Floor.
+                         if (d < 0.25f) {
+                           return "#";
+                         } else if (d < 0.5f) {
+                           return "x";
+                         } else if (d < 0.75f) {
+                           return "-";
+                         } else if (d < 0.9f) {
+                           return ".";
+                         } else {
+                           return " ";
+                         }
+                       }(),
+                       0};
+      }
+    }
+  }
+
+  std::size_t hits   = 0; // Number of cache hits.
+  std::size_t misses = 0; // Number of cache misses.
+
+private:
+  unsigned int                   height_ = 0;
+  std::vector<std::vector<Cell>> runs_; // Cached columns per distance to the ceiling, shade and bound; empty if not (yet) cached.
+};
+
+namespace {
+
+///
+/// Cast a single ray from a position until it hits a wall, the level edge or the maximum depth.
+/// As a side effect, all map blocks the ray passes through are marked in `visited`.
+///
+[[nodiscard]] RayHit cast_ray(const LevelMap& map, const Position<float>& pos, float ray_angle, TiledBitGrid& visited) {
+  const float norm_x = std::sin(ray_angle);
+  const float norm_y = std::cos(ray_angle);
+
+  RayHit result;
+  bool   hit = false; // Indicates 'ray hit'.
+  while (!hit && (result.dist < MAX_DEPTH)) {
+    result.dist += 0.1f;
+
+    const int xx = static_cast<int>(std::round(pos.x + norm_x * result.dist));
+    const int yy = static_cast<int>(std::round(pos.y + norm_y * result.dist));
+
+    const bool oob      = map.is_oob({xx, yy});
+    const bool hit_wall = map.is_wall({xx, yy});
+    hit                 = oob || hit_wall;
+
+    if (!oob) {
+      visited.set(static_cast<unsigned int>(xx), static_cast<unsigned int>(yy));
+    }
+
+    if (hit_wall) {
+      std::array<std::pair<float, float>, 4> corners; // Distances and dot products per wall block corner.
+
+      for (int tx = 0; tx < 2; tx++) {
+        for (int ty = 0; ty < 2; ty++) {
+          const float vx                                    = static_cast<float>(xx + tx) - pos.x;
+          const float vy                                    = static_cast<float>(yy + ty) - pos.y;
+          const float d                                     = std::sqrt(vx * vx + vy * vy);
+          corners.at(static_cast<std::size_t>(ty * 2 + tx)) = std::make_pair(d, (norm_x * vx / d) + (norm_y * vy / d));
+        }
+      }
+
+      std::ranges::sort(corners, [](const auto& a, const auto& b) { return a.first < b.first; });
+
+      result.bound = (std::acos(corners.at(0).second) < 0.01f) || (std::acos(corners.at(1).second) < 0.01f);
+    }
+  }
+
+  return result;
+}
+
+///
+/// Persistent pool of worker threads, to run a job in parallel for every frame without starting threads for each.
+///
+/// The calling thread takes part as worker 0, so a pool of n workers has n - 1 threads of its own. The threads meet at a barrier to
+/// start a job, and at another one when it is done.
+///
+class WorkerPool {
+public:
+  explicit WorkerPool(std::size_t workers)
+    : start_{static_cast<std::ptrdiff_t>(workers)}
+    , done_{static_cast<std::ptrdiff_t>(workers)} {
+    for (std::size_t worker = 1; worker < workers; worker++) {
+      threads_.emplace_back([this, worker] {
+        for (start_.arrive_and_wait(); !stop_; start_.arrive_and_wait()) {
+          (*job_)(worker);
+          done_.arrive_and_wait();
+        }
+      });
+    }
+  }
+
+  ~WorkerPool() {
+    stop_ = true;
+    start_.arrive_and_wait(); // The threads are joined after this.
+  }
+
+  WorkerPool(const WorkerPool&)            = delete;
+  WorkerPool& operator=(const WorkerPool&) = delete;
+
+  /// Run a job on all workers, with the worker index as argument, and wait until all are done.
+  void run(const std::function<void(std::size_t)>& job) {
+    job_ = &job;
+    start_.arrive_and_wait();
+    job(0);
+    done_.arrive_and_wait();
+  }
+
+private:
+  std::barrier<>                          start_;
+  std::barrier<>                          done_;
+  const std::function<void(std::size_t)>* job_  = nullptr;
+  bool                                    stop_ = false; // Written before, and read after the start barrier.
+  std::vector<std::jthread>               threads_;      // Last, so these are joined before the barriers go.
+};
+
+[[nodiscard]] constexpr int distance_to_wall_shade(float d) {
+  if (d < MAX_DEPTH) {
+    const float shade = std::clamp(MAX_DEPTH - (2.0f * d), 0.0f, MAX_DEPTH);
+    return WALL_SHADES.at(WALL_SHADES.size() - 1 - static_cast<std::size_t>(shade * (WALL_SHADES.size() / MAX_DEPTH)));
+  } else {
+    return WALL_COLOR_X;
+  }
+}
+
+/// Angle of the ray for a screen column.
+[[nodiscard]] float ray_angle(const Player& p, std::size_t x, unsigned int width) {
+  return p.angle - (FOV / 2) + (static_cast<float>(x) * FOV) / static_cast<float>(width);
+}
+
+/// Projected distance from the top of the screen to a wall at the given distance, may be negative for nearby walls.
+[[nodiscard]] long ceiling_distance(float dist_wall, unsigned int height) {
+  return static_cast<long>(std::round((static_cast<float>(height) / 2.0f) - (static_cast<float>(height) / dist_wall)));
+}
+
+[[nodiscard]] constexpr std::string angle_to_char(float a) {
+  constexpr float D = PI / 8.0f;
+
+  if (a > (PI2 - D) || a <= D) {
+    return "\u21D3"; // Downwards arrow.
+  } else if (a > D && a <= (D * 3.0f)) {
+    return "\u21D8"; // South East arrow.
+  } else if (a > (D * 3.0f) && a <= (D * 5.0f)) {
+    return "\u21D2"; // Rightwards arrow.
+  } else if (a > (D * 5.0f) && a <= (PI - D)) {
+    return "\u21D7"; // North East arrow.
+  } else if (a > (PI - D) && a <= (PI + D)) {
+    return "\u21D1"; // Upwards arrow.
+  } else if (a > (PI + D) && a <= (PI + (D * 3.0f))) {
+    return "\u21D6"; // North West arrow.
+  } else if (a > (PI + (D * 3.0f)) && a <= (PI + (D * 5.0f))) {
+    return "\u21D0"; // Leftwards arrow.
+  } else {
+    return "\u21D9"; // South West arrow.
+  }
+}
+
+/// Append the UTF-8 encoding of the Unicode braille pattern with the given dots (U+2800 to U+28FF) to a string.
+void append_braille(std::string& s, std::uint8_t dots) {
+  s += static_cast<char>(0xE2);
+  s += static_cast<char>(0xA0 | (dots >> 6));
+  s += static_cast<char>(0x80 | (dots & 0x3F));
+}
+
+///
+/// Save the session state (player state and explored map blocks) to a file on disk.
+///
+/// The file format is plain text: a header line, the level dimensions, the player state and the explored bit grid words in hexadecimal.
+///
+void save_session(const std::string& path, const Player& p, const TiledBitGrid& explored) {
+  std::ofstream file{path};
+  if (!file) {
+    throw std::runtime_error{fmt::format("failed to open session file '{}' for writing", path)};
+  }
+
+  file << fmt::format("raycasting-session 1\n{} {}\n{} {} {}\n", explored.width, explored.height, p.pos.x, p.pos.y, p.angle);
+
+  for (unsigned int y = 0; y < explored.height; y++) {
+    for (unsigned int wx = 0; wx < explored.tiles_per_row; wx++) {
+      file << fmt::format("{:016x}{}", explored.word(wx, y), (wx + 1 == explored.tiles_per_row) ? '\n' : ' ');
+    }
+  }
+
+  if (!file) {
+    throw std::runtime_error{fmt::format("failed to write session file '{}'", path)};
+  }
+}
+
+///
+/// Load the session state from a file on disk, see `save_session`.
+///
+/// \returns False if there is no such session file, true if it was loaded.
+///
+/// \throws An exception if the session file is invalid or doesn't match the level dimensions.
+///
+[[nodiscard]] bool load_session(const std::string& path, Player& p, TiledBitGrid& explored) {
+  std::ifstream file{path};
+  if (!file) {
+    return false;
+  }
+
+  std::string  magic;
+  unsigned int version{}, width{}, height{};
+  file >> magic >> version >> width >> height >> p.pos.x >> p.pos.y >> p.angle;
+
+  if (!file || magic != "raycasting-session" || version != 1) {
+    throw std::runtime_error{fmt::format("invalid session file '{}'", path)};
+  }
+
+  if (width != explored.width || height != explored.height) {
+    throw std::runtime_error{fmt::format("session file '{}' does not match the level dimensions", path)};
+  }
+
+  // The position must round to a map block, written so that NaN fails too.
+  if (!(p.pos.x >= 0.0f && p.pos.y >= 0.0f && p.pos.x <= static_cast<float>(width - 1) && p.pos.y <= static_cast<float>(height - 1))) {
+    throw std::runtime_error{fmt::format("session file '{}' puts the player outside the level", path)};
+  }
+
+  for (unsigned int y = 0; y < explored.height; y++) {
+    for (unsigned int wx = 0; wx < explored.tiles_per_row; wx++) {
+      std::uint64_t word{};
+      file >> std::hex >> word;
+
+      if (word != 0) {
+        explored.set_bits(wx, y, word);
+      }
+    }
+  }
+
+  if (!file) {
+    throw std::runtime_error{fmt::format("invalid session file '{}'", path)};
+  }
+
+  return true;
+}
+
+/// Read a level map definition from a file on disk.
+[[nodiscard]] std::string read_level_file(const char* path) {
+  std::ifstream file{path};
+  if (!file) {
+    throw std::runtime_error{fmt::format("failed to open level map file '{}'", path)};
+  }
+
+  std::stringstream contents;
+  contents << file.rdbuf();
+
+  return contents.str();
+}
+
+///
+/// Draws random free map blocks (i.e. not wall elements) of a level. Plain random draws are tried first. If too many of those in a row
+/// hit a wall, e.g. on a level of almost solid rock, the free map blocks are collected once and drawn from directly instead.
+///
+class FreeBlockSampler {
+public:
+  explicit FreeBlockSampler(const LevelMap& map)
+    : map_{map}
+    , x_dist_{0, static_cast<int>(map.width) - 1}
+    , y_dist_{0, static_cast<int>(map.height) - 1} {
+  }
+
+  /// Draw a random free map block. Throws an exception if the level has no free map blocks at all.
+  [[nodiscard]] Position<int> operator()(std::mt19937& rng) {
+    if (!scanned_) {
+      for (unsigned int draw = 0; draw < MAX_DRAWS; draw++) {
+        if (const Position<int> pos{x_dist_(rng), y_dist_(rng)}; !map_.is_wall(pos)) {
+          return pos;
+        }
+      }
+
+      for (int y = 0; y < static_cast<int>(map_.height); y++) {
+        for (int x = 0; x < static_cast<int>(map_.width); x++) {
+          if (!map_.is_wall({x, y})) {
+            free_blocks_.emplace_back(x, y);
+          }
+        }
+      }
+
+      scanned_ = true;
+    }
+
+    if (free_blocks_.empty()) {
+      throw std::invalid_argument{"invalid level -- there are no free map blocks"};
+    }
+
+    return free_blocks_[std::uniform_int_distribution<std::size_t>{0, free_blocks_.size() - 1}(rng)];
+  }
+
+private:
+  static constexpr unsigned int MAX_DRAWS = 1000; // Number of random draws in a row hitting a wall before collecting the free blocks.
+
+  const LevelMap&                    map_;
+  std::uniform_int_distribution<int> x_dist_;
+  std::uniform_int_distribution<int> y_dist_;
+  bool                               scanned_ = false; // Indicates the free map blocks were collected.
+  std::vector<Position<int>>         free_blocks_;
+};
+
+///
+/// Compare the level map backends on a level definition: memory usage, random wall lookups and ray casting from random free positions.
+/// All random positions and angles come from a fixed seed, so all backends get the exact same work.
+///
+void benchmark_level(const std::string& format) {
+  constexpr unsigned int LOOKUPS = 10'000'000;
+  constexpr unsigned int RAYS    = 1'000'000;
+
+  for (const auto backend : {LevelMap::Backend::Dense, LevelMap::Backend::Tiled}) {
+    const LevelMap map{std::string{format}, backend};
+    TiledBitGrid   visited{map.width, map.height};
+
+    std::mt19937                          rng{42};
+    std::uniform_int_distribution<int>    x_dist{0, static_cast<int>(map.width) - 1};
+    std::uniform_int_distribution<int>    y_dist{0, static_cast<int>(map.height) - 1};
+    std::uniform_real_distribution<float> angle_dist{0.0f, PI2};
+
+    std::vector<Position<int>> positions;
+    positions.reserve(LOOKUPS);
+    while (positions.size() < LOOKUPS) {
+      positions.emplace_back(x_dist(rng), y_dist(rng));
+    }
+
+    auto         t_start = std::chrono::steady_clock::now();
+    unsigned int walls   = 0; // Accumulated and printed, so the lookups cannot be optimized away.
+    for (const auto& pos : positions) {
+      walls += map.is_wall(pos) ? 1u : 0u;
+    }
+    const std::chrono::duration<double, std::nano> t_lookups = std::chrono::steady_clock::now() - t_start;
+
+    FreeBlockSampler                               free_blocks{map};
+    std::vector<std::pair<Position<float>, float>> rays;
+    rays.reserve(RAYS);
+    while (rays.size() < RAYS) {
+      const Position<int> pos = free_blocks(rng);
+      rays.emplace_back(Position<float>{static_cast<float>(pos.x), static_cast<float>(pos.y)}, angle_dist(rng));
+    }
+
+    t_start          = std::chrono::steady_clock::now();
+    float total_dist = 0.0f; // Accumulated and printed, so the rays cannot be optimized away.
+    for (const auto& [pos, angle] : rays) {
+      total_dist += cast_ray(map, pos, angle, visited).dist;
+    }
+    const std::chrono::duration<double> t_rays = std::chrono::steady_clock::now() - t_start;
+
+    fmt::print("{:>5}: {:>12} bytes, {:6.2f} ns/lookup ({} walls), {:10.0f} rays/s (total distance {:.0f})\n", map.backend_name(), map.memory_usage(),
+               t_lookups.count() / LOOKUPS, walls, RAYS / t_rays.count(), total_dist);
+  }
+}
+
+///
+/// Render frames without a screen, for a player walking and turning through the level, and report the column cache statistics.
+/// Every frame is rendered both through the column cache and directly, to measure the time saved and to verify the cached frames are exact.
+///
+void run_headless(const LevelMap& map, Player p, unsigned int frames) {
+  Framebuffer         fb{HEADLESS_WIDTH, HEADLESS_HEIGHT};
+  Framebuffer         reference{HEADLESS_WIDTH, HEADLESS_HEIGHT};
+  ColumnCache         cache{HEADLESS_HEIGHT};
+  TiledBitGrid        visited{map.width, map.height};
+  std::vector<RayHit> hits(fb.width);
+
+  std::chrono::nanoseconds t_cached{0}; // Time spent drawing columns through the cache.
+  std::chrono::nanoseconds t_direct{0}; // Time spent drawing columns directly.
+
+  for (unsigned int frame = 0; frame < frames; frame++) {
+    p.move_up_if([&](const auto& pos) { return !map.is_wall(pos); });
+    if (frame % 4 == 0) {
+      p.turn_cw();
+    }
+
+    for (unsigned int x = 0; x < fb.width; x++) {
+      hits[x] = cast_ray(map, p.pos, ray_angle(p, x, fb.width), visited);
+    }
+
+    const auto t_start = std::chrono::steady_clock::now();
+    for (unsigned int x = 0; x < fb.width; x++) {
+      const auto cells = cache.get(ceiling_distance(hits[x].dist, fb.height), distance_to_wall_shade(hits[x].dist), hits[x].bound);
+      std::ranges::copy(cells, fb.column(x).begin());
+    }
+
+    const auto t_between = std::chrono::steady_clock::now();
+    for (unsigned int x = 0; x < reference.width; x++) {
+      ColumnCache::rasterize(reference.column(x), ceiling_distance(hits[x].dist, reference.height), distance_to_wall_shade(hits[x].dist), hits[x].bound);
+    }
+
+    const auto t_end = std::chrono::steady_clock::now();
+    t_cached += t_between - t_start;
+    t_direct += t_end - t_between;
+
+    if (fb.cells != reference.cells) {
+      throw std::runtime_error{fmt::format("cached frame {} differs from the directly rendered frame", frame)};
+    }
+  }
+
+  const auto lookups = cache.hits + cache.misses;
+  fmt::print("Rendered {} frames of {}x{} cells\n", frames, fb.width, fb.height);
+  fmt::print("Column cache: {} hits, {} misses, hit rate {:.1f}%\n", cache.hits, cache.misses,
+             lookups > 0 ? 100.0 * static_cast<double>(cache.hits) / static_cast<double>(lookups) : 0.0);
+  fmt::print("Column drawing time: {} us cached, {} us direct, {} us saved\n", t_cached.count() / 1000, t_direct.count() / 1000,
+             (t_direct - t_cached).count() / 1000);
+}
+
+} // namespace
+
+/// Mini-map renderer, showing the explored part of the level map as plain text, or as Unicode braille glyphs of 2x4 dots per screen cell.
+struct MiniMap {
+  enum class Mode : uint8_t { Text, Braille };
+
+private:
+  /// Braille pattern bit per dot row (top to bottom) for the left and right dot column.
+  static constexpr std::array<std::array<std::uint8_t, 2>, 4> DOT_BITS{{{0x01, 0x08}, {0x02, 0x10}, {0x04, 0x20}, {0x40, 0x80}}};
+
+  const LevelMap& map_;
+  const TiledBitGrid& explored_;
+  unsigned int    zoom_ = 1; // Number of map block units per braille dot (horizontally and vertically).
+  Mode            mode_;
+
+  std::vector<std::optional<std::uint8_t>> glyphs_;            // Braille dot patterns for the current zoom level, computed on first use.
+  unsigned int                             glyphs_width_  = 0; // Braille mini-map width for the whole level in [screen cells].
+  unsigned int                             glyphs_height_ = 0; // Braille mini-map height for the whole level in [screen cells].
+
+  /// Get the braille dot pattern at the given glyph coordinates. A dot is set if any explored map block it covers is a wall element.
+  [[nodiscard]] std::uint8_t glyph(unsigned int gx, unsigned int gy) {
+    auto& g = glyphs_[(glyphs_width_ * gy) + gx];
+
+    if (!g) {
+      std::uint8_t dots = 0;
+      for (unsigned int dy = 0; dy < 4; dy++) {
+        for (unsigned int dx = 0; dx < 2; dx++) {
+          if (map_.any_wall(((gx * 2) + dx) * zoom_, ((gy * 4) + dy) * zoom_, zoom_, zoom_, &explored_)) {
+            dots |= DOT_BITS.at(dy).at(dx);
+          }
+        }
+      }
+
+      g = dots;
+    }
+
+    return *g;
+  }
+
+  void reset_glyphs() {
+    glyphs_width_  = (map_.width + (2 * zoom_) - 1) / (2 * zoom_);
+    glyphs_height_ = (map_.height + (4 * zoom_) - 1) / (4 * zoom_);
+    glyphs_.assign(static_cast<std::size_t>(glyphs_width_) * glyphs_height_, std::nullopt);
+  }
+
+public:
+  /// Constructor. Defaults to braille mode when the level map is too large to show as text in the mini-map area.
+  MiniMap(const LevelMap& map, const TiledBitGrid& explored)
+    : map_{map}
+    , explored_{explored}
+    , mode_{(map.width <= 2 * MINIMAP_WIDTH && map.height <= 4 * MINIMAP_HEIGHT) ? Mode::Text : Mode::Braille} {
+    reset_glyphs();
+  }
+
+  /// Invalidate the cached glyph covering the given map block, e.g. because it was newly explored.
+  void invalidate(unsigned int x, unsigned int y) {
+    glyphs_[(glyphs_width_ * (y / (4 * zoom_))) + (x / (2 * zoom_))].reset();
+  }
+
+  void toggle_mode() {
+    mode_ = (mode_ == Mode::Text) ? Mode::Braille : Mode::Text;
+  }
+
+  void zoom_in() {
+    if (zoom_ > 1) {
+      zoom_ /= 2;
+      reset_glyphs();
+    }
+  }
+
+  void zoom_out() {
+    if (zoom_ < MINIMAP_MAX_ZOOM) {
+      zoom_ *= 2;
+      reset_glyphs();
+    }
+  }
+
+  /// Size of the screen area covered by the mini-map in [screen cells].
+  [[nodiscard]] Position<unsigned int> size(const Screen& s) const {
+    if (mode_ == Mode::Text) {
+      return {std::min(map_.width, s.width), std::min(map_.height, s.height)};
+    } else {
+      return {std::min({MINIMAP_WIDTH, glyphs_width_, s.width}), std::min({MINIMAP_HEIGHT, glyphs_height_, s.height})};
+    }
+  }
+
+  /// Draw the mini-map in the top left corner of the screen. The braille mini-map view follows the player.
+  void draw(const Screen& s, const Player& p) {
+    const auto [w, h] = size(s);
+
+    if (mode_ == Mode::Text) {
+      std::string row;
+      for (unsigned int y = 0; y < h; y++) {
+        row.assign(w, ' ');
+        for (unsigned int x = 0; x < w; x++) {
+          if (explored_.test(x, y) && map_.is_wall({x, y})) {
+            row[x] = '#';
+          }
+        }
+
+        s.print({0u, y}, row);
+      }
+
+      s.print(p.pos, angle_to_char(p.angle));
+      return;
+    }
+
+    const Position<int> player{p.pos};
+    const unsigned int  player_gx = static_cast<unsigned int>(std::max(player.x, 0)) / (2 * zoom_);
+    const unsigned int  player_gy = static_cast<unsigned int>(std::max(player.y, 0)) / (4 * zoom_);
+    const unsigned int  origin_gx = std::min(player_gx - std::min(player_gx, w / 2), glyphs_width_ - w);
+    const unsigned int  origin_gy = std::min(player_gy - std::min(player_gy, h / 2), glyphs_height_ - h);
+
+    std::string row;
+    for (unsigned int y = 0; y < h; y++) {
+      row.clear();
+
+      for (unsigned int x = 0; x < w; x++) {
+        const unsigned int gx = origin_gx + x;
+        const unsigned int gy = origin_gy + y;
+
+        if (gx == player_gx && gy == player_gy) {
+          row += angle_to_char(p.angle);
+        } else {
+          append_braille(row, glyph(gx, gy));
+        }
+      }
+
+      s.print({0u, y}, row);
+    }
+  }
+};
+
+int main(int argc, char** argv) {
+  try {
+    if (std::setlocale(LC_ALL, "") == nullptr) { // Required for Unicode support.
+      throw std::runtime_error{"failed to set locale"};
+    }
+
+    constexpr std::string_view DEFAULT_LEVEL{"####################\n"
+                                             "#   ##             #\n"
+                                             "#   ##             #\n"
+                                             "#                  #\n"
+                                             "#         ##########\n"
+                                             "#                  #\n"
+                                             "######             #\n"
+                                             "#    #      ###    #\n"
+                                             "#    #      ###    #\n"
+                                             "#                  #\n"
+                                             "#                  #\n"
+                                             "####################\n"};
+
+    // Command-line arguments: [--benchmark-level] [--headless <frames>] [--session <session file>] [<level file>]
+    bool                        benchmark = false;
+    std::optional<unsigned int> headless_frames;
+    std::optional<std::string>  level_path;
+    std::optional<std::string>  session_path;
+
+    const std::span args{argv, static_cast<std::size_t>(argc)};
+    for (std::size_t i = 1; i < args.size(); i++) {
+      const std::string_view arg{args[i]};
+      if (arg == "--benchmark-level") {
+        benchmark = true;
+      } else if (arg == "--headless" && i + 1 < args.size()) {
+        headless_frames = static_cast<unsigned int>(std::stoul(args[++i]));
+      } else if (arg == "--session" && i + 1 < args.size()) {
+        session_path = args[++i];
+      } else {
+        level_path = arg;
+      }
+    }
+
+    if (benchmark) {
+      benchmark_level(level_path ? read_level_file(level_path->c_str()) : std::string{DEFAULT_LEVEL});
+      return EXIT_SUCCESS;
+    }
+
+    const LevelMap MAP{level_path ? read_level_file(level_path->c_str()) : std::string{DEFAULT_LEVEL}};
+
+    Player       p{{7.0f, 1.0f}, 0.0f};
+    TiledBitGrid explored{MAP.width, MAP.height}; // Map blocks seen by any ray so far.
+
+    if (session_path) {
+      static_cast<void>(load_session(*session_path, p, explored)); // A missing session file simply starts a new session.
+    }
+
+    if (MAP.is_oob(p.pos) || MAP.is_wall(p.pos)) {
+      throw std::invalid_argument{"invalid level -- the player start position is out of bounds or a wall element"};
+    }
+
+    if (headless_frames) {
+      run_headless(MAP, p, *headless_frames);
+      return EXIT_SUCCESS;
+    }
+
+    // Per-worker bit grids for the map blocks visited by rays, merged into the explored map after each frame.
+    std::vector<TiledBitGrid> visited(std::max(1u, std::thread::hardware_concurrency()), TiledBitGrid{MAP.width, MAP.height});
+    WorkerPool                pool{visited.size()};
+    std::vector<RayHit>       hits;
+
+    const EventLoop loop; // Must be created before the screen, see constructor.
+    Screen          s;
+    MiniMap         mini_map{MAP, explored};
+    Framebuffer     fb{s.width, s.height};
+    ColumnCache     column_cache{s.height};
+
+    bool dirty        = true;                                    // Indicates whether a new frame must be rendered.
+    auto t_dirty      = std::chrono::steady_clock::now();        // Wake-up time of the event that made the frame dirty.
+    auto t_last_frame = std::chrono::steady_clock::time_point{}; // Start time of the last rendered frame.
+
+    while (true) {
+      const auto t_start = std::chrono::steady_clock::now();
+
+      if (!dirty || (t_start - t_last_frame) < MIN_FRAME_TIME) {
+        if (dirty) {
+          loop.schedule_tick(MIN_FRAME_TIME - (t_start - t_last_frame)); // Too soon after the last frame, defer it.
+        }
+
+        const auto events    = loop.wait();
+        const bool was_dirty = dirty;
+
+        if (events.resize) {
+          s.resize();
+          fb.resize(s.width, s.height);
+          column_cache.reset(s.height);
+          dirty = true;
+        }
+
+        if (events.input) {
+          for (auto key = s.get_key(); key != Screen::Key::None; key = s.get_key()) { // Drain all pending input.
+            switch (key) {
+              using enum Screen::Key;
+            case Up: p.move_up_if([&](const auto& pos) { return !MAP.is_wall(pos); }); break;
+            case Down: p.move_down_if([&](const auto& pos) { return !MAP.is_wall(pos); }); break;
+            case Left: p.turn_ccw(); break;
+            case Right: p.turn_cw(); break;
+            case MiniMapMode: mini_map.toggle_mode(); break;
+            case ZoomIn: mini_map.zoom_in(); break;
+            case ZoomOut: mini_map.zoom_out(); break;
+            case Other:
+            case None: continue;
+            case Quit:
+              if (session_path) {
+                save_session(*session_path, p, explored);
+              }
+
+              return EXIT_SUCCESS;
+            }
+
+            dirty = true;
+          }
+        }
+
+        // Without input there is no other way to quit, so quit like with the key.
+        if (events.hangup) {
+          if (session_path) {
+            save_session(*session_path, p, explored);
+          }
+
+          return EXIT_SUCCESS;
+        }
+
+        // Note: a timer tick by itself changes nothing here, it only wakes us up to render a deferred frame.
+
+        if (dirty && !was_dirty) {
+          t_dirty = events.wake_time;
+        }
+
+        continue;
+      }
+
+      // Cast all rays in parallel bands of screen columns. Each worker marks the map blocks its rays pass through in its own bit grid.
+      hits.resize(s.width);
+
+      const auto cast_band = [&](std::size_t worker) {
+        const std::size_t band = (hits.size() + visited.size() - 1) / visited.size();
+        for (std::size_t x = worker * band; x < std::min((worker + 1) * band, hits.size()); x++) {
+          hits[x] = cast_ray(MAP, p.pos, ray_angle(p, x, s.width), visited[worker]);
+        }
+      };
+
+      pool.run(cast_band);
+
+      for (auto& v : visited) {
+        explored.merge_from(v, [&](unsigned int x, unsigned int y) { mini_map.invalidate(x, y); });
+      }
+
+      // Draw all columns from the column cache, then the mini-map and player location / orientation on top.
+      for (unsigned int x = 0; x < fb.width; x++) {
+        const auto [dist_wall, bound] = hits[x];
+        std::ranges::copy(column_cache.get(ceiling_distance(dist_wall, fb.height), distance_to_wall_shade(dist_wall), bound), fb.column(x).begin());
+      }
+
+      s.draw(fb);
+      mini_map.draw(s, p);
+
+      const auto t_end     = std::chrono::steady_clock::now();
+      const auto t_elapsed = std::chrono::duration_cast<std::chrono::microseconds>(t_end - t_start);
+      const auto t_latency = std::chrono::duration_cast<std::chrono::microseconds>(t_end - t_dirty);
+      s.print({0u, s.height - 1},
+              fmt::format("Frame rate: {:.0f} FPS, wake-up-to-frame latency: {} us", 1e6f / static_cast<float>(t_elapsed.count()), t_latency.count()));
+
+      s.update();
+
+      dirty        = false;
+      t_last_frame = t_start;
+    }
+  } catch (const std::exception& e) {
+    std::cerr << "Error: " << e.what() << '\n';
+    return EXIT_FAILURE;
+  }
+}
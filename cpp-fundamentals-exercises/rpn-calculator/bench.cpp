@@ -0,0 +1,473 @@
+//
+// Microbenchmarks of the calculator engine parts, and of the calculator library end to end, with machine-readable output.
+//
+
+#include <fmt/core.h>
+
+#include <algorithm>
+#include <charconv>
+#include <chrono>
+#include <concepts>
+#include <exception>
+#include <iostream>
+#include <random>
+#include <string>
+#include <string_view>
+#include <type_traits>
+#include <vector>
+
+#include "calculator.hpp"
+#include "engine.hpp"
+
+using namespace rpn;
+
+namespace {
+
+/// Keep the compiler from optimizing away the computation of a value.
+template<typename T>
+void keep(const T& value) {
+  asm volatile("" : : "m"(value) : "memory");
+}
+
+/// Name of a value type, for the results.
+template<typename T>
+[[nodiscard]] constexpr std::string_view type_name() {
+  if constexpr (std::is_same_v<T, signed char>) {
+    return "signed char";
+  } else if constexpr (std::is_same_v<T, short>) {
+    return "short";
+  } else if constexpr (std::is_same_v<T, int>) {
+    return "int";
+  } else if constexpr (std::is_same_v<T, long>) {
+    return "long";
+  } else if constexpr (std::is_same_v<T, long long>) {
+    return "long long";
+  } else if constexpr (std::is_same_v<T, float>) {
+    return "float";
+  } else if constexpr (std::is_same_v<T, double>) {
+    return "double";
+  } else if constexpr (std::is_same_v<T, long double>) {
+    return "long double";
+  } else if constexpr (std::is_same_v<T, Number>) {
+    return "Number";
+  }
+}
+
+/// Result of a benchmark.
+struct Measurement {
+  std::string name;       // What is measured.
+  std::string parameter;  // Variant of the measurement, like the value type.
+  std::size_t operations; // Number of operations per run.
+  double      seconds;    // Time of the fastest run.
+};
+
+///
+/// Runner of benchmarks, keeping the fastest of a number of runs for each.
+///
+class Bench {
+public:
+  Bench(int runs, std::string_view filter)
+    : runs_{runs}
+    , filter_{filter} {
+  }
+
+  ///
+  /// Run a benchmark, unless it does not match the filter.
+  ///
+  /// \param name What is measured, matched with the filter.
+  /// \param parameter Variant of the measurement.
+  /// \param operations Number of operations a single run of the body does.
+  /// \param body Function doing the operations.
+  ///
+  void measure(std::string_view name, std::string_view parameter, std::size_t operations, std::invocable auto&& body) {
+    if (fmt::format("{} {}", name, parameter).find(filter_) == std::string::npos) {
+      return;
+    }
+
+    auto best = std::chrono::duration<double>::max();
+    for (int run = 0; run < runs_; run++) {
+      const auto t_start = std::chrono::steady_clock::now();
+      body();
+      best = std::min(best, std::chrono::duration<double>(std::chrono::steady_clock::now() - t_start));
+    }
+
+    results_.push_back({std::string{name}, std::string{parameter}, operations, best.count()});
+  }
+
+  [[nodiscard]] const std::vector<Measurement>& results() const {
+    return results_;
+  }
+
+private:
+  int                      runs_;
+  std::string              filter_;
+  std::vector<Measurement> results_;
+};
+
+/// Generate calculation text of a number of tokens: mostly operands and operators, with some invalid tokens.
+[[nodiscard]] std::string generate_tokens(std::size_t count) {
+  std::mt19937                        rng{42};
+  std::uniform_int_distribution<long> operand{-1'000'000'000, 1'000'000'000};
+  std::uniform_int_distribution<int>  kind{0, 15};
+
+  std::string text;
+  for (std::size_t i = 0; i < count; i++) {
+    const int k = kind(rng);
+    if (k < 8) {
+      text += std::to_string(operand(rng));
+    } else if (k < 15) {
+      text += "+-*/%"[k % 5];
+    } else {
+      text += "1.5e3";
+    }
+
+    text += (i % 16 == 15) ? '\n' : ' ';
+  }
+
+  return text;
+}
+
+/// Generate calculations, one per line.
+[[nodiscard]] std::vector<std::string> generate_calculations(std::size_t count) {
+  std::mt19937                       rng{42};
+  std::uniform_int_distribution<int> length{1, 8};
+  std::uniform_int_distribution<int> operand{-1000, 1000};
+  std::uniform_int_distribution<int> op{0, 4};
+
+  std::vector<std::string> calculations(count);
+  for (auto& calculation : calculations) {
+    calculation = std::to_string(operand(rng));
+    for (int i = length(rng); i > 0; i--) {
+      calculation += fmt::format(" {} {}", operand(rng), "+-*/%"[op(rng)]);
+    }
+
+    calculation += '\n';
+  }
+
+  return calculations;
+}
+
+///
+/// Write a calculation of `generate_calculations` in infix notation, with the same order of evaluation.
+///
+/// Every operator is applied to the calculation before it, which gets parentheses from the second operator on: `1 2 + 3 *` is
+/// `(1 + 2) * 3`.
+///
+[[nodiscard]] std::string to_infix(std::string_view calculation) {
+  const auto take = [&] {
+    const std::size_t end   = std::min(calculation.find_first_of(" \n"), calculation.size());
+    const auto        token = calculation.substr(0, end);
+    calculation.remove_prefix(std::min(end + 1, calculation.size()));
+    return token;
+  };
+
+  std::string infix{take()};
+  for (bool first = true; !calculation.empty(); first = false) {
+    const auto operand = take();
+    const auto op      = take();
+    infix              = first ? fmt::format("{} {} {}", infix, op, operand) : fmt::format("({}) {} {}", infix, op, operand);
+  }
+
+  return infix + '\n';
+}
+
+/// Generate random bytes, like from `/dev/urandom`.
+[[nodiscard]] std::string generate_binary(std::size_t count) {
+  std::mt19937_64 rng{42};
+  std::string     bytes(count, '\0');
+  for (char& c : bytes) {
+    c = static_cast<char>(rng());
+  }
+
+  return bytes;
+}
+
+/// Benchmark the token index, and reading tokens from it.
+void bench_tokenizer(Bench& bench) {
+  const std::string text   = generate_tokens(1 << 20);
+  const std::string binary = generate_binary(1 << 24);
+  TokenIndex        index{text};
+
+  bench.measure("TokenIndex::assign", "bytes", text.size(), [&] { index.assign(text); });
+  bench.measure("TokenIndex::assign", "binary bytes", binary.size(), [&] { index.assign(binary); });
+
+  index.assign(text);
+
+  bench.measure("read_token", "", index.size(), [&] {
+    for (std::size_t cursor = 0; cursor < index.size();) {
+      keep(read_token(index, cursor).index());
+    }
+  });
+}
+
+/// Generate operand text that parses to the value type: integers that fit it, or numbers with a fraction for floating-point types.
+template<signed_arithmetic T>
+[[nodiscard]] std::vector<std::string> generate_operands(std::size_t count) {
+  constexpr int DIGITS = std::is_integral_v<T> ? std::numeric_limits<T>::digits10 : 15;
+
+  std::mt19937                       rng{42};
+  std::uniform_int_distribution<int> length{1, DIGITS};
+  std::uniform_int_distribution<int> digit{0, 9};
+  std::uniform_int_distribution<int> sign{0, 1};
+
+  std::vector<std::string> operands(count);
+  for (auto& operand : operands) {
+    const int n = length(rng);
+    if (sign(rng) != 0) {
+      operand += '-';
+    }
+
+    for (int i = 0; i < n; i++) {
+      operand += static_cast<char>('0' + digit(rng));
+      if (std::is_floating_point_v<T> && i == (n - 1) / 2 && n > 1) {
+        operand += '.';
+      }
+    }
+  }
+
+  return operands;
+}
+
+/// Benchmark operand parsing for a value type.
+template<signed_arithmetic T>
+void bench_parse(Bench& bench) {
+  constexpr std::size_t COUNT = 1 << 18;
+
+  const std::vector<std::string> operands = generate_operands<T>(COUNT);
+  std::vector<Tokens::Operand>   tokens;
+  for (const auto& operand : operands) {
+    tokens.push_back(Tokens::Operand{operand});
+  }
+
+  bench.measure("Tokens::Operand::parse", type_name<T>(), COUNT, [&] {
+    for (const auto& token : tokens) {
+      keep(token.parse<T>());
+    }
+  });
+}
+
+///
+/// Benchmark parsing operands with a base prefix, against `std::from_chars` with a base argument on the digits after the prefix.
+///
+/// The values are spread evenly over the number of bits, so the digit counts are too.
+///
+void bench_parse_based(Bench& bench, int base) {
+  constexpr std::size_t COUNT = 1 << 18;
+
+  std::mt19937_64                    rng{42};
+  std::uniform_int_distribution<int> shift{1, 63};
+
+  std::vector<std::string> operands;
+  for (std::size_t i = 0; i < COUNT; i++) {
+    const std::uint64_t value = rng() >> shift(rng);
+    switch (base) {
+    case 16: operands.push_back(fmt::format("0x{:x}", value)); break;
+    case 8: operands.push_back(fmt::format("0o{:o}", value)); break;
+    default: operands.push_back(fmt::format("0b{:b}", value)); break;
+    }
+  }
+
+  std::vector<Tokens::Operand> tokens;
+  for (const auto& operand : operands) {
+    tokens.push_back(Tokens::Operand{operand});
+  }
+
+  const std::string_view name = (base == 16) ? "hexadecimal" : ((base == 8) ? "octal" : "binary");
+
+  bench.measure("Tokens::Operand::parse", name, COUNT, [&] {
+    for (const auto& token : tokens) {
+      keep(token.parse<long>());
+    }
+  });
+
+  bench.measure("std::from_chars", name, COUNT, [&] {
+    for (const auto& operand : operands) {
+      long value{};
+      keep(std::from_chars(operand.data() + 2, operand.data() + operand.size(), value, base).ptr);
+      keep(value);
+    }
+  });
+}
+
+/// Benchmark `calculate` for a value type, for every operator it supports.
+template<typename T>
+void bench_calculate(Bench& bench) {
+  constexpr std::size_t COUNT = 1 << 18;
+
+  std::mt19937                       rng{42};
+  std::uniform_int_distribution<int> operand{-30'000, 30'000};
+
+  std::vector<T> lhs;
+  std::vector<T> rhs;
+  for (std::size_t i = 0; i < COUNT; i++) {
+    lhs.push_back(static_cast<T>(operand(rng)));
+    const int r = operand(rng);
+    rhs.push_back(static_cast<T>((r == 0) ? 1 : r)); // Division by zero throws, which is not what is measured.
+  }
+
+  for (const char op : OPERATORS) {
+    if (std::is_floating_point_v<T> && op == '%') {
+      continue;
+    }
+
+    bench.measure(fmt::format("calculate '{}'", op), type_name<T>(), COUNT, [&] {
+      for (std::size_t i = 0; i < COUNT; i++) {
+        keep(calculate(lhs[i], rhs[i], op));
+      }
+    });
+  }
+}
+
+/// Benchmark pushing two values on a stack and popping these, as the evaluation does.
+template<std::size_t N>
+void bench_stack(Bench& bench) {
+  constexpr std::size_t COUNT = 1 << 20;
+
+  bench.measure("Stack push/pop", (N == 2) ? "array" : "deque", 2 * COUNT, [&] {
+    Stack<long, N> stack;
+    for (std::size_t i = 0; i < COUNT; i++) {
+      stack.push(static_cast<long>(i));
+      stack.push(static_cast<long>(i + 1));
+      keep(stack.pop());
+      keep(stack.pop());
+    }
+  });
+}
+
+///
+/// Benchmark the calculator library: calculations per second, evaluated one at a time, and as lines of one input text.
+///
+/// The same calculations are evaluated in infix notation as well, for a comparison with native RPN input.
+///
+void bench_calculator(Bench& bench) {
+  constexpr std::size_t COUNT = 1 << 18;
+
+  const std::vector<std::string> calculations = generate_calculations(COUNT);
+  std::vector<std::string>       infix;
+
+  std::string text;
+  std::string infix_text;
+  for (const auto& calculation : calculations) {
+    text += calculation;
+    infix_text += infix.emplace_back(to_infix(calculation));
+  }
+
+  Calculator  calculator;
+  std::string output;
+
+  bench.measure("Calculator::evaluate", "", COUNT, [&] {
+    for (const auto& calculation : calculations) {
+      keep(calculator.evaluate(calculation).text.size());
+    }
+  });
+
+  bench.measure("Calculator::evaluate_lines", "", COUNT, [&] {
+    output.clear();
+    keep(calculator.evaluate_lines(text, output));
+  });
+
+  bench.measure("Calculator::evaluate_infix", "", COUNT, [&] {
+    for (const auto& calculation : infix) {
+      keep(calculator.evaluate_infix(calculation).text.size());
+    }
+  });
+
+  bench.measure("Calculator::evaluate_infix_lines", "", COUNT, [&] {
+    output.clear();
+    keep(calculator.evaluate_infix_lines(infix_text, output));
+  });
+
+  const std::string binary = generate_binary(1 << 24);
+
+  bench.measure("Calculator::evaluate_lines", "binary bytes", binary.size(), [&] {
+    output.clear();
+    keep(calculator.evaluate_lines(binary, output));
+  });
+}
+
+/// Write the results as JSON.
+void print_json(const std::vector<Measurement>& results) {
+  fmt::print("{{\n  \"benchmarks\": [\n");
+  for (std::size_t i = 0; i < results.size(); i++) {
+    const auto& [name, parameter, operations, seconds] = results[i];
+    fmt::print("    {{\"name\": \"{}\", \"parameter\": \"{}\", \"operations\": {}, \"seconds\": {:.6g}, \"ns_per_operation\": {:.4g}, "
+               "\"operations_per_second\": {:.6g}}}{}\n",
+               name, parameter, operations, seconds, seconds * 1e9 / static_cast<double>(operations), static_cast<double>(operations) / seconds,
+               (i + 1 < results.size()) ? "," : "");
+  }
+
+  fmt::print("  ]\n}}\n");
+}
+
+/// Write the results as CSV.
+void print_csv(const std::vector<Measurement>& results) {
+  fmt::print("name,parameter,operations,seconds,ns_per_operation,operations_per_second\n");
+  for (const auto& [name, parameter, operations, seconds] : results) {
+    fmt::print("\"{}\",\"{}\",{},{:.6g},{:.4g},{:.6g}\n", name, parameter, operations, seconds, seconds * 1e9 / static_cast<double>(operations),
+               static_cast<double>(operations) / seconds);
+  }
+}
+
+} // namespace
+
+int main(int argc, char** argv) {
+  try {
+    std::string format = "json"; // Output format: JSON or CSV.
+    std::string filter;          // Only run the benchmarks with this in their name or parameter.
+    int         runs   = 5;      // Number of runs per benchmark, of which the fastest counts.
+
+    for (int i = 1; i < argc; i++) {
+      const std::string_view arg{argv[i]};
+      if (arg == "--format" && (i + 1) < argc) {
+        format = argv[++i];
+      } else if (arg == "--filter" && (i + 1) < argc) {
+        filter = argv[++i];
+      } else if (arg == "--runs" && (i + 1) < argc) {
+        runs = std::max(std::stoi(argv[++i]), 1);
+      }
+    }
+
+    if (format != "json" && format != "csv") {
+      std::cerr << "Unsupported output format '" << format << "', use 'json' or 'csv'\n";
+      return 1;
+    }
+
+    Bench bench{runs, filter};
+
+    bench_tokenizer(bench);
+
+    bench_parse<signed char>(bench);
+    bench_parse<short>(bench);
+    bench_parse<int>(bench);
+    bench_parse<long>(bench);
+    bench_parse<long long>(bench);
+    bench_parse<float>(bench);
+    bench_parse<double>(bench);
+    bench_parse<long double>(bench);
+
+    bench_parse_based(bench, 16);
+    bench_parse_based(bench, 8);
+    bench_parse_based(bench, 2);
+
+    bench_calculate<int>(bench);
+    bench_calculate<long>(bench);
+    bench_calculate<double>(bench);
+    bench_calculate<Number>(bench);
+
+    bench_stack<2>(bench);
+    bench_stack<16>(bench);
+
+    bench_calculator(bench);
+
+    if (format == "json") {
+      print_json(bench.results());
+    } else {
+      print_csv(bench.results());
+    }
+  } catch (const std::exception& e) {
+    std::cerr << "Caught exception: " << e.what() << '\n';
+    return 1;
+  }
+
+  return 0;
+}
@@ -0,0 +1,175 @@
+#include "calculator.hpp"
+
+#include <algorithm>
+#include <cstdio>
+#include <stdexcept>
+
+#include "engine.hpp"
+
+namespace rpn {
+
+/// All state of a calculator, reused between calls.
+struct Calculator::State {
+  State(std::size_t width, int base)
+    : out{nullptr, width, base} {
+  }
+
+  TokenIndex       index;
+  InfixEvaluator<> infix;
+  ResultWriter     out;
+
+  /// Move the written lines to the end of a text.
+  void take(std::string& output) {
+    output.append(out.text());
+    out.erase(out.text().size());
+  }
+
+  /// The result of a single calculation, which is all of the written text.
+  [[nodiscard]] Result result(std::size_t errors) const {
+    std::string_view text = out.text();
+    text.remove_suffix(1); // The newline.
+
+    if (out.errors() != errors) {
+      return {false, text.substr(ResultWriter::ERROR_PREFIX.size())};
+    }
+
+    return {true, text};
+  }
+};
+
+namespace {
+
+///
+/// Evaluate the lines read from a file one chunk at a time, writing out the output of every chunk.
+///
+/// \param evaluate_chunk Evaluates the lines of a chunk, appending to the output and returning the number of calculations.
+///
+/// \returns The number of calculations.
+///
+std::size_t evaluate_chunks(std::FILE* source, std::FILE* sink, auto&& evaluate_chunk) {
+  InputReader reader{source};
+  std::string output;
+  std::size_t count = 0;
+
+  for (auto input = reader.read(InputReader::is_newline); !input.empty(); input = reader.read(InputReader::is_newline)) {
+    output.clear();
+    count += evaluate_chunk(input, output);
+
+    if (std::fwrite(output.data(), 1, output.size(), sink) != output.size() || std::fflush(sink) != 0) {
+      throw std::runtime_error{"failed to write output"};
+    }
+  }
+
+  return count;
+}
+
+} // namespace
+
+Calculator::Calculator(std::size_t width, int base)
+  : state_{std::make_unique<State>(width, base)} {
+}
+
+Calculator::~Calculator() = default;
+
+Calculator::Calculator(Calculator&&) noexcept            = default;
+Calculator& Calculator::operator=(Calculator&&) noexcept = default;
+
+Result Calculator::evaluate(std::string_view calculation) {
+  TokenIndex&   index  = state_->index;
+  ResultWriter& out    = state_->out;
+  std::size_t   cursor = 0;
+
+  out.erase(out.text().size());
+  index.assign(calculation);
+
+  const std::size_t errors = out.errors();
+  rpn::evaluate(index, cursor, calculation.size(), out);
+
+  return state_->result(errors);
+}
+
+Result Calculator::evaluate(std::FILE* source) {
+  ResultWriter& out = state_->out;
+  out.erase(out.text().size());
+
+  InputReader reader{source};
+  TokenStream tokens{reader};
+
+  const std::size_t errors = out.errors();
+  rpn::evaluate([&] { return tokens.next(); }, out);
+
+  return state_->result(errors);
+}
+
+Result Calculator::evaluate_infix(std::FILE* source) {
+  ResultWriter& out = state_->out;
+  out.erase(out.text().size());
+
+  InputReader reader{source};
+
+  const std::size_t errors = out.errors();
+  state_->infix.evaluate(reader, out);
+
+  return state_->result(errors);
+}
+
+Result Calculator::evaluate_infix(std::string_view calculation) {
+  ResultWriter& out = state_->out;
+  out.erase(out.text().size());
+
+  const std::size_t errors = out.errors();
+  state_->infix.evaluate(calculation, out);
+
+  return state_->result(errors);
+}
+
+std::size_t Calculator::evaluate_lines(std::string_view input, std::string& output) {
+  TokenIndex&   index  = state_->index;
+  ResultWriter& out    = state_->out;
+  std::size_t   cursor = 0;
+
+  out.erase(out.text().size());
+  index.assign(input);
+
+  // Lines without tokens are skipped, the tokens left over after an error in a line as well. Every token is passed once at most, so
+  // this scan is cheaper than a binary search per line, for which lines are too short.
+  const std::size_t lines = out.lines();
+  while (cursor < index.size()) {
+    const std::size_t limit = std::min(input.find('\n', index.starts[cursor]), input.size());
+    rpn::evaluate(index, cursor, limit, out);
+    while (cursor < index.size() && index.starts[cursor] < limit) {
+      cursor++;
+    }
+  }
+
+  state_->take(output);
+  return out.lines() - lines;
+}
+
+std::size_t Calculator::evaluate_infix_lines(std::string_view input, std::string& output) {
+  state_->out.erase(state_->out.text().size());
+
+  const std::size_t lines = state_->infix.evaluate_lines(input, state_->out);
+
+  state_->take(output);
+  return lines;
+}
+
+std::size_t Calculator::evaluate_lines(std::FILE* source, std::FILE* sink) {
+  return evaluate_chunks(source, sink, [&](std::string_view input, std::string& output) { return evaluate_lines(input, output); });
+}
+
+std::size_t Calculator::evaluate_infix_lines(std::FILE* source, std::FILE* sink) {
+  return evaluate_chunks(source, sink, [&](std::string_view input, std::string& output) { return evaluate_infix_lines(input, output); });
+}
+
+std::size_t Calculator::respond(std::string_view input, std::string& output) {
+  state_->out.erase(state_->out.text().size());
+
+  const std::size_t used = rpn::evaluate_lines(input, state_->index, state_->out);
+
+  state_->take(output);
+  return used;
+}
+
+} // namespace rpn
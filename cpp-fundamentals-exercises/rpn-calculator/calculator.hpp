@@ -0,0 +1,155 @@
+//
+// RPN calculator library.
+//
+
+#pragma once
+
+#include <cstddef>
+#include <cstdio>
+#include <memory>
+#include <string>
+#include <string_view>
+
+namespace rpn {
+
+/// Outcome of a calculation.
+struct Result {
+  bool             ok = false; // Indicates the calculation succeeded, otherwise the text is an error message.
+  std::string_view text;       // Result value or error message, refers to the calculator and is valid until its next use.
+};
+
+///
+/// Reentrant RPN calculator, to evaluate calculations in-process.
+///
+/// All state (the token index, the infix evaluation stacks and the output buffer) is owned by the calculator object, and reused between calls. There is no global
+/// state, so any number of calculators can be used concurrently from different threads. A single calculator must not be shared between
+/// threads without synchronization.
+///
+/// Values are integers of any size. Operands are decimal, or hexadecimal, octal or binary with the prefixes `0x`, `0o` and `0b`. Results
+/// are formatted like the command-line calculator does: result values are written in the output base and right-aligned to the minimum
+/// width, and error messages are prefixed with "Error: " in the output of the line-based functions.
+///
+class Calculator {
+public:
+  ///
+  /// \param width Minimum result value width, zero for none.
+  /// \param base Base of the result values: 10, or 16, 8 or 2 (written with the prefix of operands in that base).
+  ///
+  /// \throws A `std::invalid_argument` for an unsupported base.
+  ///
+  explicit Calculator(std::size_t width = 0, int base = 10);
+  ~Calculator();
+
+  Calculator(Calculator&&) noexcept;
+  Calculator& operator=(Calculator&&) noexcept;
+
+  ///
+  /// Evaluate a single calculation.
+  ///
+  /// \param calculation The calculation text, newlines are whitespace like any other.
+  ///
+  /// \returns The result value or error message, without a trailing newline.
+  ///
+  /// \throws A `std::length_error` if the calculation is larger than 4 GiB.
+  ///
+  [[nodiscard]] Result evaluate(std::string_view calculation);
+
+  ///
+  /// Evaluate a single infix calculation, like `(4 + 5) * -2`.
+  ///
+  /// The operators `*`, `/` and `%` take precedence over `+` and `-`, parentheses group, and a `-` where an operand is expected
+  /// negates. The operators are applied while the calculation is read, without building an RPN calculation.
+  ///
+  /// \param calculation The calculation text, newlines are whitespace like any other.
+  ///
+  /// \returns The result value or error message, without a trailing newline.
+  ///
+  [[nodiscard]] Result evaluate_infix(std::string_view calculation);
+
+  ///
+  /// Evaluate every line with tokens as a separate calculation, like the `--lines` mode of the command-line calculator.
+  ///
+  /// \param input Input text.
+  /// \param output Text to append a result or error message line to, for every calculation.
+  ///
+  /// \returns The number of calculations.
+  ///
+  std::size_t evaluate_lines(std::string_view input, std::string& output);
+
+  ///
+  /// Evaluate every line with tokens as a separate infix calculation, like `evaluate_lines` does for RPN calculations.
+  ///
+  /// \param input Input text.
+  /// \param output Text to append a result or error message line to, for every calculation.
+  ///
+  /// \returns The number of calculations.
+  ///
+  std::size_t evaluate_infix_lines(std::string_view input, std::string& output);
+
+  ///
+  /// Evaluate a single calculation read from a file, in chunks of bounded size, so it need not fit in memory. Reading stops at the end of
+  /// the calculation or at its first error.
+  ///
+  /// \param source File to read the calculation text from.
+  ///
+  /// \returns The result value or error message, without a trailing newline.
+  ///
+  /// \throws A `std::runtime_error` if reading fails.
+  ///
+  [[nodiscard]] Result evaluate(std::FILE* source);
+
+  ///
+  /// Evaluate a single infix calculation read from a file, like `evaluate` does for RPN calculations.
+  ///
+  /// \param source File to read the calculation text from.
+  ///
+  /// \returns The result value or error message, without a trailing newline.
+  ///
+  /// \throws A `std::runtime_error` if reading fails.
+  ///
+  [[nodiscard]] Result evaluate_infix(std::FILE* source);
+
+  ///
+  /// Evaluate every line with tokens read from a file as a separate calculation, like `evaluate_lines`.
+  ///
+  /// The input is read in chunks of bounded size that end at a line end, and the output is written per chunk, so the input need not fit
+  /// in memory, and interactive input is answered line by line.
+  ///
+  /// \param source File to read the input text from.
+  /// \param sink File to write the result and error message lines to.
+  ///
+  /// \returns The number of calculations.
+  ///
+  /// \throws A `std::runtime_error` if reading or writing fails.
+  ///
+  std::size_t evaluate_lines(std::FILE* source, std::FILE* sink);
+
+  ///
+  /// Evaluate every line with tokens read from a file as a separate infix calculation, like `evaluate_lines` does for RPN calculations.
+  ///
+  /// \param source File to read the input text from.
+  /// \param sink File to write the result and error message lines to.
+  ///
+  /// \returns The number of calculations.
+  ///
+  /// \throws A `std::runtime_error` if reading or writing fails.
+  ///
+  std::size_t evaluate_infix_lines(std::FILE* source, std::FILE* sink);
+
+  ///
+  /// Evaluate all complete lines of input text, like the calculator server. Every line gets a response line, also lines without tokens.
+  ///
+  /// \param input Input text, the part after the last newline is left for later.
+  /// \param output Text to append the response lines to.
+  ///
+  /// \returns The number of bytes of input evaluated.
+  ///
+  std::size_t respond(std::string_view input, std::string& output);
+
+private:
+  struct State;
+
+  std::unique_ptr<State> state_;
+};
+
+} // namespace rpn
@@ -0,0 +1,270 @@
+//
+// Conformance test runner: evaluates test cases from data files in-process using the calculator library, on all processor cores.
+//
+
+#include <fmt/core.h>
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <deque>
+#include <exception>
+#include <fstream>
+#include <iostream>
+#include <random>
+#include <sstream>
+#include <stdexcept>
+#include <string>
+#include <string_view>
+#include <thread>
+#include <vector>
+
+#include "calculator.hpp"
+
+namespace {
+
+/// Conformance test case, referring to the text of its data file.
+struct Case {
+  std::string_view input;    // The calculation.
+  std::string_view expected; // The expected output, without trailing newline.
+  std::string_view file;     // Data file name.
+  std::size_t      line = 0; // Line number in the data file.
+};
+
+/// Failed test case.
+struct Failure {
+  const Case* test;
+  std::string output;
+};
+
+///
+/// Read a file.
+///
+/// \throws A `std::runtime_error` if the file cannot be read.
+///
+[[nodiscard]] std::string read_file(const std::string& path) {
+  std::ifstream file{path, std::ios::binary};
+  if (!file) {
+    throw std::runtime_error{fmt::format("failed to open '{}'", path)};
+  }
+
+  std::ostringstream text;
+  text << file.rdbuf();
+  return std::move(text).str();
+}
+
+///
+/// Parse the test cases of a data file.
+///
+/// Every line holds a calculation and the expected output, separated by a tab. Empty lines, and lines starting with '#' are skipped.
+///
+/// \param text Text of the data file, which the test cases refer to.
+/// \param file Data file name, for error messages.
+/// \param cases Test cases to append to.
+///
+/// \throws A `std::runtime_error` if a line has no tab.
+///
+void parse_cases(std::string_view text, std::string_view file, std::vector<Case>& cases) {
+  std::size_t line = 0;
+  for (std::size_t begin = 0; begin < text.size();) {
+    const std::size_t end  = std::min(text.find('\n', begin), text.size());
+    std::string_view  test = text.substr(begin, end - begin);
+    begin                  = end + 1;
+    line++;
+
+    if (test.ends_with('\r')) {
+      test.remove_suffix(1);
+    }
+
+    if (test.empty() || test.starts_with('#')) {
+      continue;
+    }
+
+    const std::size_t tab = test.find('\t');
+    if (tab == std::string_view::npos) {
+      throw std::runtime_error{fmt::format("{}:{}: expected a tab between calculation and expected output", file, line)};
+    }
+
+    cases.push_back({test.substr(0, tab), test.substr(tab + 1), file, line});
+  }
+}
+
+///
+/// Run test cases, spread over a number of threads, each with its own calculator.
+///
+/// \param cases The test cases.
+/// \param threads Number of threads.
+///
+/// \returns The failed test cases, in order.
+///
+[[nodiscard]] std::vector<Failure> run(const std::vector<Case>& cases, std::size_t threads) {
+  constexpr std::size_t CHUNK = 1024; // Number of test cases a thread takes at a time.
+
+  std::atomic<std::size_t>          next{0};
+  std::vector<std::vector<Failure>> failures(threads);
+
+  const auto work = [&](std::vector<Failure>& failed) {
+    rpn::Calculator calculator;
+    for (std::size_t begin = 0; (begin = next.fetch_add(CHUNK)) < cases.size();) {
+      for (std::size_t i = begin; i < std::min(begin + CHUNK, cases.size()); i++) {
+        const Case& test      = cases[i];
+        const auto [ok, text] = calculator.evaluate(test.input);
+        if (ok ? (text != test.expected) : (!test.expected.starts_with("Error: ") || test.expected.substr(7) != text)) {
+          failed.push_back({&test, fmt::format("{}{}", ok ? "" : "Error: ", text)});
+        }
+      }
+    }
+  };
+
+  std::vector<std::thread> pool;
+  for (std::size_t t = 1; t < threads; t++) {
+    pool.emplace_back(work, std::ref(failures[t]));
+  }
+
+  work(failures[0]);
+  for (auto& thread : pool) {
+    thread.join();
+  }
+
+  std::vector<Failure> failed;
+  for (auto& f : failures) {
+    std::ranges::move(f, std::back_inserter(failed));
+  }
+
+  std::ranges::sort(failed, {}, &Failure::test);
+  return failed;
+}
+
+///
+/// Write generated test cases to the standard output.
+///
+/// The expected outputs come from a reference evaluation independent of the calculator: `__int128` arithmetic on operands of at most
+/// seven digits, which cannot overflow for the at most four operations per calculation. Some calculations have an invalid or a missing
+/// last operator, or divide by zero, for the error messages.
+///
+/// \param count Number of test cases.
+/// \param seed Seed of the random number generator.
+///
+void generate(std::size_t count, unsigned int seed) {
+  std::mt19937                       rng{seed};
+  std::uniform_int_distribution<int> length{1, 4};
+  std::uniform_int_distribution<int> operand{-1'000'000, 1'000'000};
+  std::uniform_int_distribution<int> small{-3, 3}; // Makes division by zero likely enough.
+  std::uniform_int_distribution<int> op{0, 4};
+  std::uniform_int_distribution<int> variant{0, 63};
+
+  std::string text = "# Generated conformance test cases.\n";
+  for (std::size_t i = 0; i < count; i++) {
+    __int128    value = operand(rng);
+    std::string error;
+
+    text += fmt::format("{}", static_cast<long>(value));
+    for (int n = length(rng); n > 0; n--) {
+      const int  kind = variant(rng);
+      const long rhs  = (kind < 8) ? small(rng) : operand(rng);
+      const char o    = (n == 1 && kind == 63) ? 'x' : "+-*/%"[op(rng)];
+      text += fmt::format(" {}", rhs);
+
+      if (n == 1 && kind == 62) {
+        error = error.empty() ? "expected operator, got end-of-calculation" : error;
+        break;
+      }
+
+      text += fmt::format(" {}", o);
+      if (!error.empty()) {
+        continue;
+      }
+
+      switch (o) {
+      case '+': value += rhs; break;
+      case '-': value -= rhs; break;
+      case '*': value *= rhs; break;
+      case '/':
+      case '%':
+        if (rhs == 0) {
+          error = "division by zero";
+        } else {
+          value = (o == '/') ? value / rhs : value % rhs;
+        }
+        break;
+      default: error = "expected operator, got invalid token"; break;
+      }
+    }
+
+    text += '\t';
+    text += error.empty() ? fmt::format("{}", value) : "Error: " + error;
+    text += '\n';
+
+    if (text.size() >= (1 << 20)) {
+      std::fwrite(text.data(), 1, text.size(), stdout);
+      text.clear();
+    }
+  }
+
+  std::fwrite(text.data(), 1, text.size(), stdout);
+  if (std::fflush(stdout) != 0) {
+    throw std::runtime_error{"failed to write output"};
+  }
+}
+
+} // namespace
+
+int main(int argc, char** argv) {
+  try {
+    std::vector<std::string> paths;                                                         // Test data files.
+    std::size_t              threads   = std::max(std::thread::hardware_concurrency(), 1U); // Number of threads to run the tests on.
+    std::size_t              generated = 0;                                                 // Number of test cases to generate.
+    unsigned int             seed      = 42;                                                // Seed for generated test cases.
+
+    for (int i = 1; i < argc; i++) {
+      const std::string_view arg{argv[i]};
+      if (arg == "--threads" && (i + 1) < argc) {
+        threads = std::max(std::stoul(argv[++i]), 1UL);
+      } else if (arg == "--generate" && (i + 1) < argc) {
+        generated = std::stoul(argv[++i]);
+      } else if (arg == "--seed" && (i + 1) < argc) {
+        seed = static_cast<unsigned int>(std::stoul(argv[++i]));
+      } else {
+        paths.emplace_back(arg);
+      }
+    }
+
+    if (generated > 0) {
+      generate(generated, seed);
+      return 0;
+    }
+
+    if (paths.empty()) {
+      std::cerr << fmt::format("Usage: {} [--threads <count>] <test_file>...\n       {} --generate <count> [--seed <seed>]\n", argv[0], argv[0]);
+      return 1;
+    }
+
+    std::deque<std::string> texts; // Never moves the texts, which the test cases refer to.
+    std::vector<Case>       cases;
+    for (const auto& path : paths) {
+      parse_cases(texts.emplace_back(read_file(path)), path, cases);
+    }
+
+    const auto                          t_start = std::chrono::steady_clock::now();
+    const std::vector<Failure>          failed  = run(cases, threads);
+    const std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - t_start;
+
+    for (const auto& [test, output] : failed) {
+      std::cout << fmt::format("\033[1m\033[31m[FAIL]\033[0m: {}:{}: {} \033[1m-->\033[0m {}\n", test->file, test->line, test->input,
+                               test->expected);
+      std::cout << fmt::format("\033[1m\033[31mExpected: '{}', got: '{}'\033[0m\n", test->expected, output);
+    }
+
+    std::cout << fmt::format("\033[1m[INFO]\033[0m: Test summary: ran {} tests in total, of which {} tests \033[1m\033[32mPASS\033[0med and {} "
+                             "tests \033[1m\033[31mFAIL\033[0med.\n",
+                             cases.size(), cases.size() - failed.size(), failed.size());
+    std::cout << fmt::format("\033[1m[INFO]\033[0m: Ran on {} threads in {:.3f} s: {:.0f} tests/s.\n", threads, elapsed.count(),
+                             static_cast<double>(cases.size()) / elapsed.count());
+
+    return failed.empty() ? 0 : 1;
+  } catch (const std::exception& e) {
+    std::cerr << "Caught exception: " << e.what() << '\n';
+    return 1;
+  }
+}
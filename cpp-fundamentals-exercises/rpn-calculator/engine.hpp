@@ -0,0 +1,2231 @@
+//
+// Calculator engine: tokenizer, value types and evaluation, shared by the calculator library and its tools.
+//
+// Everything here is either a type, a constant, or a (template or inline) function without state of its own. All state is passed in
+// by the caller, so the engine can be used from any number of threads at once, as long as each uses its own objects.
+//
+
+#pragma once
+
+#include <fmt/core.h>
+
+#if defined(__x86_64__) && (defined(__GNUC__) || defined(__clang__))
+#include <immintrin.h>
+#define HAVE_X86_SIMD
+#endif
+
+#if __has_include(<unistd.h>)
+#include <unistd.h>
+#define HAVE_POSIX_READ
+#endif
+
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <bit>
+#include <cerrno>
+#include <charconv>
+#include <cmath>
+#include <concepts>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <exception>
+#include <functional>
+#include <limits>
+#include <optional>
+#include <stdexcept>
+#include <string>
+#include <string_view>
+#include <type_traits>
+#include <utility>
+#include <variant>
+#include <vector>
+
+#include "stack.hpp"
+
+namespace rpn {
+
+/// Helper class to let function overloading deal with type selection.
+template<typename... Ts>
+struct overload : Ts... {
+  using Ts::operator()...;
+};
+
+/// Class template argument (CTAD) deduction guide, not needed for C++20 and later.
+// template<typename... Ts> overload(Ts...) -> overload<Ts...>;
+
+/// The set of allowed operators.
+inline constexpr std::string_view OPERATORS = "+-*/%";
+
+/// Calculation-related specific error type.
+class calculation_error final : public std::exception {
+public:
+  explicit calculation_error(std::string_view message)
+    : message_{message} {
+  }
+
+  [[nodiscard]] const char* what() const noexcept override {
+    return message_.c_str();
+  }
+
+private:
+  std::string message_;
+};
+
+namespace States {
+
+/// Expecting operand 1.
+struct Operand1 {};
+
+/// Expecting operand 2.
+struct Operand2 {};
+
+/// Expecting operator.
+struct Operator {};
+
+/// Show result.
+struct Result {};
+
+} // namespace States
+
+/// State representation.
+using State = std::variant<States::Operand1, States::Operand2, States::Operator, States::Result>;
+
+/// Any signed arithmetic type.
+template<typename T>
+concept signed_arithmetic = std::is_signed_v<T> && std::is_arithmetic_v<T>;
+
+
+///
+/// Check whether all eight bytes of a chunk are ASCII digits.
+///
+/// Adding 6 to a digit byte keeps its upper nibble at 3, while it carries it over for ':' and up. So both the byte and the byte plus
+/// six have 3 as their upper nibble only for digits.
+///
+[[nodiscard]] constexpr bool is_eight_digits(std::uint64_t chunk) {
+  return ((chunk & 0xF0F0F0F0F0F0F0F0) | (((chunk + 0x0606060606060606) & 0xF0F0F0F0F0F0F0F0) >> 4)) == 0x3333333333333333;
+}
+
+///
+/// Convert a chunk of eight ASCII digits (loaded little-endian, so the first digit is in the lowest byte) to its value.
+///
+/// Using SIMD-within-a-register (SWAR), each step combines pairs of neighbouring lanes into lanes of double the width using a single
+/// multiplication: digits into 2-digit values, into 4-digit values, into the 8-digit value.
+///
+[[nodiscard]] constexpr std::uint32_t parse_eight_digits(std::uint64_t chunk) {
+  chunk = ((chunk & 0x0F0F0F0F0F0F0F0F) * ((10 << 8) + 1)) >> 8;
+  chunk = ((chunk & 0x00FF00FF00FF00FF) * ((100 << 16) + 1)) >> 16;
+  return static_cast<std::uint32_t>(((chunk & 0x0000FFFF0000FFFF) * ((10000ULL << 32) + 1)) >> 32);
+}
+
+/// Load eight characters as a little-endian chunk.
+[[nodiscard]] constexpr std::uint64_t load_chunk(const char* digits) {
+  std::uint64_t chunk = 0;
+  if (std::is_constant_evaluated()) {
+    for (std::size_t i = 0; i < sizeof(chunk); i++) {
+      chunk |= static_cast<std::uint64_t>(static_cast<unsigned char>(digits[i])) << (8 * i);
+    }
+
+    return chunk;
+  }
+
+  std::memcpy(&chunk, digits, sizeof(chunk));
+  if constexpr (std::endian::native == std::endian::big) {
+    chunk = __builtin_bswap64(chunk);
+  }
+
+  return chunk;
+}
+
+///
+/// Parse a decimal integer, eight digits at a time where possible.
+///
+/// \returns The parsed value, or nothing if the input is not a plain (optionally negative) decimal integer.
+///
+/// \throws A `calculation_error` if the value does not fit the value type.
+///
+template<std::integral T>
+[[nodiscard]] constexpr std::optional<T> parse_integer(std::string_view value) {
+  const bool       negative = value.starts_with('-');
+  std::string_view digits   = value.substr(negative ? 1 : 0);
+
+  if (digits.empty()) {
+    return std::nullopt;
+  }
+
+  // Up to 19 digits always fit 64 bits. Only for longer input leading zeros matter.
+  if (digits.size() > std::numeric_limits<std::uint64_t>::digits10) {
+    const std::size_t significant = digits.find_first_not_of('0');
+    if (significant == std::string_view::npos) {
+      return T{0};
+    }
+
+    digits.remove_prefix(significant);
+  }
+
+  if (digits.size() > std::numeric_limits<std::uint64_t>::digits10) {
+    if (std::ranges::all_of(digits, [](char c) { return c >= '0' && c <= '9'; })) {
+      throw calculation_error{fmt::format("failed to parse input '{}': parse type value overflow", value)};
+    }
+
+    return std::nullopt;
+  }
+
+  // Parse the leading digits that do not fill a chunk one at a time. For short numbers this is faster than combining the lanes.
+  std::uint64_t     magnitude = 0;
+  const std::size_t head      = digits.size() % 8;
+  for (std::size_t i = 0; i < head; i++) {
+    const auto digit = static_cast<unsigned char>(digits[i] - '0');
+    if (digit > 9) {
+      return std::nullopt;
+    }
+
+    magnitude = (magnitude * 10) + digit;
+  }
+
+  for (std::size_t offset = head; offset < digits.size(); offset += 8) {
+    const std::uint64_t chunk = load_chunk(digits.data() + offset);
+    if (!is_eight_digits(chunk)) {
+      return std::nullopt;
+    }
+
+    magnitude = (magnitude * 100'000'000) + parse_eight_digits(chunk);
+  }
+
+  if (magnitude > static_cast<std::uint64_t>(std::numeric_limits<T>::max()) + (negative ? 1 : 0)) {
+    throw calculation_error{fmt::format("failed to parse input '{}': parse type value overflow", value)};
+  }
+
+  return static_cast<T>(negative ? (std::uint64_t{0} - magnitude) : magnitude);
+}
+
+/// Digit value of every byte, for bases up to 16 (with either case for the letter digits), or 0xFF for bytes that are no digit.
+inline constexpr std::array<std::uint8_t, 256> DIGIT_VALUES = [] {
+  std::array<std::uint8_t, 256> values{};
+  values.fill(0xFF);
+  for (std::uint8_t i = 0; i < 10; i++) {
+    values['0' + i] = i;
+  }
+
+  for (std::uint8_t i = 0; i < 6; i++) {
+    values['a' + i] = values['A' + i] = static_cast<std::uint8_t>(10 + i);
+  }
+
+  return values;
+}();
+
+/// Integer literal with a base prefix.
+struct BasedLiteral {
+  bool             negative = false; // Indicates a leading minus sign.
+  int              base     = 0;     // 16 for prefix `0x`, 8 for `0o`, and 2 for `0b`.
+  std::string_view digits;           // The digits after the prefix, not validated.
+};
+
+///
+/// Split an integer literal with a base prefix (`0x`, `0o` or `0b`, in either case), after an optional minus sign.
+///
+/// \returns The parts of the literal, or nothing if it has no base prefix.
+///
+[[nodiscard]] constexpr std::optional<BasedLiteral> split_based_literal(std::string_view value) {
+  const bool negative = value.starts_with('-');
+  value.remove_prefix(negative ? 1 : 0);
+
+  if (value.size() < 2 || value[0] != '0') {
+    return std::nullopt;
+  }
+
+  switch (value[1] | 0x20) { // To lower case.
+  case 'x': return BasedLiteral{negative, 16, value.substr(2)};
+  case 'o': return BasedLiteral{negative, 8, value.substr(2)};
+  case 'b': return BasedLiteral{negative, 2, value.substr(2)};
+  default: return std::nullopt;
+  }
+}
+
+/// Check whether a token is an integer literal with a base prefix, and at least one digit, all valid for its base.
+[[nodiscard]] constexpr bool is_based_literal(std::string_view value) {
+  const auto literal = split_based_literal(value);
+  return literal && !literal->digits.empty()
+      && std::ranges::all_of(literal->digits, [&](char c) { return DIGIT_VALUES[static_cast<unsigned char>(c)] < literal->base; });
+}
+
+///
+/// Check whether all eight bytes of a chunk are hexadecimal digits.
+///
+/// Bytes up to 0x7F are checked for ranges using additions that cannot carry into the next byte: `c + (0x80 - lo)` has its high bit set
+/// if `c >= lo`, and `c + (0x7F - hi)` has it clear if `c <= hi`. Setting bit 5 maps 'A' to 'F' onto 'a' to 'f', and leaves digits be.
+///
+[[nodiscard]] constexpr bool is_eight_hex_digits(std::uint64_t chunk) {
+  constexpr std::uint64_t ONES = 0x0101010101010101;
+  constexpr std::uint64_t HIGH = 0x8080808080808080;
+
+  const auto in_range = [&](std::uint64_t c, std::uint64_t lo, std::uint64_t hi) {
+    return ((c + ((0x80 - lo) * ONES)) & ~(c + ((0x7F - hi) * ONES))) & HIGH;
+  };
+
+  return (chunk & HIGH) == 0 && (in_range(chunk, '0', '9') | in_range(chunk | (0x20 * ONES), 'a', 'f')) == HIGH;
+}
+
+///
+/// Convert a chunk of eight hexadecimal digits (loaded little-endian, so the first digit is in the lowest byte) to its value.
+///
+/// The low nibble of a byte is the digit value, plus 9 for letters, which have bit 6 set. The digits are combined like decimal digits
+/// in `parse_eight_digits`, into lanes of double the width at every step.
+///
+[[nodiscard]] constexpr std::uint32_t parse_eight_hex_digits(std::uint64_t chunk) {
+  chunk = (chunk & 0x0F0F0F0F0F0F0F0F) + (((chunk >> 6) & 0x0101010101010101) * 9);
+  chunk = ((chunk * ((16 << 8) + 1)) >> 8) & 0x00FF00FF00FF00FF;
+  chunk = ((chunk * ((256 << 16) + 1)) >> 16) & 0x0000FFFF0000FFFF;
+  return static_cast<std::uint32_t>((chunk * ((65536ULL << 32) + 1)) >> 32);
+}
+
+/// Check whether all eight bytes of a chunk are octal digits: '0' to '7' differ in their lowest three bits only.
+[[nodiscard]] constexpr bool is_eight_octal_digits(std::uint64_t chunk) {
+  return (chunk & 0xF8F8F8F8F8F8F8F8) == 0x3030303030303030;
+}
+
+/// Convert a chunk of eight octal digits (loaded little-endian) to its value, like `parse_eight_hex_digits` does.
+[[nodiscard]] constexpr std::uint32_t parse_eight_octal_digits(std::uint64_t chunk) {
+  chunk = (((chunk & 0x0707070707070707) * ((8 << 8) + 1)) >> 8) & 0x00FF00FF00FF00FF;
+  chunk = ((chunk * ((64 << 16) + 1)) >> 16) & 0x0000FFFF0000FFFF;
+  return static_cast<std::uint32_t>((chunk * ((4096ULL << 32) + 1)) >> 32);
+}
+
+/// Check whether all eight bytes of a chunk are binary digits: '0' and '1' differ in their lowest bit only.
+[[nodiscard]] constexpr bool is_eight_binary_digits(std::uint64_t chunk) {
+  return (chunk & 0xFEFEFEFEFEFEFEFE) == 0x3030303030303030;
+}
+
+///
+/// Convert a chunk of eight binary digits (loaded little-endian) to its value.
+///
+/// A single multiplication gathers the digit bits (bit 8i for digit i) into the highest byte, the first digit most significant: the
+/// multiplier moves bit 8i to bit 63 - i, and no two other products of its bits and the digit bits overlap, so nothing carries.
+///
+[[nodiscard]] constexpr std::uint8_t parse_eight_binary_digits(std::uint64_t chunk) {
+  return static_cast<std::uint8_t>(((chunk & 0x0101010101010101) * 0x8040201008040201) >> 56);
+}
+
+/// Sign and magnitude of an integer literal with a base prefix.
+struct BasedValue {
+  bool          negative  = false;
+  std::uint64_t magnitude = 0;
+};
+
+///
+/// Parse the sign and magnitude of an integer literal with a base prefix, eight digits at a time where possible.
+///
+/// \returns The parsed value, or nothing if the input is not an integer literal with a base prefix, or has invalid digits.
+///
+/// \throws A `calculation_error` if the magnitude does not fit 64 bits.
+///
+[[nodiscard]] constexpr std::optional<BasedValue> parse_based_magnitude(std::string_view value) {
+  const auto literal = split_based_literal(value);
+  if (!literal || literal->digits.empty()) {
+    return std::nullopt;
+  }
+
+  const int        base   = literal->base;
+  const int        bits   = std::countr_zero(static_cast<unsigned int>(base)); // Per digit.
+  std::string_view digits = literal->digits;
+
+  // For octal the first of 22 digits can only be 0 or 1, as the digits have 66 bits.
+  const std::size_t max_digits = (64 + bits - 1) / bits;
+  const int         top_bits   = 64 - (bits * static_cast<int>(max_digits - 1)); // Of the first digit.
+
+  // Only for longer input leading zeros matter.
+  if (digits.size() > max_digits) {
+    digits.remove_prefix(std::min(digits.find_first_not_of('0'), digits.size() - 1));
+  }
+
+  if (digits.size() > max_digits || (digits.size() == max_digits && (DIGIT_VALUES[static_cast<unsigned char>(digits[0])] >> top_bits) != 0)) {
+    if (is_based_literal(value)) {
+      throw calculation_error{fmt::format("failed to parse input '{}': parse type value overflow", value)};
+    }
+
+    return std::nullopt;
+  }
+
+  // Add a chunk of eight digits to the magnitude, if these are all valid.
+  std::uint64_t magnitude = 0;
+  const auto    add_chunk = [&](std::uint64_t chunk) {
+    if (base == 16 && is_eight_hex_digits(chunk)) {
+      magnitude = (magnitude << 32) | parse_eight_hex_digits(chunk);
+    } else if (base == 8 && is_eight_octal_digits(chunk)) {
+      magnitude = (magnitude << 24) | parse_eight_octal_digits(chunk);
+    } else if (base == 2 && is_eight_binary_digits(chunk)) {
+      magnitude = (magnitude << 8) | parse_eight_binary_digits(chunk);
+    } else {
+      return false;
+    }
+
+    return true;
+  };
+
+  const std::size_t head = digits.size() % 8;
+  if (digits.size() < 8) {
+    // Short numbers one digit at a time, using the lookup table.
+    for (const char c : digits) {
+      const std::uint8_t digit = DIGIT_VALUES[static_cast<unsigned char>(c)];
+      if (digit >= base) {
+        return std::nullopt;
+      }
+
+      magnitude = (magnitude << bits) | digit;
+    }
+  } else if (head != 0 && !add_chunk((load_chunk(digits.data()) << (8 * (8 - head))) | (0x3030303030303030 >> (8 * head)))) {
+    // The leading digits that do not fill a chunk, taken from the first eight, and padded with zeros in front.
+    return std::nullopt;
+  }
+
+  for (std::size_t offset = (digits.size() < 8) ? digits.size() : head; offset < digits.size(); offset += 8) {
+    if (!add_chunk(load_chunk(digits.data() + offset))) {
+      return std::nullopt;
+    }
+  }
+
+  return BasedValue{literal->negative, magnitude};
+}
+
+///
+/// Parse an integer literal with a base prefix.
+///
+/// The digits are the magnitude, like for decimal integers: `-0x10` is -16, and `0xFFFFFFFFFFFFFFFF` overflows a `long`.
+///
+/// \returns The parsed value, or nothing if the input is not an integer literal with a base prefix, or has invalid digits.
+///
+/// \throws A `calculation_error` if the value does not fit the value type.
+///
+template<std::integral T>
+[[nodiscard]] constexpr std::optional<T> parse_based_integer(std::string_view value) {
+  const auto v = parse_based_magnitude(value);
+  if (!v) {
+    return std::nullopt;
+  }
+
+  if (v->magnitude > static_cast<std::uint64_t>(std::numeric_limits<T>::max()) + (v->negative ? 1 : 0)) {
+    throw calculation_error{fmt::format("failed to parse input '{}': parse type value overflow", value)};
+  }
+
+  return static_cast<T>(v->negative ? (std::uint64_t{0} - v->magnitude) : v->magnitude);
+}
+
+namespace Tokens {
+
+/// Operand token.
+struct Operand {
+  const std::string_view value; // Refers to the input text.
+
+  ///
+  /// Parse token to a value type indicated by the template argument.
+  ///
+  /// \returns The parsed value.
+  ///
+  /// \throws An exception when a parse error occurs, or this function is called on an empty value.
+  ///
+  template<signed_arithmetic T>
+  [[nodiscard]] constexpr T parse() const {
+    if (!value.empty()) {
+      // Plain integers take the fast paths, anything else (like fractions for integral types) gets diagnosed below. Literals with a base
+      // prefix go first, these are told apart by two bytes, and do not pass the decimal attempt.
+      if constexpr (std::is_integral_v<T>) {
+        if (const auto b = parse_based_integer<T>(value)) {
+          return *b;
+        } else if (const auto v = parse_integer<T>(value)) {
+          return *v;
+        }
+      } else if (const auto b = parse_based_integer<long long>(value)) {
+        return static_cast<T>(*b);
+      }
+
+      //
+      // NOTE: Select the 'long double' overload of from_chars for maximum value width. Depending on the platform for
+      //        which this code is compiled, it will provide 80 bits or even 128 bits extended floating-point precision.
+      //        For MSVC this may not even have any effect and will still use 64 bits, like 'double'.
+      //
+      long double v{};
+      const auto [ptr, error] = std::from_chars(value.data(), value.data() + value.size(), v);
+      if (error == std::errc{}) {
+        // Check for invalid cross-type parse requests.
+        if constexpr (std::is_integral_v<T> && !std::is_floating_point_v<T>) {
+          if (std::fmod(v, 1.0) > std::numeric_limits<double>::epsilon()) {
+            throw std::logic_error{fmt::format("failed to parse input '{}': invalid cross-type parse", value)};
+          }
+        }
+
+        // Check for overflow errors.
+        if (v > static_cast<double>(std::numeric_limits<T>::max()) || v < static_cast<double>(std::numeric_limits<T>::lowest())) {
+          throw calculation_error{fmt::format("failed to parse input '{}': parse type value overflow", value)};
+        }
+
+        return static_cast<T>(v);
+      } else {
+        throw calculation_error{fmt::format("failed to parse input '{}'", value)};
+      }
+    }
+
+    throw std::logic_error{"trying to call parse on an empty value"};
+  }
+};
+
+/// Operator token.
+struct Operator {
+  const char op;
+};
+
+/// End-of-calculation token.
+struct Eoc {};
+
+/// Invalid token.
+struct Invalid {};
+
+} // namespace Tokens
+
+/// Input token representation.
+using Token = std::variant<Tokens::Operand, Tokens::Operator, Tokens::Eoc, Tokens::Invalid>;
+
+/// Byte classes of a block of 64 input bytes, as bit masks with bit i for byte i.
+struct BlockMasks {
+  std::uint64_t whitespace = 0; // Any of ' ', '\t', '\n', '\v', '\f' and '\r'.
+  std::uint64_t digits     = 0; // Any of '0' to '9'.
+  std::uint64_t newlines   = 0; // Only '\n'.
+  std::uint64_t binary     = 0; // Non-ASCII bytes, and control bytes other than whitespace. No valid token contains these.
+};
+
+/// Function classifying a block of 64 input bytes.
+using Classifier = BlockMasks (*)(const char* block);
+
+
+/// Block size of the classifiers in [bytes].
+inline constexpr std::size_t BLOCK_SIZE = 64;
+
+/// Classify a block of input bytes, one byte at a time. This is the reference for the vectorized classifiers.
+[[nodiscard]] inline BlockMasks classify_scalar(const char* block) {
+  BlockMasks masks;
+  for (std::size_t i = 0; i < BLOCK_SIZE; i++) {
+    const char c = block[i];
+    const bool space = (c == ' ' || (c >= '\t' && c <= '\r'));
+    masks.whitespace |= static_cast<std::uint64_t>(space) << i;
+    masks.digits |= static_cast<std::uint64_t>(c >= '0' && c <= '9') << i;
+    masks.newlines |= static_cast<std::uint64_t>(c == '\n') << i;
+    masks.binary |= static_cast<std::uint64_t>(!space && (c < ' ' || c > '~')) << i;
+  }
+
+  return masks;
+}
+
+#ifdef HAVE_X86_SIMD
+
+///
+/// Classify a block of input bytes, 16 bytes at a time using SSE2 (which every x86-64 processor supports).
+///
+/// Range checks use a wrapping subtraction and a saturating subtraction: `c` is in `[lo, lo + n]` if `(c - lo) -sat n` is zero.
+///
+[[nodiscard]] inline BlockMasks classify_sse2(const char* block) {
+  const auto in_range = [](__m128i v, char lo, char n) {
+    return _mm_cmpeq_epi8(_mm_subs_epu8(_mm_sub_epi8(v, _mm_set1_epi8(lo)), _mm_set1_epi8(n)), _mm_setzero_si128());
+  };
+
+  const auto to_mask = [](__m128i v, std::size_t i) { return static_cast<std::uint64_t>(static_cast<std::uint16_t>(_mm_movemask_epi8(v))) << (16 * i); };
+
+  BlockMasks    masks;
+  std::uint64_t text = 0; // Printable ASCII and whitespace.
+  for (std::size_t i = 0; i < BLOCK_SIZE / 16; i++) {
+    const __m128i v     = _mm_loadu_si128(reinterpret_cast<const __m128i*>(block + (16 * i)));
+    const __m128i space = _mm_or_si128(_mm_cmpeq_epi8(v, _mm_set1_epi8(' ')), in_range(v, '\t', '\r' - '\t'));
+
+    masks.whitespace |= to_mask(space, i);
+    masks.digits |= to_mask(in_range(v, '0', 9), i);
+    masks.newlines |= to_mask(_mm_cmpeq_epi8(v, _mm_set1_epi8('\n')), i);
+    text |= to_mask(_mm_or_si128(space, in_range(v, ' ', '~' - ' ')), i);
+  }
+
+  masks.binary = ~text;
+  return masks;
+}
+
+/// Classify a block of input bytes, 32 bytes at a time using AVX2. Only call this if the processor supports AVX2.
+[[gnu::target("avx2")]] [[nodiscard]] inline BlockMasks classify_avx2(const char* block) {
+  // No lambdas here: these would not inherit the target attribute.
+  const __m256i zero = _mm256_setzero_si256();
+
+  BlockMasks    masks;
+  std::uint64_t text = 0; // Printable ASCII and whitespace.
+  for (std::size_t i = 0; i < BLOCK_SIZE / 32; i++) {
+    const __m256i v = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(block + (32 * i)));
+
+    const __m256i space     = _mm256_cmpeq_epi8(v, _mm256_set1_epi8(' '));
+    const __m256i ctrl      = _mm256_cmpeq_epi8(_mm256_subs_epu8(_mm256_sub_epi8(v, _mm256_set1_epi8('\t')), _mm256_set1_epi8('\r' - '\t')), zero);
+    const __m256i digits    = _mm256_cmpeq_epi8(_mm256_subs_epu8(_mm256_sub_epi8(v, _mm256_set1_epi8('0')), _mm256_set1_epi8(9)), zero);
+    const __m256i newlines  = _mm256_cmpeq_epi8(v, _mm256_set1_epi8('\n'));
+    const __m256i printable = _mm256_cmpeq_epi8(_mm256_subs_epu8(_mm256_sub_epi8(v, _mm256_set1_epi8(' ')), _mm256_set1_epi8('~' - ' ')), zero);
+
+    masks.whitespace |= static_cast<std::uint64_t>(static_cast<std::uint32_t>(_mm256_movemask_epi8(_mm256_or_si256(space, ctrl)))) << (32 * i);
+    masks.digits |= static_cast<std::uint64_t>(static_cast<std::uint32_t>(_mm256_movemask_epi8(digits))) << (32 * i);
+    masks.newlines |= static_cast<std::uint64_t>(static_cast<std::uint32_t>(_mm256_movemask_epi8(newlines))) << (32 * i);
+    text |= static_cast<std::uint64_t>(static_cast<std::uint32_t>(_mm256_movemask_epi8(_mm256_or_si256(printable, ctrl)))) << (32 * i);
+  }
+
+  masks.binary = ~text;
+  return masks;
+}
+
+#endif // HAVE_X86_SIMD
+
+/// Select the fastest classifier supported by the processor.
+[[nodiscard]] inline Classifier best_classifier() {
+#ifdef HAVE_X86_SIMD
+  return __builtin_cpu_supports("avx2") ? classify_avx2 : classify_sse2;
+#else
+  return classify_scalar;
+#endif
+}
+
+///
+/// Mask of the bytes of a block that are left out of the input: from the byte after the first binary byte of a line, until the newline.
+///
+/// A token with a binary byte is invalid, and evaluation stops at an invalid token, so these bytes never make a difference.
+///
+/// \param masks Byte classes of the block.
+/// \param skipping Indicates the block starts in a part of a line that is left out, on return whether the next block does.
+///
+[[nodiscard]] inline std::uint64_t skipped_bytes(const BlockMasks& masks, bool& skipping) {
+  if (masks.binary == 0 && !skipping) [[likely]] {
+    return 0;
+  }
+
+  std::uint64_t mask = 0;
+  for (std::size_t pos = 0; pos < BLOCK_SIZE;) {
+    const std::uint64_t from = ~std::uint64_t{0} << pos;
+    if (skipping) {
+      const std::uint64_t newlines = masks.newlines & from;
+      if (newlines == 0) {
+        mask |= from;
+        break;
+      }
+
+      const auto end = static_cast<std::size_t>(std::countr_zero(newlines));
+      mask |= from & ~(~std::uint64_t{0} << end);
+      skipping = false;
+      pos      = end + 1;
+    } else {
+      const std::uint64_t binary = masks.binary & from;
+      if (binary == 0) {
+        break;
+      }
+
+      skipping = true;
+      pos      = static_cast<std::size_t>(std::countr_zero(binary)) + 1;
+    }
+  }
+
+  return mask;
+}
+
+///
+/// Structural index of the input text: the start and end offsets of all whitespace-separated tokens.
+///
+/// The input is classified in blocks of 64 bytes into bit masks, using SIMD instructions if available. The token starts are the
+/// non-whitespace bytes preceded by whitespace, and the token ends the whitespace bytes preceded by non-whitespace (carrying over the
+/// last bit between blocks). The offsets are extracted from the masks one set bit at a time. Per block, a mask of the "unusual" token
+/// bytes (neither digits nor whitespace) is kept, so tokens can be classified without looking at their bytes again in most cases.
+///
+/// Binary bytes (non-ASCII, or control bytes other than whitespace) are validated in the same pass. A token with a binary byte is invalid,
+/// and evaluation stops at an invalid token, so the rest of its line is left out of the index: the token ends at the binary byte. This
+/// rejects lines of binary input (like from `/dev/urandom`) in bulk, with a single token to read for most of them.
+///
+struct TokenIndex {
+  TokenIndex() = default;
+
+  explicit TokenIndex(std::string_view input_, Classifier classify = best_classifier()) {
+    assign(input_, classify);
+  }
+
+  ///
+  /// Index new input text, reusing the storage of the previous index.
+  ///
+  /// \throws A `std::length_error` if the input is larger than 4 GiB.
+  ///
+  void assign(std::string_view input_, Classifier classify = best_classifier()) {
+    if (input_.size() > std::numeric_limits<std::uint32_t>::max()) {
+      throw std::length_error{"input too large -- at most 4 GiB is supported"};
+    }
+
+    input = input_;
+    non_digits.clear();
+    non_digits.reserve((input.size() / BLOCK_SIZE) + 1);
+
+    std::size_t   n_starts = 0;
+    std::size_t   n_ends   = 0;
+    std::uint64_t carry    = 0;     // Indicates the last byte of the previous block was part of a token.
+    bool          skipping = false; // Indicates the previous block ended in the rest of a line after a binary byte.
+    for (std::size_t offset = 0; offset < input.size(); offset += BLOCK_SIZE) {
+      BlockMasks masks;
+      if (input.size() - offset >= BLOCK_SIZE) {
+        masks = classify(input.data() + offset);
+      } else {
+        std::array<char, BLOCK_SIZE> tail;
+        tail.fill(' '); // Pad the last partial block with whitespace, which also ends the last token.
+        std::ranges::copy(input.substr(offset), tail.begin());
+        masks = classify(tail.data());
+      }
+
+      const std::uint64_t token = ~masks.whitespace & ~skipped_bytes(masks, skipping);
+      const std::uint64_t after = (token << 1) | carry; // Bit i set if byte i - 1 is part of a token.
+      carry                     = token >> 63;
+
+      extract(token & ~after, offset, starts, n_starts);
+      extract(~token & after, offset, ends, n_ends);
+      non_digits.push_back(token & ~masks.digits);
+    }
+
+    starts.resize(n_starts);
+    ends.resize(n_ends);
+
+    if (carry != 0) {
+      ends.push_back(static_cast<std::uint32_t>(input.size())); // The last token runs until the end of a full last block.
+    }
+  }
+
+  /// Number of tokens.
+  [[nodiscard]] std::size_t size() const {
+    return starts.size();
+  }
+
+  /// Count the bytes in the offset range [start, end) that are not digits (nor whitespace).
+  [[nodiscard]] unsigned int count_non_digits(std::size_t start, std::size_t end) const {
+    unsigned int count = 0;
+    for (std::size_t block = start / BLOCK_SIZE; block * BLOCK_SIZE < end; block++) {
+      std::uint64_t mask = non_digits[block];
+      if (block == start / BLOCK_SIZE) {
+        mask &= ~std::uint64_t{0} << (start % BLOCK_SIZE);
+      }
+
+      if ((block + 1) * BLOCK_SIZE > end) {
+        mask &= ~(~std::uint64_t{0} << (end % BLOCK_SIZE));
+      }
+
+      count += static_cast<unsigned int>(std::popcount(mask));
+    }
+
+    return count;
+  }
+
+  std::string_view           input;
+  std::vector<std::uint32_t> starts;     // Token start offsets.
+  std::vector<std::uint32_t> ends;       // Token end offsets (one past the last byte).
+  std::vector<std::uint64_t> non_digits; // Per block, the token bytes that are not digits.
+
+private:
+  ///
+  /// Write the offsets of all set bits in a mask to `offsets`, starting at index `count`.
+  ///
+  /// The vector is grown ahead by a full block, so the loop needs no bounds checks. The excess is trimmed when the index is complete.
+  ///
+  static void extract(std::uint64_t mask, std::size_t offset, std::vector<std::uint32_t>& offsets, std::size_t& count) {
+    if (offsets.size() < count + BLOCK_SIZE) {
+      offsets.resize(std::max(count + BLOCK_SIZE, 2 * offsets.size()));
+    }
+
+    for (; mask != 0; mask &= mask - 1) {
+      offsets[count++] = static_cast<std::uint32_t>(offset + static_cast<std::size_t>(std::countr_zero(mask)));
+    }
+  }
+};
+
+///
+/// Read the next token from a token index.
+///
+/// \param index Token index of the input.
+/// \param cursor Index of the next token to read, incremented on return.
+/// \param limit Offset in the input where the calculation ends, tokens from there on are not read.
+///
+/// \returns The read token.
+///
+[[nodiscard]] inline Token read_token(const TokenIndex& index, std::size_t& cursor, std::size_t limit = std::numeric_limits<std::size_t>::max()) {
+  if (cursor >= index.size() || index.starts[cursor] >= limit) {
+    return Tokens::Eoc{};
+  }
+
+  const std::size_t      start = index.starts[cursor];
+  const std::size_t      end   = index.ends[cursor];
+  const std::string_view input = index.input.substr(start, end - start);
+  cursor++;
+
+  const unsigned int non_digits = index.count_non_digits(start, end);
+
+  if (non_digits == 0) {
+    return Tokens::Operand{input}; // Positive number.
+  } else if ((non_digits == 1) && (input.length() > 1) && input.starts_with('-')) {
+    return Tokens::Operand{input}; // Negative number.
+  } else if ((input.length() == 1) && (OPERATORS.find(input[0]) != std::string_view::npos)) {
+    return Tokens::Operator{input[0]};
+  } else if ((input[0] == '0' || input[0] == '-') && is_based_literal(input)) {
+    return Tokens::Operand{input}; // Hexadecimal, octal or binary number.
+  } else {
+    return Tokens::Invalid{};
+  }
+}
+
+///
+/// Reader of the input in chunks of bounded size, so the input need not fit in memory and is evaluated as it arrives.
+///
+/// Every chunk ends at a delimiter byte, so no token (or line) is cut in two: the bytes after the last delimiter are carried over to
+/// the next chunk. Only a token or line that does not fit in a chunk makes the chunk grow beyond the chunk size.
+///
+/// The input is validated as it is read, like the token index does: the rest of a line after a binary byte is dropped right away. So
+/// lines of binary input take no memory and no indexing, and a chunk may also end with a binary byte whose line is being dropped.
+///
+class InputReader {
+public:
+  /// Number of bytes read at a time.
+  static constexpr std::size_t CHUNK_SIZE = 1 << 16;
+
+  explicit InputReader(std::FILE* source = stdin)
+    : source_{source} {
+  }
+
+  /// Delimiter of tokens, the same bytes the token index takes for whitespace.
+  [[nodiscard]] static bool is_whitespace(char c) {
+    return c == ' ' || (c >= '\t' && c <= '\r');
+  }
+
+  /// Delimiter of lines.
+  [[nodiscard]] static bool is_newline(char c) {
+    return c == '\n';
+  }
+
+  ///
+  /// Read the next chunk of the input, as soon as it ends with a delimiter.
+  ///
+  /// \param is_delimiter Predicate for the bytes a chunk may end with.
+  ///
+  /// \returns The chunk, valid until the next call. It is empty at the end of the input.
+  ///
+  /// \throws A `std::runtime_error` if reading fails.
+  ///
+  template<typename Predicate>
+  [[nodiscard]] std::string_view read(Predicate is_delimiter) {
+    buffer_.erase(0, chunk_size_); // Keep only the carried over bytes.
+    chunk_size_ = 0;
+
+    while (!end_ && chunk_size_ == 0) {
+      const std::size_t scanned = buffer_.size();
+      buffer_.resize(scanned + CHUNK_SIZE);
+      const std::size_t n = read_some(buffer_.data() + scanned, CHUNK_SIZE);
+      end_                = (n == 0);
+      drop_skipped(scanned, n);
+
+      if (skipping_) {
+        chunk_size_ = buffer_.size(); // Nothing after the binary byte is kept.
+        continue;
+      }
+
+      const auto last = std::find_if(buffer_.rbegin(), buffer_.rend() - static_cast<std::ptrdiff_t>(scanned), is_delimiter);
+      if (last != buffer_.rend() - static_cast<std::ptrdiff_t>(scanned)) {
+        chunk_size_ = static_cast<std::size_t>(buffer_.rend() - last);
+      }
+    }
+
+    if (end_) {
+      chunk_size_ = buffer_.size(); // The rest of the input, if any.
+    }
+
+    return std::string_view{buffer_}.substr(0, chunk_size_);
+  }
+
+private:
+  /// Read at most `size` bytes, returning as soon as any are available (so interactive input is not held back).
+  [[nodiscard]] std::size_t read_some(char* data, std::size_t size) {
+#ifdef HAVE_POSIX_READ
+    ssize_t n = 0;
+    do {
+      n = ::read(fileno(source_), data, size);
+    } while (n < 0 && errno == EINTR);
+
+    if (n < 0) {
+      throw std::runtime_error{"failed to read input stream"};
+    }
+
+    return static_cast<std::size_t>(n);
+#else
+    // This waits for a full chunk, so interactive input is only evaluated once it ends.
+    const std::size_t n = std::fread(data, 1, size, source_);
+    if (std::ferror(source_) != 0) {
+      throw std::runtime_error{"failed to read input stream"};
+    }
+
+    return n;
+#endif
+  }
+
+  ///
+  /// Drop the bytes that are left out of the input (see `skipped_bytes`) from newly read bytes, and trim the buffer to the rest.
+  ///
+  /// \param offset Offset of the new bytes in the buffer.
+  /// \param size Number of new bytes.
+  ///
+  void drop_skipped(std::size_t offset, std::size_t size) {
+    std::size_t kept = offset;
+    for (std::size_t block = offset; block < offset + size; block += BLOCK_SIZE) {
+      const std::size_t n = std::min(BLOCK_SIZE, offset + size - block);
+
+      BlockMasks masks;
+      if (n == BLOCK_SIZE) {
+        masks = classify_(buffer_.data() + block);
+      } else {
+        std::array<char, BLOCK_SIZE> tail;
+        tail.fill(' ');
+        std::copy_n(buffer_.data() + block, n, tail.begin());
+        masks = classify_(tail.data());
+      }
+
+      const std::uint64_t dropped = skipped_bytes(masks, skipping_);
+      if (dropped == 0) [[likely]] {
+        if (kept != block) {
+          std::memmove(buffer_.data() + kept, buffer_.data() + block, n);
+        }
+
+        kept += n;
+      } else {
+        for (std::uint64_t keep = ~dropped & (~std::uint64_t{0} >> (BLOCK_SIZE - n)); keep != 0; keep &= keep - 1) {
+          buffer_[kept++] = buffer_[block + static_cast<std::size_t>(std::countr_zero(keep))];
+        }
+      }
+    }
+
+    buffer_.resize(kept);
+  }
+
+  std::FILE*  source_;
+  Classifier  classify_ = best_classifier();
+  std::string buffer_;             // The current chunk, followed by the carried over bytes.
+  std::size_t chunk_size_ = 0;     // Size of the current chunk.
+  bool        skipping_   = false; // Indicates the rest of a line after a binary byte is being dropped.
+  bool        end_        = false;
+};
+
+///
+/// Source of the tokens of the input, read one chunk at a time: the next chunk is indexed when the tokens of the previous are used up.
+///
+class TokenStream {
+public:
+  explicit TokenStream(InputReader& reader)
+    : reader_{reader} {
+  }
+
+  /// Read the next token, `Tokens::Eoc` at the end of the input.
+  [[nodiscard]] Token next() {
+    while (cursor_ >= index_.size()) {
+      const std::string_view chunk = reader_.read(InputReader::is_whitespace);
+      if (chunk.empty()) {
+        return Tokens::Eoc{};
+      }
+
+      index_.assign(chunk);
+      cursor_ = 0;
+    }
+
+    return read_token(index_, cursor_);
+  }
+
+private:
+  InputReader& reader_;
+  TokenIndex   index_;
+  std::size_t  cursor_ = 0;
+};
+
+
+///
+/// Check whether integers can be written in a base: 10, or 16, 8 and 2 with the prefixes `0x`, `0o` and `0b`.
+///
+/// \throws A `std::invalid_argument` if not.
+///
+inline void check_output_base(int base) {
+  if (base != 10 && base != 16 && base != 8 && base != 2) {
+    throw std::invalid_argument{fmt::format("unsupported output base {} -- use 2, 8, 10 or 16", base)};
+  }
+}
+
+/// Prefix of integers written in a base other than 10, as for operands.
+[[nodiscard]] constexpr std::string_view base_prefix(int base) {
+  switch (base) {
+  case 16: return "0x";
+  case 8: return "0o";
+  case 2: return "0b";
+  default: return "";
+  }
+}
+
+///
+/// Arbitrary-precision integer.
+///
+/// The value is stored as a sign and a magnitude, the latter as 32-bit limbs with the least significant limb first. This keeps the
+/// intermediate products and quotients of the limb arithmetic within 64 bits.
+///
+class BigInt {
+public:
+  BigInt() = default;
+
+  explicit BigInt(__int128 value)
+    : negative_{value < 0} {
+    for (auto magnitude = negative_ ? -static_cast<unsigned __int128>(value) : static_cast<unsigned __int128>(value); magnitude != 0; magnitude >>= 32) {
+      limbs_.push_back(static_cast<std::uint32_t>(magnitude));
+    }
+  }
+
+  /// Convert to a 128-bit integer, if the value fits.
+  [[nodiscard]] std::optional<__int128> to_int128() const {
+    if (limbs_.size() > 4) {
+      return std::nullopt;
+    }
+
+    unsigned __int128 magnitude = 0;
+    for (auto limb = limbs_.rbegin(); limb != limbs_.rend(); limb++) {
+      magnitude = (magnitude << 32) | *limb;
+    }
+
+    constexpr auto MAX = static_cast<unsigned __int128>(std::numeric_limits<__int128>::max());
+    if (magnitude > MAX + (negative_ ? 1 : 0)) {
+      return std::nullopt;
+    }
+
+    return static_cast<__int128>(negative_ ? -magnitude : magnitude);
+  }
+
+  [[nodiscard]] bool is_zero() const {
+    return limbs_.empty();
+  }
+
+  ///
+  /// Text representation in a base, with its prefix for bases other than 10.
+  ///
+  /// \param base 10, 16, 8 or 2.
+  ///
+  [[nodiscard]] std::string to_string(int base = 10) const {
+    if (is_zero()) {
+      return std::string{base_prefix(base)} + "0";
+    }
+
+    std::string digits;
+    if (base != 10) {
+      // Take the bits of a digit at a time, least significant first. Digits may span two limbs for octal.
+      const int         bits  = std::countr_zero(static_cast<unsigned int>(base));
+      const std::size_t total = limbs_.size() * 32;
+      for (std::size_t bit = 0; bit < total; bit += static_cast<std::size_t>(bits)) {
+        unsigned int digit = 0;
+        for (std::size_t i = 0; i < static_cast<std::size_t>(bits) && bit + i < total; i++) {
+          digit |= ((limbs_[(bit + i) / 32] >> ((bit + i) % 32)) & 1U) << i;
+        }
+
+        digits += "0123456789abcdef"[digit];
+      }
+
+      digits.erase(digits.find_last_not_of('0') + 1); // The leading zeros of the most significant limb.
+      digits += base_prefix(base)[1];
+      digits += '0';
+    } else {
+      // Split off nine decimal digits at a time, least significant first.
+      for (Limbs magnitude = limbs_; !magnitude.empty();) {
+        auto chunk = divide(magnitude, 1'000'000'000);
+        for (int i = 0; i < 9 && (chunk != 0 || !magnitude.empty()); i++, chunk /= 10) {
+          digits += static_cast<char>('0' + (chunk % 10));
+        }
+      }
+    }
+
+    if (negative_) {
+      digits += '-';
+    }
+
+    std::ranges::reverse(digits);
+    return digits;
+  }
+
+  friend bool operator==(const BigInt&, const BigInt&) = default;
+
+  friend BigInt operator+(const BigInt& lhs, const BigInt& rhs) {
+    if (lhs.negative_ == rhs.negative_) {
+      return BigInt{lhs.negative_, add(lhs.limbs_, rhs.limbs_)};
+    } else if (compare(lhs.limbs_, rhs.limbs_) >= 0) {
+      return BigInt{lhs.negative_, subtract(lhs.limbs_, rhs.limbs_)};
+    } else {
+      return BigInt{rhs.negative_, subtract(rhs.limbs_, lhs.limbs_)};
+    }
+  }
+
+  friend BigInt operator-(const BigInt& lhs, const BigInt& rhs) {
+    BigInt negated = rhs;
+    negated.negative_ = !negated.negative_ && !negated.is_zero();
+    return lhs + negated;
+  }
+
+  friend BigInt operator*(const BigInt& lhs, const BigInt& rhs) {
+    Limbs product(lhs.limbs_.size() + rhs.limbs_.size());
+    for (std::size_t i = 0; i < lhs.limbs_.size(); i++) {
+      std::uint64_t carry = 0;
+      for (std::size_t j = 0; j < rhs.limbs_.size(); j++) {
+        const std::uint64_t p = (static_cast<std::uint64_t>(lhs.limbs_[i]) * rhs.limbs_[j]) + product[i + j] + carry;
+        product[i + j]        = static_cast<std::uint32_t>(p);
+        carry                 = p >> 32;
+      }
+
+      product[i + rhs.limbs_.size()] = static_cast<std::uint32_t>(carry);
+    }
+
+    return BigInt{lhs.negative_ != rhs.negative_, std::move(product)};
+  }
+
+  /// Division, truncating toward zero like the built-in integer division. The divisor must not be zero.
+  friend BigInt operator/(const BigInt& lhs, const BigInt& rhs) {
+    return BigInt{lhs.negative_ != rhs.negative_, divide(lhs.limbs_, rhs.limbs_).first};
+  }
+
+  /// Remainder, with the sign of the dividend like the built-in integer modulo. The divisor must not be zero.
+  friend BigInt operator%(const BigInt& lhs, const BigInt& rhs) {
+    return BigInt{lhs.negative_, divide(lhs.limbs_, rhs.limbs_).second};
+  }
+
+private:
+  using Limbs = std::vector<std::uint32_t>;
+
+  BigInt(bool negative, Limbs&& limbs)
+    : limbs_{std::move(limbs)} {
+    while (!limbs_.empty() && limbs_.back() == 0) {
+      limbs_.pop_back();
+    }
+
+    negative_ = negative && !limbs_.empty(); // There is no negative zero.
+  }
+
+  /// Compare two magnitudes, returning a negative value, zero or a positive value.
+  [[nodiscard]] static int compare(const Limbs& lhs, const Limbs& rhs) {
+    if (lhs.size() != rhs.size()) {
+      return (lhs.size() < rhs.size()) ? -1 : 1;
+    }
+
+    for (std::size_t i = lhs.size(); i-- > 0;) {
+      if (lhs[i] != rhs[i]) {
+        return (lhs[i] < rhs[i]) ? -1 : 1;
+      }
+    }
+
+    return 0;
+  }
+
+  [[nodiscard]] static Limbs add(const Limbs& lhs, const Limbs& rhs) {
+    Limbs         sum(std::max(lhs.size(), rhs.size()) + 1);
+    std::uint64_t carry = 0;
+    for (std::size_t i = 0; i < sum.size(); i++) {
+      carry += (i < lhs.size() ? lhs[i] : 0) + static_cast<std::uint64_t>(i < rhs.size() ? rhs[i] : 0);
+      sum[i] = static_cast<std::uint32_t>(carry);
+      carry >>= 32;
+    }
+
+    return sum;
+  }
+
+  /// Subtract magnitudes, where the left-hand side must not be smaller than the right-hand side.
+  [[nodiscard]] static Limbs subtract(const Limbs& lhs, const Limbs& rhs) {
+    Limbs        difference(lhs.size());
+    std::int64_t borrow = 0;
+    for (std::size_t i = 0; i < lhs.size(); i++) {
+      const std::int64_t d = static_cast<std::int64_t>(lhs[i]) - (i < rhs.size() ? rhs[i] : 0) - borrow;
+      difference[i]        = static_cast<std::uint32_t>(d);
+      borrow               = (d < 0) ? 1 : 0;
+    }
+
+    return difference;
+  }
+
+  /// Divide a magnitude in place by a single limb, returning the remainder.
+  static std::uint32_t divide(Limbs& magnitude, std::uint32_t divisor) {
+    std::uint64_t remainder = 0;
+    for (std::size_t i = magnitude.size(); i-- > 0;) {
+      const std::uint64_t n = (remainder << 32) | magnitude[i];
+      magnitude[i]          = static_cast<std::uint32_t>(n / divisor);
+      remainder             = n % divisor;
+    }
+
+    while (!magnitude.empty() && magnitude.back() == 0) {
+      magnitude.pop_back();
+    }
+
+    return static_cast<std::uint32_t>(remainder);
+  }
+
+  ///
+  /// Divide magnitudes, returning the quotient and remainder.
+  ///
+  /// This is Knuth's algorithm D (The Art of Computer Programming, volume 2, section 4.3.1): long division estimating each quotient limb from
+  /// the leading limbs, after normalizing the divisor so its most significant bit is set. The estimate is then at most two too large.
+  ///
+  [[nodiscard]] static std::pair<Limbs, Limbs> divide(const Limbs& lhs, const Limbs& rhs) {
+    if (compare(lhs, rhs) < 0) {
+      return {{}, lhs};
+    } else if (rhs.size() == 1) {
+      Limbs               quotient  = lhs;
+      const std::uint32_t remainder = divide(quotient, rhs[0]);
+      return {std::move(quotient), {remainder}};
+    }
+
+    const std::size_t n     = rhs.size();
+    const std::size_t m     = lhs.size() - n;
+    const int         shift = std::countl_zero(rhs.back());
+
+    const auto shifted = [shift](const Limbs& limbs, std::size_t size) {
+      Limbs result(size);
+      for (std::size_t i = 0; i < limbs.size(); i++) {
+        const std::uint64_t wide = static_cast<std::uint64_t>(limbs[i]) << shift;
+        result[i] |= static_cast<std::uint32_t>(wide);
+        if (i + 1 < size) {
+          result[i + 1] = static_cast<std::uint32_t>(wide >> 32);
+        }
+      }
+
+      return result;
+    };
+
+    const Limbs v = shifted(rhs, n);
+    Limbs       u = shifted(lhs, lhs.size() + 1);
+    Limbs       quotient(m + 1);
+
+    constexpr std::uint64_t BASE = std::uint64_t{1} << 32;
+    for (std::size_t j = m + 1; j-- > 0;) {
+      const std::uint64_t numerator = (static_cast<std::uint64_t>(u[j + n]) << 32) | u[j + n - 1];
+      std::uint64_t       qhat      = numerator / v[n - 1];
+      std::uint64_t       rhat      = numerator % v[n - 1];
+      while (qhat >= BASE || qhat * v[n - 2] > ((rhat << 32) | u[j + n - 2])) {
+        qhat--;
+        rhat += v[n - 1];
+        if (rhat >= BASE) {
+          break;
+        }
+      }
+
+      // Multiply and subtract.
+      std::int64_t borrow = 0;
+      std::int64_t t      = 0;
+      for (std::size_t i = 0; i < n; i++) {
+        const std::uint64_t p = qhat * v[i];
+        t                     = static_cast<std::int64_t>(u[i + j]) - borrow - static_cast<std::int64_t>(p & 0xFFFFFFFF);
+        u[i + j]              = static_cast<std::uint32_t>(t);
+        borrow                = static_cast<std::int64_t>(p >> 32) - (t >> 32);
+      }
+
+      t        = static_cast<std::int64_t>(u[j + n]) - borrow;
+      u[j + n] = static_cast<std::uint32_t>(t);
+
+      // The estimate was one too large, add back.
+      if (t < 0) {
+        qhat--;
+        std::uint64_t carry = 0;
+        for (std::size_t i = 0; i < n; i++) {
+          carry += static_cast<std::uint64_t>(u[i + j]) + v[i];
+          u[i + j] = static_cast<std::uint32_t>(carry);
+          carry >>= 32;
+        }
+
+        u[j + n] = static_cast<std::uint32_t>(u[j + n] + carry);
+      }
+
+      quotient[j] = static_cast<std::uint32_t>(qhat);
+    }
+
+    // Undo the normalization for the remainder.
+    Limbs remainder(n);
+    for (std::size_t i = 0; i < n; i++) {
+      remainder[i] = static_cast<std::uint32_t>(((static_cast<std::uint64_t>(u[i + 1]) << 32) | u[i]) >> shift);
+    }
+
+    return {std::move(quotient), std::move(remainder)};
+  }
+
+  bool  negative_ = false;
+  Limbs limbs_; // Magnitude, without most significant zero limbs.
+};
+
+///
+/// Integer of any size.
+///
+/// Values are stored as a `long` when they fit, as this is by far the most common case. Operations check for overflow using compiler
+/// builtins, and promote the value to a 128-bit integer, and then to a `BigInt` when required. Results are demoted to the smallest
+/// representation they fit in, so after an overflow the fast path is taken again.
+///
+/// The wide representations are kept out of line and shared between copies, so a `Number` holding a `long` is cheap to copy and move.
+///
+class Number {
+public:
+  Number(long value = 0)
+    : value_{value} {
+  }
+
+  // Copying and destroying a `long` only costs a check of the pointer, the reference counting of wide values is out of line.
+  Number(const Number& other) noexcept
+    : value_{other.value_}
+    , wide_{other.wide_} {
+    if (wide_ != nullptr) [[unlikely]] {
+      retain(wide_);
+    }
+  }
+
+  Number(Number&& other) noexcept
+    : value_{other.value_}
+    , wide_{std::exchange(other.wide_, nullptr)} {
+  }
+
+  Number& operator=(const Number& other) noexcept {
+    Number copy{other};
+    return *this = std::move(copy);
+  }
+
+  Number& operator=(Number&& other) noexcept {
+    std::swap(value_, other.value_);
+    std::swap(wide_, other.wide_);
+    return *this;
+  }
+
+  ~Number() {
+    if (wide_ != nullptr) [[unlikely]] {
+      release(wide_);
+    }
+  }
+
+  /// The value of a literal with a base prefix, which may take all 64 bits for its magnitude.
+  [[nodiscard]] static Number from_based(const BasedValue& value) {
+    const auto magnitude = static_cast<__int128>(value.magnitude);
+    return demote(value.negative ? -magnitude : magnitude);
+  }
+
+  /// Check whether the value fits a `long`.
+  [[nodiscard]] bool is_long() const {
+    return wide_ == nullptr;
+  }
+
+  /// The value as a `long`, only valid if it fits.
+  [[nodiscard]] long to_long() const {
+    return value_;
+  }
+
+  /// Text representation in a base, like `BigInt::to_string`.
+  [[nodiscard]] std::string to_string(int base = 10) const {
+    if (is_long()) {
+      return (base == 10) ? std::to_string(value_) : BigInt{value_}.to_string(base);
+    }
+
+    return std::visit(overload{[&](__int128 v) { return BigInt{v}.to_string(base); }, [&](const BigInt& v) { return v.to_string(base); }}, wide_->value);
+  }
+
+  friend bool operator==(const Number& lhs, const Number& rhs) {
+    if (lhs.is_long() || rhs.is_long()) {
+      return lhs.is_long() && rhs.is_long() && lhs.value_ == rhs.value_;
+    }
+
+    return lhs.wide_->value == rhs.wide_->value;
+  }
+
+  friend Number operator+(const Number& lhs, const Number& rhs) {
+    return apply(lhs, rhs, [](auto a, auto b, auto& r) { return __builtin_add_overflow(a, b, &r); }, std::plus{});
+  }
+
+  friend Number operator-(const Number& lhs, const Number& rhs) {
+    return apply(lhs, rhs, [](auto a, auto b, auto& r) { return __builtin_sub_overflow(a, b, &r); }, std::minus{});
+  }
+
+  friend Number operator*(const Number& lhs, const Number& rhs) {
+    return apply(lhs, rhs, [](auto a, auto b, auto& r) { return __builtin_mul_overflow(a, b, &r); }, std::multiplies{});
+  }
+
+  /// Division, the divisor must not be zero.
+  friend Number operator/(const Number& lhs, const Number& rhs) {
+    return apply(lhs, rhs, [](auto a, auto b, auto& r) { return overflowing_division(a, b, r, std::divides{}); }, std::divides{});
+  }
+
+  /// Modulo, the divisor must not be zero.
+  friend Number operator%(const Number& lhs, const Number& rhs) {
+    return apply(lhs, rhs, [](auto a, auto b, auto& r) { return overflowing_division(a, b, r, std::modulus{}); }, std::modulus{});
+  }
+
+private:
+  using Wide = std::variant<__int128, BigInt>;
+
+  /// A wide value, with the number of `Number`s sharing it.
+  struct Shared {
+    std::atomic<std::size_t> references{1};
+    const Wide               value;
+  };
+
+  explicit Number(Wide&& value)
+    : wide_{new Shared{.value = std::move(value)}} {
+  }
+
+  [[gnu::noinline]] static void retain(Shared* shared) {
+    shared->references.fetch_add(1, std::memory_order_relaxed);
+  }
+
+  [[gnu::noinline]] static void release(Shared* shared) {
+    if (shared->references.fetch_sub(1, std::memory_order_acq_rel) == 1) {
+      delete shared;
+    }
+  }
+
+  /// Divide (or take the modulo), unless this overflows: only the most negative value divided by minus one does.
+  template<typename T>
+  static bool overflowing_division(T a, T b, T& result, std::invocable<T, T> auto&& divide) {
+    if (a == std::numeric_limits<T>::min() && b == -1) {
+      return true;
+    }
+
+    result = divide(a, b);
+    return false;
+  }
+
+  /// The value as a 128-bit integer, if it fits.
+  [[nodiscard]] std::optional<__int128> to_int128() const {
+    if (is_long()) {
+      return value_;
+    } else if (const auto* v = std::get_if<__int128>(&wide_->value)) {
+      return *v;
+    }
+
+    return std::nullopt;
+  }
+
+  /// The value as an arbitrary-precision integer.
+  [[nodiscard]] BigInt to_big() const {
+    if (const auto* b = is_long() ? nullptr : std::get_if<BigInt>(&wide_->value)) {
+      return *b;
+    }
+
+    return BigInt{*to_int128()};
+  }
+
+  /// Demote a 128-bit integer to a `long`, if it fits.
+  [[nodiscard]] static Number demote(__int128 value) {
+    if (value >= std::numeric_limits<long>::min() && value <= std::numeric_limits<long>::max()) {
+      return Number{static_cast<long>(value)};
+    }
+
+    return Number{Wide{value}};
+  }
+
+  ///
+  /// Apply an operation, in the smallest representation it does not overflow in.
+  ///
+  /// \param checked Function applying the operation to `long` or `__int128` values, returning true on overflow.
+  /// \param big Function applying the operation to `BigInt` values.
+  ///
+  [[nodiscard]] static Number apply(const Number& lhs, const Number& rhs, auto&& checked, auto&& big) {
+    if (lhs.is_long() && rhs.is_long()) [[likely]] {
+      long result{};
+      if (!checked(lhs.value_, rhs.value_, result)) [[likely]] {
+        return Number{result};
+      }
+    }
+
+    return promoted(lhs, rhs, checked, big);
+  }
+
+  /// Apply an operation to promoted values. Kept out of line, so the fast path of `apply` is inlined into the callers.
+  [[gnu::noinline]] [[nodiscard]] static Number promoted(const Number& lhs, const Number& rhs, auto&& checked, auto&& big) {
+    if (const auto a = lhs.to_int128(), b = rhs.to_int128(); a && b) {
+      __int128 result{};
+      if (!checked(*a, *b, result)) {
+        return demote(result);
+      }
+    }
+
+    BigInt result = big(lhs.to_big(), rhs.to_big());
+    if (const auto v = result.to_int128()) {
+      return demote(*v);
+    }
+
+    return Number{Wide{std::move(result)}};
+  }
+
+  long    value_ = 0;       // The value, if it fits a `long`.
+  Shared* wide_  = nullptr; // Otherwise the value, in the smallest representation it fits.
+};
+
+///
+/// Buffered writer for calculation results.
+///
+/// Values are formatted with `std::to_chars` (which is locale-independent, and gives the shortest round-trip representation for
+/// floating-point values) directly into a large buffer, which is written out when full. In fixed-width mode values are right-aligned
+/// to a minimum width. Integer values can be written in base 16, 8 or 2 instead of 10, with the prefix of operands in that base.
+///
+/// Without a sink the buffer grows as needed, and the text is taken out with `text` and `erase`.
+///
+class ResultWriter {
+public:
+  static constexpr std::string_view ERROR_PREFIX = "Error: "; // Prefix of error message lines.
+
+  ///
+  /// \param sink Stream to write to, or none to keep the text.
+  /// \param width Minimum value width, zero for none.
+  /// \param base Base of integer values.
+  ///
+  /// \throws A `std::invalid_argument` for an unsupported base.
+  ///
+  explicit ResultWriter(std::FILE* sink = stdout, std::size_t width = 0, int base = 10)
+    : sink_{sink}
+    , width_{width}
+    , base_{base}
+    , buffer_((sink != nullptr) ? BUFFER_SIZE : 0) {
+    check_output_base(base);
+  }
+
+  ResultWriter(const ResultWriter&)            = delete;
+  ResultWriter& operator=(const ResultWriter&) = delete;
+
+  ~ResultWriter() {
+    // Errors cannot be reported from here, call `flush` first to see those.
+    if (sink_ != nullptr) {
+      std::fwrite(buffer_.data(), 1, size_, sink_);
+    }
+  }
+
+  /// Write a result value line.
+  template<signed_arithmetic T>
+  void value(T v) {
+    if constexpr (std::is_integral_v<T>) {
+      if (base_ != 10) {
+        based_value(v);
+        return;
+      }
+    }
+
+    std::array<char, MAX_VALUE_SIZE> text;
+    const auto [ptr, error] = std::to_chars(text.data(), text.data() + text.size(), v);
+    if (error != std::errc{}) {
+      throw std::logic_error{"failed to format result value"};
+    }
+
+    line({text.data(), static_cast<std::size_t>(ptr - text.data())});
+  }
+
+  /// Write a result value line, for a value of any size.
+  void value(const Number& v) {
+    if (v.is_long()) [[likely]] {
+      value(v.to_long());
+    } else {
+      line(v.to_string(base_));
+    }
+  }
+
+  /// Write an error message line.
+  void error(std::string_view message) {
+    reserve(ERROR_PREFIX.size() + message.size() + 1);
+    for (const auto part : {ERROR_PREFIX, message, std::string_view{"\n"}}) {
+      std::memcpy(buffer_.data() + size_, part.data(), part.size());
+      size_ += part.size();
+    }
+
+    lines_++;
+    errors_++;
+  }
+
+  ///
+  /// Write out the buffered lines.
+  ///
+  /// \throws A `std::runtime_error` if writing fails, and a `std::logic_error` without a sink.
+  ///
+  void flush() {
+    if (sink_ == nullptr) {
+      throw std::logic_error{"no sink to write output to"};
+    }
+
+    if (std::fwrite(buffer_.data(), 1, size_, sink_) != size_ || std::fflush(sink_) != 0) {
+      throw std::runtime_error{"failed to write output"};
+    }
+
+    size_ = 0;
+  }
+
+  /// Number of lines written.
+  [[nodiscard]] std::size_t lines() const {
+    return lines_;
+  }
+
+  /// Number of error message lines written.
+  [[nodiscard]] std::size_t errors() const {
+    return errors_;
+  }
+
+  /// The buffered text.
+  [[nodiscard]] std::string_view text() const {
+    return {buffer_.data(), size_};
+  }
+
+  /// Remove text from the start of the buffer, after it was written out elsewhere.
+  void erase(std::size_t count) {
+    count = std::min(count, size_);
+    std::memmove(buffer_.data(), buffer_.data() + count, size_ - count);
+    size_ -= count;
+  }
+
+private:
+  static constexpr std::size_t BUFFER_SIZE    = 1 << 20; // In [bytes].
+  static constexpr std::size_t MAX_VALUE_SIZE = 80;      // Longest formatted value in [characters], for any arithmetic type and base.
+
+  /// Write an integer result value line in the output base: the sign and prefix first, then the magnitude ("-0x10" rather than "0x-10").
+  template<std::signed_integral T>
+  void based_value(T v) {
+    using U = std::make_unsigned_t<T>;
+
+    std::array<char, MAX_VALUE_SIZE> text;
+    char*                            first = text.data();
+    if (v < 0) {
+      *first++ = '-';
+    }
+
+    first                   = std::ranges::copy(base_prefix(base_), first).out;
+    const U magnitude       = (v < 0) ? static_cast<U>(U{0} - static_cast<U>(v)) : static_cast<U>(v);
+    const auto [ptr, error] = std::to_chars(first, text.data() + text.size(), magnitude, base_);
+    if (error != std::errc{}) {
+      throw std::logic_error{"failed to format result value"};
+    }
+
+    line({text.data(), static_cast<std::size_t>(ptr - text.data())});
+  }
+
+  /// Write a line of text, right-aligned in fixed-width mode.
+  void line(std::string_view text) {
+    const auto pad = std::max(width_, text.size()) - text.size();
+
+    reserve(pad + text.size() + 1);
+    std::memset(buffer_.data() + size_, ' ', pad);
+    std::memcpy(buffer_.data() + size_ + pad, text.data(), text.size());
+    size_ += pad + text.size();
+    buffer_[size_++] = '\n';
+    lines_++;
+  }
+
+  /// Make room for a line of a given size, flushing the buffer or growing it for extremely long lines (or without a sink).
+  void reserve(std::size_t size) {
+    if (size_ + size > buffer_.size()) {
+      if (sink_ != nullptr) {
+        flush();
+        buffer_.resize(std::max(buffer_.size(), size));
+      } else {
+        buffer_.resize(std::max(2 * buffer_.size(), size_ + size));
+      }
+    }
+  }
+
+  std::FILE*        sink_;
+  std::size_t       width_;
+  int               base_;
+  std::vector<char> buffer_;
+  std::size_t       size_   = 0;
+  std::size_t       lines_  = 0;
+  std::size_t       errors_ = 0;
+};
+
+///
+/// Perform a calculation given two input values and an operator.
+///
+/// \note For the built-in integer types there is no overflow handling in place! Use `Number` values for that, or `checked_calculate`.
+///
+/// \param lhs Left-hand side input value.
+/// \param lhs Right-hand side input value.
+/// \param lhs Operator.
+///
+/// \returns Calculation result.
+///
+/// \throws An exception if an unsupported operator is specified.
+///
+template<typename T>
+[[nodiscard]] constexpr T calculate(T lhs, T rhs, char op) {
+  switch (op) {
+  case '+': return lhs + rhs;
+  case '-': return lhs - rhs;
+  case '*': return lhs * rhs;
+  case '/':
+    if (rhs == 0) {
+      throw calculation_error{"division by zero"};
+    }
+
+    return lhs / rhs;
+  case '%':
+    if constexpr (!std::is_floating_point_v<T>) {
+      if (rhs == 0) {
+        throw calculation_error{"division by zero"};
+      }
+
+      return lhs % rhs;
+    }
+  default: throw std::invalid_argument{"unsupported operator"};
+  }
+}
+
+///
+/// Perform a calculation on `long` values, checking for overflow.
+///
+/// \param lhs Left-hand side input value.
+/// \param lhs Right-hand side input value.
+/// \param lhs Operator.
+///
+/// \returns Calculation result, or nothing if it overflows.
+///
+/// \throws An exception if an unsupported operator is specified, or on division by zero.
+///
+[[nodiscard]] constexpr std::optional<long> checked_calculate(long lhs, long rhs, char op) {
+  long result{};
+  bool overflow{};
+  switch (op) {
+  case '+': overflow = __builtin_add_overflow(lhs, rhs, &result); break;
+  case '-': overflow = __builtin_sub_overflow(lhs, rhs, &result); break;
+  case '*': overflow = __builtin_mul_overflow(lhs, rhs, &result); break;
+  case '/':
+  case '%':
+    if (rhs == 0) {
+      throw calculation_error{"division by zero"};
+    }
+
+    // Only the most negative value divided by minus one overflows. The remainder is zero, but the hardware traps on it as well.
+    if (rhs == -1) {
+      overflow = (op == '/') && __builtin_sub_overflow(0L, lhs, &result);
+    } else {
+      result = (op == '/') ? lhs / rhs : lhs % rhs;
+    }
+    break;
+  default: throw std::invalid_argument{"unsupported operator"};
+  }
+
+  return overflow ? std::nullopt : std::optional{result};
+}
+
+///
+/// Classify a token, like `read_token` does.
+///
+/// \param token The token text, without whitespace.
+///
+/// \returns The token.
+///
+[[nodiscard]] constexpr Token classify_token(std::string_view token) {
+  const auto is_digit = [](char c) { return c >= '0' && c <= '9'; };
+
+  if (token.empty()) {
+    return Tokens::Eoc{};
+  } else if (std::ranges::all_of(token, is_digit)) {
+    return Tokens::Operand{token}; // Positive number.
+  } else if ((token.length() > 1) && token.starts_with('-') && std::ranges::all_of(token.substr(1), is_digit)) {
+    return Tokens::Operand{token}; // Negative number.
+  } else if ((token.length() == 1) && (OPERATORS.find(token[0]) != std::string_view::npos)) {
+    return Tokens::Operator{token[0]};
+  } else if (is_based_literal(token)) {
+    return Tokens::Operand{token}; // Hexadecimal, octal or binary number.
+  } else {
+    return Tokens::Invalid{};
+  }
+}
+
+///
+/// Take the next whitespace-separated token from a calculation.
+///
+/// \param calculation The calculation text, the token is removed from it on return.
+///
+/// \returns The token.
+///
+[[nodiscard]] constexpr Token take_token(std::string_view& calculation) {
+  constexpr std::string_view WHITESPACE = " \t\n\v\f\r";
+
+  calculation.remove_prefix(std::min(calculation.find_first_not_of(WHITESPACE), calculation.size()));
+  const std::string_view token = calculation.substr(0, calculation.find_first_of(WHITESPACE));
+  calculation.remove_prefix(token.size());
+
+  return classify_token(token);
+}
+
+///
+/// Evaluate a calculation at compile time.
+///
+/// This follows the same steps as the state machine in `evaluate`. As throwing is not allowed in a constant expression, a malformed
+/// calculation or a division by zero is a compile error. So is signed integer overflow, which is undefined behavior.
+///
+/// \param calculation The calculation text.
+///
+/// \returns The result.
+///
+template<std::signed_integral T = long>
+[[nodiscard]] consteval T evaluate_constant(std::string_view calculation) {
+  Stack<T, 2> m;
+  bool        got_operator = false;
+
+  const auto push_operand = [&](const Token& t) {
+    if (!std::holds_alternative<Tokens::Operand>(t)) {
+      throw calculation_error{"expected operand"};
+    }
+
+    m.push(std::get<Tokens::Operand>(t).parse<T>());
+  };
+
+  push_operand(take_token(calculation));
+  for (;;) {
+    const Token t = take_token(calculation);
+    if (std::holds_alternative<Tokens::Eoc>(t) && got_operator) {
+      return m.pop().value();
+    }
+
+    push_operand(t);
+
+    const Token o = take_token(calculation);
+    if (!std::holds_alternative<Tokens::Operator>(o)) {
+      throw calculation_error{"expected operator"};
+    }
+
+    const auto rhs = m.pop().value();
+    const auto lhs = m.pop().value();
+    m.push(calculate(lhs, rhs, std::get<Tokens::Operator>(o).op));
+
+    got_operator = true;
+  }
+}
+
+///
+/// Literal for calculations evaluated at compile time, like `"4 5 * 2 -"_rpn`.
+///
+/// \returns The result as a `long`.
+///
+consteval long operator""_rpn(const char* calculation, std::size_t size) {
+  return evaluate_constant(std::string_view{calculation, size});
+}
+
+static_assert("4 5 * 5 * 30 - 2 /"_rpn == 35);
+static_assert("-9223372036854775807 1 -"_rpn == std::numeric_limits<long>::min());
+static_assert(evaluate_constant<int>("\t7\n2 %  ") == 1);
+static_assert("0xff 0b1 + 0o10 /"_rpn == 32);
+
+/// The stack memory type, for a given value type.
+template<typename T>
+using Memory = Stack<T, 2>;
+
+///
+/// Parse an operand to a value type. For `Number` the magnitude of literals with a base prefix may take all 64 bits, so the bit
+/// patterns of unsigned values can be entered as they are, like `0xFFFFFFFFFFFFFFFF`. Decimal operands are parsed as a `long`.
+///
+template<typename T>
+[[nodiscard]] T parse_operand(const Tokens::Operand& o) {
+  if constexpr (std::is_same_v<T, Number>) {
+    if (const auto b = parse_based_magnitude(o.value)) {
+      return Number::from_based(*b);
+    }
+  }
+
+  return T{o.parse<long>()};
+}
+
+
+///
+/// Evaluate a calculation, writing the result or error message.
+///
+/// The errors of the state machine, and division by zero, are reported without throwing an exception. These are common for invalid
+/// input, for which an exception would take most of the time.
+///
+/// \param next_token Source of the tokens of the calculation, returning `Tokens::Eoc` at its end.
+/// \param out Writer for the result.
+///
+/// \tparam T Value type for the calculation, by default values of any size.
+///
+template<typename T = Number>
+void evaluate(std::invocable auto&& next_token, ResultWriter& out) {
+  bool      stop         = false;
+  bool      got_operator = false;
+  State     s            = States::Operand1{};
+  Memory<T> m;
+
+  const auto fail = [&](std::string_view message) {
+    out.error(message);
+    stop = true;
+  };
+
+  while (!stop) {
+    const Token t = next_token();
+
+    try {
+      // clang-format off
+      std::visit(overload{
+        [&](States::Operand1&) {
+          std::visit(overload{
+            [&](const Tokens::Operand& o) {
+              m.push(parse_operand<T>(o));
+              s = States::Operand2{};
+            },
+            [&](const Tokens::Operator&) { fail("expected operand 1, got operator");           },
+            [&](const Tokens::Eoc&)      { fail("expected operand 1, got end-of-calculation"); },
+            [&](const Tokens::Invalid&)  { fail("expected operand 1, got invalid token");      }
+          }, t);
+        },
+        [&](States::Operand2&) {
+          std::visit(overload{
+            [&](const Tokens::Operand& o) {
+              m.push(parse_operand<T>(o));
+              s = States::Operator{};
+            },
+            [&](const Tokens::Eoc&) {
+              if (got_operator) {
+                s = States::Result{};
+              } else {
+                fail("expected operand 2, got end-of-calculation");
+              }
+            },
+            [&](const Tokens::Operator&) { fail("expected operand 2, got operator");      },
+            [&](const Tokens::Invalid&)  { fail("expected operand 2, got invalid token"); }
+          }, t);
+        },
+        [&](States::Operator&) {
+          std::visit(overload{
+            [&](const Tokens::Operator& o) {
+              if (m.size() != 2) {
+                throw std::logic_error{"expected two elements in memory"};
+              }
+
+              const auto rhs = m.pop().value();
+              const auto lhs = m.pop().value();
+              if ((o.op == '/' || o.op == '%') && rhs == T{0}) {
+                fail("division by zero");
+                return;
+              }
+
+              m.push(calculate(lhs, rhs, o.op));
+
+              got_operator = true;
+              s = States::Operand2{};
+            },
+            [&](const Tokens::Operand&) { fail("expected operator, got operand");            },
+            [&](const Tokens::Eoc&)     { fail("expected operator, got end-of-calculation"); },
+            [&](const Tokens::Invalid&) { fail("expected operator, got invalid token");      }
+          }, t);
+        },
+        [&](States::Result&) {
+          if (m.size() != 1) {
+            throw std::logic_error{"expected only a single result in memory"};
+          }
+
+          out.value(m.pop().value());
+
+          stop = true; // Bail out.
+        }
+      }, s);
+      // clang-format on
+    } catch (const calculation_error& e) {
+      fail(e.what()); // Parse errors.
+    }
+  }
+}
+
+///
+/// Evaluate a calculation in a token index, writing the result or error message.
+///
+/// \param index Token index of the input.
+/// \param cursor Index of the first token of the calculation, on return the index of the token where evaluation stopped.
+/// \param limit Offset in the input where the calculation ends.
+/// \param out Writer for the result.
+///
+/// \tparam T Value type for the calculation, by default values of any size.
+///
+template<typename T = Number>
+void evaluate(const TokenIndex& index, std::size_t& cursor, std::size_t limit, ResultWriter& out) {
+  evaluate<T>([&] { return read_token(index, cursor, limit); }, out);
+}
+
+///
+/// Evaluate all complete lines of input text, each line as a separate calculation.
+///
+/// Unlike `--lines` mode, every line gets a result or error message, also lines without tokens. So a client sending calculations gets
+/// exactly one response line for every request line.
+///
+/// \param input Input text, the part after the last newline is left for later.
+/// \param index Token index to use, reused for its storage.
+/// \param out Writer for the results.
+///
+/// \returns The number of bytes of input evaluated.
+///
+inline std::size_t evaluate_lines(std::string_view input, TokenIndex& index, ResultWriter& out) {
+  const std::size_t last = input.rfind('\n');
+  if (last == std::string_view::npos) {
+    return 0;
+  }
+
+  const std::string_view lines = input.substr(0, last + 1);
+  index.assign(lines);
+
+  std::size_t cursor = 0;
+  for (std::size_t begin = 0; begin < lines.size();) {
+    while (cursor < index.size() && index.starts[cursor] < begin) {
+      cursor++; // Tokens left over after an error in the previous line.
+    }
+
+    const std::size_t limit = lines.find('\n', begin);
+    evaluate(index, cursor, limit, out);
+    begin = limit + 1;
+  }
+
+  return lines.size();
+}
+
+///
+/// Evaluator of infix calculations, like `(4 + 5) * -2`, with the shunting-yard algorithm.
+///
+/// Instead of writing the operators out in RPN order, every operator is applied to the value stack as soon as the algorithm would write
+/// it, with `calculate` like `evaluate` does. So no RPN text or token list is built in between. The operators `*`, `/` and `%` take
+/// precedence over `+` and `-`, all of these are left-associative, and a `-` where an operand is expected negates what follows. Operands
+/// are written as for RPN calculations, and need no whitespace around them.
+///
+/// The stacks are kept between calculations for their storage, so an evaluator must not be shared between threads.
+///
+/// \tparam T Value type for the calculation, by default values of any size.
+///
+template<typename T = Number>
+class InfixEvaluator {
+public:
+  ///
+  /// Evaluate a calculation, writing the result or error message.
+  ///
+  /// \param calculation The calculation text, newlines are whitespace like any other.
+  /// \param out Writer for the result.
+  ///
+  void evaluate(std::string_view calculation, ResultWriter& out) {
+    std::size_t pos = 0;
+    evaluate([&](bool operand) { return take_token(calculation, pos, operand); }, out);
+  }
+
+  ///
+  /// Evaluate a calculation read in chunks, writing the result or error message. Reading stops at the first error.
+  ///
+  /// Chunks end at whitespace, which no token spans, so the tokens are taken from one chunk at a time.
+  ///
+  /// \param reader Reader of the calculation text, newlines are whitespace like any other.
+  /// \param out Writer for the result.
+  ///
+  void evaluate(InputReader& reader, ResultWriter& out) {
+    std::string_view chunk;
+    std::size_t      pos = 0;
+
+    evaluate(
+      [&](bool operand) -> Token {
+        for (;;) {
+          const Token t = take_token(chunk, pos, operand);
+          if (!std::holds_alternative<Tokens::Eoc>(t)) {
+            return t;
+          }
+
+          chunk = reader.read(InputReader::is_whitespace);
+          pos   = 0;
+          if (chunk.empty()) {
+            return t;
+          }
+        }
+      },
+      out);
+  }
+
+  ///
+  /// Evaluate every line with tokens as a separate calculation, like `--lines` mode does for RPN calculations.
+  ///
+  /// \param input Input text.
+  /// \param out Writer for the results.
+  ///
+  /// \returns The number of calculations.
+  ///
+  std::size_t evaluate_lines(std::string_view input, ResultWriter& out) {
+    std::size_t count = 0;
+    for (std::size_t begin = 0; begin < input.size();) {
+      const std::size_t      end  = std::min(input.find('\n', begin), input.size());
+      const std::string_view line = input.substr(begin, end - begin);
+      begin                       = end + 1;
+
+      if (std::ranges::any_of(line, [](char c) { return BYTES[static_cast<unsigned char>(c)] != SPACE; })) {
+        evaluate(line, out);
+        count++;
+      }
+    }
+
+    return count;
+  }
+
+private:
+  static constexpr char NEGATE = '~'; // Unary minus, on the operator stack.
+
+  // Byte classes for scanning calculations: operands run until whitespace, an operator or a parenthesis.
+  static constexpr std::uint8_t OTHER     = 0;
+  static constexpr std::uint8_t SPACE     = 1;
+  static constexpr std::uint8_t DELIMITER = 2;
+
+  static constexpr std::array<std::uint8_t, 256> BYTES = [] {
+    std::array<std::uint8_t, 256> bytes{};
+    for (const char c : std::string_view{" \t\n\v\f\r"}) {
+      bytes[static_cast<unsigned char>(c)] = SPACE;
+    }
+
+    for (const char c : std::string_view{"+-*/%()"}) {
+      bytes[static_cast<unsigned char>(c)] = DELIMITER;
+    }
+
+    return bytes;
+  }();
+
+  /// Precedence of an operator on the stack, higher goes first. An opening parenthesis is not applied, but it stops applying.
+  [[nodiscard]] static constexpr int precedence(char op) {
+    switch (op) {
+    case NEGATE: return 3;
+    case '*':
+    case '/':
+    case '%': return 2;
+    case '+':
+    case '-': return 1;
+    default: return 0;
+    }
+  }
+
+  ///
+  /// Take the next token from a calculation.
+  ///
+  /// Parentheses are operator tokens too. A minus sign followed by a digit is part of an operand if one is expected, so the operand is a
+  /// negative number like for RPN calculations, and the most negative value of an operand type can be written.
+  ///
+  /// \param calculation The calculation text.
+  /// \param pos Offset of the next byte to scan, on return the offset after the token.
+  /// \param operand Indicates an operand is expected.
+  ///
+  /// \returns The token.
+  ///
+  [[nodiscard]] static Token take_token(std::string_view calculation, std::size_t& pos, bool operand) {
+    const auto byte = [&](std::size_t i) { return BYTES[static_cast<unsigned char>(calculation[i])]; };
+
+    while (pos < calculation.size() && byte(pos) == SPACE) {
+      pos++;
+    }
+
+    if (pos == calculation.size()) {
+      return Tokens::Eoc{};
+    }
+
+    const std::size_t start = pos++;
+    if (byte(start) == DELIMITER) {
+      const bool sign = operand && calculation[start] == '-' && pos < calculation.size() && calculation[pos] >= '0' && calculation[pos] <= '9';
+      if (!sign) {
+        return Tokens::Operator{calculation[start]};
+      }
+    }
+
+    while (pos < calculation.size() && byte(pos) == OTHER) {
+      pos++;
+    }
+
+    return classify_token(calculation.substr(start, pos - start));
+  }
+
+  ///
+  /// Apply the operator on top of the operator stack to the values on top of the value stack.
+  ///
+  /// \returns False on division by zero.
+  ///
+  [[nodiscard]] bool apply() {
+    const char op = operators_.back();
+    operators_.pop_back();
+
+    T rhs = std::move(values_.back());
+    values_.pop_back();
+
+    if (op == NEGATE) {
+      values_.push_back(calculate(T{0}, std::move(rhs), '-'));
+      return true;
+    }
+
+    if ((op == '/' || op == '%') && rhs == T{0}) {
+      return false;
+    }
+
+    T& lhs = values_.back();
+    lhs    = calculate(std::move(lhs), std::move(rhs), op);
+    return true;
+  }
+
+  ///
+  /// Evaluate a calculation given its tokens, writing the result or error message.
+  ///
+  /// \param next_token Source of the tokens of the calculation, taking whether an operand is expected (see `take_token`).
+  /// \param out Writer for the result.
+  ///
+  void evaluate(std::invocable<bool> auto&& next_token, ResultWriter& out) {
+    values_.clear();
+    operators_.clear();
+
+    try {
+      if (const auto error = run(next_token)) {
+        out.error(*error);
+      } else {
+        out.value(values_.back());
+      }
+    } catch (const calculation_error& e) {
+      out.error(e.what()); // Parse errors.
+    }
+  }
+
+  ///
+  /// Run the shunting-yard algorithm on the tokens of a calculation, leaving the result on the value stack.
+  ///
+  /// \param next_token Source of the tokens of the calculation, taking whether an operand is expected.
+  ///
+  /// \returns An error message, or nothing if the calculation succeeded.
+  ///
+  [[nodiscard]] std::optional<std::string_view> run(std::invocable<bool> auto&& next_token) {
+    bool operand = true; // Indicates an operand is expected next, otherwise an operator.
+
+    for (;;) {
+      const Token t = next_token(operand);
+      const auto* o = std::get_if<Tokens::Operator>(&t);
+
+      if (operand) {
+        if (const auto* v = std::get_if<Tokens::Operand>(&t)) {
+          values_.push_back(parse_operand<T>(*v));
+          operand = false;
+        } else if (o != nullptr && (o->op == '(' || o->op == '-')) {
+          operators_.push_back((o->op == '-') ? NEGATE : '(');
+        } else if (o != nullptr) {
+          return (o->op == ')') ? "expected operand, got closing parenthesis" : "expected operand, got operator";
+        } else {
+          return std::holds_alternative<Tokens::Eoc>(t) ? "expected operand, got end-of-calculation" : "expected operand, got invalid token";
+        }
+      } else if (o != nullptr && o->op != '(') {
+        // Apply the operators that go first: those of at least the same precedence, or all up to the parenthesis for a closing one.
+        while (!operators_.empty() && operators_.back() != '(' && precedence(operators_.back()) >= precedence(o->op)) {
+          if (!apply()) {
+            return "division by zero";
+          }
+        }
+
+        if (o->op != ')') {
+          operators_.push_back(o->op);
+          operand = true;
+        } else if (operators_.empty()) {
+          return "unmatched closing parenthesis";
+        } else {
+          operators_.pop_back();
+        }
+      } else if (std::holds_alternative<Tokens::Eoc>(t)) {
+        while (!operators_.empty()) {
+          if (operators_.back() == '(') {
+            return "unmatched opening parenthesis";
+          } else if (!apply()) {
+            return "division by zero";
+          }
+        }
+
+        return std::nullopt;
+      } else if (o != nullptr) {
+        return "expected operator, got opening parenthesis";
+      } else {
+        return std::holds_alternative<Tokens::Operand>(t) ? "expected operator, got operand" : "expected operator, got invalid token";
+      }
+    }
+  }
+
+  std::vector<T>    values_;    // Value stack.
+  std::vector<char> operators_; // Operator stack, with opening parentheses.
+};
+
+} // namespace rpn
@@ -0,0 +1,634 @@
+//
+// Differential fuzzer: evaluates generated, mutated and random input with the calculator library, and with a simple reference
+// evaluator, and checks that both give the same results and error messages.
+//
+// Built with ENABLE_LIBFUZZER (Clang only) this is a libFuzzer target, otherwise it has its own driver generating the input.
+//
+
+#include <fmt/core.h>
+
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <charconv>
+#include <chrono>
+#include <cstdint>
+#include <cstdio>
+#include <exception>
+#include <fstream>
+#include <iostream>
+#include <limits>
+#include <optional>
+#include <random>
+#include <sstream>
+#include <string>
+#include <string_view>
+#include <thread>
+#include <vector>
+
+#include "calculator.hpp"
+#include "engine.hpp"
+
+namespace {
+
+namespace reference {
+
+/// Token kinds, like the calculator distinguishes them.
+enum class Kind { Operand, Operator, Eoc, Invalid };
+
+/// Name of a token kind, as used in the error messages.
+[[nodiscard]] constexpr std::string_view name(Kind kind) {
+  switch (kind) {
+  case Kind::Operand: return "operand";
+  case Kind::Operator: return "operator";
+  case Kind::Eoc: return "end-of-calculation";
+  default: return "invalid token";
+  }
+}
+
+/// Check for a whitespace byte, without the locale.
+[[nodiscard]] constexpr bool is_space(char c) {
+  return c == ' ' || (c >= '\t' && c <= '\r');
+}
+
+/// Check for a digit byte, without the locale.
+[[nodiscard]] constexpr bool is_digit(char c) {
+  return c >= '0' && c <= '9';
+}
+
+/// Value of a digit in any base up to 16, or 16 for anything else.
+[[nodiscard]] constexpr int digit_value(char c) {
+  if (is_digit(c)) {
+    return c - '0';
+  } else if (c >= 'a' && c <= 'f') {
+    return c - 'a' + 10;
+  } else if (c >= 'A' && c <= 'F') {
+    return c - 'A' + 10;
+  }
+
+  return 16;
+}
+
+/// Operand parts: the sign, the base (from the prefix `0x`, `0o` or `0b`, in either case), and the digits.
+struct Parts {
+  bool             negative = false;
+  int              base     = 10;
+  std::string_view digits;
+};
+
+/// Split an operand into its parts, without checking the digits.
+[[nodiscard]] Parts split_operand(std::string_view token) {
+  Parts parts{token.starts_with('-'), 10, token};
+  parts.digits.remove_prefix(parts.negative ? 1 : 0);
+
+  if (parts.digits.size() >= 2 && parts.digits[0] == '0') {
+    const auto prefix = std::string_view{"xXoObB"}.find(parts.digits[1]);
+    if (prefix != std::string_view::npos) {
+      parts.base = std::array{16, 8, 2}[prefix / 2];
+      parts.digits.remove_prefix(2);
+    }
+  }
+
+  return parts;
+}
+
+/// Classify a token, the empty token is the end of the calculation.
+[[nodiscard]] Kind classify(std::string_view token) {
+  if (token.empty()) {
+    return Kind::Eoc;
+  } else if (token.size() == 1 && std::string_view{"+-*/%"}.find(token[0]) != std::string_view::npos) {
+    return Kind::Operator;
+  }
+
+  const auto [negative, base, digits] = split_operand(token);
+  if (!digits.empty() && std::ranges::all_of(digits, [&](char c) { return digit_value(c) < base; })) {
+    return Kind::Operand;
+  }
+
+  return Kind::Invalid;
+}
+
+///
+/// Reference evaluator, as simple as possible.
+///
+/// Values are kept in 128 bits, which is plenty for most calculations, but not for all: values of any size are supported by the
+/// calculator. The output is not known for calculations with values beyond 128 bits.
+///
+class Evaluator {
+public:
+  ///
+  /// Evaluate a calculation.
+  ///
+  /// \param calculation The calculation text.
+  /// \param output Text to append the output line to, without newline.
+  ///
+  /// \returns False if the output is not known.
+  ///
+  bool evaluate(std::string_view calculation, std::string& output) {
+    split(calculation);
+
+    std::size_t i     = 0;
+    const auto  next  = [&] { return (i < tokens_.size()) ? tokens_[i++] : std::string_view{}; };
+    const auto  error = [&](std::string_view expected, std::string_view token) {
+      output += "Error: expected ";
+      output += expected;
+      output += ", got ";
+      output += name(classify(token));
+      return true;
+    };
+
+    // Parse an operand as `long`, or with a base prefix to any 64-bit magnitude, or append the error message.
+    const auto parse = [&](std::string_view token, __int128& value) {
+      const auto [negative, base, digits] = split_operand(token);
+
+      unsigned long long magnitude{};
+      if (std::from_chars(digits.data(), digits.data() + digits.size(), magnitude, base).ec != std::errc{}
+          || (base == 10 && magnitude > static_cast<unsigned long long>(std::numeric_limits<long>::max()) + (negative ? 1 : 0))) {
+        fmt::format_to(std::back_inserter(output), "Error: failed to parse input '{}': parse type value overflow", token);
+        return false;
+      }
+
+      value = negative ? -static_cast<__int128>(magnitude) : static_cast<__int128>(magnitude);
+      return true;
+    };
+
+    __int128 value{};
+    __int128 rhs{};
+
+    std::string_view t = next();
+    if (classify(t) != Kind::Operand) {
+      return error("operand 1", t);
+    } else if (!parse(t, value)) {
+      return true;
+    }
+
+    for (bool got_operator = false;; got_operator = true) {
+      t = next();
+      if (classify(t) == Kind::Eoc && got_operator) {
+        fmt::format_to(std::back_inserter(output), "{}", value);
+        return true;
+      } else if (classify(t) != Kind::Operand) {
+        return error("operand 2", t);
+      } else if (!parse(t, rhs)) {
+        return true;
+      }
+
+      t = next();
+      if (classify(t) != Kind::Operator) {
+        return error("operator", t);
+      }
+
+      bool overflow = false;
+      switch (t[0]) {
+      case '+': overflow = __builtin_add_overflow(value, rhs, &value); break;
+      case '-': overflow = __builtin_sub_overflow(value, rhs, &value); break;
+      case '*': overflow = __builtin_mul_overflow(value, rhs, &value); break;
+      default:
+        if (rhs == 0) {
+          output += "Error: division by zero";
+          return true;
+        }
+
+        overflow = (rhs == -1 && value == std::numeric_limits<__int128>::min());
+        if (!overflow) {
+          value = (t[0] == '/') ? value / rhs : value % rhs;
+        }
+        break;
+      }
+
+      if (overflow) {
+        return false;
+      }
+    }
+  }
+
+  ///
+  /// Evaluate every line with tokens as a separate calculation.
+  ///
+  /// \param input The input text.
+  /// \param output Text to append the output lines to.
+  ///
+  /// \returns False if the output of any line is not known.
+  ///
+  bool evaluate_lines(std::string_view input, std::string& output) {
+    for (std::size_t begin = 0; begin < input.size();) {
+      const std::size_t      end  = std::min(input.find('\n', begin), input.size());
+      const std::string_view line = input.substr(begin, end - begin);
+      begin                       = end + 1;
+
+      if (std::ranges::all_of(line, is_space)) {
+        continue;
+      }
+
+      if (!evaluate(line, output)) {
+        return false;
+      }
+
+      output += '\n';
+    }
+
+    return true;
+  }
+
+private:
+  /// Split text into whitespace-separated tokens.
+  void split(std::string_view text) {
+    tokens_.clear();
+    for (std::size_t i = 0; i < text.size();) {
+      if (is_space(text[i])) {
+        i++;
+        continue;
+      }
+
+      const std::size_t start = i;
+      while (i < text.size() && !is_space(text[i])) {
+        i++;
+      }
+
+      tokens_.push_back(text.substr(start, i - start));
+    }
+  }
+
+  std::vector<std::string_view> tokens_; // Reused for its storage.
+};
+
+} // namespace reference
+
+/// Make input printable, escaping anything but printable ASCII.
+[[nodiscard]] std::string escape(std::string_view text) {
+  std::string escaped;
+  for (const char c : text) {
+    if (c >= ' ' && c <= '~' && c != '\\') {
+      escaped += c;
+    } else {
+      escaped += fmt::format("\\x{:02x}", static_cast<unsigned char>(c));
+    }
+  }
+
+  return escaped;
+}
+
+///
+/// Differential checker of the calculator against the reference.
+///
+/// Every input is evaluated as a single calculation, and line by line. The token index is also built using the scalar classifier, and
+/// compared with the one of the (vectorized) classifier the calculator uses.
+///
+class Checker {
+public:
+  ///
+  /// Check an input.
+  ///
+  /// \returns A description of the difference found, if any.
+  ///
+  [[nodiscard]] std::optional<std::string> check(std::string_view input) {
+    cases_++;
+
+    const auto mismatch = [&](std::string_view what, std::string_view actual) {
+      return fmt::format("{} differs for input \"{}\":\n  reference: \"{}\"\n  calculator: \"{}\"", what, escape(input), escape(expected_),
+                         escape(actual));
+    };
+
+    index_.assign(input, rpn::classify_scalar);
+    best_.assign(input);
+    if (index_.starts != best_.starts || index_.ends != best_.ends || index_.non_digits != best_.non_digits) {
+      return fmt::format("token index differs between classifiers for input \"{}\"", escape(input));
+    }
+
+    expected_.clear();
+    if (reference_.evaluate(input, expected_)) {
+      const auto [ok, text] = calculator_.evaluate(input);
+      if (ok ? (text != expected_) : (!expected_.starts_with("Error: ") || std::string_view{expected_}.substr(7) != text)) {
+        return mismatch("calculation", fmt::format("{}{}", ok ? "" : "Error: ", text));
+      }
+    } else {
+      unknown_++;
+    }
+
+    expected_.clear();
+    if (reference_.evaluate_lines(input, expected_)) {
+      output_.clear();
+      calculator_.evaluate_lines(input, output_);
+      if (output_ != expected_) {
+        return mismatch("line output", output_);
+      }
+    } else {
+      unknown_++;
+    }
+
+    return std::nullopt;
+  }
+
+  /// Number of inputs checked.
+  [[nodiscard]] std::size_t cases() const {
+    return cases_;
+  }
+
+  /// Number of evaluations of which the reference does not know the output, because of values beyond 128 bits.
+  [[nodiscard]] std::size_t unknown() const {
+    return unknown_;
+  }
+
+private:
+  reference::Evaluator reference_;
+  rpn::Calculator      calculator_;
+  rpn::TokenIndex      index_;
+  rpn::TokenIndex      best_;
+  std::string          expected_;
+  std::string          output_;
+  std::size_t          cases_   = 0;
+  std::size_t          unknown_ = 0;
+};
+
+} // namespace
+
+#ifdef ENABLE_LIBFUZZER
+
+extern "C" int LLVMFuzzerTestOneInput(const std::uint8_t* data, std::size_t size) {
+  static Checker checker; // libFuzzer runs a single thread.
+
+  if (const auto difference = checker.check({reinterpret_cast<const char*>(data), size})) {
+    std::cerr << *difference << '\n';
+    __builtin_trap();
+  }
+
+  return 0;
+}
+
+#else
+
+namespace {
+
+///
+/// Generator of fuzzing input: calculations, mutated calculations, and random bytes.
+///
+/// The calculations favour the edge cases: the extreme values, overflowing operands, leading zeros, long chains, odd whitespace and
+/// multiple lines. The mutations replace, insert, delete and duplicate bytes and token-sized parts.
+///
+class Generator {
+public:
+  explicit Generator(std::uint64_t seed)
+    : rng_{seed} {
+  }
+
+  /// Generate the next input.
+  [[nodiscard]] const std::string& next() {
+    const auto kind = pick(16);
+    if (kind < 6) {
+      calculation();
+    } else if (kind < 15) {
+      calculation();
+      for (auto n = pick(4) + 1; n > 0; n--) {
+        mutate();
+      }
+    } else {
+      garbage();
+    }
+
+    return text_;
+  }
+
+private:
+  /// Pick a number in [0, n).
+  [[nodiscard]] std::size_t pick(std::size_t n) {
+    return std::uniform_int_distribution<std::size_t>{0, n - 1}(rng_);
+  }
+
+  /// Append an operand.
+  void operand() {
+    static constexpr std::array<std::string_view, 24> EDGES = {
+      "9223372036854775807", "-9223372036854775808", "-9223372036854775807", "9223372036854775808", "-9223372036854775809",
+      "0",                   "-0",                   "1",                    "-1",                  "2",
+      "00000000000000000000000000042", "-000000000000000000009223372036854775808", "99999999999999999999", "4294967296",
+      "0x7fffffffffffffff", "-0x8000000000000000", "0x8000000000000000", "0o1777777777777777777777", "0o2000000000000000000000",
+      "0b", "0x", "-0o", "0xG", "0b0000000000000000000000000000000000000000000000000000000000000000000001"};
+
+    switch (pick(5)) {
+    case 0: text_ += EDGES[pick(EDGES.size())]; break;
+    case 1: fmt::format_to(std::back_inserter(text_), "{}", static_cast<long>(pick(21)) - 10); break;
+    case 2: fmt::format_to(std::back_inserter(text_), "{}", static_cast<long>(rng_())); break;
+    case 3: {
+      // Hexadecimal (in either case), octal or binary.
+      const auto        magnitude = rng_() >> pick(64);
+      const std::string sign      = (pick(2) == 0) ? "" : "-";
+      switch (pick(4)) {
+      case 0: fmt::format_to(std::back_inserter(text_), "{}0x{:x}", sign, magnitude); break;
+      case 1: fmt::format_to(std::back_inserter(text_), "{}0X{:X}", sign, magnitude); break;
+      case 2: fmt::format_to(std::back_inserter(text_), "{}0o{:o}", sign, magnitude); break;
+      default: fmt::format_to(std::back_inserter(text_), "{}0b{:b}", sign, magnitude); break;
+      }
+      break;
+    }
+    default: fmt::format_to(std::back_inserter(text_), "{}", static_cast<long>(rng_() >> (pick(63) + 1)) * ((pick(2) == 0) ? 1 : -1)); break;
+    }
+  }
+
+  /// Append whitespace.
+  void whitespace() {
+    constexpr std::string_view WHITESPACE = " \t\n\v\f\r";
+
+    if (pick(8) != 0) {
+      text_ += ' ';
+      return;
+    }
+
+    for (auto n = pick(3) + 1; n > 0; n--) {
+      text_ += WHITESPACE[pick(WHITESPACE.size())];
+    }
+  }
+
+  /// Generate calculations, mostly valid ones, on one or more lines.
+  void calculation() {
+    text_.clear();
+    for (auto lines = (pick(4) == 0) ? pick(4) + 2 : 1; lines > 0; lines--) {
+      operand();
+      for (auto n = pick(8); n > 0; n--) {
+        whitespace();
+        operand();
+        whitespace();
+        text_ += "+-*/%"[pick(5)];
+      }
+
+      text_ += '\n';
+    }
+  }
+
+  /// Change a calculation.
+  void mutate() {
+    const std::size_t at = pick(text_.size() + 1);
+    switch (pick(6)) {
+    case 0:
+      if (at < text_.size()) {
+        text_[at] = static_cast<char>(pick(256));
+      }
+      break;
+    case 1: text_.insert(at, 1, static_cast<char>(pick(256))); break;
+    case 2: text_.insert(at, 1, "+-*/% \n0123456789xobXOBaAfFgG"[pick(29)]); break;
+    case 3: text_.erase(at, pick(8)); break;
+    case 4: text_.insert(at, text_.substr(pick(text_.size() + 1), pick(16))); break;
+    default: {
+      std::string operand_text;
+      std::swap(text_, operand_text);
+      operand();
+      std::swap(text_, operand_text);
+      text_.insert(at, " " + operand_text + " ");
+      break;
+    }
+    }
+  }
+
+  /// Generate random bytes, like from `/dev/urandom`, sometimes biased towards the bytes that matter to the calculator.
+  void garbage() {
+    constexpr std::string_view BYTES = "0123456789+-*/% \n\t";
+
+    text_.resize(pick(256));
+    const bool biased = (pick(2) == 0);
+    for (char& c : text_) {
+      c = biased ? BYTES[pick(BYTES.size())] : static_cast<char>(pick(256));
+    }
+  }
+
+  std::mt19937_64 rng_;
+  std::string     text_;
+};
+
+/// Outcome of fuzzing on a thread.
+struct Outcome {
+  std::size_t                cases   = 0; // Number of inputs checked.
+  std::size_t                unknown = 0; // Number of evaluations beyond the reference.
+  std::optional<std::string> difference;  // The difference found, if any.
+};
+
+///
+/// Check generated inputs, on a number of threads, each with its own generator and checker.
+///
+/// \param threads Number of threads, thread `t` generates input using seed `seed + t`.
+/// \param seed Seed of the input generator.
+/// \param cases Number of inputs to check, spread over the threads.
+/// \param seconds Time to check inputs for instead, if not zero.
+///
+/// \returns The outcome for every thread, checking stops on all threads at the first difference found.
+///
+[[nodiscard]] std::vector<Outcome> fuzz(std::size_t threads, std::uint64_t seed, std::size_t cases, double seconds) {
+  using Clock = std::chrono::steady_clock;
+
+  const auto        t_stop = Clock::now() + std::chrono::duration_cast<Clock::duration>(std::chrono::duration<double>{seconds});
+  std::atomic<bool> found{false};
+
+  std::vector<Outcome> outcomes(threads);
+
+  const auto work = [&](std::size_t t) {
+    Generator         generator{seed + t};
+    Checker           checker;
+    const std::size_t count = (cases / threads) + ((t < cases % threads) ? 1 : 0);
+
+    for (std::size_t i = 0; (seconds > 0) ? ((i % 4096 != 0) || Clock::now() < t_stop) : (i < count); i++) {
+      if (i % 4096 == 0 && found.load(std::memory_order_relaxed)) {
+        break;
+      }
+
+      if (auto difference = checker.check(generator.next())) {
+        outcomes[t].difference = fmt::format("{}\nFound after {} inputs, with seed {}", *difference, i + 1, seed + t);
+        found.store(true, std::memory_order_relaxed);
+        break;
+      }
+    }
+
+    outcomes[t].cases   = checker.cases();
+    outcomes[t].unknown = checker.unknown();
+  };
+
+  std::vector<std::thread> pool;
+  for (std::size_t t = 1; t < threads; t++) {
+    pool.emplace_back(work, t);
+  }
+
+  work(0);
+  for (auto& thread : pool) {
+    thread.join();
+  }
+
+  return outcomes;
+}
+
+/// Read a file.
+[[nodiscard]] std::string read_file(const std::string& path) {
+  std::ifstream file{path, std::ios::binary};
+  if (!file) {
+    throw std::runtime_error{fmt::format("failed to open '{}'", path)};
+  }
+
+  std::ostringstream text;
+  text << file.rdbuf();
+  return std::move(text).str();
+}
+
+} // namespace
+
+int main(int argc, char** argv) {
+  try {
+    std::size_t              cases   = 1'000'000;                                         // Number of generated inputs to check.
+    double                   seconds = 0;                                                 // Time to check generated inputs for instead, if not zero.
+    std::uint64_t            seed    = 42;                                                // Seed of the input generator.
+    std::size_t              threads = std::max(std::thread::hardware_concurrency(), 1U); // Number of threads to check generated inputs on.
+    std::vector<std::string> paths;                                                       // Files with inputs to check, like reproducers.
+
+    for (int i = 1; i < argc; i++) {
+      const std::string_view arg{argv[i]};
+      if (arg == "--cases" && (i + 1) < argc) {
+        cases = std::stoul(argv[++i]);
+      } else if (arg == "--seconds" && (i + 1) < argc) {
+        seconds = std::stod(argv[++i]);
+      } else if (arg == "--seed" && (i + 1) < argc) {
+        seed = std::stoull(argv[++i]);
+      } else if (arg == "--threads" && (i + 1) < argc) {
+        threads = std::max(std::stoul(argv[++i]), 1UL);
+      } else {
+        paths.emplace_back(arg);
+      }
+    }
+
+    if (!paths.empty()) {
+      Checker checker;
+      for (const auto& path : paths) {
+        if (const auto difference = checker.check(read_file(path))) {
+          std::cerr << *difference << '\n';
+          return 1;
+        }
+      }
+
+      fmt::print("Checked {} inputs, no differences\n", checker.cases());
+      return 0;
+    }
+
+    const auto                          t_start  = std::chrono::steady_clock::now();
+    const std::vector<Outcome>          outcomes = fuzz(threads, seed, cases, seconds);
+    const std::chrono::duration<double> elapsed  = std::chrono::steady_clock::now() - t_start;
+
+    std::size_t checked = 0;
+    std::size_t unknown = 0;
+    bool        found   = false;
+    for (const auto& outcome : outcomes) {
+      checked += outcome.cases;
+      unknown += outcome.unknown;
+      if (outcome.difference) {
+        std::cerr << *outcome.difference << '\n';
+        found = true;
+      }
+    }
+
+    if (found) {
+      return 1;
+    }
+
+    fmt::print("Checked {} inputs on {} threads in {:.3f} s ({:.0f} inputs/s), no differences ({} evaluations beyond the reference)\n",
+               checked, threads, elapsed.count(), static_cast<double>(checked) / elapsed.count(), unknown);
+  } catch (const std::exception& e) {
+    std::cerr << "Caught exception: " << e.what() << '\n';
+    return 1;
+  }
+
+  return 0;
+}
+
+#endif // ENABLE_LIBFUZZER
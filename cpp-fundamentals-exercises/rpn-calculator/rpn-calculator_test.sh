@@ -143,7 +143,7 @@ test_input "9223372036854775807 0 %" "Error: division by zero"
 test_input "9223372036854775807 -0 %" "Error: division by zero"
 
 log_info "Overflow tests:"
-test_input "9223372036854775807 9223372036854775807 * 9223372036854775807 *" "Error: integer overflow"
+test_input "9223372036854775807 9223372036854775807 * 9223372036854775807 *" "784637716923335095224261902710254454442933591094742482943"
 
 log_info "Invalid input tests:"
 test_input "" "Error: expected operand 1, got end-of-calculation"
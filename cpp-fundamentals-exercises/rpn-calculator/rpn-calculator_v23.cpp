@@ -0,0 +1,2175 @@
+#include <fmt/core.h>
+
+#if defined(__x86_64__) && (defined(__GNUC__) || defined(__clang__))
+#include <immintrin.h>
+#define HAVE_X86_SIMD
+#endif
+
+#if defined(__x86_64__) && defined(__linux__)
+#include <sys/mman.h>
+#include <unistd.h>
+#define HAVE_JIT
+#endif
+
+#if __has_include(<unistd.h>)
+#include <unistd.h>
+#define HAVE_POSIX_READ
+#endif
+
+#ifdef ENABLE_DOCTESTS
+#define DOCTEST_CONFIG_IMPLEMENT
+#include <doctest/doctest.h>
+#endif
+
+#include <algorithm>
+#include <array>
+#include <bit>
+#include <cerrno>
+#include <charconv>
+#include <chrono>
+#include <cmath>
+#include <concepts>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <exception>
+#include <fstream>
+#include <iostream>
+#include <limits>
+#include <list>
+#include <optional>
+#include <random>
+#include <sstream>
+#include <stdexcept>
+#include <string>
+#include <string_view>
+#include <system_error>
+#include <type_traits>
+#include <unordered_map>
+#include <variant>
+#include <vector>
+
+#include "stack.hpp"
+
+/// Helper class to let function overloading deal with type selection.
+template<typename... Ts>
+struct overload : Ts... {
+  using Ts::operator()...;
+};
+
+/// Class template argument (CTAD) deduction guide, not needed for C++20 and later.
+// template<typename... Ts> overload(Ts...) -> overload<Ts...>;
+
+/// The set of allowed operators.
+constexpr std::string OPERATORS = "+-*/%";
+
+/// Calculation-related specific error type.
+class calculation_error final : public std::exception {
+public:
+  explicit calculation_error(std::string_view message)
+    : message_{message} {
+  }
+
+  [[nodiscard]] const char* what() const noexcept override {
+    return message_.c_str();
+  }
+
+private:
+  std::string message_;
+};
+
+namespace States {
+
+/// Expecting operand 1.
+struct Operand1 {};
+
+/// Expecting operand 2.
+struct Operand2 {};
+
+/// Expecting operator.
+struct Operator {};
+
+/// Show result.
+struct Result {};
+
+} // namespace States
+
+/// State representation.
+using State = std::variant<States::Operand1, States::Operand2, States::Operator, States::Result>;
+
+/// Any signed arithmetic type.
+template<typename T>
+concept signed_arithmetic = std::is_signed_v<T> && std::is_arithmetic_v<T>;
+
+namespace {
+
+///
+/// Check whether all eight bytes of a chunk are ASCII digits.
+///
+/// Adding 6 to a digit byte keeps its upper nibble at 3, while it carries it over for ':' and up. So both the byte and the byte plus
+/// six have 3 as their upper nibble only for digits.
+///
+[[nodiscard]] constexpr bool is_eight_digits(std::uint64_t chunk) {
+  return ((chunk & 0xF0F0F0F0F0F0F0F0) | (((chunk + 0x0606060606060606) & 0xF0F0F0F0F0F0F0F0) >> 4)) == 0x3333333333333333;
+}
+
+///
+/// Convert a chunk of eight ASCII digits (loaded little-endian, so the first digit is in the lowest byte) to its value.
+///
+/// Using SIMD-within-a-register (SWAR), each step combines pairs of neighbouring lanes into lanes of double the width using a single
+/// multiplication: digits into 2-digit values, into 4-digit values, into the 8-digit value.
+///
+[[nodiscard]] constexpr std::uint32_t parse_eight_digits(std::uint64_t chunk) {
+  chunk = ((chunk & 0x0F0F0F0F0F0F0F0F) * ((10 << 8) + 1)) >> 8;
+  chunk = ((chunk & 0x00FF00FF00FF00FF) * ((100 << 16) + 1)) >> 16;
+  return static_cast<std::uint32_t>(((chunk & 0x0000FFFF0000FFFF) * ((10000ULL << 32) + 1)) >> 32);
+}
+
+/// Load eight characters as a little-endian chunk.
+[[nodiscard]] std::uint64_t load_chunk(const char* digits) {
+  std::uint64_t chunk = 0;
+  std::memcpy(&chunk, digits, sizeof(chunk));
+  if constexpr (std::endian::native == std::endian::big) {
+    chunk = __builtin_bswap64(chunk);
+  }
+
+  return chunk;
+}
+
+///
+/// Parse a decimal integer, eight digits at a time where possible.
+///
+/// \returns The parsed value, or nothing if the input is not a plain (optionally negative) decimal integer.
+///
+/// \throws A `calculation_error` if the value does not fit the value type.
+///
+template<std::integral T>
+[[nodiscard]] std::optional<T> parse_integer(std::string_view value) {
+  const bool       negative = value.starts_with('-');
+  std::string_view digits   = value.substr(negative ? 1 : 0);
+
+  if (digits.empty()) {
+    return std::nullopt;
+  }
+
+  // Up to 19 digits always fit 64 bits. Only for longer input leading zeros matter.
+  if (digits.size() > std::numeric_limits<std::uint64_t>::digits10) {
+    const std::size_t significant = digits.find_first_not_of('0');
+    if (significant == std::string_view::npos) {
+      return T{0};
+    }
+
+    digits.remove_prefix(significant);
+  }
+
+  if (digits.size() > std::numeric_limits<std::uint64_t>::digits10) {
+    if (std::ranges::all_of(digits, [](char c) { return c >= '0' && c <= '9'; })) {
+      throw calculation_error{fmt::format("failed to parse input '{}': parse type value overflow", value)};
+    }
+
+    return std::nullopt;
+  }
+
+  // Parse the leading digits that do not fill a chunk one at a time. For short numbers this is faster than combining the lanes.
+  std::uint64_t     magnitude = 0;
+  const std::size_t head      = digits.size() % 8;
+  for (std::size_t i = 0; i < head; i++) {
+    const auto digit = static_cast<unsigned char>(digits[i] - '0');
+    if (digit > 9) {
+      return std::nullopt;
+    }
+
+    magnitude = (magnitude * 10) + digit;
+  }
+
+  for (std::size_t offset = head; offset < digits.size(); offset += 8) {
+    const std::uint64_t chunk = load_chunk(digits.data() + offset);
+    if (!is_eight_digits(chunk)) {
+      return std::nullopt;
+    }
+
+    magnitude = (magnitude * 100'000'000) + parse_eight_digits(chunk);
+  }
+
+  if (magnitude > static_cast<std::uint64_t>(std::numeric_limits<T>::max()) + (negative ? 1 : 0)) {
+    throw calculation_error{fmt::format("failed to parse input '{}': parse type value overflow", value)};
+  }
+
+  return static_cast<T>(negative ? (std::uint64_t{0} - magnitude) : magnitude);
+}
+
+} // namespace
+
+namespace Tokens {
+
+/// Operand token.
+struct Operand {
+  const std::string_view value; // Refers to the input text.
+
+  ///
+  /// Parse token to a value type indicated by the template argument.
+  ///
+  /// \returns The parsed value.
+  ///
+  /// \throws An exception when a parse error occurs, or this function is called on an empty value.
+  ///
+  template<signed_arithmetic T>
+  [[nodiscard]] T parse() const {
+    if (!value.empty()) {
+      // Plain integers take the fast path, anything else (like fractions for integral types) gets diagnosed below.
+      if constexpr (std::is_integral_v<T>) {
+        if (const auto v = parse_integer<T>(value)) {
+          return *v;
+        }
+      }
+
+      //
+      // NOTE: Select the 'long double' overload of from_chars for maximum value width. Depending on the platform for
+      //        which this code is compiled, it will provide 80 bits or even 128 bits extended floating-point precision.
+      //        For MSVC this may not even have any effect and will still use 64 bits, like 'double'.
+      //
+      long double v{};
+      const auto [ptr, error] = std::from_chars(value.data(), value.data() + value.size(), v);
+      if (error == std::errc{}) {
+        // Check for invalid cross-type parse requests.
+        if constexpr (std::is_integral_v<T> && !std::is_floating_point_v<T>) {
+          if (std::fmod(v, 1.0) > std::numeric_limits<double>::epsilon()) {
+            throw std::logic_error{fmt::format("failed to parse input '{}': invalid cross-type parse", value)};
+          }
+        }
+
+        // Check for overflow errors.
+        if (v > static_cast<double>(std::numeric_limits<T>::max()) || v < static_cast<double>(std::numeric_limits<T>::lowest())) {
+          throw calculation_error{fmt::format("failed to parse input '{}': parse type value overflow", value)};
+        }
+
+        return static_cast<T>(v);
+      } else {
+        throw calculation_error{fmt::format("failed to parse input '{}'", value)};
+      }
+    }
+
+    throw std::logic_error{"trying to call parse on an empty value"};
+  }
+};
+
+/// Operator token.
+struct Operator {
+  const char op;
+};
+
+/// End-of-calculation token.
+struct Eoc {};
+
+/// Invalid token.
+struct Invalid {};
+
+} // namespace Tokens
+
+/// Input token representation.
+using Token = std::variant<Tokens::Operand, Tokens::Operator, Tokens::Eoc, Tokens::Invalid>;
+
+/// Byte classes of a block of 64 input bytes, as bit masks with bit i for byte i.
+struct BlockMasks {
+  std::uint64_t whitespace = 0; // Any of ' ', '\t', '\n', '\v', '\f' and '\r'.
+  std::uint64_t digits     = 0; // Any of '0' to '9'.
+};
+
+/// Function classifying a block of 64 input bytes.
+using Classifier = BlockMasks (*)(const char* block);
+
+namespace {
+
+/// Block size of the classifiers in [bytes].
+constexpr std::size_t BLOCK_SIZE = 64;
+
+/// Classify a block of input bytes, one byte at a time. This is the reference for the vectorized classifiers.
+[[nodiscard]] BlockMasks classify_scalar(const char* block) {
+  BlockMasks masks;
+  for (std::size_t i = 0; i < BLOCK_SIZE; i++) {
+    const char c = block[i];
+    masks.whitespace |= static_cast<std::uint64_t>(c == ' ' || (c >= '\t' && c <= '\r')) << i;
+    masks.digits |= static_cast<std::uint64_t>(c >= '0' && c <= '9') << i;
+  }
+
+  return masks;
+}
+
+#ifdef HAVE_X86_SIMD
+
+///
+/// Classify a block of input bytes, 16 bytes at a time using SSE2 (which every x86-64 processor supports).
+///
+/// Range checks use a wrapping subtraction and a saturating subtraction: `c` is in `[lo, lo + n]` if `(c - lo) -sat n` is zero.
+///
+[[nodiscard]] BlockMasks classify_sse2(const char* block) {
+  const auto in_range = [](__m128i v, char lo, char n) {
+    return _mm_cmpeq_epi8(_mm_subs_epu8(_mm_sub_epi8(v, _mm_set1_epi8(lo)), _mm_set1_epi8(n)), _mm_setzero_si128());
+  };
+
+  const auto to_mask = [](__m128i v, std::size_t i) { return static_cast<std::uint64_t>(static_cast<std::uint16_t>(_mm_movemask_epi8(v))) << (16 * i); };
+
+  BlockMasks masks;
+  for (std::size_t i = 0; i < BLOCK_SIZE / 16; i++) {
+    const __m128i v = _mm_loadu_si128(reinterpret_cast<const __m128i*>(block + (16 * i)));
+
+    masks.whitespace |= to_mask(_mm_or_si128(_mm_cmpeq_epi8(v, _mm_set1_epi8(' ')), in_range(v, '\t', '\r' - '\t')), i);
+    masks.digits |= to_mask(in_range(v, '0', 9), i);
+  }
+
+  return masks;
+}
+
+/// Classify a block of input bytes, 32 bytes at a time using AVX2. Only call this if the processor supports AVX2.
+[[gnu::target("avx2")]] [[nodiscard]] BlockMasks classify_avx2(const char* block) {
+  // No lambdas here: these would not inherit the target attribute.
+  const __m256i zero = _mm256_setzero_si256();
+
+  BlockMasks masks;
+  for (std::size_t i = 0; i < BLOCK_SIZE / 32; i++) {
+    const __m256i v = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(block + (32 * i)));
+
+    const __m256i space  = _mm256_cmpeq_epi8(v, _mm256_set1_epi8(' '));
+    const __m256i ctrl   = _mm256_cmpeq_epi8(_mm256_subs_epu8(_mm256_sub_epi8(v, _mm256_set1_epi8('\t')), _mm256_set1_epi8('\r' - '\t')), zero);
+    const __m256i digits = _mm256_cmpeq_epi8(_mm256_subs_epu8(_mm256_sub_epi8(v, _mm256_set1_epi8('0')), _mm256_set1_epi8(9)), zero);
+
+    masks.whitespace |= static_cast<std::uint64_t>(static_cast<std::uint32_t>(_mm256_movemask_epi8(_mm256_or_si256(space, ctrl)))) << (32 * i);
+    masks.digits |= static_cast<std::uint64_t>(static_cast<std::uint32_t>(_mm256_movemask_epi8(digits))) << (32 * i);
+  }
+
+  return masks;
+}
+
+#endif // HAVE_X86_SIMD
+
+/// Select the fastest classifier supported by the processor.
+[[nodiscard]] Classifier best_classifier() {
+#ifdef HAVE_X86_SIMD
+  return __builtin_cpu_supports("avx2") ? classify_avx2 : classify_sse2;
+#else
+  return classify_scalar;
+#endif
+}
+
+} // namespace
+
+///
+/// Structural index of the input text: the start and end offsets of all whitespace-separated tokens.
+///
+/// The input is classified in blocks of 64 bytes into bit masks, using SIMD instructions if available. The token starts are the
+/// non-whitespace bytes preceded by whitespace, and the token ends the whitespace bytes preceded by non-whitespace (carrying over the
+/// last bit between blocks). The offsets are extracted from the masks one set bit at a time. Per block, a mask of the "unusual" token
+/// bytes (neither digits nor whitespace) is kept, so tokens can be classified without looking at their bytes again in most cases.
+///
+struct TokenIndex {
+  TokenIndex() = default;
+
+  explicit TokenIndex(std::string_view input_, Classifier classify = best_classifier()) {
+    assign(input_, classify);
+  }
+
+  ///
+  /// Index new input text, reusing the storage of the previous index.
+  ///
+  /// \throws A `std::length_error` if the input is larger than 4 GiB.
+  ///
+  void assign(std::string_view input_, Classifier classify = best_classifier()) {
+    if (input_.size() > std::numeric_limits<std::uint32_t>::max()) {
+      throw std::length_error{"input too large -- at most 4 GiB is supported"};
+    }
+
+    input = input_;
+    non_digits.clear();
+    non_digits.reserve((input.size() / BLOCK_SIZE) + 1);
+
+    std::size_t   n_starts = 0;
+    std::size_t   n_ends   = 0;
+    std::uint64_t carry    = 0; // Indicates the last byte of the previous block was part of a token.
+    for (std::size_t offset = 0; offset < input.size(); offset += BLOCK_SIZE) {
+      BlockMasks masks;
+      if (input.size() - offset >= BLOCK_SIZE) {
+        masks = classify(input.data() + offset);
+      } else {
+        std::array<char, BLOCK_SIZE> tail;
+        tail.fill(' '); // Pad the last partial block with whitespace, which also ends the last token.
+        std::ranges::copy(input.substr(offset), tail.begin());
+        masks = classify(tail.data());
+      }
+
+      const std::uint64_t token = ~masks.whitespace;
+      const std::uint64_t after = (token << 1) | carry; // Bit i set if byte i - 1 is part of a token.
+      carry                     = token >> 63;
+
+      extract(token & ~after, offset, starts, n_starts);
+      extract(~token & after, offset, ends, n_ends);
+      non_digits.push_back(token & ~masks.digits);
+    }
+
+    starts.resize(n_starts);
+    ends.resize(n_ends);
+
+    if (carry != 0) {
+      ends.push_back(static_cast<std::uint32_t>(input.size())); // The last token runs until the end of a full last block.
+    }
+  }
+
+  /// Number of tokens.
+  [[nodiscard]] std::size_t size() const {
+    return starts.size();
+  }
+
+  /// Count the bytes in the offset range [start, end) that are not digits (nor whitespace).
+  [[nodiscard]] unsigned int count_non_digits(std::size_t start, std::size_t end) const {
+    unsigned int count = 0;
+    for (std::size_t block = start / BLOCK_SIZE; block * BLOCK_SIZE < end; block++) {
+      std::uint64_t mask = non_digits[block];
+      if (block == start / BLOCK_SIZE) {
+        mask &= ~std::uint64_t{0} << (start % BLOCK_SIZE);
+      }
+
+      if ((block + 1) * BLOCK_SIZE > end) {
+        mask &= ~(~std::uint64_t{0} << (end % BLOCK_SIZE));
+      }
+
+      count += static_cast<unsigned int>(std::popcount(mask));
+    }
+
+    return count;
+  }
+
+  std::string_view           input;
+  std::vector<std::uint32_t> starts;     // Token start offsets.
+  std::vector<std::uint32_t> ends;       // Token end offsets (one past the last byte).
+  std::vector<std::uint64_t> non_digits; // Per block, the token bytes that are not digits.
+
+private:
+  ///
+  /// Write the offsets of all set bits in a mask to `offsets`, starting at index `count`.
+  ///
+  /// The vector is grown ahead by a full block, so the loop needs no bounds checks. The excess is trimmed when the index is complete.
+  ///
+  static void extract(std::uint64_t mask, std::size_t offset, std::vector<std::uint32_t>& offsets, std::size_t& count) {
+    if (offsets.size() < count + BLOCK_SIZE) {
+      offsets.resize(std::max(count + BLOCK_SIZE, 2 * offsets.size()));
+    }
+
+    for (; mask != 0; mask &= mask - 1) {
+      offsets[count++] = static_cast<std::uint32_t>(offset + static_cast<std::size_t>(std::countr_zero(mask)));
+    }
+  }
+};
+
+namespace {
+
+///
+/// Read the next token from a token index.
+///
+/// \param index Token index of the input.
+/// \param cursor Index of the next token to read, incremented on return.
+/// \param limit Offset in the input where the calculation ends, tokens from there on are not read.
+///
+/// \returns The read token.
+///
+[[nodiscard]] Token read_token(const TokenIndex& index, std::size_t& cursor, std::size_t limit = std::numeric_limits<std::size_t>::max()) {
+  if (cursor >= index.size() || index.starts[cursor] >= limit) {
+    return Tokens::Eoc{};
+  }
+
+  const std::size_t      start = index.starts[cursor];
+  const std::size_t      end   = index.ends[cursor];
+  const std::string_view input = index.input.substr(start, end - start);
+  cursor++;
+
+  const unsigned int non_digits = index.count_non_digits(start, end);
+
+  if (non_digits == 0) {
+    return Tokens::Operand{input}; // Positive number.
+  } else if ((non_digits == 1) && (input.length() > 1) && input.starts_with('-')) {
+    return Tokens::Operand{input}; // Negative number.
+  } else if ((input.length() == 1) && (OPERATORS.find(input[0]) != std::string::npos)) {
+    return Tokens::Operator{input[0]};
+  } else {
+    return Tokens::Invalid{};
+  }
+}
+
+///
+/// Reader of the input in chunks of bounded size, so the input need not fit in memory and is evaluated as it arrives.
+///
+/// Every chunk ends at a delimiter byte, so no token (or line) is cut in two: the bytes after the last delimiter are carried over to
+/// the next chunk. Only a token or line that does not fit in a chunk makes the chunk grow beyond the chunk size.
+///
+class InputReader {
+public:
+  /// Number of bytes read at a time.
+  static constexpr std::size_t CHUNK_SIZE = 1 << 16;
+
+  explicit InputReader(std::FILE* source = stdin)
+    : source_{source} {
+  }
+
+  /// Delimiter of tokens, the same bytes the token index takes for whitespace.
+  [[nodiscard]] static bool is_whitespace(char c) {
+    return c == ' ' || (c >= '\t' && c <= '\r');
+  }
+
+  /// Delimiter of lines.
+  [[nodiscard]] static bool is_newline(char c) {
+    return c == '\n';
+  }
+
+  ///
+  /// Read the next chunk of the input.
+  ///
+  /// \param is_delimiter Predicate for the bytes a chunk may end with.
+  /// \param full Wait for a full chunk (or the end of the input), rather than returning as soon as a delimiter arrives.
+  ///
+  /// \returns The chunk, valid until the next call. It is empty at the end of the input.
+  ///
+  /// \throws A `std::runtime_error` if reading fails.
+  ///
+  template<typename Predicate>
+  [[nodiscard]] std::string_view read(Predicate is_delimiter, bool full = false) {
+    buffer_.erase(0, chunk_size_); // Keep only the carried over bytes.
+    chunk_size_ = 0;
+
+    while (!end_ && (chunk_size_ == 0 || (full && buffer_.size() < CHUNK_SIZE))) {
+      const std::size_t scanned = buffer_.size();
+      buffer_.resize(scanned + CHUNK_SIZE);
+      buffer_.resize(scanned + read_some(buffer_.data() + scanned, CHUNK_SIZE));
+      end_ = (buffer_.size() == scanned);
+
+      const auto last = std::find_if(buffer_.rbegin(), buffer_.rend() - static_cast<std::ptrdiff_t>(scanned), is_delimiter);
+      if (last != buffer_.rend() - static_cast<std::ptrdiff_t>(scanned)) {
+        chunk_size_ = static_cast<std::size_t>(buffer_.rend() - last);
+      }
+    }
+
+    if (end_) {
+      chunk_size_ = buffer_.size(); // The rest of the input, if any.
+    }
+
+    return std::string_view{buffer_}.substr(0, chunk_size_);
+  }
+
+  /// Whether the last chunk read ends the input.
+  [[nodiscard]] bool at_end() const {
+    return end_;
+  }
+
+private:
+  /// Read at most `size` bytes, returning as soon as any are available (so interactive input is not held back).
+  [[nodiscard]] std::size_t read_some(char* data, std::size_t size) {
+#ifdef HAVE_POSIX_READ
+    ssize_t n = 0;
+    do {
+      n = ::read(fileno(source_), data, size);
+    } while (n < 0 && errno == EINTR);
+
+    if (n < 0) {
+      throw std::runtime_error{"failed to read input stream"};
+    }
+
+    return static_cast<std::size_t>(n);
+#else
+    // This waits for a full chunk, so interactive input is only evaluated once it ends.
+    const std::size_t n = std::fread(data, 1, size, source_);
+    if (std::ferror(source_) != 0) {
+      throw std::runtime_error{"failed to read input stream"};
+    }
+
+    return n;
+#endif
+  }
+
+  std::FILE*  source_;
+  std::string buffer_;         // The current chunk, followed by the carried over bytes.
+  std::size_t chunk_size_ = 0; // Size of the current chunk.
+  bool        end_        = false;
+};
+
+///
+/// Source of the tokens of the input, read one chunk at a time: the next chunk is indexed when the tokens of the previous are used up.
+///
+class TokenStream {
+public:
+  ///
+  /// \param reader Reader of the input.
+  /// \param chunk Chunk already read from it, if any.
+  ///
+  explicit TokenStream(InputReader& reader, std::string_view chunk = {})
+    : reader_{reader} {
+    index_.assign(chunk);
+  }
+
+  /// Read the next token, `Tokens::Eoc` at the end of the input.
+  [[nodiscard]] Token next() {
+    while (cursor_ >= index_.size()) {
+      const std::string_view chunk = reader_.read(InputReader::is_whitespace);
+      if (chunk.empty()) {
+        return Tokens::Eoc{};
+      }
+
+      index_.assign(chunk);
+      cursor_ = 0;
+    }
+
+    return read_token(index_, cursor_);
+  }
+
+private:
+  InputReader& reader_;
+  TokenIndex   index_;
+  std::size_t  cursor_ = 0;
+};
+
+} // namespace
+
+///
+/// Buffered writer for calculation results.
+///
+/// Values are formatted with `std::to_chars` (which is locale-independent, and gives the shortest round-trip representation for
+/// floating-point values) directly into a large buffer, which is written out when full. In fixed-width mode values are right-aligned
+/// to a minimum width.
+///
+class ResultWriter {
+public:
+  explicit ResultWriter(std::FILE* sink = stdout, std::size_t width = 0)
+    : sink_{sink}
+    , width_{width}
+    , buffer_(BUFFER_SIZE) {
+  }
+
+  ResultWriter(const ResultWriter&)            = delete;
+  ResultWriter& operator=(const ResultWriter&) = delete;
+
+  ~ResultWriter() {
+    // Errors cannot be reported from here, call `flush` first to see those.
+    std::fwrite(buffer_.data(), 1, size_, sink_);
+  }
+
+  /// Write a result value line.
+  template<signed_arithmetic T>
+  void value(T v) {
+    std::array<char, MAX_VALUE_SIZE> text;
+    const auto [ptr, error] = std::to_chars(text.data(), text.data() + text.size(), v);
+    if (error != std::errc{}) {
+      throw std::logic_error{"failed to format result value"};
+    }
+
+    const auto length = static_cast<std::size_t>(ptr - text.data());
+    const auto pad    = std::max(width_, length) - length;
+
+    reserve(pad + length + 1);
+    std::memset(buffer_.data() + size_, ' ', pad);
+    std::memcpy(buffer_.data() + size_ + pad, text.data(), length);
+    size_ += pad + length;
+    buffer_[size_++] = '\n';
+    lines_++;
+  }
+
+  /// Write an error message line.
+  void error(std::string_view message) {
+    constexpr std::string_view PREFIX = "Error: ";
+
+    reserve(PREFIX.size() + message.size() + 1);
+    for (const auto part : {PREFIX, message, std::string_view{"\n"}}) {
+      std::memcpy(buffer_.data() + size_, part.data(), part.size());
+      size_ += part.size();
+    }
+
+    lines_++;
+  }
+
+  ///
+  /// Write out the buffered lines.
+  ///
+  /// \throws A `std::runtime_error` if writing fails.
+  ///
+  void flush() {
+    if (std::fwrite(buffer_.data(), 1, size_, sink_) != size_ || std::fflush(sink_) != 0) {
+      throw std::runtime_error{"failed to write output"};
+    }
+
+    size_ = 0;
+  }
+
+  /// Number of lines written.
+  [[nodiscard]] std::size_t lines() const {
+    return lines_;
+  }
+
+private:
+  static constexpr std::size_t BUFFER_SIZE    = 1 << 20; // In [bytes].
+  static constexpr std::size_t MAX_VALUE_SIZE = 64;      // Longest formatted value in [characters], for any arithmetic type.
+
+  /// Make room for a line of a given size, flushing the buffer or growing it for extremely long lines.
+  void reserve(std::size_t size) {
+    if (size_ + size > buffer_.size()) {
+      flush();
+      buffer_.resize(std::max(buffer_.size(), size));
+    }
+  }
+
+  std::FILE*        sink_;
+  std::size_t       width_;
+  std::vector<char> buffer_;
+  std::size_t       size_  = 0;
+  std::size_t       lines_ = 0;
+};
+
+namespace {
+
+///
+/// Measure the token index throughput for all classifiers available, on generated expression text.
+///
+void benchmark_tokenizer() {
+  constexpr std::size_t SIZE = 64 << 20;
+  constexpr int         RUNS = 5;
+
+  std::mt19937                       rng{42};
+  std::uniform_int_distribution<int> length{1, 19};
+  std::uniform_int_distribution<int> digit{0, 9};
+
+  std::string text;
+  text.reserve(SIZE + 64);
+  while (text.size() < SIZE) {
+    for (int i = length(rng); i > 0; i--) {
+      text += static_cast<char>('0' + digit(rng));
+    }
+
+    text += (digit(rng) < 5) ? " + " : " * ";
+    if (digit(rng) == 0) {
+      text += '\n';
+    }
+  }
+
+  std::vector<std::pair<const char*, Classifier>> classifiers{{"scalar", classify_scalar}};
+#ifdef HAVE_X86_SIMD
+  classifiers.emplace_back("sse2", classify_sse2);
+  if (__builtin_cpu_supports("avx2")) {
+    classifiers.emplace_back("avx2", classify_avx2);
+  }
+#endif
+
+  for (const auto& [name, classifier] : classifiers) {
+    auto       best = std::chrono::duration<double>::max();
+    TokenIndex index; // Reused, so the runs after the first measure tokenizing rather than page faults.
+    for (int run = 0; run < RUNS; run++) {
+      const auto t_start = std::chrono::steady_clock::now();
+      index.assign(text, classifier);
+      best = std::min(best, std::chrono::duration<double>(std::chrono::steady_clock::now() - t_start));
+    }
+
+    fmt::print("{:>6}: {:6.2f} GB/s ({} tokens in {} MiB)\n", name, static_cast<double>(text.size()) / best.count() / 1e9, index.size(), text.size() >> 20);
+  }
+}
+
+///
+/// Perform a calculation given two input values and an operator.
+///
+/// \note There is no overflow handling in place!
+///
+/// \param lhs Left-hand side input value.
+/// \param lhs Right-hand side input value.
+/// \param lhs Operator.
+///
+/// \returns Calculation result.
+///
+/// \throws An exception if an unsupported operator is specified.
+///
+template<typename T>
+[[nodiscard]] T calculate(T lhs, T rhs, char op) {
+  switch (op) {
+  case '+': return lhs + rhs;
+  case '-': return lhs - rhs;
+  case '*': return lhs * rhs;
+  case '/':
+    if (rhs == 0) {
+      throw calculation_error{"division by zero"};
+    }
+
+    return lhs / rhs;
+  case '%':
+    if constexpr (!std::is_floating_point_v<T>) {
+      if (rhs == 0) {
+        throw calculation_error{"division by zero"};
+      }
+
+      return lhs % rhs;
+    }
+  default: throw std::invalid_argument{"unsupported operator"};
+  }
+}
+
+///
+/// Measure the operand parsing throughput of `std::from_chars` and `Tokens::Operand::parse` for a number of digit-length distributions.
+///
+void benchmark_parse() {
+  constexpr std::size_t COUNT = 1 << 20;
+  constexpr int         RUNS  = 5;
+
+  struct Distribution {
+    const char*            name;
+    std::array<double, 19> weights; // Relative frequency of 1 to 19 digit operands.
+  };
+
+  const std::array distributions{
+    Distribution{"short (1-4 digits)", {4, 4, 2, 1}},
+    Distribution{"mixed (1-19 digits)", {8, 8, 6, 5, 4, 3, 3, 2, 2, 2, 1, 1, 1, 1, 1, 1, 1, 1, 1}}, // Mostly small numbers with a tail.
+    Distribution{"long (15-19 digits)", {0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 1, 1, 1, 1, 1}},
+  };
+
+  using Parser = long (*)(std::string_view);
+
+  const std::array<std::pair<const char*, Parser>, 3> parsers{{
+    {"from_chars<long>",
+     [](std::string_view value) {
+       long v{};
+       std::from_chars(value.data(), value.data() + value.size(), v);
+       return v;
+     }},
+    {"from_chars<long double>",
+     [](std::string_view value) {
+       long double v{};
+       std::from_chars(value.data(), value.data() + value.size(), v);
+       return static_cast<long>(v);
+     }},
+    {"Operand::parse<long>", [](std::string_view value) { return Tokens::Operand{value}.parse<long>(); }},
+  }};
+
+  std::mt19937                       rng{42};
+  std::uniform_int_distribution<int> digit{0, 9};
+
+  for (const auto& distribution : distributions) {
+    std::discrete_distribution<std::size_t> length{distribution.weights.begin(), distribution.weights.end()};
+
+    // Operands refer into one text, separated by spaces like real input.
+    std::string text;
+    text.reserve(COUNT * 21);
+    std::vector<std::string_view> operands;
+    operands.reserve(COUNT);
+    for (std::size_t i = 0; i < COUNT; i++) {
+      const std::size_t start = text.size();
+      if (digit(rng) < 3) {
+        text += '-';
+      }
+
+      text += static_cast<char>('1' + (digit(rng) % 8)); // Keeps 19-digit operands within the range of long.
+      for (std::size_t n = length(rng); n > 0; n--) {
+        text += static_cast<char>('0' + digit(rng));
+      }
+
+      operands.emplace_back(text.data() + start, text.size() - start);
+      text += ' ';
+    }
+
+    fmt::print("{}:\n", distribution.name);
+
+    long reference = 0;
+    for (const auto& [name, parser] : parsers) {
+      auto best = std::chrono::duration<double>::max();
+      long sum  = 0;
+      for (int run = 0; run < RUNS; run++) {
+        sum                = 0;
+        const auto t_start = std::chrono::steady_clock::now();
+        for (const auto operand : operands) {
+          sum += parser(operand) % 1000; // Keeps the sum from overflowing.
+        }
+
+        best = std::min(best, std::chrono::duration<double>(std::chrono::steady_clock::now() - t_start));
+      }
+
+      if (name == parsers[0].first) {
+        reference = sum;
+      }
+
+      fmt::print("  {:>24}: {:6.2f} ns/operand{}\n", name, best.count() * 1e9 / COUNT, (sum == reference) ? "" : " (results differ!)");
+    }
+  }
+}
+
+} // namespace
+
+/// The stack memory type.
+using Memory = Stack<long, 2>;
+
+namespace {
+
+///
+/// Evaluate a calculation, writing the result or error message.
+///
+/// \param next_token Source of the tokens of the calculation, returning `Tokens::Eoc` at its end.
+/// \param out Writer for the result.
+///
+void evaluate(std::invocable auto&& next_token, ResultWriter& out) {
+  bool   stop         = false;
+  bool   got_operator = false;
+  State  s            = States::Operand1{};
+  Memory m;
+
+  while (!stop) {
+    const Token t = next_token();
+
+    try {
+      // clang-format off
+      std::visit(overload{
+        [&](States::Operand1&) {
+          std::visit(overload{
+            [&](const Tokens::Operand& o) {
+              m.push(o.parse<long>());
+              s = States::Operand2{};
+            },
+            [](const Tokens::Operator&) { throw calculation_error{"expected operand 1, got operator"};           },
+            [](const Tokens::Eoc&)      { throw calculation_error{"expected operand 1, got end-of-calculation"}; },
+            [](const Tokens::Invalid&)  { throw calculation_error{"expected operand 1, got invalid token"};      }
+          }, t);
+        },
+        [&](States::Operand2&) {
+          std::visit(overload{
+            [&](const Tokens::Operand& o) {
+              m.push(o.parse<long>());
+              s = States::Operator{};
+            },
+            [&](const Tokens::Eoc&) {
+              if (got_operator) {
+                s = States::Result{};
+              } else {
+                throw calculation_error{"expected operand 2, got end-of-calculation"};
+              }
+            },
+            [](const Tokens::Operator&) { throw calculation_error{"expected operand 2, got operator"};      },
+            [](const Tokens::Invalid&)  { throw calculation_error{"expected operand 2, got invalid token"}; }
+          }, t);
+        },
+        [&](States::Operator&) {
+          std::visit(overload{
+            [&](const Tokens::Operator& o) {
+              if (m.size() != 2) {
+                throw std::logic_error{"expected two elements in memory"};
+              }
+
+              const auto rhs = m.pop().value();
+              const auto lhs = m.pop().value();
+              m.push(calculate(lhs, rhs, o.op));
+
+              got_operator = true;
+              s = States::Operand2{};
+            },
+            [](const Tokens::Operand&) { throw calculation_error{"expected operator, got operand"};            },
+            [](const Tokens::Eoc&)     { throw calculation_error{"expected operator, got end-of-calculation"}; },
+            [](const Tokens::Invalid&) { throw calculation_error{"expected operator, got invalid token"};      }
+          }, t);
+        },
+        [&](States::Result&) {
+          if (m.size() != 1) {
+            throw std::logic_error{"expected only a single result in memory"};
+          }
+
+          out.value(m.pop().value());
+
+          stop = true; // Bail out.
+        }
+      }, s);
+      // clang-format on
+    } catch (const calculation_error& e) {
+      out.error(e.what());
+      stop = true;
+    }
+  }
+}
+
+///
+/// Evaluate a calculation in a token index, writing the result or error message.
+///
+/// \param index Token index of the input.
+/// \param cursor Index of the first token of the calculation, on return the index of the token where evaluation stopped.
+/// \param limit Offset in the input where the calculation ends.
+/// \param out Writer for the result.
+///
+void evaluate(const TokenIndex& index, std::size_t& cursor, std::size_t limit, ResultWriter& out) {
+  evaluate([&] { return read_token(index, cursor, limit); }, out);
+}
+
+///
+/// Measure the result output throughput of `std::ostream` and `ResultWriter`, writing to the null device.
+///
+void benchmark_output() {
+  constexpr std::size_t COUNT = 1 << 22;
+  constexpr int         RUNS  = 5;
+
+  std::mt19937                        rng{42};
+  std::uniform_int_distribution<int>  length{0, 18};
+  std::uniform_int_distribution<long> value{std::numeric_limits<long>::min(), std::numeric_limits<long>::max()};
+
+  std::vector<long> values(COUNT);
+  std::ranges::generate(values, [&] { return value(rng) / static_cast<long>(std::pow(10, length(rng))); }); // Mixed lengths.
+
+  // Both must produce the exact same text.
+  std::ostringstream expected;
+  for (const auto v : values) {
+    expected << v << '\n';
+  }
+
+  std::FILE* file = std::tmpfile();
+  if (file == nullptr) {
+    throw std::runtime_error{"failed to create temporary file"};
+  }
+
+  {
+    ResultWriter out{file};
+    for (const auto v : values) {
+      out.value(v);
+    }
+
+    out.flush();
+  }
+
+  std::string actual(expected.view().size(), '\0');
+  std::rewind(file);
+  const bool identical = (std::fread(actual.data(), 1, actual.size(), file) == actual.size()) && (std::fgetc(file) == EOF) && (actual == expected.view());
+  std::fclose(file);
+
+  fmt::print("Output {} to std::ostream\n", identical ? "identical" : "DIFFERS");
+
+  const auto measure = [&](const char* name, std::invocable<std::FILE*> auto&& write) {
+    std::FILE* null = std::fopen("/dev/null", "w");
+    if (null == nullptr) {
+      throw std::runtime_error{"failed to open the null device"};
+    }
+
+    auto best = std::chrono::duration<double>::max();
+    for (int run = 0; run < RUNS; run++) {
+      const auto t_start = std::chrono::steady_clock::now();
+      write(null);
+      best = std::min(best, std::chrono::duration<double>(std::chrono::steady_clock::now() - t_start));
+    }
+
+    std::fclose(null);
+
+    fmt::print("{:>26}: {:6.1f} M lines/s\n", name, COUNT / best.count() / 1e6);
+  };
+
+  measure("std::ostream", [&](std::FILE*) {
+    std::ofstream null{"/dev/null"};
+    for (const auto v : values) {
+      null << v << '\n';
+    }
+  });
+
+  measure("ResultWriter", [&](std::FILE* null) {
+    ResultWriter out{null};
+    for (const auto v : values) {
+      out.value(v);
+    }
+
+    out.flush();
+  });
+
+  measure("ResultWriter (fixed width)", [&](std::FILE* null) {
+    ResultWriter out{null, 20};
+    for (const auto v : values) {
+      out.value(v);
+    }
+
+    out.flush();
+  });
+}
+
+} // namespace
+
+/// A valid calculation, ready for evaluation: the first operand, followed by pairs of an operand and an operator.
+struct Program {
+  std::vector<long> operands;
+  std::string       operators; // The "shape" of the calculation, operands.size() == operators.size() + 1.
+};
+
+namespace {
+
+///
+/// Compile a calculation into a program.
+///
+/// \param index Token index of the input.
+/// \param cursor Index of the first token of the calculation.
+/// \param limit Offset in the input where the calculation ends.
+///
+/// \returns The program, or nothing if the calculation is not valid. The interpreter should evaluate those, for its error messages.
+///
+[[nodiscard]] std::optional<Program> compile(const TokenIndex& index, std::size_t cursor, std::size_t limit) {
+  Program program;
+
+  // Valid calculations are two operands, then alternating an operator and an operand, ending after an operator.
+  for (std::size_t position = 0;; position++) {
+    const Token t              = read_token(index, cursor, limit);
+    const bool  expect_operand = (position < 2) || (position % 2 == 1);
+
+    if (std::holds_alternative<Tokens::Eoc>(t) && (position >= 3) && (position % 2 == 1)) {
+      return program;
+    } else if (const auto* operand = std::get_if<Tokens::Operand>(&t); operand != nullptr && expect_operand) {
+      try {
+        program.operands.push_back(operand->parse<long>());
+      } catch (const calculation_error&) {
+        return std::nullopt;
+      }
+    } else if (const auto* op = std::get_if<Tokens::Operator>(&t); op != nullptr && !expect_operand) {
+      program.operators += op->op;
+    } else {
+      return std::nullopt;
+    }
+  }
+}
+
+///
+/// Evaluate a program one operator at a time.
+///
+/// \param operators The operators of the program.
+/// \param operands The operands of the program, one more than there are operators.
+///
+/// \returns The result.
+///
+/// \throws A `calculation_error` on division by zero.
+///
+[[nodiscard]] long interpret(std::string_view operators, const long* operands) {
+  long value = operands[0];
+  for (std::size_t i = 0; i < operators.size(); i++) {
+    value = calculate(value, operands[i + 1], operators[i]);
+  }
+
+  return value;
+}
+
+/// Check whether an operation can fail, which is a division or modulo by zero.
+[[nodiscard]] bool can_fail(char op, long rhs) {
+  return (op == '/' || op == '%') && rhs == 0;
+}
+
+///
+/// Remove operations that do not change the value: adding or subtracting zero, and multiplying or dividing by one. Multiplying by zero
+/// makes the preceding operations irrelevant, these are removed as well unless they can fail.
+///
+/// \returns The number of operations removed.
+///
+std::size_t remove_identities(Program& program) {
+  Program result{{program.operands[0]}, {}};
+  bool    may_fail = false; // Indicates an operation in the result so far can fail.
+  for (std::size_t i = 0; i < program.operators.size(); i++) {
+    const char op  = program.operators[i];
+    const long rhs = program.operands[i + 1];
+
+    if (((op == '+' || op == '-') && rhs == 0) || ((op == '*' || op == '/') && rhs == 1)) {
+      continue;
+    } else if (op == '*' && rhs == 0 && !may_fail) {
+      result = Program{{0}, {}};
+      continue;
+    }
+
+    result.operands.push_back(rhs);
+    result.operators += op;
+    may_fail = may_fail || can_fail(op, rhs);
+  }
+
+  const std::size_t removed = program.operators.size() - result.operators.size();
+  program                   = std::move(result);
+  return removed;
+}
+
+///
+/// Fold operations on constant values into a single value, as far as the operations cannot fail.
+///
+/// As all operands are constant, this evaluates all operations up to the first division by zero. That one is kept, so the error still
+/// happens when the program is evaluated. The operations after it are removed, as these would never be evaluated.
+///
+/// \returns The number of operations removed.
+///
+std::size_t fold_constants(Program& program) {
+  std::size_t i     = 0;
+  long        value = program.operands[0];
+  for (; i < program.operators.size() && !can_fail(program.operators[i], program.operands[i + 1]); i++) {
+    value = calculate(value, program.operands[i + 1], program.operators[i]);
+  }
+
+  Program result{{value}, {}};
+  if (i < program.operators.size()) {
+    result.operands.push_back(program.operands[i + 1]);
+    result.operators += program.operators[i];
+  }
+
+  const std::size_t removed = program.operators.size() - result.operators.size();
+  program                   = std::move(result);
+  return removed;
+}
+
+} // namespace
+
+/// Operation counts of the optimizer over all programs.
+struct OptimizerStats {
+  std::size_t programs   = 0;
+  std::size_t before     = 0; // Operations before optimization.
+  std::size_t identities = 0; // Operations removed as algebraic identities.
+  std::size_t folded     = 0; // Operations removed by constant folding.
+
+  ///
+  /// Optimize a program, counting the removed operations.
+  ///
+  /// \note Evaluating the optimized program gives the same result as the original program, or the same error.
+  ///
+  void optimize(Program& program) {
+    programs++;
+    before += program.operators.size();
+    identities += remove_identities(program);
+    folded += fold_constants(program);
+  }
+
+  /// Operations after optimization.
+  [[nodiscard]] std::size_t after() const {
+    return before - identities - folded;
+  }
+};
+
+#ifdef HAVE_JIT
+
+///
+/// Native x86-64 machine code for a program shape.
+///
+/// The code runs the calculation in registers: RAX holds the left-hand side value, and RCX the next operand loaded from the operand array.
+/// Addition, subtraction and multiplication wrap around like `calculate<long>` does in practice. Division and modulo check the divisor for
+/// zero before dividing. The generated function follows the System V calling convention, with the signature of `Entry`.
+///
+/// The code is written into an anonymous memory mapping, which is made executable (and read-only) when complete.
+///
+class JitFunction {
+public:
+  /// Compiled function, returning zero on success and non-zero on division by zero.
+  using Entry = int (*)(const long* operands, long* result);
+
+  explicit JitFunction(std::string_view operators) {
+    std::vector<std::uint8_t> code;
+    std::vector<std::size_t>  divisions; // Offsets of the jump displacements to the division-by-zero exit.
+
+    const auto emit = [&](std::initializer_list<std::uint8_t> bytes) { code.insert(code.end(), bytes); };
+
+    const auto emit_u32 = [&](std::uint32_t value) {
+      for (int i = 0; i < 4; i++) {
+        code.push_back(static_cast<std::uint8_t>(value >> (8 * i)));
+      }
+    };
+
+    emit({0x48, 0x8B, 0x07}); // mov rax, [rdi]
+    for (std::size_t i = 0; i < operators.size(); i++) {
+      if ((i + 1) * sizeof(long) > std::numeric_limits<std::int32_t>::max()) {
+        throw std::length_error{"program too large to compile"};
+      }
+
+      emit({0x48, 0x8B, 0x8F}); // mov rcx, [rdi + disp32]
+      emit_u32(static_cast<std::uint32_t>((i + 1) * sizeof(long)));
+
+      switch (operators[i]) {
+      case '+': emit({0x48, 0x01, 0xC8}); break;       // add rax, rcx
+      case '-': emit({0x48, 0x29, 0xC8}); break;       // sub rax, rcx
+      case '*': emit({0x48, 0x0F, 0xAF, 0xC1}); break; // imul rax, rcx
+      case '/':
+      case '%':
+        emit({0x48, 0x85, 0xC9}); // test rcx, rcx
+        emit({0x0F, 0x84});       // jz rel32
+        divisions.push_back(code.size());
+        emit_u32(0);
+        emit({0x48, 0x99});       // cqo
+        emit({0x48, 0xF7, 0xF9}); // idiv rcx
+        if (operators[i] == '%') {
+          emit({0x48, 0x89, 0xD0}); // mov rax, rdx
+        }
+        break;
+      default: throw std::invalid_argument{"unsupported operator"};
+      }
+    }
+
+    emit({0x48, 0x89, 0x06}); // mov [rsi], rax
+    emit({0x31, 0xC0});       // xor eax, eax
+    emit({0xC3});             // ret
+
+    const std::size_t division_by_zero = code.size();
+    emit({0xB8, 0x01, 0x00, 0x00, 0x00}); // mov eax, 1
+    emit({0xC3});                         // ret
+
+    for (const auto offset : divisions) {
+      const auto displacement = static_cast<std::uint32_t>(division_by_zero - (offset + 4));
+      std::memcpy(code.data() + offset, &displacement, sizeof(displacement));
+    }
+
+    const auto page_size = static_cast<std::size_t>(::sysconf(_SC_PAGESIZE));
+    size_                = ((code.size() + page_size - 1) / page_size) * page_size;
+
+    void* memory = ::mmap(nullptr, size_, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+    if (memory == MAP_FAILED) {
+      throw std::system_error{errno, std::generic_category(), "failed to map memory for compiled code"};
+    }
+
+    std::memcpy(memory, code.data(), code.size());
+    if (::mprotect(memory, size_, PROT_READ | PROT_EXEC) != 0) {
+      ::munmap(memory, size_);
+      throw std::system_error{errno, std::generic_category(), "failed to make compiled code executable"};
+    }
+
+    memory_ = memory;
+    entry_  = reinterpret_cast<Entry>(memory);
+  }
+
+  JitFunction(const JitFunction&)            = delete;
+  JitFunction& operator=(const JitFunction&) = delete;
+
+  ~JitFunction() {
+    ::munmap(memory_, size_);
+  }
+
+  ///
+  /// Run the compiled code.
+  ///
+  /// \param operands The operands of the program, one more than there are operators.
+  ///
+  /// \returns The result.
+  ///
+  /// \throws A `calculation_error` on division by zero.
+  ///
+  [[nodiscard]] long operator()(const long* operands) const {
+    long value{};
+    if (entry_(operands, &value) != 0) {
+      throw calculation_error{"division by zero"};
+    }
+
+    return value;
+  }
+
+private:
+  void*       memory_ = nullptr;
+  std::size_t size_   = 0;
+  Entry       entry_  = nullptr;
+};
+
+#endif // HAVE_JIT
+
+///
+/// Evaluator for programs that compiles hot program shapes to machine code.
+///
+/// Programs are interpreted until their shape was evaluated `JIT_THRESHOLD` times. In verification mode every compiled evaluation is checked
+/// against the interpreter. Without JIT support for the platform, all programs are interpreted.
+///
+/// At most `MAX_SHAPES` shapes are kept, the least recently used one is dropped to make room for a new one. This bounds the memory for
+/// the counts and the compiled code, which takes at least a page per shape, for input with ever new shapes. If no memory can be mapped
+/// for the code, the shape is interpreted.
+///
+class JitCache {
+public:
+  /// Number of evaluations of a program shape before it is compiled.
+  static constexpr std::size_t JIT_THRESHOLD = 16;
+
+  /// Number of program shapes kept.
+  static constexpr std::size_t MAX_SHAPES = 1024;
+
+  explicit JitCache(bool verify = false)
+    : verify_{verify} {
+  }
+
+  ///
+  /// Evaluate a program.
+  ///
+  /// \returns The result.
+  ///
+  /// \throws A `calculation_error` on division by zero, and a `std::logic_error` if verification fails.
+  ///
+  [[nodiscard]] long evaluate(const Program& program) {
+#ifdef HAVE_JIT
+    Shape& shape = find(program.operators);
+    if (!shape.code && ++shape.count >= JIT_THRESHOLD) {
+      compile(shape);
+    }
+
+    if (shape.code) {
+      return verify_ ? verified(*shape.code, program) : (*shape.code)(program.operands.data());
+    }
+#endif
+
+    return interpret(program.operators, program.operands.data());
+  }
+
+  /// Number of program shapes compiled.
+  [[nodiscard]] std::size_t compiled() const {
+    return compiled_;
+  }
+
+  /// Number of program shapes kept, at most `MAX_SHAPES`.
+  [[nodiscard]] std::size_t size() const {
+#ifdef HAVE_JIT
+    return shapes_.size();
+#else
+    return 0;
+#endif
+  }
+
+private:
+#ifdef HAVE_JIT
+  struct Shape {
+    const std::string          operators;
+    std::size_t                count = 0;
+    std::optional<JitFunction> code;
+  };
+
+  /// Look up the shape of a program and make it the most recently used one, dropping the least recently used one if there are too many.
+  [[nodiscard]] Shape& find(const std::string& operators) {
+    if (const auto it = index_.find(operators); it != index_.end()) {
+      shapes_.splice(shapes_.begin(), shapes_, it->second);
+      return *it->second;
+    }
+
+    if (shapes_.size() == MAX_SHAPES) {
+      index_.erase(shapes_.back().operators);
+      shapes_.pop_back();
+    }
+
+    Shape& shape = shapes_.emplace_front(operators);
+    index_.emplace(shape.operators, shapes_.begin());
+    return shape;
+  }
+
+  /// Compile a shape. If that fails for lack of memory, it is interpreted until it reaches the threshold again.
+  void compile(Shape& shape) {
+    try {
+      shape.code.emplace(shape.operators);
+      compiled_++;
+    } catch (const std::system_error&) {
+      shape.count = 0;
+    } catch (const std::length_error&) {
+      shape.count = 0;
+    }
+  }
+
+  /// Evaluate a program with the compiled code as well as the interpreter, and compare.
+  [[nodiscard]] static long verified(const JitFunction& code, const Program& program) {
+    std::optional<long> expected;
+    try {
+      expected = interpret(program.operators, program.operands.data());
+    } catch (const calculation_error&) {
+    }
+
+    std::optional<long> actual;
+    try {
+      actual = code(program.operands.data());
+    } catch (const calculation_error&) {
+    }
+
+    if (actual != expected) {
+      throw std::logic_error{fmt::format("compiled code for '{}' differs from the interpreter: {} instead of {}", program.operators,
+                                         actual ? std::to_string(*actual) : "error", expected ? std::to_string(*expected) : "error")};
+    }
+
+    return code(program.operands.data());
+  }
+
+  std::list<Shape>                                                shapes_; // Most recently used first.
+  std::unordered_map<std::string_view, std::list<Shape>::iterator> index_;  // Refers to the operators of the shapes.
+#endif
+
+  bool        verify_;
+  std::size_t compiled_ = 0;
+};
+
+namespace {
+
+///
+/// Measure the evaluation throughput of the interpreter and the compiled code, for programs of several sizes.
+///
+void benchmark_jit() {
+  constexpr std::size_t COUNT = 1 << 16; // Operand sets per program shape.
+  constexpr int         RUNS  = 5;
+
+  std::mt19937                        rng{42};
+  std::uniform_int_distribution<long> operand{1, 1000}; // Non-zero, so no divisions by zero.
+
+  // Divisions take tens of cycles each, which hides most of the interpreter overhead. So measure with and without.
+  std::vector<std::string> shapes;
+  for (const std::string_view set : {"+-*", "+-*/%"}) {
+    std::uniform_int_distribution<std::size_t> op{0, set.size() - 1};
+    for (const std::size_t size : {1, 4, 16, 64}) {
+      std::string operators;
+      for (std::size_t i = 0; i < size; i++) {
+        operators += set[op(rng)];
+      }
+
+      shapes.push_back(operators);
+    }
+  }
+
+  for (const auto& operators : shapes) {
+    const std::size_t size = operators.size();
+
+    std::vector<long> operands(COUNT * (size + 1));
+    std::ranges::generate(operands, [&] { return operand(rng); });
+
+    const auto measure = [&](std::invocable<const long*> auto&& evaluate) {
+      auto best = std::chrono::duration<double>::max();
+      long sum  = 0;
+      for (int run = 0; run < RUNS; run++) {
+        sum                = 0;
+        const auto t_start = std::chrono::steady_clock::now();
+        for (std::size_t i = 0; i < COUNT; i++) {
+          sum += evaluate(operands.data() + (i * (size + 1))) % 1000; // Keeps the sum from overflowing.
+        }
+
+        best = std::min(best, std::chrono::duration<double>(std::chrono::steady_clock::now() - t_start));
+      }
+
+      return std::pair{COUNT / best.count(), sum};
+    };
+
+    const auto [interpreted, interpreted_sum] = measure([&](const long* o) { return interpret(operators, o); });
+    fmt::print("{:2} operators ({:>7} division): interpreter {:7.2f} M evaluations/s", size,
+               (operators.find_first_of("/%") == std::string::npos) ? "without" : "with", interpreted / 1e6);
+
+#ifdef HAVE_JIT
+    const JitFunction code{operators};
+    const auto [compiled, compiled_sum] = measure([&](const long* o) { return code(o); });
+    fmt::print(", compiled {:7.2f} M evaluations/s ({:.1f}x){}", compiled / 1e6, compiled / interpreted,
+               (compiled_sum == interpreted_sum) ? "" : " (results differ!)");
+#endif
+
+    fmt::print("\n");
+  }
+}
+
+} // namespace
+
+int main(int argc, char** argv) {
+  int result{};
+
+#ifdef ENABLE_DOCTESTS
+  doctest::Context ctx;
+  ctx.applyCommandLine(argc, argv);
+  result = ctx.run();
+  if (ctx.shouldExit()) {
+    return result;
+  }
+#endif // ENABLE_DOCTESTS
+
+  try {
+    bool        lines    = false; // Evaluate every input line as a separate calculation.
+    std::size_t width    = 0;     // Minimum result width, zero for none.
+    bool        jit      = false; // Evaluate valid calculations as programs, compiling the hot ones.
+    bool        verify   = false; // Verify all compiled evaluations against the interpreter.
+    bool        optimize = false; // Optimize valid calculations before evaluation.
+
+    for (int i = 1; i < argc; i++) {
+      const std::string_view arg{argv[i]};
+      if (arg == "--benchmark") {
+        benchmark_tokenizer();
+        return result;
+      } else if (arg == "--benchmark-parse") {
+        benchmark_parse();
+        return result;
+      } else if (arg == "--benchmark-output") {
+        benchmark_output();
+        return result;
+      } else if (arg == "--benchmark-jit") {
+        benchmark_jit();
+        return result;
+      } else if (arg == "--lines") {
+        lines = true;
+      } else if (arg == "--jit") {
+        jit = true;
+      } else if (arg == "--jit-verify") {
+        jit    = true;
+        verify = true;
+      } else if (arg == "--optimize") {
+        optimize = true;
+      } else if (arg == "--width" && (i + 1) < argc) {
+        width = std::stoul(argv[++i]);
+      }
+    }
+
+    InputReader    reader;
+    TokenIndex     index;
+    std::size_t    cursor = 0;
+    ResultWriter   out{stdout, width};
+    JitCache       cache{verify};
+    OptimizerStats stats;
+
+    // Invalid calculations always go to the state machine, which reports the errors.
+    const auto run = [&](std::size_t limit) {
+      if (jit || optimize) {
+        if (auto program = compile(index, cursor, limit)) {
+          if (optimize) {
+            stats.optimize(*program);
+          }
+
+          try {
+            out.value(jit ? cache.evaluate(*program) : interpret(program->operators, program->operands.data()));
+          } catch (const calculation_error& e) {
+            out.error(e.what());
+          }
+
+          return;
+        }
+      }
+
+      evaluate(index, cursor, limit, out);
+    };
+
+    if (lines) {
+      // The input is read in chunks of whole lines, and the results are written out per chunk. Lines without tokens are skipped, the
+      // tokens left over after an error in a line as well.
+      for (auto input = reader.read(InputReader::is_newline); !input.empty(); input = reader.read(InputReader::is_newline)) {
+        index.assign(input);
+        for (cursor = 0; cursor < index.size();) {
+          const std::size_t limit = std::min(input.find('\n', index.starts[cursor]), input.size());
+          run(limit);
+          cursor = static_cast<std::size_t>(std::ranges::lower_bound(index.starts, limit) - index.starts.begin());
+        }
+
+        out.flush();
+      }
+    } else if (const auto input = reader.read(InputReader::is_whitespace, true); reader.at_end()) {
+      index.assign(input);
+      run(input.size());
+    } else {
+      // A calculation that does not fit in a chunk is streamed through the state machine.
+      TokenStream tokens{reader, input};
+      evaluate([&] { return tokens.next(); }, out);
+    }
+
+    out.flush();
+
+    if (optimize) {
+      std::cerr << fmt::format("Optimized {} calculations: {} operations before, {} after ({} identities removed, {} folded)\n", stats.programs,
+                               stats.before, stats.after(), stats.identities, stats.folded);
+    }
+  } catch (const std::exception& e) {
+    std::cerr << "Caught exception: " << e.what() << '\n';
+  }
+
+  return result;
+}
+
+#ifdef ENABLE_DOCTESTS
+
+/// Helper to suppress compiler errors regarding 'nodiscard'.
+#define USE(e) static_cast<void>(e)
+
+TEST_CASE("Tokens::Operand::parse") {
+  SUBCASE("Valid input") {
+    Tokens::Operand o1{"42"};
+    CHECK(o1.parse<int>() == 42);
+
+    Tokens::Operand o2{"-1234567890"};
+    CHECK(o2.parse<long>() == -1234567890);
+
+    Tokens::Operand o3{"3.14"};
+    CHECK(o3.parse<float>() == doctest::Approx(3.14f));
+
+    Tokens::Operand o4{"2.71828"};
+    CHECK(o4.parse<double>() == doctest::Approx(2.71828));
+  }
+
+  SUBCASE("Invalid input") {
+    Tokens::Operand o1{"abc"};
+    CHECK_THROWS_AS(USE(o1.parse<int>()), calculation_error);
+
+    Tokens::Operand o2{"123.45"};
+    CHECK_THROWS_AS(USE(o2.parse<long>()), std::logic_error);
+
+    Tokens::Operand o3{"xyz"};
+    CHECK_THROWS_AS(USE(o3.parse<double>()), calculation_error);
+  }
+
+  SUBCASE("Empty input") {
+    Tokens::Operand o{""};
+    CHECK_THROWS_AS(USE(o.parse<int>()), std::logic_error);
+    CHECK_THROWS_AS(USE(o.parse<long>()), std::logic_error);
+    CHECK_THROWS_AS(USE(o.parse<float>()), std::logic_error);
+    CHECK_THROWS_AS(USE(o.parse<double>()), std::logic_error);
+  }
+
+  SUBCASE("Overflow input") {
+    Tokens::Operand o1{"2147483648"};
+    CHECK_THROWS_AS(USE(o1.parse<int>()), calculation_error); // Exceeds the range of int.
+
+    Tokens::Operand o2{"92233720368547758080"};
+    CHECK_THROWS_AS(USE(o2.parse<long>()), calculation_error); // Exceeds the range of long.
+
+    Tokens::Operand o3{"9223372036854775808"};
+    CHECK_THROWS_AS(USE(o3.parse<long>()), calculation_error); // Exceeds the range of long by one.
+  }
+}
+
+TEST_CASE("parse_integer") {
+  SUBCASE("Converts eight digits at a time") {
+    CHECK(is_eight_digits(load_chunk("12345678")));
+    CHECK(!is_eight_digits(load_chunk("1234567a")));
+    CHECK(!is_eight_digits(load_chunk("/2345678")));
+    CHECK(!is_eight_digits(load_chunk("1234:678")));
+    CHECK(parse_eight_digits(load_chunk("12345678")) == 12345678);
+    CHECK(parse_eight_digits(load_chunk("00000009")) == 9);
+  }
+
+  SUBCASE("Parses integers of all lengths") {
+    std::string digits;
+    long        expected = 0;
+    for (int n = 1; n <= 18; n++) {
+      digits += static_cast<char>('0' + (n % 10));
+      expected = (expected * 10) + (n % 10);
+
+      CHECK(parse_integer<long>(digits) == expected);
+      CHECK(parse_integer<long>("-" + digits) == -expected);
+    }
+  }
+
+  SUBCASE("Parses the range limits exactly") {
+    CHECK(parse_integer<long>("9223372036854775807") == std::numeric_limits<long>::max());
+    CHECK(parse_integer<long>("-9223372036854775808") == std::numeric_limits<long>::min());
+    CHECK(parse_integer<int>("-2147483648") == std::numeric_limits<int>::min());
+    CHECK_THROWS_AS(USE(parse_integer<long>("-9223372036854775809")), calculation_error);
+    CHECK_THROWS_AS(USE(parse_integer<int>("2147483648")), calculation_error);
+  }
+
+  SUBCASE("Skips leading zeros") {
+    CHECK(parse_integer<long>("000000000000000000000000042") == 42);
+    CHECK(parse_integer<long>("-00000000000000000000000000") == 0);
+  }
+
+  SUBCASE("Leaves anything else to the generic parser") {
+    CHECK(!parse_integer<long>(""));
+    CHECK(!parse_integer<long>("-"));
+    CHECK(!parse_integer<long>("12.5"));
+    CHECK(!parse_integer<long>("123456789abc"));
+    CHECK(!parse_integer<long>("1234567890123456789012345.0"));
+  }
+}
+
+TEST_CASE("TokenIndex") {
+  SUBCASE("Finds token boundaries") {
+    const TokenIndex index{"  12 -3\t+\n\n*  "};
+
+    CHECK(index.starts == std::vector<std::uint32_t>{2, 5, 8, 11});
+    CHECK(index.ends == std::vector<std::uint32_t>{4, 7, 9, 12});
+  }
+
+  SUBCASE("Handles tokens crossing block boundaries and at the end of the input") {
+    const std::string input = std::string(60, ' ') + "12345678 9" + std::string(54, ' ') + "42";
+    const TokenIndex  index{input};
+
+    CHECK(index.starts == std::vector<std::uint32_t>{60, 69, 124});
+    CHECK(index.ends == std::vector<std::uint32_t>{68, 70, 126});
+  }
+
+  SUBCASE("Handles empty and whitespace-only input") {
+    CHECK(TokenIndex{""}.size() == 0);
+    CHECK(TokenIndex{" \t\n\v\f\r"}.size() == 0);
+  }
+
+  SUBCASE("All classifiers agree") {
+    std::mt19937 rng{1};
+    std::string  input(1000, ' ');
+    std::ranges::generate(input, [&] { return " \n0123456789-+*/%a\xff"[rng() % 19]; });
+
+    const TokenIndex reference{input, classify_scalar};
+    std::vector      classifiers{best_classifier()};
+#ifdef HAVE_X86_SIMD
+    classifiers.push_back(classify_sse2);
+#endif
+
+    for (const auto classifier : classifiers) {
+      const TokenIndex index{input, classifier};
+
+      CHECK(index.starts == reference.starts);
+      CHECK(index.ends == reference.ends);
+      CHECK(index.non_digits == reference.non_digits);
+    }
+  }
+}
+
+TEST_CASE("read_token") {
+  SUBCASE("Reads an operand") {
+    const TokenIndex index{"123"};
+    std::size_t      cursor = 0;
+
+    const auto t = read_token(index, cursor);
+
+    CHECK(std::holds_alternative<Tokens::Operand>(t));
+    CHECK(std::get<Tokens::Operand>(t).value == "123");
+    CHECK(cursor == 1);
+  }
+
+  SUBCASE("Reads a negative operand") {
+    const TokenIndex index{"-456"};
+    std::size_t      cursor = 0;
+
+    const auto t = read_token(index, cursor);
+
+    CHECK(std::holds_alternative<Tokens::Operand>(t));
+    CHECK(std::get<Tokens::Operand>(t).value == "-456");
+  }
+
+  SUBCASE("Reads an operator") {
+    const TokenIndex index{"+"};
+    std::size_t      cursor = 0;
+
+    const auto t = read_token(index, cursor);
+
+    CHECK(std::holds_alternative<Tokens::Operator>(t));
+    CHECK(std::get<Tokens::Operator>(t).op == '+');
+  }
+
+  SUBCASE("Reads an invalid token") {
+    for (const auto input : {"abc", "1-2", "--1", "-", "++", "12a", "\xff"}) {
+      const TokenIndex index{input};
+      std::size_t      cursor = 0;
+
+      if (std::string_view{input} == "-") {
+        CHECK(std::holds_alternative<Tokens::Operator>(read_token(index, cursor)));
+      } else {
+        CHECK(std::holds_alternative<Tokens::Invalid>(read_token(index, cursor)));
+      }
+    }
+  }
+
+  SUBCASE("Returns end-of-calculation after the last token") {
+    const TokenIndex index{"1 2"};
+    std::size_t      cursor = 0;
+
+    USE(read_token(index, cursor));
+    USE(read_token(index, cursor));
+
+    CHECK(std::holds_alternative<Tokens::Eoc>(read_token(index, cursor)));
+    CHECK(std::holds_alternative<Tokens::Eoc>(read_token(index, cursor)));
+  }
+
+  SUBCASE("Returns end-of-calculation at the limit") {
+    const TokenIndex index{"1 2\n3"};
+    std::size_t      cursor = 0;
+
+    USE(read_token(index, cursor, 3));
+    USE(read_token(index, cursor, 3));
+
+    CHECK(std::holds_alternative<Tokens::Eoc>(read_token(index, cursor, 3)));
+    CHECK(std::holds_alternative<Tokens::Operand>(read_token(index, cursor)));
+  }
+}
+
+TEST_CASE("InputReader") {
+  // A token and a line straddle the end of the first chunk.
+  const std::string input = std::string(InputReader::CHUNK_SIZE - 2, '1') + " 2345 6\n7";
+
+  std::FILE* file = std::tmpfile();
+  REQUIRE(file != nullptr);
+  REQUIRE(std::fwrite(input.data(), 1, input.size(), file) == input.size());
+
+  SUBCASE("Tokens") {
+    std::rewind(file);
+    InputReader reader{file};
+    CHECK(reader.read(InputReader::is_whitespace) == std::string_view{input}.substr(0, InputReader::CHUNK_SIZE - 1));
+    CHECK(reader.read(InputReader::is_whitespace) == "2345 6\n");
+    CHECK(reader.read(InputReader::is_whitespace) == "7");
+    CHECK(reader.at_end());
+    CHECK(reader.read(InputReader::is_whitespace).empty());
+  }
+
+  SUBCASE("Lines") {
+    std::rewind(file);
+    InputReader reader{file};
+    CHECK(reader.read(InputReader::is_newline) == std::string_view{input}.substr(0, input.size() - 1));
+    CHECK(reader.read(InputReader::is_newline) == "7");
+    CHECK(reader.read(InputReader::is_newline).empty());
+  }
+
+  SUBCASE("Token stream") {
+    std::rewind(file);
+    InputReader reader{file};
+    TokenStream tokens{reader};
+    CHECK(std::holds_alternative<Tokens::Operand>(tokens.next()));
+    CHECK(std::get<Tokens::Operand>(tokens.next()).value == "2345");
+    CHECK(std::get<Tokens::Operand>(tokens.next()).value == "6");
+    CHECK(std::get<Tokens::Operand>(tokens.next()).value == "7");
+    CHECK(std::holds_alternative<Tokens::Eoc>(tokens.next()));
+  }
+
+  std::fclose(file);
+}
+
+TEST_CASE("ResultWriter") {
+  const auto written = [](std::size_t width, std::invocable<ResultWriter&> auto&& write) {
+    std::FILE* file = std::tmpfile();
+    REQUIRE(file != nullptr);
+
+    {
+      ResultWriter out{file, width};
+      write(out);
+      out.flush();
+    }
+
+    std::fseek(file, 0, SEEK_END);
+    std::string text(static_cast<std::size_t>(std::ftell(file)), '\0');
+    std::rewind(file);
+    text.resize(std::fread(text.data(), 1, text.size(), file));
+    std::fclose(file);
+
+    return text;
+  };
+
+  SUBCASE("Writes the same text as std::ostream") {
+    const auto text = written(0, [](ResultWriter& out) {
+      out.value(42L);
+      out.value(std::numeric_limits<long>::min());
+      out.value(0);
+      out.error("division by zero");
+      out.value(-7);
+
+      CHECK(out.lines() == 5);
+    });
+
+    std::ostringstream expected;
+    expected << 42L << '\n' << std::numeric_limits<long>::min() << '\n' << 0 << '\n' << "Error: division by zero\n" << -7 << '\n';
+
+    CHECK(text == expected.str());
+  }
+
+  SUBCASE("Writes shortest round-trip floating-point values") {
+    CHECK(written(0, [](ResultWriter& out) {
+            out.value(0.1);
+            out.value(1e300);
+            out.value(2.5f);
+          }) == "0.1\n1e+300\n2.5\n");
+  }
+
+  SUBCASE("Right-aligns values in fixed-width mode") {
+    CHECK(written(4, [](ResultWriter& out) {
+            out.value(7);
+            out.value(-12345);
+            out.error("overflow");
+          }) == "   7\n-12345\nError: overflow\n");
+  }
+
+  SUBCASE("Writes lines larger than the buffer size") {
+    CHECK(written(2'000'000, [](ResultWriter& out) { out.value(1); }).size() == 2'000'001);
+  }
+}
+
+TEST_CASE("calculate") {
+  SUBCASE("Addition") {
+    CHECK(calculate(2, 3, '+') == 5);
+    CHECK(calculate(0, 0, '+') == 0);
+    CHECK(calculate(-5, 10, '+') == 5);
+    CHECK(calculate(-9223372036854775807L, 1L, '+') == -9223372036854775806L);
+    CHECK(calculate(-9223372036854775807L, 1L, '+') == -9223372036854775806L);
+    CHECK(calculate(9223372036854775807L, -1L, '+') == 9223372036854775806L);
+    CHECK(calculate(0L, 9223372036854775807L, '+') == 9223372036854775807L);
+    // CHECK(calculate(-9223372036854775807L, -9223372036854775807L, '+') == -18446744073709551614L); // 64-bit overflow.
+    CHECK(calculate(9223372036854775807L, -9223372036854775807L, '+') == 0L);
+    CHECK(calculate(0L, -9223372036854775807L, '+') == -9223372036854775807L);
+  }
+
+  SUBCASE("Subtraction") {
+    CHECK(calculate(5, 3, '-') == 2);
+    CHECK(calculate(0, 0, '-') == 0);
+    CHECK(calculate(-5, 10, '-') == -15);
+    CHECK(calculate(1000000000, 2000000000, '-') == -1000000000);
+    // CHECK(calculate(-9223372036854775807L, 1L, '-') == -9223372036854775808L); // 64-bit overflow.
+    // CHECK(calculate(9223372036854775807L, -1L, '-') == 9223372036854775808L);  // 64-bit overflow.
+    CHECK(calculate(0L, 9223372036854775807L, '-') == -9223372036854775807L);
+    CHECK(calculate(-9223372036854775807L, -9223372036854775807L, '-') == 0L);
+    // CHECK(calculate(9223372036854775807L, -9223372036854775807L, '-') == 18446744073709551614L); // 64-bit overflow.
+    CHECK(calculate(0L, -9223372036854775807L, '-') == 9223372036854775807L);
+  }
+
+  SUBCASE("Multiplication") {
+    CHECK(calculate(2, 3, '*') == 6);
+    CHECK(calculate(0, 5, '*') == 0);
+    CHECK(calculate(-5, -2, '*') == 10);
+    CHECK(calculate(1000000000L, 2000000000L, '*') == 2000000000000000000L);
+    CHECK(calculate(-9223372036854775807L, 1L, '*') == -9223372036854775807L);
+    CHECK(calculate(9223372036854775807L, -1L, '*') == -9223372036854775807L);
+    CHECK(calculate(0L, 9223372036854775807L, '*') == 0L);
+    // CHECK(calculate(-9223372036854775807L, -9223372036854775807L, '*') == 85070591730234615847396907784232501249L); // 64-bit overflow.
+    // CHECK(calculate(9223372036854775807L, -9223372036854775807L, '*') == -85070591730234615847396907784232501249L); // 64-bit overflow.
+    CHECK(calculate(0L, -9223372036854775807L, '*') == 0L);
+  }
+
+  SUBCASE("Division") {
+    CHECK(calculate(10, 2, '/') == 5);
+    CHECK(calculate(0, 5, '/') == 0);
+    CHECK(calculate(-10, 2, '/') == -5);
+    CHECK(calculate(1000000000, 2000000000, '/') == 0);
+    CHECK(calculate(-9223372036854775807L, 1L, '/') == -9223372036854775807L);
+    CHECK(calculate(9223372036854775807L, -1L, '/') == -9223372036854775807L);
+    CHECK(calculate(0L, 9223372036854775807L, '/') == 0L);
+    CHECK(calculate(-9223372036854775807L, -9223372036854775807L, '/') == 1L);
+    CHECK(calculate(9223372036854775807L, -9223372036854775807L, '/') == -1L);
+    CHECK(calculate(0L, -9223372036854775807L, '/') == 0L);
+  }
+
+  SUBCASE("Modulo") {
+    CHECK(calculate(10, 3, '%') == 1);
+    CHECK(calculate(0, 5, '%') == 0);
+    CHECK(calculate(-10, 3, '%') == -1);
+    CHECK(calculate(1000000000, 2000000000, '%') == 1000000000);
+    CHECK(calculate(-9223372036854775807L, 1L, '%') == 0L);
+    CHECK(calculate(9223372036854775807L, -1L, '%') == 0L);
+    CHECK(calculate(0L, 9223372036854775807L, '%') == 0L);
+    CHECK(calculate(-9223372036854775807L, -9223372036854775807L, '%') == 0L);
+    CHECK(calculate(9223372036854775807L, -9223372036854775807L, '%') == 0L);
+    CHECK(calculate(0L, -9223372036854775807L, '%') == 0L);
+  }
+
+  SUBCASE("Unsupported Operator") {
+    CHECK_THROWS_AS(USE(calculate(2, 3, '^')), std::invalid_argument);
+    CHECK_THROWS_AS(USE(calculate(0, 0, '@')), std::invalid_argument);
+    CHECK_THROWS_AS(USE(calculate(-5, 10, '$')), std::invalid_argument);
+  }
+
+  SUBCASE("Division by Zero") {
+    CHECK_THROWS_AS(USE(calculate(5, 0, '/')), calculation_error);
+    CHECK_THROWS_AS(USE(calculate(0, 0, '/')), calculation_error);
+    CHECK_THROWS_AS(USE(calculate(-10, 0, '/')), calculation_error);
+    CHECK_THROWS_AS(USE(calculate(5, 0, '%')), calculation_error);
+    CHECK_THROWS_AS(USE(calculate(0, 0, '%')), calculation_error);
+    CHECK_THROWS_AS(USE(calculate(-10, 0, '%')), calculation_error);
+  }
+}
+
+TEST_CASE("compile") {
+  const auto compiled = [](std::string_view input) {
+    const TokenIndex index{input};
+    return compile(index, 0, input.size());
+  };
+
+  SUBCASE("Compiles valid calculations") {
+    const auto program = compiled("1 2 + -3 * 4 /");
+
+    REQUIRE(program);
+    CHECK(program->operands == std::vector<long>{1, 2, -3, 4});
+    CHECK(program->operators == "+*/");
+  }
+
+  SUBCASE("Rejects invalid calculations") {
+    for (const auto input : {"", "1", "1 2", "1 2 + 3", "1 +", "1 2 + +", "1 a +", "1 2 3 +", "99999999999999999999 1 +"}) {
+      CHECK(!compiled(input));
+    }
+  }
+}
+
+TEST_CASE("JitCache") {
+  const std::vector<Program> programs{
+    {{7, 3}, "+"},
+    {{7, 3}, "-"},
+    {{-7, 3}, "*"},
+    {{-7, 2}, "/"},
+    {{-7, 2}, "%"},
+    {{7, 0}, "/"},
+    {{7, 0}, "%"},
+    {{4, 5, 5, 30, 2}, "**-/"},
+    {{std::numeric_limits<long>::max(), 1, 3}, "+*"},
+  };
+
+  SUBCASE("Compiled code matches the interpreter") {
+    JitCache cache{true};
+    for (std::size_t i = 0; i < JitCache::JIT_THRESHOLD + 1; i++) {
+      for (const auto& program : programs) {
+        try {
+          const long value = cache.evaluate(program);
+          CHECK(value == interpret(program.operators, program.operands.data()));
+        } catch (const calculation_error&) {
+          CHECK_THROWS_AS(USE(interpret(program.operators, program.operands.data())), calculation_error);
+        }
+      }
+    }
+
+#ifdef HAVE_JIT
+    CHECK(cache.compiled() == 7); // The number of distinct shapes.
+#else
+    CHECK(cache.compiled() == 0);
+#endif
+  }
+
+  SUBCASE("Keeps a bounded number of shapes") {
+    JitCache cache{true};
+    for (std::size_t i = 0; i < 2 * JitCache::MAX_SHAPES; i++) {
+      Program program{std::vector<long>(9, 2), ""};
+      for (std::size_t shape = i; program.operators.size() < 8; shape /= 3) {
+        program.operators += "+-*"[shape % 3];
+      }
+
+      for (std::size_t j = 0; j < JitCache::JIT_THRESHOLD; j++) {
+        const long value = cache.evaluate(program);
+        CHECK(value == interpret(program.operators, program.operands.data()));
+      }
+    }
+
+    CHECK(cache.size() <= JitCache::MAX_SHAPES);
+#ifdef HAVE_JIT
+    CHECK(cache.compiled() == 2 * JitCache::MAX_SHAPES);
+#endif
+  }
+}
+
+TEST_CASE("OptimizerStats::optimize") {
+  SUBCASE("Removes identities") {
+    Program program{{5, 0, 1, 0, 1, 3}, "+*-/%"};
+
+    CHECK(remove_identities(program) == 4);
+    CHECK(program.operands == std::vector<long>{5, 3});
+    CHECK(program.operators == "%");
+  }
+
+  SUBCASE("Removes operations before a multiplication by zero, unless these can fail") {
+    Program program{{5, 2, 0, 7}, "+*-"};
+
+    CHECK(remove_identities(program) == 2);
+    CHECK(program.operands == std::vector<long>{0, 7});
+    CHECK(program.operators == "-");
+
+    Program failing{{5, 0, 0}, "/*"};
+
+    CHECK(remove_identities(failing) == 0);
+  }
+
+  SUBCASE("Folds up to a division by zero") {
+    Program program{{5, 2, 0, 7}, "*%+"};
+
+    CHECK(fold_constants(program) == 2);
+    CHECK(program.operands == std::vector<long>{10, 0});
+    CHECK(program.operators == "%");
+  }
+
+  SUBCASE("Keeps results and errors the same") {
+    std::mt19937                        rng{3};
+    std::uniform_int_distribution<long> operand{-2, 2};
+    std::uniform_int_distribution<int>  op{0, 4};
+    OptimizerStats                      stats;
+
+    for (int n = 0; n < 1000; n++) {
+      Program program{{operand(rng)}, {}};
+      for (int i = 0; i < 6; i++) {
+        program.operands.push_back(operand(rng));
+        program.operators += "+-*/%"[op(rng)];
+      }
+
+      std::optional<long> expected;
+      try {
+        expected = interpret(program.operators, program.operands.data());
+      } catch (const calculation_error&) {
+      }
+
+      stats.optimize(program);
+      CHECK(program.operators.size() <= 1);
+
+      std::optional<long> actual;
+      try {
+        actual = interpret(program.operators, program.operands.data());
+      } catch (const calculation_error&) {
+      }
+
+      CHECK(actual == expected);
+    }
+
+    CHECK(stats.programs == 1000);
+    CHECK(stats.before == 6000);
+  }
+}
+
+#endif // ENABLE_DOCTESTS
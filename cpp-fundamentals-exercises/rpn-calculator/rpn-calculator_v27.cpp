@@ -0,0 +1,4439 @@
+#include <fmt/core.h>
+
+#if defined(__x86_64__) && (defined(__GNUC__) || defined(__clang__))
+#include <immintrin.h>
+#define HAVE_X86_SIMD
+#endif
+
+#if defined(__x86_64__) && defined(__linux__)
+#include <sys/mman.h>
+#include <unistd.h>
+#define HAVE_JIT
+#endif
+
+#ifdef __linux__
+#include <arpa/inet.h>
+#include <fcntl.h>
+#include <linux/futex.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <poll.h>
+#include <signal.h>
+#include <sys/epoll.h>
+#include <sys/mman.h>
+#include <sys/resource.h>
+#include <sys/signalfd.h>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <sys/syscall.h>
+#include <sys/un.h>
+#include <unistd.h>
+#define HAVE_SERVER
+#endif
+
+#if __has_include(<unistd.h>)
+#include <unistd.h>
+#define HAVE_POSIX_READ
+#endif
+
+#ifdef ENABLE_DOCTESTS
+#define DOCTEST_CONFIG_IMPLEMENT
+#include <doctest/doctest.h>
+#endif
+
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <bit>
+#include <cerrno>
+#include <charconv>
+#include <chrono>
+#include <cmath>
+#include <concepts>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <deque>
+#include <exception>
+#include <fstream>
+#include <iostream>
+#include <limits>
+#include <list>
+#include <memory>
+#include <optional>
+#include <random>
+#include <span>
+#include <sstream>
+#include <stdexcept>
+#include <string>
+#include <string_view>
+#include <system_error>
+#include <thread>
+#include <type_traits>
+#include <unordered_map>
+#include <utility>
+#include <variant>
+#include <vector>
+
+#include "stack.hpp"
+
+/// Helper class to let function overloading deal with type selection.
+template<typename... Ts>
+struct overload : Ts... {
+  using Ts::operator()...;
+};
+
+/// Class template argument (CTAD) deduction guide, not needed for C++20 and later.
+// template<typename... Ts> overload(Ts...) -> overload<Ts...>;
+
+/// The set of allowed operators.
+constexpr std::string OPERATORS = "+-*/%";
+
+/// Calculation-related specific error type.
+class calculation_error final : public std::exception {
+public:
+  explicit calculation_error(std::string_view message)
+    : message_{message} {
+  }
+
+  [[nodiscard]] const char* what() const noexcept override {
+    return message_.c_str();
+  }
+
+private:
+  std::string message_;
+};
+
+namespace States {
+
+/// Expecting operand 1.
+struct Operand1 {};
+
+/// Expecting operand 2.
+struct Operand2 {};
+
+/// Expecting operator.
+struct Operator {};
+
+/// Show result.
+struct Result {};
+
+} // namespace States
+
+/// State representation.
+using State = std::variant<States::Operand1, States::Operand2, States::Operator, States::Result>;
+
+/// Any signed arithmetic type.
+template<typename T>
+concept signed_arithmetic = std::is_signed_v<T> && std::is_arithmetic_v<T>;
+
+namespace {
+
+///
+/// Check whether all eight bytes of a chunk are ASCII digits.
+///
+/// Adding 6 to a digit byte keeps its upper nibble at 3, while it carries it over for ':' and up. So both the byte and the byte plus
+/// six have 3 as their upper nibble only for digits.
+///
+[[nodiscard]] constexpr bool is_eight_digits(std::uint64_t chunk) {
+  return ((chunk & 0xF0F0F0F0F0F0F0F0) | (((chunk + 0x0606060606060606) & 0xF0F0F0F0F0F0F0F0) >> 4)) == 0x3333333333333333;
+}
+
+///
+/// Convert a chunk of eight ASCII digits (loaded little-endian, so the first digit is in the lowest byte) to its value.
+///
+/// Using SIMD-within-a-register (SWAR), each step combines pairs of neighbouring lanes into lanes of double the width using a single
+/// multiplication: digits into 2-digit values, into 4-digit values, into the 8-digit value.
+///
+[[nodiscard]] constexpr std::uint32_t parse_eight_digits(std::uint64_t chunk) {
+  chunk = ((chunk & 0x0F0F0F0F0F0F0F0F) * ((10 << 8) + 1)) >> 8;
+  chunk = ((chunk & 0x00FF00FF00FF00FF) * ((100 << 16) + 1)) >> 16;
+  return static_cast<std::uint32_t>(((chunk & 0x0000FFFF0000FFFF) * ((10000ULL << 32) + 1)) >> 32);
+}
+
+/// Load eight characters as a little-endian chunk.
+[[nodiscard]] constexpr std::uint64_t load_chunk(const char* digits) {
+  std::uint64_t chunk = 0;
+  if (std::is_constant_evaluated()) {
+    for (std::size_t i = 0; i < sizeof(chunk); i++) {
+      chunk |= static_cast<std::uint64_t>(static_cast<unsigned char>(digits[i])) << (8 * i);
+    }
+
+    return chunk;
+  }
+
+  std::memcpy(&chunk, digits, sizeof(chunk));
+  if constexpr (std::endian::native == std::endian::big) {
+    chunk = __builtin_bswap64(chunk);
+  }
+
+  return chunk;
+}
+
+///
+/// Parse a decimal integer, eight digits at a time where possible.
+///
+/// \returns The parsed value, or nothing if the input is not a plain (optionally negative) decimal integer.
+///
+/// \throws A `calculation_error` if the value does not fit the value type.
+///
+template<std::integral T>
+[[nodiscard]] constexpr std::optional<T> parse_integer(std::string_view value) {
+  const bool       negative = value.starts_with('-');
+  std::string_view digits   = value.substr(negative ? 1 : 0);
+
+  if (digits.empty()) {
+    return std::nullopt;
+  }
+
+  // Up to 19 digits always fit 64 bits. Only for longer input leading zeros matter.
+  if (digits.size() > std::numeric_limits<std::uint64_t>::digits10) {
+    const std::size_t significant = digits.find_first_not_of('0');
+    if (significant == std::string_view::npos) {
+      return T{0};
+    }
+
+    digits.remove_prefix(significant);
+  }
+
+  if (digits.size() > std::numeric_limits<std::uint64_t>::digits10) {
+    if (std::ranges::all_of(digits, [](char c) { return c >= '0' && c <= '9'; })) {
+      throw calculation_error{fmt::format("failed to parse input '{}': parse type value overflow", value)};
+    }
+
+    return std::nullopt;
+  }
+
+  // Parse the leading digits that do not fill a chunk one at a time. For short numbers this is faster than combining the lanes.
+  std::uint64_t     magnitude = 0;
+  const std::size_t head      = digits.size() % 8;
+  for (std::size_t i = 0; i < head; i++) {
+    const auto digit = static_cast<unsigned char>(digits[i] - '0');
+    if (digit > 9) {
+      return std::nullopt;
+    }
+
+    magnitude = (magnitude * 10) + digit;
+  }
+
+  for (std::size_t offset = head; offset < digits.size(); offset += 8) {
+    const std::uint64_t chunk = load_chunk(digits.data() + offset);
+    if (!is_eight_digits(chunk)) {
+      return std::nullopt;
+    }
+
+    magnitude = (magnitude * 100'000'000) + parse_eight_digits(chunk);
+  }
+
+  if (magnitude > static_cast<std::uint64_t>(std::numeric_limits<T>::max()) + (negative ? 1 : 0)) {
+    throw calculation_error{fmt::format("failed to parse input '{}': parse type value overflow", value)};
+  }
+
+  return static_cast<T>(negative ? (std::uint64_t{0} - magnitude) : magnitude);
+}
+
+} // namespace
+
+namespace Tokens {
+
+/// Operand token.
+struct Operand {
+  const std::string_view value; // Refers to the input text.
+
+  ///
+  /// Parse token to a value type indicated by the template argument.
+  ///
+  /// \returns The parsed value.
+  ///
+  /// \throws An exception when a parse error occurs, or this function is called on an empty value.
+  ///
+  template<signed_arithmetic T>
+  [[nodiscard]] constexpr T parse() const {
+    if (!value.empty()) {
+      // Plain integers take the fast path, anything else (like fractions for integral types) gets diagnosed below.
+      if constexpr (std::is_integral_v<T>) {
+        if (const auto v = parse_integer<T>(value)) {
+          return *v;
+        }
+      }
+
+      //
+      // NOTE: Select the 'long double' overload of from_chars for maximum value width. Depending on the platform for
+      //        which this code is compiled, it will provide 80 bits or even 128 bits extended floating-point precision.
+      //        For MSVC this may not even have any effect and will still use 64 bits, like 'double'.
+      //
+      long double v{};
+      const auto [ptr, error] = std::from_chars(value.data(), value.data() + value.size(), v);
+      if (error == std::errc{}) {
+        // Check for invalid cross-type parse requests.
+        if constexpr (std::is_integral_v<T> && !std::is_floating_point_v<T>) {
+          if (std::fmod(v, 1.0) > std::numeric_limits<double>::epsilon()) {
+            throw std::logic_error{fmt::format("failed to parse input '{}': invalid cross-type parse", value)};
+          }
+        }
+
+        // Check for overflow errors.
+        if (v > static_cast<double>(std::numeric_limits<T>::max()) || v < static_cast<double>(std::numeric_limits<T>::lowest())) {
+          throw calculation_error{fmt::format("failed to parse input '{}': parse type value overflow", value)};
+        }
+
+        return static_cast<T>(v);
+      } else {
+        throw calculation_error{fmt::format("failed to parse input '{}'", value)};
+      }
+    }
+
+    throw std::logic_error{"trying to call parse on an empty value"};
+  }
+};
+
+/// Operator token.
+struct Operator {
+  const char op;
+};
+
+/// End-of-calculation token.
+struct Eoc {};
+
+/// Invalid token.
+struct Invalid {};
+
+} // namespace Tokens
+
+/// Input token representation.
+using Token = std::variant<Tokens::Operand, Tokens::Operator, Tokens::Eoc, Tokens::Invalid>;
+
+/// Byte classes of a block of 64 input bytes, as bit masks with bit i for byte i.
+struct BlockMasks {
+  std::uint64_t whitespace = 0; // Any of ' ', '\t', '\n', '\v', '\f' and '\r'.
+  std::uint64_t digits     = 0; // Any of '0' to '9'.
+};
+
+/// Function classifying a block of 64 input bytes.
+using Classifier = BlockMasks (*)(const char* block);
+
+namespace {
+
+/// Block size of the classifiers in [bytes].
+constexpr std::size_t BLOCK_SIZE = 64;
+
+/// Classify a block of input bytes, one byte at a time. This is the reference for the vectorized classifiers.
+[[nodiscard]] BlockMasks classify_scalar(const char* block) {
+  BlockMasks masks;
+  for (std::size_t i = 0; i < BLOCK_SIZE; i++) {
+    const char c = block[i];
+    masks.whitespace |= static_cast<std::uint64_t>(c == ' ' || (c >= '\t' && c <= '\r')) << i;
+    masks.digits |= static_cast<std::uint64_t>(c >= '0' && c <= '9') << i;
+  }
+
+  return masks;
+}
+
+#ifdef HAVE_X86_SIMD
+
+///
+/// Classify a block of input bytes, 16 bytes at a time using SSE2 (which every x86-64 processor supports).
+///
+/// Range checks use a wrapping subtraction and a saturating subtraction: `c` is in `[lo, lo + n]` if `(c - lo) -sat n` is zero.
+///
+[[nodiscard]] BlockMasks classify_sse2(const char* block) {
+  const auto in_range = [](__m128i v, char lo, char n) {
+    return _mm_cmpeq_epi8(_mm_subs_epu8(_mm_sub_epi8(v, _mm_set1_epi8(lo)), _mm_set1_epi8(n)), _mm_setzero_si128());
+  };
+
+  const auto to_mask = [](__m128i v, std::size_t i) { return static_cast<std::uint64_t>(static_cast<std::uint16_t>(_mm_movemask_epi8(v))) << (16 * i); };
+
+  BlockMasks masks;
+  for (std::size_t i = 0; i < BLOCK_SIZE / 16; i++) {
+    const __m128i v = _mm_loadu_si128(reinterpret_cast<const __m128i*>(block + (16 * i)));
+
+    masks.whitespace |= to_mask(_mm_or_si128(_mm_cmpeq_epi8(v, _mm_set1_epi8(' ')), in_range(v, '\t', '\r' - '\t')), i);
+    masks.digits |= to_mask(in_range(v, '0', 9), i);
+  }
+
+  return masks;
+}
+
+/// Classify a block of input bytes, 32 bytes at a time using AVX2. Only call this if the processor supports AVX2.
+[[gnu::target("avx2")]] [[nodiscard]] BlockMasks classify_avx2(const char* block) {
+  // No lambdas here: these would not inherit the target attribute.
+  const __m256i zero = _mm256_setzero_si256();
+
+  BlockMasks masks;
+  for (std::size_t i = 0; i < BLOCK_SIZE / 32; i++) {
+    const __m256i v = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(block + (32 * i)));
+
+    const __m256i space  = _mm256_cmpeq_epi8(v, _mm256_set1_epi8(' '));
+    const __m256i ctrl   = _mm256_cmpeq_epi8(_mm256_subs_epu8(_mm256_sub_epi8(v, _mm256_set1_epi8('\t')), _mm256_set1_epi8('\r' - '\t')), zero);
+    const __m256i digits = _mm256_cmpeq_epi8(_mm256_subs_epu8(_mm256_sub_epi8(v, _mm256_set1_epi8('0')), _mm256_set1_epi8(9)), zero);
+
+    masks.whitespace |= static_cast<std::uint64_t>(static_cast<std::uint32_t>(_mm256_movemask_epi8(_mm256_or_si256(space, ctrl)))) << (32 * i);
+    masks.digits |= static_cast<std::uint64_t>(static_cast<std::uint32_t>(_mm256_movemask_epi8(digits))) << (32 * i);
+  }
+
+  return masks;
+}
+
+#endif // HAVE_X86_SIMD
+
+/// Select the fastest classifier supported by the processor.
+[[nodiscard]] Classifier best_classifier() {
+#ifdef HAVE_X86_SIMD
+  return __builtin_cpu_supports("avx2") ? classify_avx2 : classify_sse2;
+#else
+  return classify_scalar;
+#endif
+}
+
+} // namespace
+
+///
+/// Structural index of the input text: the start and end offsets of all whitespace-separated tokens.
+///
+/// The input is classified in blocks of 64 bytes into bit masks, using SIMD instructions if available. The token starts are the
+/// non-whitespace bytes preceded by whitespace, and the token ends the whitespace bytes preceded by non-whitespace (carrying over the
+/// last bit between blocks). The offsets are extracted from the masks one set bit at a time. Per block, a mask of the "unusual" token
+/// bytes (neither digits nor whitespace) is kept, so tokens can be classified without looking at their bytes again in most cases.
+///
+struct TokenIndex {
+  TokenIndex() = default;
+
+  explicit TokenIndex(std::string_view input_, Classifier classify = best_classifier()) {
+    assign(input_, classify);
+  }
+
+  ///
+  /// Index new input text, reusing the storage of the previous index.
+  ///
+  /// \throws A `std::length_error` if the input is larger than 4 GiB.
+  ///
+  void assign(std::string_view input_, Classifier classify = best_classifier()) {
+    if (input_.size() > std::numeric_limits<std::uint32_t>::max()) {
+      throw std::length_error{"input too large -- at most 4 GiB is supported"};
+    }
+
+    input = input_;
+    non_digits.clear();
+    non_digits.reserve((input.size() / BLOCK_SIZE) + 1);
+
+    std::size_t   n_starts = 0;
+    std::size_t   n_ends   = 0;
+    std::uint64_t carry    = 0; // Indicates the last byte of the previous block was part of a token.
+    for (std::size_t offset = 0; offset < input.size(); offset += BLOCK_SIZE) {
+      BlockMasks masks;
+      if (input.size() - offset >= BLOCK_SIZE) {
+        masks = classify(input.data() + offset);
+      } else {
+        std::array<char, BLOCK_SIZE> tail;
+        tail.fill(' '); // Pad the last partial block with whitespace, which also ends the last token.
+        std::ranges::copy(input.substr(offset), tail.begin());
+        masks = classify(tail.data());
+      }
+
+      const std::uint64_t token = ~masks.whitespace;
+      const std::uint64_t after = (token << 1) | carry; // Bit i set if byte i - 1 is part of a token.
+      carry                     = token >> 63;
+
+      extract(token & ~after, offset, starts, n_starts);
+      extract(~token & after, offset, ends, n_ends);
+      non_digits.push_back(token & ~masks.digits);
+    }
+
+    starts.resize(n_starts);
+    ends.resize(n_ends);
+
+    if (carry != 0) {
+      ends.push_back(static_cast<std::uint32_t>(input.size())); // The last token runs until the end of a full last block.
+    }
+  }
+
+  /// Number of tokens.
+  [[nodiscard]] std::size_t size() const {
+    return starts.size();
+  }
+
+  /// Count the bytes in the offset range [start, end) that are not digits (nor whitespace).
+  [[nodiscard]] unsigned int count_non_digits(std::size_t start, std::size_t end) const {
+    unsigned int count = 0;
+    for (std::size_t block = start / BLOCK_SIZE; block * BLOCK_SIZE < end; block++) {
+      std::uint64_t mask = non_digits[block];
+      if (block == start / BLOCK_SIZE) {
+        mask &= ~std::uint64_t{0} << (start % BLOCK_SIZE);
+      }
+
+      if ((block + 1) * BLOCK_SIZE > end) {
+        mask &= ~(~std::uint64_t{0} << (end % BLOCK_SIZE));
+      }
+
+      count += static_cast<unsigned int>(std::popcount(mask));
+    }
+
+    return count;
+  }
+
+  std::string_view           input;
+  std::vector<std::uint32_t> starts;     // Token start offsets.
+  std::vector<std::uint32_t> ends;       // Token end offsets (one past the last byte).
+  std::vector<std::uint64_t> non_digits; // Per block, the token bytes that are not digits.
+
+private:
+  ///
+  /// Write the offsets of all set bits in a mask to `offsets`, starting at index `count`.
+  ///
+  /// The vector is grown ahead by a full block, so the loop needs no bounds checks. The excess is trimmed when the index is complete.
+  ///
+  static void extract(std::uint64_t mask, std::size_t offset, std::vector<std::uint32_t>& offsets, std::size_t& count) {
+    if (offsets.size() < count + BLOCK_SIZE) {
+      offsets.resize(std::max(count + BLOCK_SIZE, 2 * offsets.size()));
+    }
+
+    for (; mask != 0; mask &= mask - 1) {
+      offsets[count++] = static_cast<std::uint32_t>(offset + static_cast<std::size_t>(std::countr_zero(mask)));
+    }
+  }
+};
+
+namespace {
+
+///
+/// Read the next token from a token index.
+///
+/// \param index Token index of the input.
+/// \param cursor Index of the next token to read, incremented on return.
+/// \param limit Offset in the input where the calculation ends, tokens from there on are not read.
+///
+/// \returns The read token.
+///
+[[nodiscard]] Token read_token(const TokenIndex& index, std::size_t& cursor, std::size_t limit = std::numeric_limits<std::size_t>::max()) {
+  if (cursor >= index.size() || index.starts[cursor] >= limit) {
+    return Tokens::Eoc{};
+  }
+
+  const std::size_t      start = index.starts[cursor];
+  const std::size_t      end   = index.ends[cursor];
+  const std::string_view input = index.input.substr(start, end - start);
+  cursor++;
+
+  const unsigned int non_digits = index.count_non_digits(start, end);
+
+  if (non_digits == 0) {
+    return Tokens::Operand{input}; // Positive number.
+  } else if ((non_digits == 1) && (input.length() > 1) && input.starts_with('-')) {
+    return Tokens::Operand{input}; // Negative number.
+  } else if ((input.length() == 1) && (OPERATORS.find(input[0]) != std::string::npos)) {
+    return Tokens::Operator{input[0]};
+  } else {
+    return Tokens::Invalid{};
+  }
+}
+
+///
+/// Reader of the input in chunks of bounded size, so the input need not fit in memory and is evaluated as it arrives.
+///
+/// Every chunk ends at a delimiter byte, so no token (or line) is cut in two: the bytes after the last delimiter are carried over to
+/// the next chunk. Only a token or line that does not fit in a chunk makes the chunk grow beyond the chunk size.
+///
+class InputReader {
+public:
+  /// Number of bytes read at a time.
+  static constexpr std::size_t CHUNK_SIZE = 1 << 16;
+
+  explicit InputReader(std::FILE* source = stdin)
+    : source_{source} {
+  }
+
+  /// Delimiter of tokens, the same bytes the token index takes for whitespace.
+  [[nodiscard]] static bool is_whitespace(char c) {
+    return c == ' ' || (c >= '\t' && c <= '\r');
+  }
+
+  /// Delimiter of lines.
+  [[nodiscard]] static bool is_newline(char c) {
+    return c == '\n';
+  }
+
+  ///
+  /// Read the next chunk of the input.
+  ///
+  /// \param is_delimiter Predicate for the bytes a chunk may end with.
+  /// \param full Wait for a full chunk (or the end of the input), rather than returning as soon as a delimiter arrives.
+  ///
+  /// \returns The chunk, valid until the next call. It is empty at the end of the input.
+  ///
+  /// \throws A `std::runtime_error` if reading fails.
+  ///
+  template<typename Predicate>
+  [[nodiscard]] std::string_view read(Predicate is_delimiter, bool full = false) {
+    buffer_.erase(0, chunk_size_); // Keep only the carried over bytes.
+    chunk_size_ = 0;
+
+    while (!end_ && (chunk_size_ == 0 || (full && buffer_.size() < CHUNK_SIZE))) {
+      const std::size_t scanned = buffer_.size();
+      buffer_.resize(scanned + CHUNK_SIZE);
+      buffer_.resize(scanned + read_some(buffer_.data() + scanned, CHUNK_SIZE));
+      end_ = (buffer_.size() == scanned);
+
+      const auto last = std::find_if(buffer_.rbegin(), buffer_.rend() - static_cast<std::ptrdiff_t>(scanned), is_delimiter);
+      if (last != buffer_.rend() - static_cast<std::ptrdiff_t>(scanned)) {
+        chunk_size_ = static_cast<std::size_t>(buffer_.rend() - last);
+      }
+    }
+
+    if (end_) {
+      chunk_size_ = buffer_.size(); // The rest of the input, if any.
+    }
+
+    return std::string_view{buffer_}.substr(0, chunk_size_);
+  }
+
+  /// Whether the last chunk read ends the input.
+  [[nodiscard]] bool at_end() const {
+    return end_;
+  }
+
+private:
+  /// Read at most `size` bytes, returning as soon as any are available (so interactive input is not held back).
+  [[nodiscard]] std::size_t read_some(char* data, std::size_t size) {
+#ifdef HAVE_POSIX_READ
+    ssize_t n = 0;
+    do {
+      n = ::read(fileno(source_), data, size);
+    } while (n < 0 && errno == EINTR);
+
+    if (n < 0) {
+      throw std::runtime_error{"failed to read input stream"};
+    }
+
+    return static_cast<std::size_t>(n);
+#else
+    // This waits for a full chunk, so interactive input is only evaluated once it ends.
+    const std::size_t n = std::fread(data, 1, size, source_);
+    if (std::ferror(source_) != 0) {
+      throw std::runtime_error{"failed to read input stream"};
+    }
+
+    return n;
+#endif
+  }
+
+  std::FILE*  source_;
+  std::string buffer_;         // The current chunk, followed by the carried over bytes.
+  std::size_t chunk_size_ = 0; // Size of the current chunk.
+  bool        end_        = false;
+};
+
+///
+/// Source of the tokens of the input, read one chunk at a time: the next chunk is indexed when the tokens of the previous are used up.
+///
+class TokenStream {
+public:
+  ///
+  /// \param reader Reader of the input.
+  /// \param chunk Chunk already read from it, if any.
+  ///
+  explicit TokenStream(InputReader& reader, std::string_view chunk = {})
+    : reader_{reader} {
+    index_.assign(chunk);
+  }
+
+  /// Read the next token, `Tokens::Eoc` at the end of the input.
+  [[nodiscard]] Token next() {
+    while (cursor_ >= index_.size()) {
+      const std::string_view chunk = reader_.read(InputReader::is_whitespace);
+      if (chunk.empty()) {
+        return Tokens::Eoc{};
+      }
+
+      index_.assign(chunk);
+      cursor_ = 0;
+    }
+
+    return read_token(index_, cursor_);
+  }
+
+private:
+  InputReader& reader_;
+  TokenIndex   index_;
+  std::size_t  cursor_ = 0;
+};
+
+} // namespace
+
+///
+/// Arbitrary-precision integer.
+///
+/// The value is stored as a sign and a magnitude, the latter as 32-bit limbs with the least significant limb first. This keeps the
+/// intermediate products and quotients of the limb arithmetic within 64 bits.
+///
+class BigInt {
+public:
+  BigInt() = default;
+
+  explicit BigInt(__int128 value)
+    : negative_{value < 0} {
+    for (auto magnitude = negative_ ? -static_cast<unsigned __int128>(value) : static_cast<unsigned __int128>(value); magnitude != 0; magnitude >>= 32) {
+      limbs_.push_back(static_cast<std::uint32_t>(magnitude));
+    }
+  }
+
+  /// Convert to a 128-bit integer, if the value fits.
+  [[nodiscard]] std::optional<__int128> to_int128() const {
+    if (limbs_.size() > 4) {
+      return std::nullopt;
+    }
+
+    unsigned __int128 magnitude = 0;
+    for (auto limb = limbs_.rbegin(); limb != limbs_.rend(); limb++) {
+      magnitude = (magnitude << 32) | *limb;
+    }
+
+    constexpr auto MAX = static_cast<unsigned __int128>(std::numeric_limits<__int128>::max());
+    if (magnitude > MAX + (negative_ ? 1 : 0)) {
+      return std::nullopt;
+    }
+
+    return static_cast<__int128>(negative_ ? -magnitude : magnitude);
+  }
+
+  [[nodiscard]] bool is_zero() const {
+    return limbs_.empty();
+  }
+
+  /// Decimal text representation.
+  [[nodiscard]] std::string to_string() const {
+    if (is_zero()) {
+      return "0";
+    }
+
+    // Split off nine decimal digits at a time, least significant first.
+    std::string digits;
+    for (Limbs magnitude = limbs_; !magnitude.empty();) {
+      auto chunk = divide(magnitude, 1'000'000'000);
+      for (int i = 0; i < 9 && (chunk != 0 || !magnitude.empty()); i++, chunk /= 10) {
+        digits += static_cast<char>('0' + (chunk % 10));
+      }
+    }
+
+    if (negative_) {
+      digits += '-';
+    }
+
+    std::ranges::reverse(digits);
+    return digits;
+  }
+
+  friend bool operator==(const BigInt&, const BigInt&) = default;
+
+  friend BigInt operator+(const BigInt& lhs, const BigInt& rhs) {
+    if (lhs.negative_ == rhs.negative_) {
+      return BigInt{lhs.negative_, add(lhs.limbs_, rhs.limbs_)};
+    } else if (compare(lhs.limbs_, rhs.limbs_) >= 0) {
+      return BigInt{lhs.negative_, subtract(lhs.limbs_, rhs.limbs_)};
+    } else {
+      return BigInt{rhs.negative_, subtract(rhs.limbs_, lhs.limbs_)};
+    }
+  }
+
+  friend BigInt operator-(const BigInt& lhs, const BigInt& rhs) {
+    BigInt negated = rhs;
+    negated.negative_ = !negated.negative_ && !negated.is_zero();
+    return lhs + negated;
+  }
+
+  friend BigInt operator*(const BigInt& lhs, const BigInt& rhs) {
+    Limbs product(lhs.limbs_.size() + rhs.limbs_.size());
+    for (std::size_t i = 0; i < lhs.limbs_.size(); i++) {
+      std::uint64_t carry = 0;
+      for (std::size_t j = 0; j < rhs.limbs_.size(); j++) {
+        const std::uint64_t p = (static_cast<std::uint64_t>(lhs.limbs_[i]) * rhs.limbs_[j]) + product[i + j] + carry;
+        product[i + j]        = static_cast<std::uint32_t>(p);
+        carry                 = p >> 32;
+      }
+
+      product[i + rhs.limbs_.size()] = static_cast<std::uint32_t>(carry);
+    }
+
+    return BigInt{lhs.negative_ != rhs.negative_, std::move(product)};
+  }
+
+  /// Division, truncating toward zero like the built-in integer division. The divisor must not be zero.
+  friend BigInt operator/(const BigInt& lhs, const BigInt& rhs) {
+    return BigInt{lhs.negative_ != rhs.negative_, divide(lhs.limbs_, rhs.limbs_).first};
+  }
+
+  /// Remainder, with the sign of the dividend like the built-in integer modulo. The divisor must not be zero.
+  friend BigInt operator%(const BigInt& lhs, const BigInt& rhs) {
+    return BigInt{lhs.negative_, divide(lhs.limbs_, rhs.limbs_).second};
+  }
+
+private:
+  using Limbs = std::vector<std::uint32_t>;
+
+  BigInt(bool negative, Limbs&& limbs)
+    : limbs_{std::move(limbs)} {
+    while (!limbs_.empty() && limbs_.back() == 0) {
+      limbs_.pop_back();
+    }
+
+    negative_ = negative && !limbs_.empty(); // There is no negative zero.
+  }
+
+  /// Compare two magnitudes, returning a negative value, zero or a positive value.
+  [[nodiscard]] static int compare(const Limbs& lhs, const Limbs& rhs) {
+    if (lhs.size() != rhs.size()) {
+      return (lhs.size() < rhs.size()) ? -1 : 1;
+    }
+
+    for (std::size_t i = lhs.size(); i-- > 0;) {
+      if (lhs[i] != rhs[i]) {
+        return (lhs[i] < rhs[i]) ? -1 : 1;
+      }
+    }
+
+    return 0;
+  }
+
+  [[nodiscard]] static Limbs add(const Limbs& lhs, const Limbs& rhs) {
+    Limbs         sum(std::max(lhs.size(), rhs.size()) + 1);
+    std::uint64_t carry = 0;
+    for (std::size_t i = 0; i < sum.size(); i++) {
+      carry += (i < lhs.size() ? lhs[i] : 0) + static_cast<std::uint64_t>(i < rhs.size() ? rhs[i] : 0);
+      sum[i] = static_cast<std::uint32_t>(carry);
+      carry >>= 32;
+    }
+
+    return sum;
+  }
+
+  /// Subtract magnitudes, where the left-hand side must not be smaller than the right-hand side.
+  [[nodiscard]] static Limbs subtract(const Limbs& lhs, const Limbs& rhs) {
+    Limbs        difference(lhs.size());
+    std::int64_t borrow = 0;
+    for (std::size_t i = 0; i < lhs.size(); i++) {
+      const std::int64_t d = static_cast<std::int64_t>(lhs[i]) - (i < rhs.size() ? rhs[i] : 0) - borrow;
+      difference[i]        = static_cast<std::uint32_t>(d);
+      borrow               = (d < 0) ? 1 : 0;
+    }
+
+    return difference;
+  }
+
+  /// Divide a magnitude in place by a single limb, returning the remainder.
+  static std::uint32_t divide(Limbs& magnitude, std::uint32_t divisor) {
+    std::uint64_t remainder = 0;
+    for (std::size_t i = magnitude.size(); i-- > 0;) {
+      const std::uint64_t n = (remainder << 32) | magnitude[i];
+      magnitude[i]          = static_cast<std::uint32_t>(n / divisor);
+      remainder             = n % divisor;
+    }
+
+    while (!magnitude.empty() && magnitude.back() == 0) {
+      magnitude.pop_back();
+    }
+
+    return static_cast<std::uint32_t>(remainder);
+  }
+
+  ///
+  /// Divide magnitudes, returning the quotient and remainder.
+  ///
+  /// This is Knuth's algorithm D (The Art of Computer Programming, volume 2, section 4.3.1): long division estimating each quotient limb from
+  /// the leading limbs, after normalizing the divisor so its most significant bit is set. The estimate is then at most two too large.
+  ///
+  [[nodiscard]] static std::pair<Limbs, Limbs> divide(const Limbs& lhs, const Limbs& rhs) {
+    if (compare(lhs, rhs) < 0) {
+      return {{}, lhs};
+    } else if (rhs.size() == 1) {
+      Limbs               quotient  = lhs;
+      const std::uint32_t remainder = divide(quotient, rhs[0]);
+      return {std::move(quotient), {remainder}};
+    }
+
+    const std::size_t n     = rhs.size();
+    const std::size_t m     = lhs.size() - n;
+    const int         shift = std::countl_zero(rhs.back());
+
+    const auto shifted = [shift](const Limbs& limbs, std::size_t size) {
+      Limbs result(size);
+      for (std::size_t i = 0; i < limbs.size(); i++) {
+        const std::uint64_t wide = static_cast<std::uint64_t>(limbs[i]) << shift;
+        result[i] |= static_cast<std::uint32_t>(wide);
+        if (i + 1 < size) {
+          result[i + 1] = static_cast<std::uint32_t>(wide >> 32);
+        }
+      }
+
+      return result;
+    };
+
+    const Limbs v = shifted(rhs, n);
+    Limbs       u = shifted(lhs, lhs.size() + 1);
+    Limbs       quotient(m + 1);
+
+    constexpr std::uint64_t BASE = std::uint64_t{1} << 32;
+    for (std::size_t j = m + 1; j-- > 0;) {
+      const std::uint64_t numerator = (static_cast<std::uint64_t>(u[j + n]) << 32) | u[j + n - 1];
+      std::uint64_t       qhat      = numerator / v[n - 1];
+      std::uint64_t       rhat      = numerator % v[n - 1];
+      while (qhat >= BASE || qhat * v[n - 2] > ((rhat << 32) | u[j + n - 2])) {
+        qhat--;
+        rhat += v[n - 1];
+        if (rhat >= BASE) {
+          break;
+        }
+      }
+
+      // Multiply and subtract.
+      std::int64_t borrow = 0;
+      std::int64_t t      = 0;
+      for (std::size_t i = 0; i < n; i++) {
+        const std::uint64_t p = qhat * v[i];
+        t                     = static_cast<std::int64_t>(u[i + j]) - borrow - static_cast<std::int64_t>(p & 0xFFFFFFFF);
+        u[i + j]              = static_cast<std::uint32_t>(t);
+        borrow                = static_cast<std::int64_t>(p >> 32) - (t >> 32);
+      }
+
+      t        = static_cast<std::int64_t>(u[j + n]) - borrow;
+      u[j + n] = static_cast<std::uint32_t>(t);
+
+      // The estimate was one too large, add back.
+      if (t < 0) {
+        qhat--;
+        std::uint64_t carry = 0;
+        for (std::size_t i = 0; i < n; i++) {
+          carry += static_cast<std::uint64_t>(u[i + j]) + v[i];
+          u[i + j] = static_cast<std::uint32_t>(carry);
+          carry >>= 32;
+        }
+
+        u[j + n] = static_cast<std::uint32_t>(u[j + n] + carry);
+      }
+
+      quotient[j] = static_cast<std::uint32_t>(qhat);
+    }
+
+    // Undo the normalization for the remainder.
+    Limbs remainder(n);
+    for (std::size_t i = 0; i < n; i++) {
+      remainder[i] = static_cast<std::uint32_t>(((static_cast<std::uint64_t>(u[i + 1]) << 32) | u[i]) >> shift);
+    }
+
+    return {std::move(quotient), std::move(remainder)};
+  }
+
+  bool  negative_ = false;
+  Limbs limbs_; // Magnitude, without most significant zero limbs.
+};
+
+///
+/// Integer of any size.
+///
+/// Values are stored as a `long` when they fit, as this is by far the most common case. Operations check for overflow using compiler
+/// builtins, and promote the value to a 128-bit integer, and then to a `BigInt` when required. Results are demoted to the smallest
+/// representation they fit in, so after an overflow the fast path is taken again.
+///
+/// The wide representations are kept out of line and shared between copies, so a `Number` holding a `long` is cheap to copy and move.
+///
+class Number {
+public:
+  Number(long value = 0)
+    : value_{value} {
+  }
+
+  // Copying and destroying a `long` only costs a check of the pointer, the reference counting of wide values is out of line.
+  Number(const Number& other) noexcept
+    : value_{other.value_}
+    , wide_{other.wide_} {
+    if (wide_ != nullptr) [[unlikely]] {
+      retain(wide_);
+    }
+  }
+
+  Number(Number&& other) noexcept
+    : value_{other.value_}
+    , wide_{std::exchange(other.wide_, nullptr)} {
+  }
+
+  Number& operator=(const Number& other) noexcept {
+    Number copy{other};
+    return *this = std::move(copy);
+  }
+
+  Number& operator=(Number&& other) noexcept {
+    std::swap(value_, other.value_);
+    std::swap(wide_, other.wide_);
+    return *this;
+  }
+
+  ~Number() {
+    if (wide_ != nullptr) [[unlikely]] {
+      release(wide_);
+    }
+  }
+
+  /// Check whether the value fits a `long`.
+  [[nodiscard]] bool is_long() const {
+    return wide_ == nullptr;
+  }
+
+  /// The value as a `long`, only valid if it fits.
+  [[nodiscard]] long to_long() const {
+    return value_;
+  }
+
+  /// Decimal text representation.
+  [[nodiscard]] std::string to_string() const {
+    if (is_long()) {
+      return std::to_string(value_);
+    }
+
+    return std::visit(overload{[](__int128 v) { return BigInt{v}.to_string(); }, [](const BigInt& v) { return v.to_string(); }}, wide_->value);
+  }
+
+  friend bool operator==(const Number& lhs, const Number& rhs) {
+    if (lhs.is_long() || rhs.is_long()) {
+      return lhs.is_long() && rhs.is_long() && lhs.value_ == rhs.value_;
+    }
+
+    return lhs.wide_->value == rhs.wide_->value;
+  }
+
+  friend Number operator+(const Number& lhs, const Number& rhs) {
+    return apply(lhs, rhs, [](auto a, auto b, auto& r) { return __builtin_add_overflow(a, b, &r); }, std::plus{});
+  }
+
+  friend Number operator-(const Number& lhs, const Number& rhs) {
+    return apply(lhs, rhs, [](auto a, auto b, auto& r) { return __builtin_sub_overflow(a, b, &r); }, std::minus{});
+  }
+
+  friend Number operator*(const Number& lhs, const Number& rhs) {
+    return apply(lhs, rhs, [](auto a, auto b, auto& r) { return __builtin_mul_overflow(a, b, &r); }, std::multiplies{});
+  }
+
+  /// Division, the divisor must not be zero.
+  friend Number operator/(const Number& lhs, const Number& rhs) {
+    return apply(lhs, rhs, [](auto a, auto b, auto& r) { return overflowing_division(a, b, r, std::divides{}); }, std::divides{});
+  }
+
+  /// Modulo, the divisor must not be zero.
+  friend Number operator%(const Number& lhs, const Number& rhs) {
+    return apply(lhs, rhs, [](auto a, auto b, auto& r) { return overflowing_division(a, b, r, std::modulus{}); }, std::modulus{});
+  }
+
+private:
+  using Wide = std::variant<__int128, BigInt>;
+
+  /// A wide value, with the number of `Number`s sharing it.
+  struct Shared {
+    std::atomic<std::size_t> references{1};
+    const Wide               value;
+  };
+
+  explicit Number(Wide&& value)
+    : wide_{new Shared{.value = std::move(value)}} {
+  }
+
+  [[gnu::noinline]] static void retain(Shared* shared) {
+    shared->references.fetch_add(1, std::memory_order_relaxed);
+  }
+
+  [[gnu::noinline]] static void release(Shared* shared) {
+    if (shared->references.fetch_sub(1, std::memory_order_acq_rel) == 1) {
+      delete shared;
+    }
+  }
+
+  /// Divide (or take the modulo), unless this overflows: only the most negative value divided by minus one does.
+  template<typename T>
+  static bool overflowing_division(T a, T b, T& result, std::invocable<T, T> auto&& divide) {
+    if (a == std::numeric_limits<T>::min() && b == -1) {
+      return true;
+    }
+
+    result = divide(a, b);
+    return false;
+  }
+
+  /// The value as a 128-bit integer, if it fits.
+  [[nodiscard]] std::optional<__int128> to_int128() const {
+    if (is_long()) {
+      return value_;
+    } else if (const auto* v = std::get_if<__int128>(&wide_->value)) {
+      return *v;
+    }
+
+    return std::nullopt;
+  }
+
+  /// The value as an arbitrary-precision integer.
+  [[nodiscard]] BigInt to_big() const {
+    if (const auto* b = is_long() ? nullptr : std::get_if<BigInt>(&wide_->value)) {
+      return *b;
+    }
+
+    return BigInt{*to_int128()};
+  }
+
+  /// Demote a 128-bit integer to a `long`, if it fits.
+  [[nodiscard]] static Number demote(__int128 value) {
+    if (value >= std::numeric_limits<long>::min() && value <= std::numeric_limits<long>::max()) {
+      return Number{static_cast<long>(value)};
+    }
+
+    return Number{Wide{value}};
+  }
+
+  ///
+  /// Apply an operation, in the smallest representation it does not overflow in.
+  ///
+  /// \param checked Function applying the operation to `long` or `__int128` values, returning true on overflow.
+  /// \param big Function applying the operation to `BigInt` values.
+  ///
+  [[nodiscard]] static Number apply(const Number& lhs, const Number& rhs, auto&& checked, auto&& big) {
+    if (lhs.is_long() && rhs.is_long()) [[likely]] {
+      long result{};
+      if (!checked(lhs.value_, rhs.value_, result)) [[likely]] {
+        return Number{result};
+      }
+    }
+
+    return promoted(lhs, rhs, checked, big);
+  }
+
+  /// Apply an operation to promoted values. Kept out of line, so the fast path of `apply` is inlined into the callers.
+  [[gnu::noinline]] [[nodiscard]] static Number promoted(const Number& lhs, const Number& rhs, auto&& checked, auto&& big) {
+    if (const auto a = lhs.to_int128(), b = rhs.to_int128(); a && b) {
+      __int128 result{};
+      if (!checked(*a, *b, result)) {
+        return demote(result);
+      }
+    }
+
+    BigInt result = big(lhs.to_big(), rhs.to_big());
+    if (const auto v = result.to_int128()) {
+      return demote(*v);
+    }
+
+    return Number{Wide{std::move(result)}};
+  }
+
+  long    value_ = 0;       // The value, if it fits a `long`.
+  Shared* wide_  = nullptr; // Otherwise the value, in the smallest representation it fits.
+};
+
+///
+/// Buffered writer for calculation results.
+///
+/// Values are formatted with `std::to_chars` (which is locale-independent, and gives the shortest round-trip representation for
+/// floating-point values) directly into a large buffer, which is written out when full. In fixed-width mode values are right-aligned
+/// to a minimum width.
+///
+/// Without a sink the buffer grows as needed, and the text is taken out with `text` and `erase`.
+///
+class ResultWriter {
+public:
+  explicit ResultWriter(std::FILE* sink = stdout, std::size_t width = 0)
+    : sink_{sink}
+    , width_{width}
+    , buffer_((sink != nullptr) ? BUFFER_SIZE : 0) {
+  }
+
+  ResultWriter(const ResultWriter&)            = delete;
+  ResultWriter& operator=(const ResultWriter&) = delete;
+
+  ~ResultWriter() {
+    // Errors cannot be reported from here, call `flush` first to see those.
+    if (sink_ != nullptr) {
+      std::fwrite(buffer_.data(), 1, size_, sink_);
+    }
+  }
+
+  /// Write a result value line.
+  template<signed_arithmetic T>
+  void value(T v) {
+    std::array<char, MAX_VALUE_SIZE> text;
+    const auto [ptr, error] = std::to_chars(text.data(), text.data() + text.size(), v);
+    if (error != std::errc{}) {
+      throw std::logic_error{"failed to format result value"};
+    }
+
+    line({text.data(), static_cast<std::size_t>(ptr - text.data())});
+  }
+
+  /// Write a result value line, for a value of any size.
+  void value(const Number& v) {
+    if (v.is_long()) [[likely]] {
+      value(v.to_long());
+    } else {
+      line(v.to_string());
+    }
+  }
+
+  /// Write an error message line.
+  void error(std::string_view message) {
+    constexpr std::string_view PREFIX = "Error: ";
+
+    reserve(PREFIX.size() + message.size() + 1);
+    for (const auto part : {PREFIX, message, std::string_view{"\n"}}) {
+      std::memcpy(buffer_.data() + size_, part.data(), part.size());
+      size_ += part.size();
+    }
+
+    lines_++;
+  }
+
+  ///
+  /// Write out the buffered lines.
+  ///
+  /// \throws A `std::runtime_error` if writing fails, and a `std::logic_error` without a sink.
+  ///
+  void flush() {
+    if (sink_ == nullptr) {
+      throw std::logic_error{"no sink to write output to"};
+    }
+
+    if (std::fwrite(buffer_.data(), 1, size_, sink_) != size_ || std::fflush(sink_) != 0) {
+      throw std::runtime_error{"failed to write output"};
+    }
+
+    size_ = 0;
+  }
+
+  /// Number of lines written.
+  [[nodiscard]] std::size_t lines() const {
+    return lines_;
+  }
+
+  /// The buffered text.
+  [[nodiscard]] std::string_view text() const {
+    return {buffer_.data(), size_};
+  }
+
+  /// Remove text from the start of the buffer, after it was written out elsewhere.
+  void erase(std::size_t count) {
+    count = std::min(count, size_);
+    std::memmove(buffer_.data(), buffer_.data() + count, size_ - count);
+    size_ -= count;
+  }
+
+private:
+  static constexpr std::size_t BUFFER_SIZE    = 1 << 20; // In [bytes].
+  static constexpr std::size_t MAX_VALUE_SIZE = 64;      // Longest formatted value in [characters], for any arithmetic type.
+
+  /// Write a line of text, right-aligned in fixed-width mode.
+  void line(std::string_view text) {
+    const auto pad = std::max(width_, text.size()) - text.size();
+
+    reserve(pad + text.size() + 1);
+    std::memset(buffer_.data() + size_, ' ', pad);
+    std::memcpy(buffer_.data() + size_ + pad, text.data(), text.size());
+    size_ += pad + text.size();
+    buffer_[size_++] = '\n';
+    lines_++;
+  }
+
+  /// Make room for a line of a given size, flushing the buffer or growing it for extremely long lines (or without a sink).
+  void reserve(std::size_t size) {
+    if (size_ + size > buffer_.size()) {
+      if (sink_ != nullptr) {
+        flush();
+        buffer_.resize(std::max(buffer_.size(), size));
+      } else {
+        buffer_.resize(std::max(2 * buffer_.size(), size_ + size));
+      }
+    }
+  }
+
+  std::FILE*        sink_;
+  std::size_t       width_;
+  std::vector<char> buffer_;
+  std::size_t       size_  = 0;
+  std::size_t       lines_ = 0;
+};
+
+namespace {
+
+///
+/// Measure the token index throughput for all classifiers available, on generated expression text.
+///
+void benchmark_tokenizer() {
+  constexpr std::size_t SIZE = 64 << 20;
+  constexpr int         RUNS = 5;
+
+  std::mt19937                       rng{42};
+  std::uniform_int_distribution<int> length{1, 19};
+  std::uniform_int_distribution<int> digit{0, 9};
+
+  std::string text;
+  text.reserve(SIZE + 64);
+  while (text.size() < SIZE) {
+    for (int i = length(rng); i > 0; i--) {
+      text += static_cast<char>('0' + digit(rng));
+    }
+
+    text += (digit(rng) < 5) ? " + " : " * ";
+    if (digit(rng) == 0) {
+      text += '\n';
+    }
+  }
+
+  std::vector<std::pair<const char*, Classifier>> classifiers{{"scalar", classify_scalar}};
+#ifdef HAVE_X86_SIMD
+  classifiers.emplace_back("sse2", classify_sse2);
+  if (__builtin_cpu_supports("avx2")) {
+    classifiers.emplace_back("avx2", classify_avx2);
+  }
+#endif
+
+  for (const auto& [name, classifier] : classifiers) {
+    auto       best = std::chrono::duration<double>::max();
+    TokenIndex index; // Reused, so the runs after the first measure tokenizing rather than page faults.
+    for (int run = 0; run < RUNS; run++) {
+      const auto t_start = std::chrono::steady_clock::now();
+      index.assign(text, classifier);
+      best = std::min(best, std::chrono::duration<double>(std::chrono::steady_clock::now() - t_start));
+    }
+
+    fmt::print("{:>6}: {:6.2f} GB/s ({} tokens in {} MiB)\n", name, static_cast<double>(text.size()) / best.count() / 1e9, index.size(), text.size() >> 20);
+  }
+}
+
+///
+/// Perform a calculation given two input values and an operator.
+///
+/// \note For the built-in integer types there is no overflow handling in place! Use `Number` values for that, or `checked_calculate`.
+///
+/// \param lhs Left-hand side input value.
+/// \param lhs Right-hand side input value.
+/// \param lhs Operator.
+///
+/// \returns Calculation result.
+///
+/// \throws An exception if an unsupported operator is specified.
+///
+template<typename T>
+[[nodiscard]] constexpr T calculate(T lhs, T rhs, char op) {
+  switch (op) {
+  case '+': return lhs + rhs;
+  case '-': return lhs - rhs;
+  case '*': return lhs * rhs;
+  case '/':
+    if (rhs == 0) {
+      throw calculation_error{"division by zero"};
+    }
+
+    return lhs / rhs;
+  case '%':
+    if constexpr (!std::is_floating_point_v<T>) {
+      if (rhs == 0) {
+        throw calculation_error{"division by zero"};
+      }
+
+      return lhs % rhs;
+    }
+  default: throw std::invalid_argument{"unsupported operator"};
+  }
+}
+
+///
+/// Perform a calculation on `long` values, checking for overflow.
+///
+/// \param lhs Left-hand side input value.
+/// \param lhs Right-hand side input value.
+/// \param lhs Operator.
+///
+/// \returns Calculation result, or nothing if it overflows.
+///
+/// \throws An exception if an unsupported operator is specified, or on division by zero.
+///
+[[nodiscard]] constexpr std::optional<long> checked_calculate(long lhs, long rhs, char op) {
+  long result{};
+  bool overflow{};
+  switch (op) {
+  case '+': overflow = __builtin_add_overflow(lhs, rhs, &result); break;
+  case '-': overflow = __builtin_sub_overflow(lhs, rhs, &result); break;
+  case '*': overflow = __builtin_mul_overflow(lhs, rhs, &result); break;
+  case '/':
+  case '%':
+    if (rhs == 0) {
+      throw calculation_error{"division by zero"};
+    }
+
+    // Only the most negative value divided by minus one overflows. The remainder is zero, but the hardware traps on it as well.
+    if (rhs == -1) {
+      overflow = (op == '/') && __builtin_sub_overflow(0L, lhs, &result);
+    } else {
+      result = (op == '/') ? lhs / rhs : lhs % rhs;
+    }
+    break;
+  default: throw std::invalid_argument{"unsupported operator"};
+  }
+
+  return overflow ? std::nullopt : std::optional{result};
+}
+
+///
+/// Classify a token, like `read_token` does.
+///
+/// \param token The token text, without whitespace.
+///
+/// \returns The token.
+///
+[[nodiscard]] constexpr Token classify_token(std::string_view token) {
+  const auto is_digit = [](char c) { return c >= '0' && c <= '9'; };
+
+  if (token.empty()) {
+    return Tokens::Eoc{};
+  } else if (std::ranges::all_of(token, is_digit)) {
+    return Tokens::Operand{token}; // Positive number.
+  } else if ((token.length() > 1) && token.starts_with('-') && std::ranges::all_of(token.substr(1), is_digit)) {
+    return Tokens::Operand{token}; // Negative number.
+  } else if ((token.length() == 1) && (OPERATORS.find(token[0]) != std::string::npos)) {
+    return Tokens::Operator{token[0]};
+  } else {
+    return Tokens::Invalid{};
+  }
+}
+
+///
+/// Take the next whitespace-separated token from a calculation.
+///
+/// \param calculation The calculation text, the token is removed from it on return.
+///
+/// \returns The token.
+///
+[[nodiscard]] constexpr Token take_token(std::string_view& calculation) {
+  constexpr std::string_view WHITESPACE = " \t\n\v\f\r";
+
+  calculation.remove_prefix(std::min(calculation.find_first_not_of(WHITESPACE), calculation.size()));
+  const std::string_view token = calculation.substr(0, calculation.find_first_of(WHITESPACE));
+  calculation.remove_prefix(token.size());
+
+  return classify_token(token);
+}
+
+///
+/// Evaluate a calculation at compile time.
+///
+/// This follows the same steps as the state machine in `evaluate`. As throwing is not allowed in a constant expression, a malformed
+/// calculation or a division by zero is a compile error. So is signed integer overflow, which is undefined behavior.
+///
+/// \param calculation The calculation text.
+///
+/// \returns The result.
+///
+template<std::signed_integral T = long>
+[[nodiscard]] consteval T evaluate_constant(std::string_view calculation) {
+  Stack<T, 2> m;
+  bool        got_operator = false;
+
+  const auto push_operand = [&](const Token& t) {
+    if (!std::holds_alternative<Tokens::Operand>(t)) {
+      throw calculation_error{"expected operand"};
+    }
+
+    m.push(std::get<Tokens::Operand>(t).parse<T>());
+  };
+
+  push_operand(take_token(calculation));
+  for (;;) {
+    const Token t = take_token(calculation);
+    if (std::holds_alternative<Tokens::Eoc>(t) && got_operator) {
+      return m.pop().value();
+    }
+
+    push_operand(t);
+
+    const Token o = take_token(calculation);
+    if (!std::holds_alternative<Tokens::Operator>(o)) {
+      throw calculation_error{"expected operator"};
+    }
+
+    const auto rhs = m.pop().value();
+    const auto lhs = m.pop().value();
+    m.push(calculate(lhs, rhs, std::get<Tokens::Operator>(o).op));
+
+    got_operator = true;
+  }
+}
+
+///
+/// Literal for calculations evaluated at compile time, like `"4 5 * 2 -"_rpn`.
+///
+/// \returns The result as a `long`.
+///
+consteval long operator""_rpn(const char* calculation, std::size_t size) {
+  return evaluate_constant(std::string_view{calculation, size});
+}
+
+static_assert("4 5 * 5 * 30 - 2 /"_rpn == 35);
+static_assert("-9223372036854775807 1 -"_rpn == std::numeric_limits<long>::min());
+static_assert(evaluate_constant<int>("\t7\n2 %  ") == 1);
+
+///
+/// Measure the operand parsing throughput of `std::from_chars` and `Tokens::Operand::parse` for a number of digit-length distributions.
+///
+void benchmark_parse() {
+  constexpr std::size_t COUNT = 1 << 20;
+  constexpr int         RUNS  = 5;
+
+  struct Distribution {
+    const char*            name;
+    std::array<double, 19> weights; // Relative frequency of 1 to 19 digit operands.
+  };
+
+  const std::array distributions{
+    Distribution{"short (1-4 digits)", {4, 4, 2, 1}},
+    Distribution{"mixed (1-19 digits)", {8, 8, 6, 5, 4, 3, 3, 2, 2, 2, 1, 1, 1, 1, 1, 1, 1, 1, 1}}, // Mostly small numbers with a tail.
+    Distribution{"long (15-19 digits)", {0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 1, 1, 1, 1, 1}},
+  };
+
+  using Parser = long (*)(std::string_view);
+
+  const std::array<std::pair<const char*, Parser>, 3> parsers{{
+    {"from_chars<long>",
+     [](std::string_view value) {
+       long v{};
+       std::from_chars(value.data(), value.data() + value.size(), v);
+       return v;
+     }},
+    {"from_chars<long double>",
+     [](std::string_view value) {
+       long double v{};
+       std::from_chars(value.data(), value.data() + value.size(), v);
+       return static_cast<long>(v);
+     }},
+    {"Operand::parse<long>", [](std::string_view value) { return Tokens::Operand{value}.parse<long>(); }},
+  }};
+
+  std::mt19937                       rng{42};
+  std::uniform_int_distribution<int> digit{0, 9};
+
+  for (const auto& distribution : distributions) {
+    std::discrete_distribution<std::size_t> length{distribution.weights.begin(), distribution.weights.end()};
+
+    // Operands refer into one text, separated by spaces like real input.
+    std::string text;
+    text.reserve(COUNT * 21);
+    std::vector<std::string_view> operands;
+    operands.reserve(COUNT);
+    for (std::size_t i = 0; i < COUNT; i++) {
+      const std::size_t start = text.size();
+      if (digit(rng) < 3) {
+        text += '-';
+      }
+
+      text += static_cast<char>('1' + (digit(rng) % 8)); // Keeps 19-digit operands within the range of long.
+      for (std::size_t n = length(rng); n > 0; n--) {
+        text += static_cast<char>('0' + digit(rng));
+      }
+
+      operands.emplace_back(text.data() + start, text.size() - start);
+      text += ' ';
+    }
+
+    fmt::print("{}:\n", distribution.name);
+
+    long reference = 0;
+    for (const auto& [name, parser] : parsers) {
+      auto best = std::chrono::duration<double>::max();
+      long sum  = 0;
+      for (int run = 0; run < RUNS; run++) {
+        sum                = 0;
+        const auto t_start = std::chrono::steady_clock::now();
+        for (const auto operand : operands) {
+          sum += parser(operand) % 1000; // Keeps the sum from overflowing.
+        }
+
+        best = std::min(best, std::chrono::duration<double>(std::chrono::steady_clock::now() - t_start));
+      }
+
+      if (name == parsers[0].first) {
+        reference = sum;
+      }
+
+      fmt::print("  {:>24}: {:6.2f} ns/operand{}\n", name, best.count() * 1e9 / COUNT, (sum == reference) ? "" : " (results differ!)");
+    }
+  }
+}
+
+} // namespace
+
+/// The stack memory type, for a given value type.
+template<typename T>
+using Memory = Stack<T, 2>;
+
+namespace {
+
+///
+/// Evaluate a calculation, writing the result or error message.
+///
+/// \param next_token Source of the tokens of the calculation, returning `Tokens::Eoc` at its end.
+/// \param out Writer for the result.
+///
+/// \tparam T Value type for the calculation, by default values of any size.
+///
+template<typename T = Number>
+void evaluate(std::invocable auto&& next_token, ResultWriter& out) {
+  bool      stop         = false;
+  bool      got_operator = false;
+  State     s            = States::Operand1{};
+  Memory<T> m;
+
+  while (!stop) {
+    const Token t = next_token();
+
+    try {
+      // clang-format off
+      std::visit(overload{
+        [&](States::Operand1&) {
+          std::visit(overload{
+            [&](const Tokens::Operand& o) {
+              m.push(T{o.parse<long>()});
+              s = States::Operand2{};
+            },
+            [](const Tokens::Operator&) { throw calculation_error{"expected operand 1, got operator"};           },
+            [](const Tokens::Eoc&)      { throw calculation_error{"expected operand 1, got end-of-calculation"}; },
+            [](const Tokens::Invalid&)  { throw calculation_error{"expected operand 1, got invalid token"};      }
+          }, t);
+        },
+        [&](States::Operand2&) {
+          std::visit(overload{
+            [&](const Tokens::Operand& o) {
+              m.push(T{o.parse<long>()});
+              s = States::Operator{};
+            },
+            [&](const Tokens::Eoc&) {
+              if (got_operator) {
+                s = States::Result{};
+              } else {
+                throw calculation_error{"expected operand 2, got end-of-calculation"};
+              }
+            },
+            [](const Tokens::Operator&) { throw calculation_error{"expected operand 2, got operator"};      },
+            [](const Tokens::Invalid&)  { throw calculation_error{"expected operand 2, got invalid token"}; }
+          }, t);
+        },
+        [&](States::Operator&) {
+          std::visit(overload{
+            [&](const Tokens::Operator& o) {
+              if (m.size() != 2) {
+                throw std::logic_error{"expected two elements in memory"};
+              }
+
+              const auto rhs = m.pop().value();
+              const auto lhs = m.pop().value();
+              m.push(calculate(lhs, rhs, o.op));
+
+              got_operator = true;
+              s = States::Operand2{};
+            },
+            [](const Tokens::Operand&) { throw calculation_error{"expected operator, got operand"};            },
+            [](const Tokens::Eoc&)     { throw calculation_error{"expected operator, got end-of-calculation"}; },
+            [](const Tokens::Invalid&) { throw calculation_error{"expected operator, got invalid token"};      }
+          }, t);
+        },
+        [&](States::Result&) {
+          if (m.size() != 1) {
+            throw std::logic_error{"expected only a single result in memory"};
+          }
+
+          out.value(m.pop().value());
+
+          stop = true; // Bail out.
+        }
+      }, s);
+      // clang-format on
+    } catch (const calculation_error& e) {
+      out.error(e.what());
+      stop = true;
+    }
+  }
+}
+
+///
+/// Evaluate a calculation in a token index, writing the result or error message.
+///
+/// \param index Token index of the input.
+/// \param cursor Index of the first token of the calculation, on return the index of the token where evaluation stopped.
+/// \param limit Offset in the input where the calculation ends.
+/// \param out Writer for the result.
+///
+/// \tparam T Value type for the calculation, by default values of any size.
+///
+template<typename T = Number>
+void evaluate(const TokenIndex& index, std::size_t& cursor, std::size_t limit, ResultWriter& out) {
+  evaluate<T>([&] { return read_token(index, cursor, limit); }, out);
+}
+
+///
+/// Measure the result output throughput of `std::ostream` and `ResultWriter`, writing to the null device.
+///
+void benchmark_output() {
+  constexpr std::size_t COUNT = 1 << 22;
+  constexpr int         RUNS  = 5;
+
+  std::mt19937                        rng{42};
+  std::uniform_int_distribution<int>  length{0, 18};
+  std::uniform_int_distribution<long> value{std::numeric_limits<long>::min(), std::numeric_limits<long>::max()};
+
+  std::vector<long> values(COUNT);
+  std::ranges::generate(values, [&] { return value(rng) / static_cast<long>(std::pow(10, length(rng))); }); // Mixed lengths.
+
+  // Both must produce the exact same text.
+  std::ostringstream expected;
+  for (const auto v : values) {
+    expected << v << '\n';
+  }
+
+  std::FILE* file = std::tmpfile();
+  if (file == nullptr) {
+    throw std::runtime_error{"failed to create temporary file"};
+  }
+
+  {
+    ResultWriter out{file};
+    for (const auto v : values) {
+      out.value(v);
+    }
+
+    out.flush();
+  }
+
+  std::string actual(expected.view().size(), '\0');
+  std::rewind(file);
+  const bool identical = (std::fread(actual.data(), 1, actual.size(), file) == actual.size()) && (std::fgetc(file) == EOF) && (actual == expected.view());
+  std::fclose(file);
+
+  fmt::print("Output {} to std::ostream\n", identical ? "identical" : "DIFFERS");
+
+  const auto measure = [&](const char* name, std::invocable<std::FILE*> auto&& write) {
+    std::FILE* null = std::fopen("/dev/null", "w");
+    if (null == nullptr) {
+      throw std::runtime_error{"failed to open the null device"};
+    }
+
+    auto best = std::chrono::duration<double>::max();
+    for (int run = 0; run < RUNS; run++) {
+      const auto t_start = std::chrono::steady_clock::now();
+      write(null);
+      best = std::min(best, std::chrono::duration<double>(std::chrono::steady_clock::now() - t_start));
+    }
+
+    std::fclose(null);
+
+    fmt::print("{:>26}: {:6.1f} M lines/s\n", name, COUNT / best.count() / 1e6);
+  };
+
+  measure("std::ostream", [&](std::FILE*) {
+    std::ofstream null{"/dev/null"};
+    for (const auto v : values) {
+      null << v << '\n';
+    }
+  });
+
+  measure("ResultWriter", [&](std::FILE* null) {
+    ResultWriter out{null};
+    for (const auto v : values) {
+      out.value(v);
+    }
+
+    out.flush();
+  });
+
+  measure("ResultWriter (fixed width)", [&](std::FILE* null) {
+    ResultWriter out{null, 20};
+    for (const auto v : values) {
+      out.value(v);
+    }
+
+    out.flush();
+  });
+}
+
+///
+/// Measure the arithmetic throughput of unchecked `long` values, overflow-checked `long` values and `Number` values on values that do not
+/// overflow, for single operations and for complete calculations.
+///
+void benchmark_arithmetic() {
+  constexpr std::size_t COUNT = 1 << 22;
+  constexpr int         RUNS  = 7;
+
+  std::mt19937                        rng{42};
+  std::uniform_int_distribution<long> operand{-1'000'000'000, 1'000'000'000}; // Products fit.
+
+  std::vector<long> lhs(COUNT);
+  std::vector<long> rhs(COUNT);
+  std::ranges::generate(lhs, [&] { return operand(rng); });
+  std::ranges::generate(rhs, [&] {
+    const long value = operand(rng);
+    return (value == 0) ? 1 : value; // No divisions by zero.
+  });
+
+  // Runs of the variants alternate, so all are affected alike by frequency scaling and other processes.
+  const auto measure = [&](const char* unit, std::size_t count, const auto&... variants) {
+    std::array best{(static_cast<void>(variants), std::chrono::duration<double>::max())...};
+    for (int run = 0; run < RUNS; run++) {
+      std::size_t i = 0;
+      (
+        [&] {
+          const auto t_start = std::chrono::steady_clock::now();
+          variants.second();
+          best[i] = std::min(best[i], std::chrono::duration<double>(std::chrono::steady_clock::now() - t_start));
+          i++;
+        }(),
+        ...);
+    }
+
+    std::size_t i = 0;
+    ((fmt::print("{:>30}: {:7.1f} M {}/s\n", variants.first, static_cast<double>(count) / best[i].count() / 1e6, unit), i++), ...);
+  };
+
+  // Divisions take tens of cycles each, which hides most of the differences. So measure with and without.
+  for (const std::string_view set : {"+-*", "+-*/%"}) {
+    std::uniform_int_distribution<std::size_t> op{0, set.size() - 1};
+
+    std::string operators(COUNT, '\0');
+    std::ranges::generate(operators, [&] { return set[op(rng)]; });
+
+    std::array<unsigned long, 3> sums{};
+    const auto                   operations = [&](std::size_t variant, std::invocable<long, long, char> auto&& calculation) {
+      return [&, variant] {
+        unsigned long sum = 0;
+        for (std::size_t i = 0; i < COUNT; i++) {
+          sum += static_cast<unsigned long>(calculation(lhs[i], rhs[i], operators[i])); // Unsigned, so the sum wraps around.
+        }
+
+        sums[variant] = sum;
+      };
+    };
+
+    fmt::print("Operations {} division:\n", (set.size() == 3) ? "without" : "with");
+    measure("operations", COUNT, std::pair{"unchecked long", operations(0, [](long a, long b, char o) { return calculate(a, b, o); })},
+            std::pair{"checked long", operations(1, [](long a, long b, char o) { return *checked_calculate(a, b, o); })},
+            std::pair{"Number", operations(2, [](long a, long b, char o) { return calculate(Number{a}, Number{b}, o).to_long(); })});
+
+    if (sums[1] != sums[0] || sums[2] != sums[0]) {
+      fmt::print("Results differ!\n");
+    }
+  }
+
+  // Complete calculations of a few small operands each, so the results do not overflow.
+  std::uniform_int_distribution<int> length{1, 6};
+  std::uniform_int_distribution<int> small{-50, 50};
+  std::uniform_int_distribution<int> op{0, 4};
+
+  std::string input;
+  std::size_t calculations = 0;
+  for (; input.size() < (16 << 20); calculations++) {
+    input += std::to_string(small(rng));
+    for (int i = length(rng); i > 0; i--) {
+      const int value = small(rng);
+      input += fmt::format(" {} {}", (value == 0) ? 1 : value, "+-*/%"[op(rng)]);
+    }
+
+    input += '\n';
+  }
+
+  const TokenIndex index{input};
+  std::FILE*       null = std::fopen("/dev/null", "w");
+  if (null == nullptr) {
+    throw std::runtime_error{"failed to open the null device"};
+  }
+
+  const auto calculate_lines = [&]<typename T>() {
+    return [&] {
+      ResultWriter out{null};
+      std::size_t  cursor = 0;
+      while (cursor < index.size()) {
+        const std::size_t limit = std::min(input.find('\n', index.starts[cursor]), input.size());
+        evaluate<T>(index, cursor, limit, out);
+        cursor = static_cast<std::size_t>(std::ranges::lower_bound(index.starts, limit) - index.starts.begin());
+      }
+
+      out.flush();
+    };
+  };
+
+  fmt::print("Calculations:\n");
+  measure("calculations", calculations, std::pair{"unchecked long", calculate_lines.operator()<long>()},
+          std::pair{"Number", calculate_lines.operator()<Number>()});
+
+  std::fclose(null);
+}
+
+} // namespace
+
+/// A valid calculation, ready for evaluation: the first operand, followed by pairs of an operand and an operator.
+struct Program {
+  std::vector<long> operands;
+  std::string       operators; // The "shape" of the calculation, operands.size() == operators.size() + 1.
+};
+
+namespace {
+
+///
+/// Compile a calculation into a program.
+///
+/// \param index Token index of the input.
+/// \param cursor Index of the first token of the calculation.
+/// \param limit Offset in the input where the calculation ends.
+///
+/// \returns The program, or nothing if the calculation is not valid. The interpreter should evaluate those, for its error messages.
+///
+[[nodiscard]] std::optional<Program> compile(const TokenIndex& index, std::size_t cursor, std::size_t limit) {
+  Program program;
+
+  // Valid calculations are two operands, then alternating an operator and an operand, ending after an operator.
+  for (std::size_t position = 0;; position++) {
+    const Token t              = read_token(index, cursor, limit);
+    const bool  expect_operand = (position < 2) || (position % 2 == 1);
+
+    if (std::holds_alternative<Tokens::Eoc>(t) && (position >= 3) && (position % 2 == 1)) {
+      return program;
+    } else if (const auto* operand = std::get_if<Tokens::Operand>(&t); operand != nullptr && expect_operand) {
+      try {
+        program.operands.push_back(operand->parse<long>());
+      } catch (const calculation_error&) {
+        return std::nullopt;
+      }
+    } else if (const auto* op = std::get_if<Tokens::Operator>(&t); op != nullptr && !expect_operand) {
+      program.operators += op->op;
+    } else {
+      return std::nullopt;
+    }
+  }
+}
+
+///
+/// Evaluate a program one operator at a time.
+///
+/// \param operators The operators of the program.
+/// \param operands The operands of the program, one more than there are operators.
+///
+/// \returns The result, or nothing if it overflows. The state machine should evaluate those, as it handles values of any size.
+///
+/// \throws A `calculation_error` on division by zero.
+///
+[[nodiscard]] std::optional<long> interpret(std::string_view operators, const long* operands) {
+  std::optional<long> value = operands[0];
+  for (std::size_t i = 0; i < operators.size() && value; i++) {
+    value = checked_calculate(*value, operands[i + 1], operators[i]);
+  }
+
+  return value;
+}
+
+/// Check whether an operation can fail, which is a division or modulo by zero.
+[[nodiscard]] bool can_fail(char op, long rhs) {
+  return (op == '/' || op == '%') && rhs == 0;
+}
+
+///
+/// Remove operations that do not change the value: adding or subtracting zero, and multiplying or dividing by one. Multiplying by zero
+/// makes the preceding operations irrelevant, these are removed as well unless they can fail.
+///
+/// \returns The number of operations removed.
+///
+std::size_t remove_identities(Program& program) {
+  Program result{{program.operands[0]}, {}};
+  bool    may_fail = false; // Indicates an operation in the result so far can fail.
+  for (std::size_t i = 0; i < program.operators.size(); i++) {
+    const char op  = program.operators[i];
+    const long rhs = program.operands[i + 1];
+
+    if (((op == '+' || op == '-') && rhs == 0) || ((op == '*' || op == '/') && rhs == 1)) {
+      continue;
+    } else if (op == '*' && rhs == 0 && !may_fail) {
+      result = Program{{0}, {}};
+      continue;
+    }
+
+    result.operands.push_back(rhs);
+    result.operators += op;
+    may_fail = may_fail || can_fail(op, rhs);
+  }
+
+  const std::size_t removed = program.operators.size() - result.operators.size();
+  program                   = std::move(result);
+  return removed;
+}
+
+///
+/// Fold operations on constant values into a single value, as far as the operations cannot fail.
+///
+/// As all operands are constant, this evaluates all operations up to the first division by zero. That one is kept, so the error still
+/// happens when the program is evaluated. The operations after it are removed, as these would never be evaluated. Folding also stops at
+/// the first operation that overflows, then that one and the operations after it are all kept.
+///
+/// \returns The number of operations removed.
+///
+std::size_t fold_constants(Program& program) {
+  std::size_t i     = 0;
+  long        value = program.operands[0];
+  for (; i < program.operators.size() && !can_fail(program.operators[i], program.operands[i + 1]); i++) {
+    const auto folded = checked_calculate(value, program.operands[i + 1], program.operators[i]);
+    if (!folded) {
+      break;
+    }
+
+    value = *folded;
+  }
+
+  Program result{{value}, {}};
+  const std::size_t size = program.operators.size();
+  const std::size_t end  = (i < size && can_fail(program.operators[i], program.operands[i + 1])) ? i + 1 : size;
+  for (std::size_t j = i; j < end; j++) {
+    result.operands.push_back(program.operands[j + 1]);
+    result.operators += program.operators[j];
+  }
+
+  const std::size_t removed = program.operators.size() - result.operators.size();
+  program                   = std::move(result);
+  return removed;
+}
+
+} // namespace
+
+/// Operation counts of the optimizer over all programs.
+struct OptimizerStats {
+  std::size_t programs   = 0;
+  std::size_t before     = 0; // Operations before optimization.
+  std::size_t identities = 0; // Operations removed as algebraic identities.
+  std::size_t folded     = 0; // Operations removed by constant folding.
+
+  ///
+  /// Optimize a program, counting the removed operations.
+  ///
+  /// \note Evaluating the optimized program gives the same result as the original program, or the same error.
+  ///
+  void optimize(Program& program) {
+    programs++;
+    before += program.operators.size();
+    identities += remove_identities(program);
+    folded += fold_constants(program);
+  }
+
+  /// Operations after optimization.
+  [[nodiscard]] std::size_t after() const {
+    return before - identities - folded;
+  }
+};
+
+#ifdef HAVE_JIT
+
+///
+/// Native x86-64 machine code for a program shape.
+///
+/// The code runs the calculation in registers: RAX holds the left-hand side value, and RCX the next operand loaded from the operand array.
+/// Addition, subtraction and multiplication check the overflow flag after the operation, like `checked_calculate` does. Division and
+/// modulo check the divisor for zero before dividing, and handle a divisor of minus one separately as the hardware traps on overflow. The
+/// generated function follows the System V calling convention, with the signature of `Entry`.
+///
+/// The code is written into an anonymous memory mapping, which is made executable (and read-only) when complete.
+///
+class JitFunction {
+public:
+  /// Compiled function, returning zero on success, `STATUS_DIVISION_BY_ZERO` or `STATUS_OVERFLOW`.
+  using Entry = int (*)(const long* operands, long* result);
+
+  static constexpr int STATUS_DIVISION_BY_ZERO = 1;
+  static constexpr int STATUS_OVERFLOW         = 2;
+
+  explicit JitFunction(std::string_view operators) {
+    std::vector<std::uint8_t> code;
+    std::vector<std::size_t>  divisions; // Offsets of the jump displacements to the division-by-zero exit.
+    std::vector<std::size_t>  overflows; // Offsets of the jump displacements to the overflow exit.
+
+    const auto emit = [&](std::initializer_list<std::uint8_t> bytes) { code.insert(code.end(), bytes); };
+
+    const auto emit_u32 = [&](std::uint32_t value) {
+      for (int i = 0; i < 4; i++) {
+        code.push_back(static_cast<std::uint8_t>(value >> (8 * i)));
+      }
+    };
+
+    emit({0x48, 0x8B, 0x07}); // mov rax, [rdi]
+    for (std::size_t i = 0; i < operators.size(); i++) {
+      if ((i + 1) * sizeof(long) > std::numeric_limits<std::int32_t>::max()) {
+        throw std::length_error{"program too large to compile"};
+      }
+
+      emit({0x48, 0x8B, 0x8F}); // mov rcx, [rdi + disp32]
+      emit_u32(static_cast<std::uint32_t>((i + 1) * sizeof(long)));
+
+      switch (operators[i]) {
+      case '+': emit({0x48, 0x01, 0xC8}); break;       // add rax, rcx
+      case '-': emit({0x48, 0x29, 0xC8}); break;       // sub rax, rcx
+      case '*': emit({0x48, 0x0F, 0xAF, 0xC1}); break; // imul rax, rcx
+      case '/':
+      case '%': {
+        emit({0x48, 0x85, 0xC9}); // test rcx, rcx
+        emit({0x0F, 0x84});       // jz rel32
+        divisions.push_back(code.size());
+        emit_u32(0);
+
+        // Dividing by minus one is negation, and the remainder is zero.
+        emit({0x48, 0x83, 0xF9, 0xFF}); // cmp rcx, -1
+        emit({0x75, 0x00});             // jne rel8
+        const std::size_t not_minus_one = code.size();
+        if (operators[i] == '/') {
+          emit({0x48, 0xF7, 0xD8}); // neg rax
+          emit({0x0F, 0x80});       // jo rel32
+          overflows.push_back(code.size());
+          emit_u32(0);
+        } else {
+          emit({0x31, 0xC0}); // xor eax, eax
+        }
+        emit({0xEB, 0x00}); // jmp rel8
+        const std::size_t divided = code.size();
+        code[not_minus_one - 1]   = static_cast<std::uint8_t>(code.size() - not_minus_one);
+
+        emit({0x48, 0x99});       // cqo
+        emit({0x48, 0xF7, 0xF9}); // idiv rcx
+        if (operators[i] == '%') {
+          emit({0x48, 0x89, 0xD0}); // mov rax, rdx
+        }
+        code[divided - 1] = static_cast<std::uint8_t>(code.size() - divided);
+        continue;
+      }
+      default: throw std::invalid_argument{"unsupported operator"};
+      }
+
+      emit({0x0F, 0x80}); // jo rel32
+      overflows.push_back(code.size());
+      emit_u32(0);
+    }
+
+    emit({0x48, 0x89, 0x06}); // mov [rsi], rax
+    emit({0x31, 0xC0});       // xor eax, eax
+    emit({0xC3});             // ret
+
+    const std::size_t division_by_zero = code.size();
+    emit({0xB8, STATUS_DIVISION_BY_ZERO, 0x00, 0x00, 0x00}); // mov eax, STATUS_DIVISION_BY_ZERO
+    emit({0xC3});                                            // ret
+
+    const std::size_t overflow = code.size();
+    emit({0xB8, STATUS_OVERFLOW, 0x00, 0x00, 0x00}); // mov eax, STATUS_OVERFLOW
+    emit({0xC3});                                    // ret
+
+    for (const auto& [target, offsets] : {std::pair{division_by_zero, divisions}, std::pair{overflow, overflows}}) {
+      for (const auto offset : offsets) {
+        const auto displacement = static_cast<std::uint32_t>(target - (offset + 4));
+        std::memcpy(code.data() + offset, &displacement, sizeof(displacement));
+      }
+    }
+
+    const auto page_size = static_cast<std::size_t>(::sysconf(_SC_PAGESIZE));
+    size_                = ((code.size() + page_size - 1) / page_size) * page_size;
+
+    void* memory = ::mmap(nullptr, size_, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+    if (memory == MAP_FAILED) {
+      throw std::system_error{errno, std::generic_category(), "failed to map memory for compiled code"};
+    }
+
+    std::memcpy(memory, code.data(), code.size());
+    if (::mprotect(memory, size_, PROT_READ | PROT_EXEC) != 0) {
+      ::munmap(memory, size_);
+      throw std::system_error{errno, std::generic_category(), "failed to make compiled code executable"};
+    }
+
+    memory_ = memory;
+    entry_  = reinterpret_cast<Entry>(memory);
+  }
+
+  JitFunction(const JitFunction&)            = delete;
+  JitFunction& operator=(const JitFunction&) = delete;
+
+  ~JitFunction() {
+    ::munmap(memory_, size_);
+  }
+
+  ///
+  /// Run the compiled code.
+  ///
+  /// \param operands The operands of the program, one more than there are operators.
+  ///
+  /// \returns The result, or nothing if it overflows.
+  ///
+  /// \throws A `calculation_error` on division by zero.
+  ///
+  [[nodiscard]] std::optional<long> operator()(const long* operands) const {
+    long value{};
+    switch (entry_(operands, &value)) {
+    case STATUS_DIVISION_BY_ZERO: throw calculation_error{"division by zero"};
+    case STATUS_OVERFLOW: return std::nullopt;
+    default: return value;
+    }
+  }
+
+private:
+  void*       memory_ = nullptr;
+  std::size_t size_   = 0;
+  Entry       entry_  = nullptr;
+};
+
+#endif // HAVE_JIT
+
+///
+/// Evaluator for programs that compiles hot program shapes to machine code.
+///
+/// Programs are interpreted until their shape was evaluated `JIT_THRESHOLD` times. In verification mode every compiled evaluation is checked
+/// against the interpreter. Without JIT support for the platform, all programs are interpreted.
+///
+/// At most `MAX_SHAPES` shapes are kept, the least recently used one is dropped to make room for a new one. This bounds the memory for
+/// the counts and the compiled code, which takes at least a page per shape, for input with ever new shapes. If no memory can be mapped
+/// for the code, the shape is interpreted.
+///
+class JitCache {
+public:
+  /// Number of evaluations of a program shape before it is compiled.
+  static constexpr std::size_t JIT_THRESHOLD = 16;
+
+  /// Number of program shapes kept.
+  static constexpr std::size_t MAX_SHAPES = 1024;
+
+  explicit JitCache(bool verify = false)
+    : verify_{verify} {
+  }
+
+  ///
+  /// Evaluate a program.
+  ///
+  /// \returns The result, or nothing if it overflows.
+  ///
+  /// \throws A `calculation_error` on division by zero, and a `std::logic_error` if verification fails.
+  ///
+  [[nodiscard]] std::optional<long> evaluate(const Program& program) {
+#ifdef HAVE_JIT
+    Shape& shape = find(program.operators);
+    if (!shape.code && ++shape.count >= JIT_THRESHOLD) {
+      compile(shape);
+    }
+
+    if (shape.code) {
+      return verify_ ? verified(*shape.code, program) : (*shape.code)(program.operands.data());
+    }
+#endif
+
+    return interpret(program.operators, program.operands.data());
+  }
+
+  /// Number of program shapes compiled.
+  [[nodiscard]] std::size_t compiled() const {
+    return compiled_;
+  }
+
+  /// Number of program shapes kept, at most `MAX_SHAPES`.
+  [[nodiscard]] std::size_t size() const {
+#ifdef HAVE_JIT
+    return shapes_.size();
+#else
+    return 0;
+#endif
+  }
+
+private:
+#ifdef HAVE_JIT
+  struct Shape {
+    const std::string          operators;
+    std::size_t                count = 0;
+    std::optional<JitFunction> code;
+  };
+
+  /// Look up the shape of a program and make it the most recently used one, dropping the least recently used one if there are too many.
+  [[nodiscard]] Shape& find(const std::string& operators) {
+    if (const auto it = index_.find(operators); it != index_.end()) {
+      shapes_.splice(shapes_.begin(), shapes_, it->second);
+      return *it->second;
+    }
+
+    if (shapes_.size() == MAX_SHAPES) {
+      index_.erase(shapes_.back().operators);
+      shapes_.pop_back();
+    }
+
+    Shape& shape = shapes_.emplace_front(operators);
+    index_.emplace(shape.operators, shapes_.begin());
+    return shape;
+  }
+
+  /// Compile a shape. If that fails for lack of memory, it is interpreted until it reaches the threshold again.
+  void compile(Shape& shape) {
+    try {
+      shape.code.emplace(shape.operators);
+      compiled_++;
+    } catch (const std::system_error&) {
+      shape.count = 0;
+    } catch (const std::length_error&) {
+      shape.count = 0;
+    }
+  }
+
+  /// Evaluate a program with the compiled code as well as the interpreter, and compare.
+  [[nodiscard]] static std::optional<long> verified(const JitFunction& code, const Program& program) {
+    const auto outcome = [](std::invocable auto&& evaluate) -> std::string {
+      try {
+        const std::optional<long> value = evaluate();
+        return value ? std::to_string(*value) : "overflow";
+      } catch (const calculation_error&) {
+        return "error";
+      }
+    };
+
+    const auto expected = outcome([&] { return interpret(program.operators, program.operands.data()); });
+    const auto actual   = outcome([&] { return code(program.operands.data()); });
+    if (actual != expected) {
+      throw std::logic_error{fmt::format("compiled code for '{}' differs from the interpreter: {} instead of {}", program.operators, actual, expected)};
+    }
+
+    return code(program.operands.data());
+  }
+
+  std::list<Shape>                                                shapes_; // Most recently used first.
+  std::unordered_map<std::string_view, std::list<Shape>::iterator> index_;  // Refers to the operators of the shapes.
+#endif
+
+  bool        verify_;
+  std::size_t compiled_ = 0;
+};
+
+namespace {
+
+///
+/// Measure the evaluation throughput of the interpreter and the compiled code, for programs of several sizes.
+///
+void benchmark_jit() {
+  constexpr std::size_t COUNT = 1 << 16; // Operand sets per program shape.
+  constexpr int         RUNS  = 5;
+
+  std::mt19937                        rng{42};
+  std::uniform_int_distribution<long> operand{1, 1000}; // Non-zero, so no divisions by zero.
+
+  // Divisions take tens of cycles each, which hides most of the interpreter overhead. So measure with and without.
+  std::vector<std::string> shapes;
+  for (const std::string_view set : {"+-*", "+-*/%"}) {
+    std::uniform_int_distribution<std::size_t> op{0, set.size() - 1};
+    for (const std::size_t size : {1, 4, 16, 64}) {
+      std::string operators;
+      for (std::size_t i = 0; i < size; i++) {
+        operators += set[op(rng)];
+      }
+
+      shapes.push_back(operators);
+    }
+  }
+
+  for (const auto& operators : shapes) {
+    const std::size_t size = operators.size();
+
+    std::vector<long> operands(COUNT * (size + 1));
+    std::ranges::generate(operands, [&] { return operand(rng); });
+
+    const auto measure = [&](std::invocable<const long*> auto&& evaluate) {
+      auto best = std::chrono::duration<double>::max();
+      long sum  = 0;
+      for (int run = 0; run < RUNS; run++) {
+        sum                = 0;
+        const auto t_start = std::chrono::steady_clock::now();
+        for (std::size_t i = 0; i < COUNT; i++) {
+          sum += evaluate(operands.data() + (i * (size + 1))).value_or(0) % 1000; // Keeps the sum from overflowing.
+        }
+
+        best = std::min(best, std::chrono::duration<double>(std::chrono::steady_clock::now() - t_start));
+      }
+
+      return std::pair{COUNT / best.count(), sum};
+    };
+
+    const auto [interpreted, interpreted_sum] = measure([&](const long* o) { return interpret(operators, o); });
+    fmt::print("{:2} operators ({:>7} division): interpreter {:7.2f} M evaluations/s", size,
+               (operators.find_first_of("/%") == std::string::npos) ? "without" : "with", interpreted / 1e6);
+
+#ifdef HAVE_JIT
+    const JitFunction code{operators};
+    const auto [compiled, compiled_sum] = measure([&](const long* o) { return code(o); });
+    fmt::print(", compiled {:7.2f} M evaluations/s ({:.1f}x){}", compiled / 1e6, compiled / interpreted,
+               (compiled_sum == interpreted_sum) ? "" : " (results differ!)");
+#endif
+
+    fmt::print("\n");
+  }
+}
+
+} // namespace
+
+namespace {
+
+///
+/// Evaluate all complete lines of input text, each line as a separate calculation.
+///
+/// Unlike `--lines` mode, every line gets a result or error message, also lines without tokens. So a client sending calculations gets
+/// exactly one response line for every request line.
+///
+/// \param input Input text, the part after the last newline is left for later.
+/// \param index Token index to use, reused for its storage.
+/// \param out Writer for the results.
+///
+/// \returns The number of bytes of input evaluated.
+///
+std::size_t evaluate_lines(std::string_view input, TokenIndex& index, ResultWriter& out) {
+  const std::size_t last = input.rfind('\n');
+  if (last == std::string_view::npos) {
+    return 0;
+  }
+
+  const std::string_view lines = input.substr(0, last + 1);
+  index.assign(lines);
+
+  for (std::size_t begin = 0; begin < lines.size();) {
+    const std::size_t limit  = lines.find('\n', begin);
+    std::size_t       cursor = static_cast<std::size_t>(std::ranges::lower_bound(index.starts, begin) - index.starts.begin());
+    evaluate(index, cursor, limit, out);
+    begin = limit + 1;
+  }
+
+  return lines.size();
+}
+
+} // namespace
+
+#ifdef HAVE_SERVER
+
+/// Owner of a file descriptor, which is closed on destruction.
+class FileDescriptor {
+public:
+  explicit FileDescriptor(int fd = -1)
+    : fd_{fd} {
+  }
+
+  FileDescriptor(FileDescriptor&& other) noexcept
+    : fd_{std::exchange(other.fd_, -1)} {
+  }
+
+  FileDescriptor& operator=(FileDescriptor&& other) noexcept {
+    std::swap(fd_, other.fd_);
+    return *this;
+  }
+
+  ~FileDescriptor() {
+    if (fd_ >= 0) {
+      ::close(fd_);
+    }
+  }
+
+  [[nodiscard]] int get() const {
+    return fd_;
+  }
+
+private:
+  int fd_;
+};
+
+namespace {
+
+///
+/// Check the result of a system call.
+///
+/// \returns The result, if not negative.
+///
+/// \throws A `std::system_error` for the current `errno` otherwise.
+///
+template<std::signed_integral T>
+T check(T result, const char* what) {
+  if (result < 0) {
+    throw std::system_error{errno, std::generic_category(), what};
+  }
+
+  return result;
+}
+
+/// Raise the limit of open file descriptors to the maximum, to serve thousands of connections.
+void raise_file_limit() {
+  rlimit limit{};
+  if (::getrlimit(RLIMIT_NOFILE, &limit) == 0 && limit.rlim_cur < limit.rlim_max) {
+    limit.rlim_cur = limit.rlim_max;
+    ::setrlimit(RLIMIT_NOFILE, &limit);
+  }
+}
+
+/// Make a Unix domain socket address for a path.
+[[nodiscard]] sockaddr_un unix_address(const std::string& path) {
+  sockaddr_un address{};
+  if (path.size() >= sizeof(address.sun_path)) {
+    throw std::length_error{"socket path too long"};
+  }
+
+  address.sun_family = AF_UNIX;
+  std::ranges::copy(path, address.sun_path);
+  return address;
+}
+
+/// Make a loopback TCP address for a port.
+[[nodiscard]] sockaddr_in loopback_address(std::uint16_t port) {
+  sockaddr_in address{};
+  address.sin_family      = AF_INET;
+  address.sin_port        = htons(port);
+  address.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+  return address;
+}
+
+/// Check whether a socket address is a TCP (rather than a Unix domain socket) address.
+template<typename Address>
+constexpr bool is_tcp = std::is_same_v<Address, sockaddr_in>;
+
+/// Create a non-blocking socket listening on an address.
+template<typename Address>
+[[nodiscard]] FileDescriptor listen_on(const Address& address) {
+  FileDescriptor socket{check(::socket(is_tcp<Address> ? AF_INET : AF_UNIX, SOCK_STREAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0), "failed to create socket")};
+
+  const int on = 1;
+  if constexpr (is_tcp<Address>) {
+    check(::setsockopt(socket.get(), SOL_SOCKET, SO_REUSEADDR, &on, sizeof(on)), "failed to set socket options");
+  }
+
+  check(::bind(socket.get(), reinterpret_cast<const sockaddr*>(&address), sizeof(address)), "failed to bind socket");
+  check(::listen(socket.get(), SOMAXCONN), "failed to listen on socket");
+  return socket;
+}
+
+/// Create a socket connected to an address, in non-blocking mode.
+template<typename Address>
+[[nodiscard]] FileDescriptor connect_to(const Address& address) {
+  FileDescriptor socket{check(::socket(is_tcp<Address> ? AF_INET : AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0), "failed to create socket")};
+  check(::connect(socket.get(), reinterpret_cast<const sockaddr*>(&address), sizeof(address)), "failed to connect");
+
+  const int on = 1;
+  if constexpr (is_tcp<Address>) {
+    check(::setsockopt(socket.get(), IPPROTO_TCP, TCP_NODELAY, &on, sizeof(on)), "failed to set socket options");
+  }
+
+  check(::fcntl(socket.get(), F_SETFL, O_NONBLOCK), "failed to make socket non-blocking");
+  return socket;
+}
+
+/// Register a file descriptor with an epoll instance, for edge-triggered input and output events.
+void watch(const FileDescriptor& epoll, int fd, std::uint32_t events = EPOLLIN | EPOLLOUT | EPOLLRDHUP | EPOLLET) {
+  epoll_event event{};
+  event.events  = events;
+  event.data.fd = fd;
+  check(::epoll_ctl(epoll.get(), EPOLL_CTL_ADD, fd, &event), "failed to watch file descriptor");
+}
+
+///
+/// Write as much of a text as possible to a non-blocking socket.
+///
+/// \returns The number of bytes written, or nothing if the connection failed.
+///
+[[nodiscard]] std::optional<std::size_t> send_some(int fd, std::string_view text) {
+  std::size_t written = 0;
+  while (written < text.size()) {
+    const auto n = ::send(fd, text.data() + written, text.size() - written, MSG_NOSIGNAL);
+    if (n < 0) {
+      if (errno == EINTR) {
+        continue;
+      } else if (errno == EAGAIN || errno == EWOULDBLOCK) {
+        break;
+      }
+
+      return std::nullopt;
+    }
+
+    written += static_cast<std::size_t>(n);
+  }
+
+  return written;
+}
+
+///
+/// Read all available data from a non-blocking socket, appending it to a buffer.
+///
+/// \param limit Maximum size of the buffer, reading stops when it is reached.
+///
+/// \returns True if the connection is still open, false on end-of-file or an error.
+///
+[[nodiscard]] bool receive_some(int fd, std::string& buffer, std::size_t limit) {
+  constexpr std::size_t CHUNK_SIZE = 1 << 16;
+
+  while (buffer.size() < limit) {
+    const std::size_t size = buffer.size();
+    buffer.resize(size + CHUNK_SIZE);
+    const auto n = ::recv(fd, buffer.data() + size, CHUNK_SIZE, 0);
+    buffer.resize(size + static_cast<std::size_t>(std::max(n, ssize_t{0})));
+
+    if (n == 0) {
+      return false;
+    } else if (n < 0) {
+      if (errno == EINTR) {
+        continue;
+      }
+
+      return errno == EAGAIN || errno == EWOULDBLOCK;
+    }
+  }
+
+  return true;
+}
+
+} // namespace
+
+///
+/// Wake-up signal between processes, for waiting on a condition in shared memory.
+///
+/// A waiter first spins for a while, as the condition often becomes true within a microsecond when the other side runs on another core.
+/// After that it sleeps on a futex, which the notifier only wakes when there are sleepers, so notifying is cheap in the common case.
+///
+struct Signal {
+  /// Number of spin iterations before sleeping, for multi-core machines. With a pause taking up to about 40 ns, this spins for some tens of
+  /// microseconds at most. Spinning on a single core only delays the other side.
+  static constexpr int SPIN_LIMIT = 1 << 10;
+
+  std::atomic<std::uint32_t> sequence{0}; // The futex word, changed on every notification.
+  std::atomic<std::uint32_t> sleepers{0};
+
+  /// Notify the other side, after the condition changed.
+  void notify() {
+    sequence.fetch_add(1);
+    if (sleepers.load() != 0) {
+      ::syscall(SYS_futex, &sequence, FUTEX_WAKE, std::numeric_limits<int>::max(), nullptr, nullptr, 0);
+    }
+  }
+
+  /// Wake all sleepers, also if the other side does not count these correctly.
+  void wake_all() {
+    sequence.fetch_add(1);
+    ::syscall(SYS_futex, &sequence, FUTEX_WAKE, std::numeric_limits<int>::max(), nullptr, nullptr, 0);
+  }
+
+  ///
+  /// Wait for a condition to become true.
+  ///
+  /// \param condition Function checking the condition.
+  /// \param timeout Longest time to sleep.
+  ///
+  /// \returns True if the condition is true, false on timeout.
+  ///
+  [[nodiscard]] bool wait(std::invocable auto&& condition, std::chrono::milliseconds timeout = std::chrono::milliseconds{100}) {
+    static const int spins = (std::thread::hardware_concurrency() > 1) ? SPIN_LIMIT : 0;
+
+    for (int i = 0; i < spins; i++) {
+      if (condition()) {
+        return true;
+      }
+
+#ifdef HAVE_X86_SIMD
+      _mm_pause();
+#endif
+    }
+
+    // Either the notifier sees the sleeper, or this sees the changed sequence or condition.
+    sleepers.fetch_add(1);
+    const std::uint32_t value = sequence.load();
+    if (!condition()) {
+      const auto seconds = std::chrono::duration_cast<std::chrono::seconds>(timeout);
+      const timespec time{seconds.count(), std::chrono::duration_cast<std::chrono::nanoseconds>(timeout - seconds).count()};
+      ::syscall(SYS_futex, &sequence, FUTEX_WAIT, value, &time, nullptr, 0);
+    }
+
+    sleepers.fetch_sub(1);
+    return condition();
+  }
+};
+
+///
+/// Lock-free single-producer single-consumer byte ring, for use in shared memory.
+///
+/// The head and tail are positions in the byte stream, which only increase. The ring holds the bytes between them, at the positions
+/// modulo the capacity. Only the consumer writes the head, and only the producer writes the tail.
+///
+/// The other side can write anything to the shared memory, so the positions are loaded once per operation, and checked to hold at most
+/// `CAPACITY` bytes between them before any of the data is touched.
+///
+struct Ring {
+  static constexpr std::size_t CAPACITY = 1 << 16; // In [bytes], a power of two.
+
+  alignas(64) std::atomic<std::uint64_t> head{0}; // Position of the next byte to read.
+  alignas(64) std::atomic<std::uint64_t> tail{0}; // Position of the next byte to write.
+  alignas(64) Signal readable;                    // Notified when bytes are written.
+  alignas(64) Signal writable;                    // Notified when bytes are read.
+  alignas(64) std::array<char, CAPACITY> data;
+
+  ///
+  /// Number of bytes held between two positions.
+  ///
+  /// \throws A `std::runtime_error` if the positions are inconsistent, which means the other side corrupted these.
+  ///
+  [[nodiscard]] static std::size_t used(std::uint64_t head_position, std::uint64_t tail_position) {
+    if (tail_position - head_position > CAPACITY) {
+      throw std::runtime_error{"inconsistent ring positions"};
+    }
+
+    return tail_position - head_position;
+  }
+
+  /// Number of bytes available to read.
+  [[nodiscard]] std::size_t size() const {
+    const std::uint64_t position = tail.load(std::memory_order_acquire);
+    return used(head.load(std::memory_order_relaxed), position);
+  }
+
+  /// Number of bytes available to write.
+  [[nodiscard]] std::size_t space() const {
+    return CAPACITY - used(head.load(std::memory_order_acquire), tail.load(std::memory_order_relaxed));
+  }
+
+  ///
+  /// Write as much of a text as there is space for (producer only).
+  ///
+  /// \returns The number of bytes written.
+  ///
+  /// \throws A `std::runtime_error` if the positions are inconsistent.
+  ///
+  std::size_t write_some(std::string_view text) {
+    const std::uint64_t position = tail.load(std::memory_order_relaxed);
+    const std::size_t   size     = std::min(text.size(), CAPACITY - used(head.load(std::memory_order_acquire), position));
+    const std::size_t   offset   = position % CAPACITY;
+    const std::size_t   first    = std::min(size, CAPACITY - offset); // Up to the end of the ring, then from the start.
+
+    std::memcpy(data.data() + offset, text.data(), first);
+    std::memcpy(data.data(), text.data() + first, size - first);
+
+    if (size > 0) {
+      tail.store(position + size, std::memory_order_release);
+      readable.notify();
+    }
+
+    return size;
+  }
+
+  ///
+  /// Read all available bytes (consumer only).
+  ///
+  /// \param buffer Buffer to append the bytes to.
+  ///
+  /// \returns The number of bytes read.
+  ///
+  /// \throws A `std::runtime_error` if the positions are inconsistent.
+  ///
+  std::size_t read_some(std::string& buffer) {
+    const std::uint64_t position = head.load(std::memory_order_relaxed);
+    const std::size_t   size     = used(position, tail.load(std::memory_order_acquire));
+    const std::size_t   offset   = position % CAPACITY;
+    const std::size_t   first    = std::min(size, CAPACITY - offset);
+
+    buffer.append(data.data() + offset, first);
+    buffer.append(data.data(), size - first);
+
+    if (size > 0) {
+      head.store(position + size, std::memory_order_release);
+      writable.notify();
+    }
+
+    return size;
+  }
+};
+
+static_assert(std::atomic<std::uint64_t>::is_always_lock_free && std::atomic<std::uint32_t>::is_always_lock_free,
+              "atomics in shared memory must be lock-free");
+
+/// Memory shared between a client and the server: a ring for the requests, and one for the responses.
+struct SharedRegion {
+  Ring                       requests;
+  Ring                       responses;
+  std::atomic<std::uint32_t> closed{0}; // Set by the server when the session ends.
+};
+
+///
+/// A `SharedRegion` in an anonymous memory file, mapped into this process.
+///
+/// The server creates the region, and passes the file descriptor to the client over a Unix domain socket, which maps the same memory.
+///
+class SharedMemory {
+public:
+  /// Create and map a new region.
+  SharedMemory()
+    : fd_{check(::memfd_create("rpn-calculator", MFD_CLOEXEC), "failed to create memory file")} {
+    check(::ftruncate(fd_.get(), sizeof(SharedRegion)), "failed to size memory file");
+    map();
+    new (memory_) SharedRegion{};
+  }
+
+  /// Map an existing region.
+  explicit SharedMemory(FileDescriptor&& fd)
+    : fd_{std::move(fd)} {
+    struct stat status {};
+    check(::fstat(fd_.get(), &status), "failed to get memory file size");
+    if (static_cast<std::size_t>(status.st_size) != sizeof(SharedRegion)) {
+      throw std::runtime_error{"unexpected shared memory size"};
+    }
+
+    map();
+  }
+
+  SharedMemory(const SharedMemory&)            = delete;
+  SharedMemory& operator=(const SharedMemory&) = delete;
+
+  ~SharedMemory() {
+    ::munmap(memory_, sizeof(SharedRegion));
+  }
+
+  [[nodiscard]] SharedRegion& region() const {
+    return *static_cast<SharedRegion*>(memory_);
+  }
+
+  [[nodiscard]] int fd() const {
+    return fd_.get();
+  }
+
+private:
+  void map() {
+    memory_ = ::mmap(nullptr, sizeof(SharedRegion), PROT_READ | PROT_WRITE, MAP_SHARED, fd_.get(), 0);
+    if (memory_ == MAP_FAILED) {
+      throw std::system_error{errno, std::generic_category(), "failed to map shared memory"};
+    }
+  }
+
+  FileDescriptor fd_;
+  void*          memory_ = nullptr;
+};
+
+namespace {
+
+/// Send a file descriptor over a Unix domain socket.
+void send_descriptor(int socket, int fd) {
+  char                                             byte = 0;
+  iovec                                            data{&byte, 1};
+  alignas(cmsghdr) std::array<char, CMSG_SPACE(sizeof(int))> control{};
+
+  msghdr message{};
+  message.msg_iov        = &data;
+  message.msg_iovlen     = 1;
+  message.msg_control    = control.data();
+  message.msg_controllen = control.size();
+
+  cmsghdr* header    = CMSG_FIRSTHDR(&message);
+  header->cmsg_level = SOL_SOCKET;
+  header->cmsg_type  = SCM_RIGHTS;
+  header->cmsg_len   = CMSG_LEN(sizeof(int));
+  std::memcpy(CMSG_DATA(header), &fd, sizeof(int));
+
+  check(::sendmsg(socket, &message, MSG_NOSIGNAL), "failed to send file descriptor");
+}
+
+/// Receive a file descriptor over a Unix domain socket, waiting for it.
+[[nodiscard]] FileDescriptor receive_descriptor(int socket) {
+  char                                             byte = 0;
+  iovec                                            data{&byte, 1};
+  alignas(cmsghdr) std::array<char, CMSG_SPACE(sizeof(int))> control{};
+
+  msghdr message{};
+  message.msg_iov        = &data;
+  message.msg_iovlen     = 1;
+  message.msg_control    = control.data();
+  message.msg_controllen = control.size();
+
+  pollfd ready{socket, POLLIN, 0};
+  check(::poll(&ready, 1, -1), "failed to wait for file descriptor");
+  check(::recvmsg(socket, &message, MSG_CMSG_CLOEXEC), "failed to receive file descriptor");
+
+  const cmsghdr* header = CMSG_FIRSTHDR(&message);
+  if (header == nullptr || header->cmsg_level != SOL_SOCKET || header->cmsg_type != SCM_RIGHTS) {
+    throw std::runtime_error{"expected a file descriptor"};
+  }
+
+  int fd = -1;
+  std::memcpy(&fd, CMSG_DATA(header), sizeof(int));
+  return FileDescriptor{fd};
+}
+
+} // namespace
+
+///
+/// Calculator server, evaluating newline-delimited calculations from clients.
+///
+/// The server listens on a Unix domain socket as well as a loopback TCP port, and serves all connections from a single thread using
+/// edge-triggered epoll. Each connection has an input buffer, of which the complete lines are evaluated as they arrive, and an output
+/// buffer for the results. Clients may pipeline requests: responses are sent in the order of the requests. A connection that does not
+/// read its responses is not read from either, once its output buffer passes `HIGH_WATER`.
+///
+/// Optionally the server listens on a second Unix domain socket for shared-memory sessions. For every client connecting there, it creates a
+/// `SharedRegion` and passes its file descriptor to the client. A thread per session then evaluates the requests from the shared memory.
+/// The socket is only used to detect that the client went away.
+///
+/// The server stops on SIGINT or SIGTERM, which are received through a signal file descriptor.
+///
+class Server {
+public:
+  static constexpr std::size_t HIGH_WATER    = 1 << 20; // Output size in [bytes] to stop reading requests at.
+  static constexpr std::size_t MAX_LINE_SIZE = 1 << 20; // Longest request line in [bytes].
+  static constexpr std::size_t MAX_SESSIONS  = 64;      // Most shared-memory sessions at once, as each takes a thread.
+
+  ///
+  /// Start listening.
+  ///
+  /// \param path Path of the Unix domain socket, which is replaced if it exists.
+  /// \param port Loopback TCP port, zero for any free port.
+  /// \param shm_path Path of the Unix domain socket for shared-memory sessions, which is replaced if it exists. Empty for none.
+  /// \param width Minimum result width, zero for none.
+  ///
+  /// \throws A `std::system_error` if a socket cannot be set up.
+  ///
+  Server(const std::string& path, std::uint16_t port, const std::string& shm_path = {}, std::size_t width = 0)
+    : path_{path}
+    , shm_path_{shm_path}
+    , width_{width}
+    , epoll_{check(::epoll_create1(EPOLL_CLOEXEC), "failed to create epoll instance")}
+    , spare_{::open("/dev/null", O_RDONLY | O_CLOEXEC)} {
+    raise_file_limit();
+
+    ::unlink(path.c_str());
+    unix_ = listen_on(unix_address(path));
+    tcp_  = listen_on(loopback_address(port));
+
+    if (!shm_path.empty()) {
+      ::unlink(shm_path.c_str());
+      shm_ = listen_on(unix_address(shm_path));
+      watch(epoll_, shm_.get(), EPOLLIN);
+    }
+
+    sockaddr_in bound{};
+    socklen_t   size = sizeof(bound);
+    check(::getsockname(tcp_.get(), reinterpret_cast<sockaddr*>(&bound), &size), "failed to get socket address");
+    port_ = ntohs(bound.sin_port);
+
+    sigset_t signals;
+    sigemptyset(&signals);
+    sigaddset(&signals, SIGINT);
+    sigaddset(&signals, SIGTERM);
+    check(::sigprocmask(SIG_BLOCK, &signals, nullptr), "failed to block signals");
+    signals_ = FileDescriptor{check(::signalfd(-1, &signals, SFD_NONBLOCK | SFD_CLOEXEC), "failed to create signal file descriptor")};
+
+    for (const auto* fd : {&unix_, &tcp_, &signals_}) {
+      watch(epoll_, fd->get(), EPOLLIN);
+    }
+  }
+
+  Server(const Server&)            = delete;
+  Server& operator=(const Server&) = delete;
+
+  ~Server() {
+    ::unlink(path_.c_str());
+    if (!shm_path_.empty()) {
+      ::unlink(shm_path_.c_str());
+    }
+  }
+
+  /// The loopback TCP port listened on.
+  [[nodiscard]] std::uint16_t port() const {
+    return port_;
+  }
+
+  ///
+  /// Serve connections, until a signal to stop is received.
+  ///
+  /// \throws A `std::system_error` if waiting for events fails.
+  ///
+  void run() {
+    std::array<epoll_event, 256> events;
+    for (bool stop = false; !stop;) {
+      const int n = ::epoll_wait(epoll_.get(), events.data(), static_cast<int>(events.size()), -1);
+      if (n < 0 && errno == EINTR) {
+        continue;
+      }
+
+      for (const auto& event : std::span{events.data(), static_cast<std::size_t>(check(n, "failed to wait for events"))}) {
+        const int fd = event.data.fd;
+        if (fd == unix_.get() || fd == tcp_.get() || fd == shm_.get()) {
+          accept_all(fd);
+        } else if (fd == signals_.get()) {
+          stop = true;
+        } else if (const auto connection = connections_.find(fd); connection != connections_.end() && !service(*connection->second)) {
+          connections_.erase(connection);
+          resume();
+        } else if (const auto session = sessions_.find(fd); session != sessions_.end() && !alive(session->second->socket.get())) {
+          sessions_.erase(session);
+          resume();
+        }
+      }
+    }
+  }
+
+private:
+  struct Connection {
+    Connection(FileDescriptor&& socket_, std::size_t width)
+      : socket{std::move(socket_)}
+      , out{nullptr, width} {
+    }
+
+    FileDescriptor socket;
+    std::string    input;           // Received request text, not yet evaluated.
+    ResultWriter   out;             // Responses, not yet sent.
+    bool           closing = false; // Indicates the client closed its side, only the responses remain to be sent.
+  };
+
+  struct Session {
+    Session(FileDescriptor&& socket_, std::size_t width)
+      : socket{std::move(socket_)}
+      , thread{serve_session, socket.get(), std::ref(memory.region()), std::cref(stopping), width} {
+    }
+
+    Session(const Session&)            = delete;
+    Session& operator=(const Session&) = delete;
+
+    ~Session() {
+      SharedRegion& region = memory.region();
+      stopping.store(true);
+      region.closed.store(1);
+      region.requests.readable.wake_all();
+      region.responses.writable.wake_all();
+      thread.join();
+    }
+
+    FileDescriptor    socket; // Only used to detect the client going away.
+    SharedMemory      memory;
+    std::atomic<bool> stopping{false}; // Set when the session ends, out of reach of the client unlike `SharedRegion::closed`.
+    std::thread       thread;
+  };
+
+  /// Longest time a session thread sleeps. Ending a session wakes it, this only bounds the wait if the client corrupts the futex words.
+  static constexpr std::chrono::seconds SESSION_WAKE_UP{1};
+
+  ///
+  /// Serve a shared-memory session: evaluate the request lines, and write the responses, until the session is closed.
+  ///
+  /// The client can write anything to the shared memory. If it corrupts the ring positions, the session ends: the socket is shut down,
+  /// so the server notices this like the client going away.
+  ///
+  /// \param socket The socket of the session.
+  /// \param region The shared memory.
+  /// \param stopping Flag set by the server to end the session.
+  /// \param width Minimum result width, zero for none.
+  ///
+  static void serve_session(int socket, SharedRegion& region, const std::atomic<bool>& stopping, std::size_t width) {
+    TokenIndex   index;
+    ResultWriter out{nullptr, width};
+    std::string  input;
+
+    const auto closed = [&] { return stopping.load() || region.closed.load() != 0; };
+
+    try {
+      while (!closed()) {
+        if (!region.requests.readable.wait([&] { return closed() || region.requests.size() > 0; }, SESSION_WAKE_UP)) {
+          continue;
+        }
+
+        region.requests.read_some(input);
+        input.erase(0, evaluate_lines(input, index, out));
+        if (input.size() >= MAX_LINE_SIZE) {
+          out.error("request line too long");
+          input.clear();
+        }
+
+        // Wait for the client to read responses, as long as these do not fit.
+        while (!out.text().empty() && !closed()) {
+          out.erase(region.responses.write_some(out.text()));
+          if (!out.text().empty()) {
+            static_cast<void>(region.responses.writable.wait([&] { return closed() || region.responses.space() > 0; }, SESSION_WAKE_UP));
+          }
+        }
+      }
+    } catch (const std::runtime_error& e) {
+      std::cerr << "Ended shared-memory session: " << e.what() << '\n';
+      region.closed.store(1);
+      ::shutdown(socket, SHUT_RDWR);
+    }
+  }
+
+  /// Check whether a client is still connected, discarding anything it sent.
+  [[nodiscard]] static bool alive(int fd) {
+    std::array<char, 64> discard;
+    const auto           n = ::recv(fd, discard.data(), discard.size(), MSG_DONTWAIT);
+    return n > 0 || (n < 0 && (errno == EAGAIN || errno == EWOULDBLOCK || errno == EINTR));
+  }
+
+  ///
+  /// Accept all pending connections of a listening socket.
+  ///
+  /// Out of file descriptors, a pending connection cannot be accepted and keeps the listening socket ready, so the event loop would spin.
+  /// Then the spare file descriptor is closed to accept the connection, which is closed right away. Without a spare file descriptor, the
+  /// listening sockets are not watched until a connection closes.
+  ///
+  void accept_all(int listener) {
+    for (;;) {
+      const int fd = ::accept4(listener, nullptr, nullptr, SOCK_NONBLOCK | SOCK_CLOEXEC);
+      if (fd < 0) {
+        const int error = errno;
+        if (error == EINTR || error == ECONNABORTED) {
+          continue;
+        } else if (error == EMFILE || error == ENFILE) {
+          if (reject(listener, error)) {
+            continue;
+          }
+        } else if (error != EAGAIN && error != EWOULDBLOCK) {
+          report_failure(std::strerror(error));
+        }
+
+        return;
+      }
+
+      if (listener == shm_.get()) {
+        if (sessions_.size() >= MAX_SESSIONS) {
+          ::close(fd);
+          report_failure("too many shared-memory sessions");
+          continue;
+        }
+
+        try {
+          auto session = std::make_unique<Session>(FileDescriptor{fd}, width_);
+          send_descriptor(fd, session->memory.fd());
+          watch(epoll_, fd, EPOLLIN | EPOLLRDHUP);
+          sessions_.emplace(fd, std::move(session));
+        } catch (const std::system_error& e) {
+          std::cerr << "Failed to start shared-memory session: " << e.what() << '\n';
+        }
+
+        continue;
+      } else if (listener == tcp_.get()) {
+        const int on = 1;
+        ::setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &on, sizeof(on));
+      }
+
+      connections_.emplace(fd, std::make_unique<Connection>(FileDescriptor{fd}, width_));
+      watch(epoll_, fd);
+    }
+  }
+
+  ///
+  /// Reject a pending connection, using the spare file descriptor to accept it. Without a spare one, stop watching the listening sockets.
+  ///
+  /// \returns True if a connection was rejected, false if none was pending or the listening sockets are not watched anymore.
+  ///
+  [[nodiscard]] bool reject(int listener, int error) {
+    if (spare_.get() < 0) {
+      for (const auto* fd : {&unix_, &tcp_, &shm_}) {
+        static_cast<void>(::epoll_ctl(epoll_.get(), EPOLL_CTL_DEL, fd->get(), nullptr));
+      }
+
+      paused_ = true;
+      report_failure(std::strerror(error));
+      return false;
+    }
+
+    spare_              = FileDescriptor{};                                                               // Closed, to make room.
+    const bool rejected = FileDescriptor{::accept4(listener, nullptr, nullptr, SOCK_CLOEXEC)}.get() >= 0; // Closed right away.
+    spare_              = FileDescriptor{::open("/dev/null", O_RDONLY | O_CLOEXEC)};
+    if (rejected) {
+      report_failure(std::strerror(error));
+    }
+
+    return rejected;
+  }
+
+  /// Watch the listening sockets again after these were not, now a connection closed and freed a file descriptor for the spare one.
+  void resume() {
+    if (!paused_) {
+      return;
+    }
+
+    spare_ = FileDescriptor{::open("/dev/null", O_RDONLY | O_CLOEXEC)};
+    for (const auto* fd : {&unix_, &tcp_, &shm_}) {
+      if (fd->get() >= 0) {
+        watch(epoll_, fd->get(), EPOLLIN);
+      }
+    }
+
+    paused_ = false;
+  }
+
+  /// Report a failure to accept connections, at most once a second, as these come in bursts.
+  void report_failure(std::string_view reason) {
+    failures_++;
+    if (const auto now = std::chrono::steady_clock::now(); now >= next_report_) {
+      std::cerr << "Failed to accept " << failures_ << " connection(s): " << reason << '\n';
+      failures_    = 0;
+      next_report_ = now + std::chrono::seconds{1};
+    }
+  }
+
+  ///
+  /// Make progress on a connection: send responses, receive and evaluate requests.
+  ///
+  /// \returns False if the connection is done, and should be closed.
+  ///
+  [[nodiscard]] bool service(Connection& c) {
+    for (;;) {
+      const auto sent = send_some(c.socket.get(), c.out.text());
+      if (!sent) {
+        return false;
+      }
+
+      c.out.erase(*sent);
+      if (c.closing || c.out.text().size() >= HIGH_WATER) {
+        return !c.closing || !c.out.text().empty(); // Continues on the next output event.
+      }
+
+      const std::size_t size = c.input.size();
+      c.closing              = !receive_some(c.socket.get(), c.input, size + MAX_LINE_SIZE);
+      const bool received    = c.input.size() > size;
+      if (c.closing && !c.input.empty() && c.input.back() != '\n') {
+        c.input += '\n'; // The last request need not end with a newline.
+      }
+
+      const std::size_t evaluated = evaluate_lines(c.input, index_, c.out);
+      c.input.erase(0, evaluated);
+
+      if (c.input.size() >= MAX_LINE_SIZE) {
+        c.out.error("request line too long");
+        c.input.clear();
+        c.closing = true;
+      } else if (!c.closing && !received) {
+        return true; // Continues on the next input (or output) event.
+      }
+    }
+  }
+
+  std::string                                          path_;
+  std::string                                          shm_path_;
+  std::size_t                                          width_;
+  std::uint16_t                                        port_ = 0;
+  FileDescriptor                                       epoll_;
+  FileDescriptor                                       spare_; // Kept to accept and reject connections when out of file descriptors.
+  FileDescriptor                                       unix_;
+  FileDescriptor                                       tcp_;
+  FileDescriptor                                       shm_;
+  FileDescriptor                                       signals_;
+  std::unordered_map<int, std::unique_ptr<Connection>> connections_;
+  std::unordered_map<int, std::unique_ptr<Session>>    sessions_;
+  TokenIndex                                           index_;            // Shared by all connections, for its storage.
+  bool                                                 paused_   = false; // Indicates the listening sockets are not watched.
+  std::size_t                                          failures_ = 0;     // Failures to accept connections since the last report.
+  std::chrono::steady_clock::time_point                next_report_;      // Time from which to report the next failure.
+};
+
+namespace {
+
+/// A fixed set of calculations for load generation, with the responses expected.
+struct Workload {
+  std::vector<std::string> calculations;
+  std::vector<std::string> expected;
+};
+
+/// Generate the calculations of a `Workload`, which are the same on every call.
+[[nodiscard]] Workload make_workload() {
+  std::mt19937                       rng{42};
+  std::uniform_int_distribution<int> length{1, 6};
+  std::uniform_int_distribution<int> operand{-1000, 1000};
+  std::uniform_int_distribution<int> op{0, 4};
+
+  Workload workload;
+  workload.calculations.resize(64);
+  for (auto& calculation : workload.calculations) {
+    calculation = std::to_string(operand(rng));
+    for (int i = length(rng); i > 0; i--) {
+      calculation += fmt::format(" {} {}", operand(rng), "+-*/%"[op(rng)]);
+    }
+
+    calculation += '\n';
+
+    ResultWriter out{nullptr};
+    TokenIndex   index;
+    evaluate_lines(calculation, index, out);
+    workload.expected.emplace_back(out.text());
+  }
+
+  return workload;
+}
+
+///
+/// Print the latency percentiles of a load generation run.
+///
+/// \param latencies Latencies of all requests, which are reordered.
+/// \param wrong Number of responses that differ from the expected ones.
+///
+void print_latencies(std::vector<std::chrono::nanoseconds>& latencies, std::size_t wrong) {
+  const auto percentile = [&](double p) {
+    const auto nth = latencies.begin() + static_cast<std::ptrdiff_t>(p * static_cast<double>(latencies.size() - 1));
+    std::ranges::nth_element(latencies, nth);
+    return std::chrono::duration<double, std::micro>(*nth).count();
+  };
+
+  fmt::print("Latency: p50 {:.2f} us, p99 {:.2f} us, max {:.1f} us{}\n", percentile(0.5), percentile(0.99), percentile(1.0),
+             (wrong == 0) ? "" : fmt::format(" ({} wrong responses!)", wrong));
+}
+
+///
+/// Generate load on a calculator server, and measure its throughput and latency.
+///
+/// Every connection keeps a number of requests in flight (the pipeline depth), sending a new request for every response received. The
+/// latency of a request is the time from queuing it for sending until its response is received. All responses are checked.
+///
+/// \param endpoint Either a loopback TCP port number, or the path of a Unix domain socket.
+/// \param connections Number of connections.
+/// \param requests Total number of requests, over all connections.
+/// \param pipeline Number of requests in flight per connection.
+///
+void generate_load(const std::string& endpoint, std::size_t connections, std::size_t requests, std::size_t pipeline) {
+  using Clock = std::chrono::steady_clock;
+
+  const Workload workload     = make_workload();
+  const auto&    calculations = workload.calculations;
+  const auto&    expected     = workload.expected;
+
+  struct Client {
+    FileDescriptor                                        socket;
+    std::string                                           output;        // Requests, not yet sent.
+    std::string                                           input;         // Responses, not yet complete.
+    std::deque<std::pair<std::size_t, Clock::time_point>> pending;       // Calculation index and time of the requests in flight.
+    std::size_t                                           remaining = 0; // Requests left to send.
+  };
+
+  raise_file_limit();
+
+  const bool tcp  = !endpoint.empty() && std::ranges::all_of(endpoint, [](char c) { return c >= '0' && c <= '9'; });
+  const auto port = tcp ? std::stoul(endpoint) : 0;
+  if (port > std::numeric_limits<std::uint16_t>::max()) {
+    throw std::out_of_range{"invalid port number"};
+  }
+
+  FileDescriptor epoll{check(::epoll_create1(EPOLL_CLOEXEC), "failed to create epoll instance")};
+
+  std::unordered_map<int, Client> clients;
+  for (std::size_t i = 0; i < connections; i++) {
+    FileDescriptor socket = tcp ? connect_to(loopback_address(static_cast<std::uint16_t>(port))) : connect_to(unix_address(endpoint));
+    const int      fd     = socket.get();
+    clients.emplace(fd, Client{std::move(socket), {}, {}, {}, (requests / connections) + ((i < requests % connections) ? 1 : 0)});
+    watch(epoll, fd);
+  }
+
+  std::size_t                           next  = 0; // Index of the next calculation to send.
+  std::size_t                           wrong = 0; // Number of responses that differ from the expected ones.
+  std::vector<std::chrono::nanoseconds> latencies;
+  latencies.reserve(requests);
+
+  const auto queue = [&](Client& client) {
+    for (; client.remaining > 0 && client.pending.size() < pipeline; client.remaining--) {
+      client.output += calculations[next];
+      client.pending.emplace_back(next, Clock::now());
+      next = (next + 1) % calculations.size();
+    }
+  };
+
+  const auto t_start = Clock::now();
+  for (auto& [fd, client] : clients) {
+    queue(client);
+  }
+
+  std::array<epoll_event, 256> events;
+  while (!clients.empty()) {
+    const int n = ::epoll_wait(epoll.get(), events.data(), static_cast<int>(events.size()), -1);
+    if (n < 0 && errno == EINTR) {
+      continue;
+    }
+
+    for (const auto& event : std::span{events.data(), static_cast<std::size_t>(check(n, "failed to wait for events"))}) {
+      const auto it = clients.find(event.data.fd);
+      if (it == clients.end()) {
+        continue;
+      }
+
+      Client& client = it->second;
+      for (bool progress = true; progress;) {
+        const auto sent = send_some(it->first, client.output);
+        const bool open = receive_some(it->first, client.input, std::numeric_limits<std::size_t>::max());
+        if (!sent) {
+          throw std::runtime_error{"connection to server failed"};
+        }
+
+        client.output.erase(0, *sent);
+
+        // Match the complete response lines with the requests in flight, in order.
+        const auto  now  = Clock::now();
+        std::size_t used = 0;
+        for (std::size_t end; (end = client.input.find('\n', used)) != std::string::npos; used = end + 1) {
+          if (client.pending.empty()) {
+            throw std::runtime_error{"received more responses than requests"};
+          }
+
+          const auto [calculation, t_sent] = client.pending.front();
+          client.pending.pop_front();
+          latencies.push_back(now - t_sent);
+          wrong += (std::string_view{client.input}.substr(used, end + 1 - used) != expected[calculation]) ? 1 : 0;
+        }
+
+        client.input.erase(0, used);
+        queue(client);
+        progress = (used > 0) && !client.output.empty();
+
+        if (client.pending.empty() && client.remaining == 0) {
+          clients.erase(it);
+          break;
+        } else if (!open) {
+          throw std::runtime_error{"server closed the connection"};
+        }
+      }
+    }
+  }
+
+  const std::chrono::duration<double> elapsed = Clock::now() - t_start;
+
+  if (latencies.empty()) {
+    return;
+  }
+
+  fmt::print("{} requests over {} {} connections (pipeline depth {}) in {:.3f} s: {:.0f} requests/s\n", latencies.size(), connections,
+             tcp ? "TCP" : "Unix socket", pipeline, elapsed.count(), static_cast<double>(latencies.size()) / elapsed.count());
+  print_latencies(latencies, wrong);
+}
+
+///
+/// Measure the round-trip time of single requests to a calculator server over shared memory.
+///
+/// Every request is written to the request ring, after which the client waits for its response, so there is one request in flight.
+///
+/// \param path Path of the Unix domain socket of the server for shared-memory sessions.
+/// \param requests Number of requests, after a number of warm-up requests.
+///
+void measure_round_trips(const std::string& path, std::size_t requests) {
+  using Clock = std::chrono::steady_clock;
+
+  constexpr std::size_t WARM_UP = 10'000;
+
+  const Workload       workload = make_workload();
+  const FileDescriptor socket   = connect_to(unix_address(path));
+  const SharedMemory   memory{receive_descriptor(socket.get())};
+  SharedRegion&        region = memory.region();
+
+  // Wait for a condition, failing when the server ends the session or goes away.
+  const auto await = [&](Signal& signal, auto condition) {
+    while (!signal.wait([&] { return condition() || region.closed.load() != 0; })) {
+      char byte = 0;
+      if (::recv(socket.get(), &byte, 1, MSG_PEEK | MSG_DONTWAIT) == 0) {
+        break;
+      }
+    }
+
+    if (!condition()) {
+      throw std::runtime_error{"server closed the session"};
+    }
+  };
+
+  std::string input; // Responses, not yet complete.
+
+  const auto round_trip = [&](std::size_t calculation) {
+    for (std::string_view request = workload.calculations[calculation]; !request.empty();) {
+      request.remove_prefix(region.requests.write_some(request));
+      if (!request.empty()) {
+        await(region.requests.writable, [&] { return region.requests.space() > 0; });
+      }
+    }
+
+    std::size_t end;
+    while ((end = input.find('\n')) == std::string::npos) {
+      await(region.responses.readable, [&] { return region.responses.size() > 0; });
+      region.responses.read_some(input);
+    }
+
+    const bool correct = (std::string_view{input}.substr(0, end + 1) == workload.expected[calculation]);
+    input.erase(0, end + 1);
+    return correct;
+  };
+
+  for (std::size_t i = 0; i < WARM_UP; i++) {
+    static_cast<void>(round_trip(i % workload.calculations.size()));
+  }
+
+  std::size_t                           wrong = 0; // Number of responses that differ from the expected ones.
+  std::vector<std::chrono::nanoseconds> latencies;
+  latencies.reserve(requests);
+
+  const auto t_start = Clock::now();
+  for (std::size_t i = 0; i < requests; i++) {
+    const auto t_sent = Clock::now();
+    wrong += round_trip(i % workload.calculations.size()) ? 0 : 1;
+    latencies.push_back(Clock::now() - t_sent);
+  }
+
+  const std::chrono::duration<double> elapsed = Clock::now() - t_start;
+
+  if (latencies.empty()) {
+    return;
+  }
+
+  fmt::print("{} round trips over shared memory in {:.3f} s: {:.0f} round trips/s\n", latencies.size(), elapsed.count(),
+             static_cast<double>(latencies.size()) / elapsed.count());
+  print_latencies(latencies, wrong);
+}
+
+} // namespace
+
+#endif // HAVE_SERVER
+
+int main(int argc, char** argv) {
+  int result{};
+
+#ifdef ENABLE_DOCTESTS
+  doctest::Context ctx;
+  ctx.applyCommandLine(argc, argv);
+  result = ctx.run();
+  if (ctx.shouldExit()) {
+    return result;
+  }
+#endif // ENABLE_DOCTESTS
+
+  try {
+    bool        lines       = false;                 // Evaluate every input line as a separate calculation.
+    std::size_t width       = 0;                     // Minimum result width, zero for none.
+    bool        jit         = false;                 // Evaluate valid calculations as programs, compiling the hot ones.
+    bool        verify      = false;                 // Verify all compiled evaluations against the interpreter.
+    bool        optimize    = false;                 // Optimize valid calculations before evaluation.
+    bool        serve       = false;                 // Run as a server.
+    std::string path        = "rpn-calculator.sock"; // Unix domain socket path for the server.
+    std::size_t port        = 7878;                  // Loopback TCP port for the server.
+    std::string shm_path;                            // Unix domain socket path for shared-memory sessions, empty for none.
+    std::string load;                                // Server endpoint to generate load on: a TCP port or a Unix domain socket path.
+    std::string load_shm;                            // Server shared-memory session socket path to measure round trips on.
+    std::size_t connections = 64;                    // Load generator connections.
+    std::size_t requests    = 1'000'000;             // Load generator requests, over all connections.
+    std::size_t pipeline    = 16;                    // Load generator requests in flight per connection.
+
+    for (int i = 1; i < argc; i++) {
+      const std::string_view arg{argv[i]};
+      if (arg == "--benchmark") {
+        benchmark_tokenizer();
+        return result;
+      } else if (arg == "--benchmark-parse") {
+        benchmark_parse();
+        return result;
+      } else if (arg == "--benchmark-output") {
+        benchmark_output();
+        return result;
+      } else if (arg == "--benchmark-jit") {
+        benchmark_jit();
+        return result;
+      } else if (arg == "--benchmark-arithmetic") {
+        benchmark_arithmetic();
+        return result;
+      } else if (arg == "--lines") {
+        lines = true;
+      } else if (arg == "--jit") {
+        jit = true;
+      } else if (arg == "--jit-verify") {
+        jit    = true;
+        verify = true;
+      } else if (arg == "--optimize") {
+        optimize = true;
+      } else if (arg == "--width" && (i + 1) < argc) {
+        width = std::stoul(argv[++i]);
+      } else if (arg == "--serve") {
+        serve = true;
+      } else if (arg == "--socket" && (i + 1) < argc) {
+        path = argv[++i];
+      } else if (arg == "--port" && (i + 1) < argc) {
+        port = std::stoul(argv[++i]);
+      } else if (arg == "--shm" && (i + 1) < argc) {
+        shm_path = argv[++i];
+      } else if (arg == "--load" && (i + 1) < argc) {
+        load = argv[++i];
+      } else if (arg == "--load-shm" && (i + 1) < argc) {
+        load_shm = argv[++i];
+      } else if (arg == "--connections" && (i + 1) < argc) {
+        connections = std::stoul(argv[++i]);
+      } else if (arg == "--requests" && (i + 1) < argc) {
+        requests = std::stoul(argv[++i]);
+      } else if (arg == "--pipeline" && (i + 1) < argc) {
+        pipeline = std::max(std::stoul(argv[++i]), 1UL);
+      }
+    }
+
+    if (serve || !load.empty() || !load_shm.empty()) {
+#ifdef HAVE_SERVER
+      if (port > std::numeric_limits<std::uint16_t>::max()) {
+        throw std::out_of_range{"invalid port number"};
+      }
+
+      if (serve) {
+        Server server{path, static_cast<std::uint16_t>(port), shm_path, width};
+        std::cerr << fmt::format("Listening on {} and 127.0.0.1:{}{}\n", path, server.port(),
+                                 shm_path.empty() ? "" : fmt::format(", shared memory on {}", shm_path));
+        server.run();
+      } else if (!load.empty()) {
+        generate_load(load, connections, requests, pipeline);
+      } else {
+        measure_round_trips(load_shm, requests);
+      }
+#else
+      std::cerr << "Server mode is not supported on this platform\n";
+#endif
+
+      return result;
+    }
+
+    InputReader    reader;
+    TokenIndex     index;
+    std::size_t    cursor = 0;
+    ResultWriter   out{stdout, width};
+    JitCache       cache{verify};
+    OptimizerStats stats;
+
+    // Invalid calculations always go to the state machine, which reports the errors. So do overflowing ones, as it promotes values.
+    const auto run = [&](std::size_t limit) {
+      if (jit || optimize) {
+        if (auto program = compile(index, cursor, limit)) {
+          if (optimize) {
+            stats.optimize(*program);
+          }
+
+          try {
+            if (const auto value = jit ? cache.evaluate(*program) : interpret(program->operators, program->operands.data())) {
+              out.value(*value);
+              return;
+            }
+          } catch (const calculation_error& e) {
+            out.error(e.what());
+            return;
+          }
+        }
+      }
+
+      evaluate(index, cursor, limit, out);
+    };
+
+    if (lines) {
+      // The input is read in chunks of whole lines, and the results are written out per chunk. Lines without tokens are skipped, the
+      // tokens left over after an error in a line as well.
+      for (auto input = reader.read(InputReader::is_newline); !input.empty(); input = reader.read(InputReader::is_newline)) {
+        index.assign(input);
+        for (cursor = 0; cursor < index.size();) {
+          const std::size_t limit = std::min(input.find('\n', index.starts[cursor]), input.size());
+          run(limit);
+          cursor = static_cast<std::size_t>(std::ranges::lower_bound(index.starts, limit) - index.starts.begin());
+        }
+
+        out.flush();
+      }
+    } else if (const auto input = reader.read(InputReader::is_whitespace, true); reader.at_end()) {
+      index.assign(input);
+      run(input.size());
+    } else {
+      // A calculation that does not fit in a chunk is streamed through the state machine.
+      TokenStream tokens{reader, input};
+      evaluate([&] { return tokens.next(); }, out);
+    }
+
+    out.flush();
+
+    if (optimize) {
+      std::cerr << fmt::format("Optimized {} calculations: {} operations before, {} after ({} identities removed, {} folded)\n", stats.programs,
+                               stats.before, stats.after(), stats.identities, stats.folded);
+    }
+  } catch (const std::exception& e) {
+    std::cerr << "Caught exception: " << e.what() << '\n';
+  }
+
+  return result;
+}
+
+#ifdef ENABLE_DOCTESTS
+
+/// Helper to suppress compiler errors regarding 'nodiscard'.
+#define USE(e) static_cast<void>(e)
+
+TEST_CASE("Tokens::Operand::parse") {
+  SUBCASE("Valid input") {
+    Tokens::Operand o1{"42"};
+    CHECK(o1.parse<int>() == 42);
+
+    Tokens::Operand o2{"-1234567890"};
+    CHECK(o2.parse<long>() == -1234567890);
+
+    Tokens::Operand o3{"3.14"};
+    CHECK(o3.parse<float>() == doctest::Approx(3.14f));
+
+    Tokens::Operand o4{"2.71828"};
+    CHECK(o4.parse<double>() == doctest::Approx(2.71828));
+  }
+
+  SUBCASE("Invalid input") {
+    Tokens::Operand o1{"abc"};
+    CHECK_THROWS_AS(USE(o1.parse<int>()), calculation_error);
+
+    Tokens::Operand o2{"123.45"};
+    CHECK_THROWS_AS(USE(o2.parse<long>()), std::logic_error);
+
+    Tokens::Operand o3{"xyz"};
+    CHECK_THROWS_AS(USE(o3.parse<double>()), calculation_error);
+  }
+
+  SUBCASE("Empty input") {
+    Tokens::Operand o{""};
+    CHECK_THROWS_AS(USE(o.parse<int>()), std::logic_error);
+    CHECK_THROWS_AS(USE(o.parse<long>()), std::logic_error);
+    CHECK_THROWS_AS(USE(o.parse<float>()), std::logic_error);
+    CHECK_THROWS_AS(USE(o.parse<double>()), std::logic_error);
+  }
+
+  SUBCASE("Overflow input") {
+    Tokens::Operand o1{"2147483648"};
+    CHECK_THROWS_AS(USE(o1.parse<int>()), calculation_error); // Exceeds the range of int.
+
+    Tokens::Operand o2{"92233720368547758080"};
+    CHECK_THROWS_AS(USE(o2.parse<long>()), calculation_error); // Exceeds the range of long.
+
+    Tokens::Operand o3{"9223372036854775808"};
+    CHECK_THROWS_AS(USE(o3.parse<long>()), calculation_error); // Exceeds the range of long by one.
+  }
+}
+
+TEST_CASE("parse_integer") {
+  SUBCASE("Converts eight digits at a time") {
+    CHECK(is_eight_digits(load_chunk("12345678")));
+    CHECK(!is_eight_digits(load_chunk("1234567a")));
+    CHECK(!is_eight_digits(load_chunk("/2345678")));
+    CHECK(!is_eight_digits(load_chunk("1234:678")));
+    CHECK(parse_eight_digits(load_chunk("12345678")) == 12345678);
+    CHECK(parse_eight_digits(load_chunk("00000009")) == 9);
+  }
+
+  SUBCASE("Parses integers of all lengths") {
+    std::string digits;
+    long        expected = 0;
+    for (int n = 1; n <= 18; n++) {
+      digits += static_cast<char>('0' + (n % 10));
+      expected = (expected * 10) + (n % 10);
+
+      CHECK(parse_integer<long>(digits) == expected);
+      CHECK(parse_integer<long>("-" + digits) == -expected);
+    }
+  }
+
+  SUBCASE("Parses the range limits exactly") {
+    CHECK(parse_integer<long>("9223372036854775807") == std::numeric_limits<long>::max());
+    CHECK(parse_integer<long>("-9223372036854775808") == std::numeric_limits<long>::min());
+    CHECK(parse_integer<int>("-2147483648") == std::numeric_limits<int>::min());
+    CHECK_THROWS_AS(USE(parse_integer<long>("-9223372036854775809")), calculation_error);
+    CHECK_THROWS_AS(USE(parse_integer<int>("2147483648")), calculation_error);
+  }
+
+  SUBCASE("Skips leading zeros") {
+    CHECK(parse_integer<long>("000000000000000000000000042") == 42);
+    CHECK(parse_integer<long>("-00000000000000000000000000") == 0);
+  }
+
+  SUBCASE("Leaves anything else to the generic parser") {
+    CHECK(!parse_integer<long>(""));
+    CHECK(!parse_integer<long>("-"));
+    CHECK(!parse_integer<long>("12.5"));
+    CHECK(!parse_integer<long>("123456789abc"));
+    CHECK(!parse_integer<long>("1234567890123456789012345.0"));
+  }
+}
+
+TEST_CASE("TokenIndex") {
+  SUBCASE("Finds token boundaries") {
+    const TokenIndex index{"  12 -3\t+\n\n*  "};
+
+    CHECK(index.starts == std::vector<std::uint32_t>{2, 5, 8, 11});
+    CHECK(index.ends == std::vector<std::uint32_t>{4, 7, 9, 12});
+  }
+
+  SUBCASE("Handles tokens crossing block boundaries and at the end of the input") {
+    const std::string input = std::string(60, ' ') + "12345678 9" + std::string(54, ' ') + "42";
+    const TokenIndex  index{input};
+
+    CHECK(index.starts == std::vector<std::uint32_t>{60, 69, 124});
+    CHECK(index.ends == std::vector<std::uint32_t>{68, 70, 126});
+  }
+
+  SUBCASE("Handles empty and whitespace-only input") {
+    CHECK(TokenIndex{""}.size() == 0);
+    CHECK(TokenIndex{" \t\n\v\f\r"}.size() == 0);
+  }
+
+  SUBCASE("All classifiers agree") {
+    std::mt19937 rng{1};
+    std::string  input(1000, ' ');
+    std::ranges::generate(input, [&] { return " \n0123456789-+*/%a\xff"[rng() % 19]; });
+
+    const TokenIndex reference{input, classify_scalar};
+    std::vector      classifiers{best_classifier()};
+#ifdef HAVE_X86_SIMD
+    classifiers.push_back(classify_sse2);
+#endif
+
+    for (const auto classifier : classifiers) {
+      const TokenIndex index{input, classifier};
+
+      CHECK(index.starts == reference.starts);
+      CHECK(index.ends == reference.ends);
+      CHECK(index.non_digits == reference.non_digits);
+    }
+  }
+}
+
+TEST_CASE("read_token") {
+  SUBCASE("Reads an operand") {
+    const TokenIndex index{"123"};
+    std::size_t      cursor = 0;
+
+    const auto t = read_token(index, cursor);
+
+    CHECK(std::holds_alternative<Tokens::Operand>(t));
+    CHECK(std::get<Tokens::Operand>(t).value == "123");
+    CHECK(cursor == 1);
+  }
+
+  SUBCASE("Reads a negative operand") {
+    const TokenIndex index{"-456"};
+    std::size_t      cursor = 0;
+
+    const auto t = read_token(index, cursor);
+
+    CHECK(std::holds_alternative<Tokens::Operand>(t));
+    CHECK(std::get<Tokens::Operand>(t).value == "-456");
+  }
+
+  SUBCASE("Reads an operator") {
+    const TokenIndex index{"+"};
+    std::size_t      cursor = 0;
+
+    const auto t = read_token(index, cursor);
+
+    CHECK(std::holds_alternative<Tokens::Operator>(t));
+    CHECK(std::get<Tokens::Operator>(t).op == '+');
+  }
+
+  SUBCASE("Reads an invalid token") {
+    for (const auto input : {"abc", "1-2", "--1", "-", "++", "12a", "\xff"}) {
+      const TokenIndex index{input};
+      std::size_t      cursor = 0;
+
+      if (std::string_view{input} == "-") {
+        CHECK(std::holds_alternative<Tokens::Operator>(read_token(index, cursor)));
+      } else {
+        CHECK(std::holds_alternative<Tokens::Invalid>(read_token(index, cursor)));
+      }
+    }
+  }
+
+  SUBCASE("Returns end-of-calculation after the last token") {
+    const TokenIndex index{"1 2"};
+    std::size_t      cursor = 0;
+
+    USE(read_token(index, cursor));
+    USE(read_token(index, cursor));
+
+    CHECK(std::holds_alternative<Tokens::Eoc>(read_token(index, cursor)));
+    CHECK(std::holds_alternative<Tokens::Eoc>(read_token(index, cursor)));
+  }
+
+  SUBCASE("Returns end-of-calculation at the limit") {
+    const TokenIndex index{"1 2\n3"};
+    std::size_t      cursor = 0;
+
+    USE(read_token(index, cursor, 3));
+    USE(read_token(index, cursor, 3));
+
+    CHECK(std::holds_alternative<Tokens::Eoc>(read_token(index, cursor, 3)));
+    CHECK(std::holds_alternative<Tokens::Operand>(read_token(index, cursor)));
+  }
+}
+
+TEST_CASE("InputReader") {
+  // A token and a line straddle the end of the first chunk.
+  const std::string input = std::string(InputReader::CHUNK_SIZE - 2, '1') + " 2345 6\n7";
+
+  std::FILE* file = std::tmpfile();
+  REQUIRE(file != nullptr);
+  REQUIRE(std::fwrite(input.data(), 1, input.size(), file) == input.size());
+
+  SUBCASE("Tokens") {
+    std::rewind(file);
+    InputReader reader{file};
+    CHECK(reader.read(InputReader::is_whitespace) == std::string_view{input}.substr(0, InputReader::CHUNK_SIZE - 1));
+    CHECK(reader.read(InputReader::is_whitespace) == "2345 6\n");
+    CHECK(reader.read(InputReader::is_whitespace) == "7");
+    CHECK(reader.at_end());
+    CHECK(reader.read(InputReader::is_whitespace).empty());
+  }
+
+  SUBCASE("Lines") {
+    std::rewind(file);
+    InputReader reader{file};
+    CHECK(reader.read(InputReader::is_newline) == std::string_view{input}.substr(0, input.size() - 1));
+    CHECK(reader.read(InputReader::is_newline) == "7");
+    CHECK(reader.read(InputReader::is_newline).empty());
+  }
+
+  SUBCASE("Token stream") {
+    std::rewind(file);
+    InputReader reader{file};
+    TokenStream tokens{reader};
+    CHECK(std::holds_alternative<Tokens::Operand>(tokens.next()));
+    CHECK(std::get<Tokens::Operand>(tokens.next()).value == "2345");
+    CHECK(std::get<Tokens::Operand>(tokens.next()).value == "6");
+    CHECK(std::get<Tokens::Operand>(tokens.next()).value == "7");
+    CHECK(std::holds_alternative<Tokens::Eoc>(tokens.next()));
+  }
+
+  std::fclose(file);
+}
+
+TEST_CASE("ResultWriter") {
+  const auto written = [](std::size_t width, std::invocable<ResultWriter&> auto&& write) {
+    std::FILE* file = std::tmpfile();
+    REQUIRE(file != nullptr);
+
+    {
+      ResultWriter out{file, width};
+      write(out);
+      out.flush();
+    }
+
+    std::fseek(file, 0, SEEK_END);
+    std::string text(static_cast<std::size_t>(std::ftell(file)), '\0');
+    std::rewind(file);
+    text.resize(std::fread(text.data(), 1, text.size(), file));
+    std::fclose(file);
+
+    return text;
+  };
+
+  SUBCASE("Writes the same text as std::ostream") {
+    const auto text = written(0, [](ResultWriter& out) {
+      out.value(42L);
+      out.value(std::numeric_limits<long>::min());
+      out.value(0);
+      out.error("division by zero");
+      out.value(-7);
+
+      CHECK(out.lines() == 5);
+    });
+
+    std::ostringstream expected;
+    expected << 42L << '\n' << std::numeric_limits<long>::min() << '\n' << 0 << '\n' << "Error: division by zero\n" << -7 << '\n';
+
+    CHECK(text == expected.str());
+  }
+
+  SUBCASE("Writes shortest round-trip floating-point values") {
+    CHECK(written(0, [](ResultWriter& out) {
+            out.value(0.1);
+            out.value(1e300);
+            out.value(2.5f);
+          }) == "0.1\n1e+300\n2.5\n");
+  }
+
+  SUBCASE("Writes values of any size") {
+    CHECK(written(0, [](ResultWriter& out) {
+            out.value(Number{-3});
+            out.value(Number{std::numeric_limits<long>::max()} + Number{1});
+          }) == "-3\n9223372036854775808\n");
+  }
+
+  SUBCASE("Right-aligns values in fixed-width mode") {
+    CHECK(written(4, [](ResultWriter& out) {
+            out.value(7);
+            out.value(-12345);
+            out.error("overflow");
+          }) == "   7\n-12345\nError: overflow\n");
+  }
+
+  SUBCASE("Keeps the text without a sink") {
+    ResultWriter out{nullptr};
+    out.value(1);
+    out.value(22);
+
+    CHECK(out.text() == "1\n22\n");
+
+    out.erase(2);
+
+    CHECK(out.text() == "22\n");
+    CHECK_THROWS_AS(out.flush(), std::logic_error);
+  }
+
+  SUBCASE("Writes lines larger than the buffer size") {
+    CHECK(written(2'000'000, [](ResultWriter& out) { out.value(1); }).size() == 2'000'001);
+  }
+}
+
+TEST_CASE("evaluate_lines") {
+  SUBCASE("Evaluates complete lines only") {
+    ResultWriter out{nullptr};
+    TokenIndex   index;
+
+    CHECK(evaluate_lines("1 2 +\n\n3 0 /\n4 5", index, out) == 13);
+    CHECK(out.text() == "3\nError: expected operand 1, got end-of-calculation\nError: division by zero\n");
+  }
+
+  SUBCASE("Starts every line afresh") {
+    ResultWriter out{nullptr};
+    TokenIndex   index;
+
+    CHECK(evaluate_lines("1 2 3 +\n4 5 *\n", index, out) == 14);
+    CHECK(out.text() == "Error: expected operator, got operand\n20\n");
+  }
+}
+
+#ifdef HAVE_SERVER
+TEST_CASE("Ring") {
+  SUBCASE("Reads what was written, across the end") {
+    auto        ring = std::make_unique<Ring>();
+    std::string text(Ring::CAPACITY - 10, 'a');
+    std::string buffer;
+
+    CHECK(ring->write_some(text) == text.size());
+    CHECK(ring->read_some(buffer) == text.size());
+    CHECK(buffer == text);
+
+    buffer.clear();
+
+    CHECK(ring->write_some("1 2 +\n3 4 *\n") == 12);
+    CHECK(ring->size() == 12);
+    CHECK(ring->read_some(buffer) == 12);
+    CHECK(buffer == "1 2 +\n3 4 *\n");
+    CHECK(ring->size() == 0);
+  }
+
+  SUBCASE("Writes no more than there is space for") {
+    auto        ring = std::make_unique<Ring>();
+    std::string text(Ring::CAPACITY + 10, 'a');
+
+    CHECK(ring->write_some(text) == Ring::CAPACITY);
+    CHECK(ring->space() == 0);
+    CHECK(ring->write_some("b") == 0);
+  }
+
+  SUBCASE("Wakes a waiting consumer") {
+    auto        ring = std::make_unique<Ring>();
+    std::thread producer{[&] { ring->write_some("1\n"); }};
+
+    CHECK(ring->readable.wait([&] { return ring->size() > 0; }, std::chrono::seconds{5}));
+
+    producer.join();
+  }
+
+  SUBCASE("Rejects corrupt positions") {
+    auto        ring = std::make_unique<Ring>();
+    std::string buffer;
+
+    ring->tail.store(Ring::CAPACITY + 1);
+    CHECK_THROWS_AS(USE(ring->size()), std::runtime_error);
+    CHECK_THROWS_AS(USE(ring->space()), std::runtime_error);
+    CHECK_THROWS_AS(ring->read_some(buffer), std::runtime_error);
+    CHECK_THROWS_AS(ring->write_some("1\n"), std::runtime_error);
+
+    ring->tail.store(10);
+    ring->head.store(11); // Ahead of the tail.
+    CHECK_THROWS_AS(ring->read_some(buffer), std::runtime_error);
+    CHECK_THROWS_AS(ring->write_some("1\n"), std::runtime_error);
+    CHECK(buffer.empty());
+
+    ring->head.store(10);
+    CHECK(ring->write_some("1\n") == 2);
+    CHECK(ring->read_some(buffer) == 2);
+  }
+}
+
+TEST_CASE("SharedMemory") {
+  SUBCASE("Maps the same region twice") {
+    const SharedMemory server;
+    const SharedMemory client{FileDescriptor{check(::dup(server.fd()), "failed to duplicate file descriptor")}};
+
+    server.region().responses.write_some("42\n");
+
+    std::string buffer;
+    CHECK(client.region().responses.read_some(buffer) == 3);
+    CHECK(buffer == "42\n");
+    CHECK(server.region().responses.size() == 0);
+  }
+}
+#endif // HAVE_SERVER
+
+TEST_CASE("calculate") {
+  SUBCASE("Addition") {
+    CHECK(calculate(2, 3, '+') == 5);
+    CHECK(calculate(0, 0, '+') == 0);
+    CHECK(calculate(-5, 10, '+') == 5);
+    CHECK(calculate(-9223372036854775807L, 1L, '+') == -9223372036854775806L);
+    CHECK(calculate(-9223372036854775807L, 1L, '+') == -9223372036854775806L);
+    CHECK(calculate(9223372036854775807L, -1L, '+') == 9223372036854775806L);
+    CHECK(calculate(0L, 9223372036854775807L, '+') == 9223372036854775807L);
+    CHECK(calculate(Number{-9223372036854775807L}, Number{-9223372036854775807L}, '+').to_string() == "-18446744073709551614");
+    CHECK(calculate(9223372036854775807L, -9223372036854775807L, '+') == 0L);
+    CHECK(calculate(0L, -9223372036854775807L, '+') == -9223372036854775807L);
+  }
+
+  SUBCASE("Subtraction") {
+    CHECK(calculate(5, 3, '-') == 2);
+    CHECK(calculate(0, 0, '-') == 0);
+    CHECK(calculate(-5, 10, '-') == -15);
+    CHECK(calculate(1000000000, 2000000000, '-') == -1000000000);
+    CHECK(calculate(Number{-9223372036854775807L}, Number{1L}, '-') == Number{std::numeric_limits<long>::min()});
+    CHECK(calculate(Number{9223372036854775807L}, Number{-1L}, '-').to_string() == "9223372036854775808");
+    CHECK(calculate(0L, 9223372036854775807L, '-') == -9223372036854775807L);
+    CHECK(calculate(-9223372036854775807L, -9223372036854775807L, '-') == 0L);
+    CHECK(calculate(Number{9223372036854775807L}, Number{-9223372036854775807L}, '-').to_string() == "18446744073709551614");
+    CHECK(calculate(0L, -9223372036854775807L, '-') == 9223372036854775807L);
+  }
+
+  SUBCASE("Multiplication") {
+    CHECK(calculate(2, 3, '*') == 6);
+    CHECK(calculate(0, 5, '*') == 0);
+    CHECK(calculate(-5, -2, '*') == 10);
+    CHECK(calculate(1000000000L, 2000000000L, '*') == 2000000000000000000L);
+    CHECK(calculate(-9223372036854775807L, 1L, '*') == -9223372036854775807L);
+    CHECK(calculate(9223372036854775807L, -1L, '*') == -9223372036854775807L);
+    CHECK(calculate(0L, 9223372036854775807L, '*') == 0L);
+    CHECK(calculate(Number{-9223372036854775807L}, Number{-9223372036854775807L}, '*').to_string() == "85070591730234615847396907784232501249");
+    CHECK(calculate(Number{9223372036854775807L}, Number{-9223372036854775807L}, '*').to_string() == "-85070591730234615847396907784232501249");
+    CHECK(calculate(0L, -9223372036854775807L, '*') == 0L);
+  }
+
+  SUBCASE("Division") {
+    CHECK(calculate(10, 2, '/') == 5);
+    CHECK(calculate(0, 5, '/') == 0);
+    CHECK(calculate(-10, 2, '/') == -5);
+    CHECK(calculate(1000000000, 2000000000, '/') == 0);
+    CHECK(calculate(-9223372036854775807L, 1L, '/') == -9223372036854775807L);
+    CHECK(calculate(9223372036854775807L, -1L, '/') == -9223372036854775807L);
+    CHECK(calculate(0L, 9223372036854775807L, '/') == 0L);
+    CHECK(calculate(-9223372036854775807L, -9223372036854775807L, '/') == 1L);
+    CHECK(calculate(9223372036854775807L, -9223372036854775807L, '/') == -1L);
+    CHECK(calculate(0L, -9223372036854775807L, '/') == 0L);
+  }
+
+  SUBCASE("Modulo") {
+    CHECK(calculate(10, 3, '%') == 1);
+    CHECK(calculate(0, 5, '%') == 0);
+    CHECK(calculate(-10, 3, '%') == -1);
+    CHECK(calculate(1000000000, 2000000000, '%') == 1000000000);
+    CHECK(calculate(-9223372036854775807L, 1L, '%') == 0L);
+    CHECK(calculate(9223372036854775807L, -1L, '%') == 0L);
+    CHECK(calculate(0L, 9223372036854775807L, '%') == 0L);
+    CHECK(calculate(-9223372036854775807L, -9223372036854775807L, '%') == 0L);
+    CHECK(calculate(9223372036854775807L, -9223372036854775807L, '%') == 0L);
+    CHECK(calculate(0L, -9223372036854775807L, '%') == 0L);
+  }
+
+  SUBCASE("Unsupported Operator") {
+    CHECK_THROWS_AS(USE(calculate(2, 3, '^')), std::invalid_argument);
+    CHECK_THROWS_AS(USE(calculate(0, 0, '@')), std::invalid_argument);
+    CHECK_THROWS_AS(USE(calculate(-5, 10, '$')), std::invalid_argument);
+  }
+
+  SUBCASE("Division by Zero") {
+    CHECK_THROWS_AS(USE(calculate(5, 0, '/')), calculation_error);
+    CHECK_THROWS_AS(USE(calculate(0, 0, '/')), calculation_error);
+    CHECK_THROWS_AS(USE(calculate(-10, 0, '/')), calculation_error);
+    CHECK_THROWS_AS(USE(calculate(5, 0, '%')), calculation_error);
+    CHECK_THROWS_AS(USE(calculate(0, 0, '%')), calculation_error);
+    CHECK_THROWS_AS(USE(calculate(-10, 0, '%')), calculation_error);
+  }
+}
+
+TEST_CASE("checked_calculate") {
+  constexpr long MIN = std::numeric_limits<long>::min();
+  constexpr long MAX = std::numeric_limits<long>::max();
+
+  SUBCASE("Calculates like calculate") {
+    for (const char op : OPERATORS) {
+      CHECK(checked_calculate(-7, 3, op) == calculate(-7L, 3L, op));
+      CHECK(checked_calculate(MAX / 2, -1, op) == calculate(MAX / 2, -1L, op));
+    }
+  }
+
+  SUBCASE("Detects overflow") {
+    CHECK(!checked_calculate(MAX, 1, '+'));
+    CHECK(!checked_calculate(MIN, 1, '-'));
+    CHECK(!checked_calculate(MAX, 2, '*'));
+    CHECK(!checked_calculate(MIN, -1, '/'));
+    CHECK(checked_calculate(MIN, -1, '%') == 0);
+  }
+
+  SUBCASE("Throws like calculate") {
+    CHECK_THROWS_AS(USE(checked_calculate(1, 0, '/')), calculation_error);
+    CHECK_THROWS_AS(USE(checked_calculate(1, 0, '%')), calculation_error);
+    CHECK_THROWS_AS(USE(checked_calculate(1, 1, '^')), std::invalid_argument);
+  }
+}
+
+TEST_CASE("BigInt") {
+  const auto text = [](__int128 value) {
+    std::string digits;
+    for (auto magnitude = (value < 0) ? -static_cast<unsigned __int128>(value) : static_cast<unsigned __int128>(value); digits.empty() || magnitude != 0;
+         magnitude /= 10) {
+      digits.insert(digits.begin(), static_cast<char>('0' + static_cast<int>(magnitude % 10)));
+    }
+
+    return (value < 0) ? "-" + digits : digits;
+  };
+
+  std::mt19937_64                    rng{7};
+  std::uniform_int_distribution<int> bits{0, 126};
+
+  // Random values of random sizes, limited to avoid 128-bit overflow in the reference calculations.
+  const auto random = [&](int max_bits) {
+    const auto value = static_cast<__int128>(((static_cast<unsigned __int128>(rng()) << 64) | rng()) >> (127 - (bits(rng) % max_bits)));
+    return (rng() % 2 == 0) ? value : -value;
+  };
+
+  SUBCASE("Converts from and to 128-bit integers") {
+    for (const auto value : {__int128{0}, __int128{-1}, std::numeric_limits<__int128>::max(), std::numeric_limits<__int128>::min()}) {
+      CHECK(BigInt{value}.to_int128() == value);
+      CHECK(BigInt{value}.to_string() == text(value));
+    }
+
+    CHECK(!(BigInt{std::numeric_limits<__int128>::max()} + BigInt{1}).to_int128());
+  }
+
+  SUBCASE("Calculates like 128-bit integers") {
+    for (int i = 0; i < 10000; i++) {
+      const __int128 a = random(126);
+      const __int128 b = random(126);
+      const __int128 c = random(63);
+      const __int128 d = random(63);
+
+      CHECK(BigInt{a} + BigInt{b} == BigInt{a + b});
+      CHECK(BigInt{a} - BigInt{b} == BigInt{a - b});
+      CHECK(BigInt{c} * BigInt{d} == BigInt{c * d});
+      CHECK(BigInt{a}.to_string() == text(a));
+      if (b != 0) {
+        CHECK(BigInt{a} / BigInt{b} == BigInt{a / b});
+        CHECK(BigInt{a} % BigInt{b} == BigInt{a % b});
+      }
+    }
+  }
+
+  SUBCASE("Divides values larger than 128 bits") {
+    const auto negative = [](const BigInt& value) { return value.to_string().front() == '-'; };
+
+    for (int i = 0; i < 10000; i++) {
+      const BigInt a{random(126)};
+      const BigInt b{random(126)};
+      const BigInt r{random(126)};
+      if (b.is_zero()) {
+        continue;
+      }
+
+      // The remainder must be smaller than the divisor, with the sign of the dividend.
+      const BigInt product   = a * b;
+      BigInt       remainder = r % b;
+      if (negative(remainder) != negative(product)) {
+        remainder = BigInt{} - remainder;
+      }
+
+      const BigInt dividend = product + remainder;
+
+      CHECK(dividend / b == a);
+      CHECK(dividend % b == remainder);
+    }
+  }
+}
+
+TEST_CASE("Number") {
+  constexpr long MAX = std::numeric_limits<long>::max();
+
+  SUBCASE("Promotes on overflow and demotes when the result fits") {
+    const Number big = Number{MAX} + Number{1};
+
+    CHECK(!big.is_long());
+    CHECK(big.to_string() == "9223372036854775808");
+    CHECK((big - Number{1}).is_long());
+    CHECK(big - Number{1} == Number{MAX});
+  }
+
+  SUBCASE("Promotes beyond 128 bits") {
+    const Number cube = Number{MAX} * Number{MAX} * Number{MAX};
+
+    CHECK(cube.to_string() == "784637716923335095224261902710254454442933591094742482943");
+    CHECK(cube / Number{MAX} / Number{MAX} == Number{MAX});
+    CHECK(cube % Number{MAX} == Number{0});
+    CHECK((Number{0} - cube).to_string() == "-784637716923335095224261902710254454442933591094742482943");
+  }
+
+  SUBCASE("Divides the most negative value by minus one") {
+    const Number min{std::numeric_limits<long>::min()};
+
+    CHECK((min / Number{-1}).to_string() == "9223372036854775808");
+    CHECK(min % Number{-1} == Number{0});
+  }
+}
+
+TEST_CASE("compile") {
+  const auto compiled = [](std::string_view input) {
+    const TokenIndex index{input};
+    return compile(index, 0, input.size());
+  };
+
+  SUBCASE("Compiles valid calculations") {
+    const auto program = compiled("1 2 + -3 * 4 /");
+
+    REQUIRE(program);
+    CHECK(program->operands == std::vector<long>{1, 2, -3, 4});
+    CHECK(program->operators == "+*/");
+  }
+
+  SUBCASE("Rejects invalid calculations") {
+    for (const auto input : {"", "1", "1 2", "1 2 + 3", "1 +", "1 2 + +", "1 a +", "1 2 3 +", "99999999999999999999 1 +"}) {
+      CHECK(!compiled(input));
+    }
+  }
+}
+
+TEST_CASE("JitCache") {
+  const std::vector<Program> programs{
+    {{7, 3}, "+"},
+    {{7, 3}, "-"},
+    {{-7, 3}, "*"},
+    {{-7, 2}, "/"},
+    {{-7, 2}, "%"},
+    {{7, 0}, "/"},
+    {{7, 0}, "%"},
+    {{4, 5, 5, 30, 2}, "**-/"},
+    {{std::numeric_limits<long>::max(), 1, 3}, "+*"},
+    {{std::numeric_limits<long>::min(), -1}, "/"},
+    {{std::numeric_limits<long>::min(), -1}, "%"},
+    {{7, -1, 3}, "/*"},
+  };
+
+  SUBCASE("Compiled code matches the interpreter") {
+    JitCache cache{true};
+    for (std::size_t i = 0; i < JitCache::JIT_THRESHOLD + 1; i++) {
+      for (const auto& program : programs) {
+        try {
+          const auto value = cache.evaluate(program);
+          CHECK(value == interpret(program.operators, program.operands.data()));
+        } catch (const calculation_error&) {
+          CHECK_THROWS_AS(USE(interpret(program.operators, program.operands.data())), calculation_error);
+        }
+      }
+    }
+
+#ifdef HAVE_JIT
+    CHECK(cache.compiled() == 8); // The number of distinct shapes.
+#else
+    CHECK(cache.compiled() == 0);
+#endif
+  }
+
+  SUBCASE("Keeps a bounded number of shapes") {
+    JitCache cache{true};
+    for (std::size_t i = 0; i < 2 * JitCache::MAX_SHAPES; i++) {
+      Program program{std::vector<long>(9, 2), ""};
+      for (std::size_t shape = i; program.operators.size() < 8; shape /= 3) {
+        program.operators += "+-*"[shape % 3];
+      }
+
+      for (std::size_t j = 0; j < JitCache::JIT_THRESHOLD; j++) {
+        const auto value = cache.evaluate(program);
+        CHECK(value == interpret(program.operators, program.operands.data()));
+      }
+    }
+
+    CHECK(cache.size() <= JitCache::MAX_SHAPES);
+#ifdef HAVE_JIT
+    CHECK(cache.compiled() == 2 * JitCache::MAX_SHAPES);
+#endif
+  }
+}
+
+TEST_CASE("OptimizerStats::optimize") {
+  SUBCASE("Removes identities") {
+    Program program{{5, 0, 1, 0, 1, 3}, "+*-/%"};
+
+    CHECK(remove_identities(program) == 4);
+    CHECK(program.operands == std::vector<long>{5, 3});
+    CHECK(program.operators == "%");
+  }
+
+  SUBCASE("Removes operations before a multiplication by zero, unless these can fail") {
+    Program program{{5, 2, 0, 7}, "+*-"};
+
+    CHECK(remove_identities(program) == 2);
+    CHECK(program.operands == std::vector<long>{0, 7});
+    CHECK(program.operators == "-");
+
+    Program failing{{5, 0, 0}, "/*"};
+
+    CHECK(remove_identities(failing) == 0);
+  }
+
+  SUBCASE("Folds up to an overflow") {
+    Program program{{5, 2, std::numeric_limits<long>::max(), 0}, "*+/"};
+
+    CHECK(fold_constants(program) == 1);
+    CHECK(program.operands == std::vector<long>{10, std::numeric_limits<long>::max(), 0});
+    CHECK(program.operators == "+/");
+  }
+
+  SUBCASE("Folds up to a division by zero") {
+    Program program{{5, 2, 0, 7}, "*%+"};
+
+    CHECK(fold_constants(program) == 2);
+    CHECK(program.operands == std::vector<long>{10, 0});
+    CHECK(program.operators == "%");
+  }
+
+  SUBCASE("Keeps results and errors the same") {
+    std::mt19937                        rng{3};
+    std::uniform_int_distribution<long> operand{-2, 2};
+    std::uniform_int_distribution<int>  op{0, 4};
+    OptimizerStats                      stats;
+
+    for (int n = 0; n < 1000; n++) {
+      Program program{{operand(rng)}, {}};
+      for (int i = 0; i < 6; i++) {
+        program.operands.push_back(operand(rng));
+        program.operators += "+-*/%"[op(rng)];
+      }
+
+      std::optional<long> expected;
+      try {
+        expected = interpret(program.operators, program.operands.data());
+      } catch (const calculation_error&) {
+      }
+
+      stats.optimize(program);
+      CHECK(program.operators.size() <= 1);
+
+      std::optional<long> actual;
+      try {
+        actual = interpret(program.operators, program.operands.data());
+      } catch (const calculation_error&) {
+      }
+
+      CHECK(actual == expected);
+    }
+
+    CHECK(stats.programs == 1000);
+    CHECK(stats.before == 6000);
+  }
+}
+
+TEST_CASE("evaluate_constant") {
+  SUBCASE("Classifies tokens like read_token") {
+    for (const auto input : {"123", "-456", "+", "-", "%", "abc", "1-2", "--1", "++", "12a", "\xff"}) {
+      const TokenIndex index{input};
+      std::size_t      cursor = 0;
+
+      CHECK(classify_token(input).index() == read_token(index, cursor).index());
+    }
+  }
+
+  SUBCASE("Takes tokens separated by any whitespace") {
+    std::string_view calculation = " 1\t\t-2\n+ ";
+
+    CHECK(std::get<Tokens::Operand>(take_token(calculation)).value == "1");
+    CHECK(std::get<Tokens::Operand>(take_token(calculation)).value == "-2");
+    CHECK(std::get<Tokens::Operator>(take_token(calculation)).op == '+');
+    CHECK(std::holds_alternative<Tokens::Eoc>(take_token(calculation)));
+  }
+
+  SUBCASE("Evaluates at compile time") {
+    constexpr long value = "10 2 / 3 + 4 * 5 - 2 / 3 + 1 + 8 * 10 % -100 +"_rpn;
+
+    CHECK(value == -94);
+  }
+}
+
+#endif // ENABLE_DOCTESTS
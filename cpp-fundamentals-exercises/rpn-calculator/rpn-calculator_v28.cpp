@@ -0,0 +1,981 @@
+#include <fmt/core.h>
+
+#ifdef ENABLE_DOCTESTS
+#define DOCTEST_CONFIG_IMPLEMENT
+#include <doctest/doctest.h>
+#endif
+
+#include <cstdio>
+#include <exception>
+#include <iostream>
+#include <stdexcept>
+#include <string>
+#include <string_view>
+
+#include "calculator.hpp"
+
+#ifdef ENABLE_DOCTESTS
+#include <random>
+#include <thread>
+#include <vector>
+
+#include "engine.hpp"
+#endif
+
+namespace {
+
+///
+/// Write text to a file.
+///
+/// \throws A `std::runtime_error` if writing fails.
+///
+void write_output(std::string_view text, std::FILE* sink = stdout) {
+  if (std::fwrite(text.data(), 1, text.size(), sink) != text.size() || std::fflush(sink) != 0) {
+    throw std::runtime_error{"failed to write output"};
+  }
+}
+
+} // namespace
+
+int main(int argc, char** argv) {
+  int result{};
+
+#ifdef ENABLE_DOCTESTS
+  doctest::Context ctx;
+  ctx.applyCommandLine(argc, argv);
+  result = ctx.run();
+  if (ctx.shouldExit()) {
+    return result;
+  }
+#endif // ENABLE_DOCTESTS
+
+  try {
+    bool        lines = false; // Evaluate every input line as a separate calculation.
+    bool        infix = false; // Read infix calculations instead of RPN.
+    std::size_t width = 0;     // Minimum result width, zero for none.
+    int         base  = 10;    // Base of the result values.
+
+    for (int i = 1; i < argc; i++) {
+      const std::string_view arg{argv[i]};
+      if (arg == "--lines") {
+        lines = true;
+      } else if (arg == "--infix") {
+        infix = true;
+      } else if (arg == "--width" && (i + 1) < argc) {
+        width = std::stoul(argv[++i]);
+      } else if (arg == "--base" && (i + 1) < argc) {
+        base = std::stoi(argv[++i]);
+      }
+    }
+
+    // The input is read in chunks, so it need not fit in memory. With `--lines` the results are written out per chunk.
+    rpn::Calculator calculator{width, base};
+
+    if (lines) {
+      infix ? calculator.evaluate_infix_lines(stdin, stdout) : calculator.evaluate_lines(stdin, stdout);
+    } else {
+      const auto [ok, text] = infix ? calculator.evaluate_infix(stdin) : calculator.evaluate(stdin);
+      write_output(fmt::format("{}{}\n", ok ? "" : "Error: ", text));
+    }
+  } catch (const std::exception& e) {
+    std::cerr << "Caught exception: " << e.what() << '\n';
+  }
+
+  return result;
+}
+
+
+#ifdef ENABLE_DOCTESTS
+
+/// Helper to suppress compiler errors regarding 'nodiscard'.
+#define USE(e) static_cast<void>(e)
+
+using namespace rpn;
+
+TEST_CASE("Tokens::Operand::parse") {
+  SUBCASE("Valid input") {
+    Tokens::Operand o1{"42"};
+    CHECK(o1.parse<int>() == 42);
+
+    Tokens::Operand o2{"-1234567890"};
+    CHECK(o2.parse<long>() == -1234567890);
+
+    Tokens::Operand o3{"3.14"};
+    CHECK(o3.parse<float>() == doctest::Approx(3.14f));
+
+    Tokens::Operand o4{"2.71828"};
+    CHECK(o4.parse<double>() == doctest::Approx(2.71828));
+  }
+
+  SUBCASE("Invalid input") {
+    Tokens::Operand o1{"abc"};
+    CHECK_THROWS_AS(USE(o1.parse<int>()), calculation_error);
+
+    Tokens::Operand o2{"123.45"};
+    CHECK_THROWS_AS(USE(o2.parse<long>()), std::logic_error);
+
+    Tokens::Operand o3{"xyz"};
+    CHECK_THROWS_AS(USE(o3.parse<double>()), calculation_error);
+  }
+
+  SUBCASE("Empty input") {
+    Tokens::Operand o{""};
+    CHECK_THROWS_AS(USE(o.parse<int>()), std::logic_error);
+    CHECK_THROWS_AS(USE(o.parse<long>()), std::logic_error);
+    CHECK_THROWS_AS(USE(o.parse<float>()), std::logic_error);
+    CHECK_THROWS_AS(USE(o.parse<double>()), std::logic_error);
+  }
+
+  SUBCASE("Overflow input") {
+    Tokens::Operand o1{"2147483648"};
+    CHECK_THROWS_AS(USE(o1.parse<int>()), calculation_error); // Exceeds the range of int.
+
+    Tokens::Operand o2{"92233720368547758080"};
+    CHECK_THROWS_AS(USE(o2.parse<long>()), calculation_error); // Exceeds the range of long.
+
+    Tokens::Operand o3{"9223372036854775808"};
+    CHECK_THROWS_AS(USE(o3.parse<long>()), calculation_error); // Exceeds the range of long by one.
+  }
+}
+
+TEST_CASE("parse_integer") {
+  SUBCASE("Converts eight digits at a time") {
+    CHECK(is_eight_digits(load_chunk("12345678")));
+    CHECK(!is_eight_digits(load_chunk("1234567a")));
+    CHECK(!is_eight_digits(load_chunk("/2345678")));
+    CHECK(!is_eight_digits(load_chunk("1234:678")));
+    CHECK(parse_eight_digits(load_chunk("12345678")) == 12345678);
+    CHECK(parse_eight_digits(load_chunk("00000009")) == 9);
+  }
+
+  SUBCASE("Parses integers of all lengths") {
+    std::string digits;
+    long        expected = 0;
+    for (int n = 1; n <= 18; n++) {
+      digits += static_cast<char>('0' + (n % 10));
+      expected = (expected * 10) + (n % 10);
+
+      CHECK(parse_integer<long>(digits) == expected);
+      CHECK(parse_integer<long>("-" + digits) == -expected);
+    }
+  }
+
+  SUBCASE("Parses the range limits exactly") {
+    CHECK(parse_integer<long>("9223372036854775807") == std::numeric_limits<long>::max());
+    CHECK(parse_integer<long>("-9223372036854775808") == std::numeric_limits<long>::min());
+    CHECK(parse_integer<int>("-2147483648") == std::numeric_limits<int>::min());
+    CHECK_THROWS_AS(USE(parse_integer<long>("-9223372036854775809")), calculation_error);
+    CHECK_THROWS_AS(USE(parse_integer<int>("2147483648")), calculation_error);
+  }
+
+  SUBCASE("Skips leading zeros") {
+    CHECK(parse_integer<long>("000000000000000000000000042") == 42);
+    CHECK(parse_integer<long>("-00000000000000000000000000") == 0);
+  }
+
+  SUBCASE("Leaves anything else to the generic parser") {
+    CHECK(!parse_integer<long>(""));
+    CHECK(!parse_integer<long>("-"));
+    CHECK(!parse_integer<long>("12.5"));
+    CHECK(!parse_integer<long>("123456789abc"));
+    CHECK(!parse_integer<long>("1234567890123456789012345.0"));
+  }
+}
+
+TEST_CASE("parse_based_integer") {
+  SUBCASE("Parses all bases, with either case") {
+    CHECK(parse_based_integer<long>("0x1f") == 31);
+    CHECK(parse_based_integer<long>("0XdeadBEEF") == 0xdeadbeef);
+    CHECK(parse_based_integer<long>("0o777") == 0777);
+    CHECK(parse_based_integer<long>("0b101") == 5);
+    CHECK(parse_based_integer<long>("-0x10") == -16);
+    CHECK(parse_based_integer<long>("0x0") == 0);
+  }
+
+  SUBCASE("Parses digits eight at a time like one at a time") {
+    std::mt19937_64 rng{3};
+    for (int i = 0; i < 1000; i++) {
+      const auto value = static_cast<long>(rng() >> (1 + (rng() % 63)));
+      CHECK(parse_based_integer<long>(fmt::format("0x{:x}", value)) == value);
+      CHECK(parse_based_integer<long>(fmt::format("0o{:o}", value)) == value);
+      CHECK(parse_based_integer<long>(fmt::format("0b{:b}", value)) == value);
+      CHECK(parse_based_integer<long>(fmt::format("0x{:X}", value)) == value);
+    }
+  }
+
+  SUBCASE("Parses the range limits exactly") {
+    CHECK(parse_based_integer<long>("0x7fffffffffffffff") == std::numeric_limits<long>::max());
+    CHECK(parse_based_integer<long>("-0x8000000000000000") == std::numeric_limits<long>::min());
+    CHECK(parse_based_integer<long>("0o0777777777777777777777") == std::numeric_limits<long>::max());
+    CHECK(parse_based_integer<std::int8_t>("-0b10000000") == -128);
+    CHECK_THROWS_AS(USE(parse_based_integer<long>("0x8000000000000000")), calculation_error);
+    CHECK_THROWS_AS(USE(parse_based_integer<long>("0o2000000000000000000000")), calculation_error);
+    CHECK_THROWS_AS(USE(parse_based_integer<long>("0x10000000000000000")), calculation_error);
+    CHECK_THROWS_AS(USE(parse_based_integer<std::int8_t>("0b10000000")), calculation_error);
+  }
+
+  SUBCASE("Takes any 64-bit magnitude for numbers") {
+    CHECK(parse_operand<Number>(Tokens::Operand{"0xffffffffffffffff"}).to_string() == "18446744073709551615");
+    CHECK(parse_operand<Number>(Tokens::Operand{"-0x8000000000000001"}).to_string() == "-9223372036854775809");
+    CHECK(parse_operand<Number>(Tokens::Operand{"-0x8000000000000000"}).is_long());
+    CHECK_THROWS_AS(USE(parse_operand<Number>(Tokens::Operand{"0x10000000000000000"})), calculation_error);
+    CHECK_THROWS_AS(USE(parse_operand<long>(Tokens::Operand{"0x8000000000000000"})), calculation_error);
+    CHECK_THROWS_AS(USE(parse_operand<Number>(Tokens::Operand{"9223372036854775808"})), calculation_error);
+  }
+
+  SUBCASE("Skips leading zeros") {
+    CHECK(parse_based_integer<long>("0x0000000000000000000000000001") == 1);
+    CHECK(parse_based_integer<long>("-0b0000000000000000000000000000000000000000000000000000000000000000000011") == -3);
+  }
+
+  SUBCASE("Rejects invalid digits and anything without a prefix") {
+    for (const auto input : {"0x", "-0b", "0xg", "0b102", "0o8", "0x12345678z", "0xz123456789", "0o1234567890", "0b1111111121111111", "12", "00x1", "0y1", "x1", "0x-1"}) {
+      CHECK_FALSE(parse_based_integer<long>(input).has_value());
+    }
+  }
+}
+
+TEST_CASE("TokenIndex") {
+  SUBCASE("Finds token boundaries") {
+    const TokenIndex index{"  12 -3\t+\n\n*  "};
+
+    CHECK(index.starts == std::vector<std::uint32_t>{2, 5, 8, 11});
+    CHECK(index.ends == std::vector<std::uint32_t>{4, 7, 9, 12});
+  }
+
+  SUBCASE("Handles tokens crossing block boundaries and at the end of the input") {
+    const std::string input = std::string(60, ' ') + "12345678 9" + std::string(54, ' ') + "42";
+    const TokenIndex  index{input};
+
+    CHECK(index.starts == std::vector<std::uint32_t>{60, 69, 124});
+    CHECK(index.ends == std::vector<std::uint32_t>{68, 70, 126});
+  }
+
+  SUBCASE("Handles empty and whitespace-only input") {
+    CHECK(TokenIndex{""}.size() == 0);
+    CHECK(TokenIndex{" \t\n\v\f\r"}.size() == 0);
+  }
+
+  SUBCASE("Leaves the rest of a line after a binary byte out") {
+    const std::string input = "1 2\x01 3 +\n4 5 " + std::string(64, '\x80') + " 6\n7";
+    const TokenIndex  index{input};
+
+    CHECK(index.starts == std::vector<std::uint32_t>{0, 2, 9, 11, 13, 80});
+    CHECK(index.ends == std::vector<std::uint32_t>{1, 4, 10, 12, 14, 81});
+  }
+
+  SUBCASE("All classifiers agree") {
+    std::mt19937 rng{1};
+    std::string  input(1000, ' ');
+    std::ranges::generate(input, [&] { return " \n0123456789-+*/%a\xff\x01~\x7f"[rng() % 22]; });
+
+    const TokenIndex reference{input, classify_scalar};
+    std::vector      classifiers{best_classifier()};
+#ifdef HAVE_X86_SIMD
+    classifiers.push_back(classify_sse2);
+#endif
+
+    for (const auto classifier : classifiers) {
+      const TokenIndex index{input, classifier};
+
+      CHECK(index.starts == reference.starts);
+      CHECK(index.ends == reference.ends);
+      CHECK(index.non_digits == reference.non_digits);
+    }
+  }
+}
+
+TEST_CASE("read_token") {
+  SUBCASE("Reads an operand") {
+    const TokenIndex index{"123"};
+    std::size_t      cursor = 0;
+
+    const auto t = read_token(index, cursor);
+
+    CHECK(std::holds_alternative<Tokens::Operand>(t));
+    CHECK(std::get<Tokens::Operand>(t).value == "123");
+    CHECK(cursor == 1);
+  }
+
+  SUBCASE("Reads a negative operand") {
+    const TokenIndex index{"-456"};
+    std::size_t      cursor = 0;
+
+    const auto t = read_token(index, cursor);
+
+    CHECK(std::holds_alternative<Tokens::Operand>(t));
+    CHECK(std::get<Tokens::Operand>(t).value == "-456");
+  }
+
+  SUBCASE("Reads an operator") {
+    const TokenIndex index{"+"};
+    std::size_t      cursor = 0;
+
+    const auto t = read_token(index, cursor);
+
+    CHECK(std::holds_alternative<Tokens::Operator>(t));
+    CHECK(std::get<Tokens::Operator>(t).op == '+');
+  }
+
+  SUBCASE("Reads hexadecimal, octal and binary operands") {
+    for (const auto input : {"0x1F", "-0xff", "0o17", "0b1010", "0B1", "0O7", "0X0"}) {
+      const TokenIndex index{input};
+      std::size_t      cursor = 0;
+
+      CHECK(std::holds_alternative<Tokens::Operand>(read_token(index, cursor)));
+    }
+  }
+
+  SUBCASE("Reads an invalid token") {
+    for (const auto input : {"abc", "1-2", "--1", "-", "++", "12a", "\xff", "0x", "0xg", "0b2", "0o9", "--0x1", "0x1.5"}) {
+      const TokenIndex index{input};
+      std::size_t      cursor = 0;
+
+      if (std::string_view{input} == "-") {
+        CHECK(std::holds_alternative<Tokens::Operator>(read_token(index, cursor)));
+      } else {
+        CHECK(std::holds_alternative<Tokens::Invalid>(read_token(index, cursor)));
+      }
+    }
+  }
+
+  SUBCASE("Returns end-of-calculation after the last token") {
+    const TokenIndex index{"1 2"};
+    std::size_t      cursor = 0;
+
+    USE(read_token(index, cursor));
+    USE(read_token(index, cursor));
+
+    CHECK(std::holds_alternative<Tokens::Eoc>(read_token(index, cursor)));
+    CHECK(std::holds_alternative<Tokens::Eoc>(read_token(index, cursor)));
+  }
+
+  SUBCASE("Returns end-of-calculation at the limit") {
+    const TokenIndex index{"1 2\n3"};
+    std::size_t      cursor = 0;
+
+    USE(read_token(index, cursor, 3));
+    USE(read_token(index, cursor, 3));
+
+    CHECK(std::holds_alternative<Tokens::Eoc>(read_token(index, cursor, 3)));
+    CHECK(std::holds_alternative<Tokens::Operand>(read_token(index, cursor)));
+  }
+}
+
+TEST_CASE("InputReader") {
+  // A token and a line straddle the end of the first chunk.
+  const std::string input = std::string(InputReader::CHUNK_SIZE - 2, '1') + " 2345 6\n7";
+
+  std::FILE* file = std::tmpfile();
+  REQUIRE(file != nullptr);
+  REQUIRE(std::fwrite(input.data(), 1, input.size(), file) == input.size());
+
+  SUBCASE("Tokens") {
+    std::rewind(file);
+    InputReader reader{file};
+    CHECK(reader.read(InputReader::is_whitespace) == std::string_view{input}.substr(0, InputReader::CHUNK_SIZE - 1));
+    CHECK(reader.read(InputReader::is_whitespace) == "2345 6\n");
+    CHECK(reader.read(InputReader::is_whitespace) == "7");
+    CHECK(reader.read(InputReader::is_whitespace).empty());
+  }
+
+  SUBCASE("Lines") {
+    std::rewind(file);
+    InputReader reader{file};
+    CHECK(reader.read(InputReader::is_newline) == std::string_view{input}.substr(0, input.size() - 1));
+    CHECK(reader.read(InputReader::is_newline) == "7");
+    CHECK(reader.read(InputReader::is_newline).empty());
+  }
+
+  SUBCASE("Token stream") {
+    std::rewind(file);
+    InputReader reader{file};
+    TokenStream tokens{reader};
+    CHECK(std::holds_alternative<Tokens::Operand>(tokens.next()));
+    CHECK(std::get<Tokens::Operand>(tokens.next()).value == "2345");
+    CHECK(std::get<Tokens::Operand>(tokens.next()).value == "6");
+    CHECK(std::get<Tokens::Operand>(tokens.next()).value == "7");
+    CHECK(std::holds_alternative<Tokens::Eoc>(tokens.next()));
+  }
+
+  SUBCASE("Drops the rest of a line after a binary byte") {
+    // The second line is longer than a chunk.
+    const std::string binary = "1 2\x80 3 +\n4 \x01" + std::string(3 * InputReader::CHUNK_SIZE, '\xff') + "5\n6 7 +";
+
+    std::FILE* binary_file = std::tmpfile();
+    REQUIRE(binary_file != nullptr);
+    REQUIRE(std::fwrite(binary.data(), 1, binary.size(), binary_file) == binary.size());
+    std::rewind(binary_file);
+
+    InputReader reader{binary_file};
+    CHECK(reader.read(InputReader::is_newline) == "1 2\x80\n4 \x01");
+    CHECK(reader.read(InputReader::is_newline) == "\n");
+    CHECK(reader.read(InputReader::is_newline) == "6 7 +");
+    CHECK(reader.read(InputReader::is_newline).empty());
+    std::fclose(binary_file);
+  }
+
+  std::fclose(file);
+}
+
+TEST_CASE("ResultWriter") {
+  const auto written = [](std::size_t width, std::invocable<ResultWriter&> auto&& write) {
+    std::FILE* file = std::tmpfile();
+    REQUIRE(file != nullptr);
+
+    {
+      ResultWriter out{file, width};
+      write(out);
+      out.flush();
+    }
+
+    std::fseek(file, 0, SEEK_END);
+    std::string text(static_cast<std::size_t>(std::ftell(file)), '\0');
+    std::rewind(file);
+    text.resize(std::fread(text.data(), 1, text.size(), file));
+    std::fclose(file);
+
+    return text;
+  };
+
+  SUBCASE("Writes the same text as std::ostream") {
+    const auto text = written(0, [](ResultWriter& out) {
+      out.value(42L);
+      out.value(std::numeric_limits<long>::min());
+      out.value(0);
+      out.error("division by zero");
+      out.value(-7);
+
+      CHECK(out.lines() == 5);
+    });
+
+    std::ostringstream expected;
+    expected << 42L << '\n' << std::numeric_limits<long>::min() << '\n' << 0 << '\n' << "Error: division by zero\n" << -7 << '\n';
+
+    CHECK(text == expected.str());
+  }
+
+  SUBCASE("Writes shortest round-trip floating-point values") {
+    CHECK(written(0, [](ResultWriter& out) {
+            out.value(0.1);
+            out.value(1e300);
+            out.value(2.5f);
+          }) == "0.1\n1e+300\n2.5\n");
+  }
+
+  SUBCASE("Writes values of any size") {
+    CHECK(written(0, [](ResultWriter& out) {
+            out.value(Number{-3});
+            out.value(Number{std::numeric_limits<long>::max()} + Number{1});
+          }) == "-3\n9223372036854775808\n");
+  }
+
+  SUBCASE("Right-aligns values in fixed-width mode") {
+    CHECK(written(4, [](ResultWriter& out) {
+            out.value(7);
+            out.value(-12345);
+            out.error("overflow");
+          }) == "   7\n-12345\nError: overflow\n");
+  }
+
+  SUBCASE("Keeps the text without a sink") {
+    ResultWriter out{nullptr};
+    out.value(1);
+    out.value(22);
+
+    CHECK(out.text() == "1\n22\n");
+
+    out.erase(2);
+
+    CHECK(out.text() == "22\n");
+    CHECK_THROWS_AS(out.flush(), std::logic_error);
+  }
+
+  SUBCASE("Writes lines larger than the buffer size") {
+    CHECK(written(2'000'000, [](ResultWriter& out) { out.value(1); }).size() == 2'000'001);
+  }
+}
+
+TEST_CASE("evaluate_lines") {
+  SUBCASE("Evaluates complete lines only") {
+    ResultWriter out{nullptr};
+    TokenIndex   index;
+
+    CHECK(evaluate_lines("1 2 +\n\n3 0 /\n4 5", index, out) == 13);
+    CHECK(out.text() == "3\nError: expected operand 1, got end-of-calculation\nError: division by zero\n");
+  }
+
+  SUBCASE("Starts every line afresh") {
+    ResultWriter out{nullptr};
+    TokenIndex   index;
+
+    CHECK(evaluate_lines("1 2 3 +\n4 5 *\n", index, out) == 14);
+    CHECK(out.text() == "Error: expected operator, got operand\n20\n");
+  }
+}
+
+
+TEST_CASE("calculate") {
+  SUBCASE("Addition") {
+    CHECK(calculate(2, 3, '+') == 5);
+    CHECK(calculate(0, 0, '+') == 0);
+    CHECK(calculate(-5, 10, '+') == 5);
+    CHECK(calculate(-9223372036854775807L, 1L, '+') == -9223372036854775806L);
+    CHECK(calculate(-9223372036854775807L, 1L, '+') == -9223372036854775806L);
+    CHECK(calculate(9223372036854775807L, -1L, '+') == 9223372036854775806L);
+    CHECK(calculate(0L, 9223372036854775807L, '+') == 9223372036854775807L);
+    CHECK(calculate(Number{-9223372036854775807L}, Number{-9223372036854775807L}, '+').to_string() == "-18446744073709551614");
+    CHECK(calculate(9223372036854775807L, -9223372036854775807L, '+') == 0L);
+    CHECK(calculate(0L, -9223372036854775807L, '+') == -9223372036854775807L);
+  }
+
+  SUBCASE("Subtraction") {
+    CHECK(calculate(5, 3, '-') == 2);
+    CHECK(calculate(0, 0, '-') == 0);
+    CHECK(calculate(-5, 10, '-') == -15);
+    CHECK(calculate(1000000000, 2000000000, '-') == -1000000000);
+    CHECK(calculate(Number{-9223372036854775807L}, Number{1L}, '-') == Number{std::numeric_limits<long>::min()});
+    CHECK(calculate(Number{9223372036854775807L}, Number{-1L}, '-').to_string() == "9223372036854775808");
+    CHECK(calculate(0L, 9223372036854775807L, '-') == -9223372036854775807L);
+    CHECK(calculate(-9223372036854775807L, -9223372036854775807L, '-') == 0L);
+    CHECK(calculate(Number{9223372036854775807L}, Number{-9223372036854775807L}, '-').to_string() == "18446744073709551614");
+    CHECK(calculate(0L, -9223372036854775807L, '-') == 9223372036854775807L);
+  }
+
+  SUBCASE("Multiplication") {
+    CHECK(calculate(2, 3, '*') == 6);
+    CHECK(calculate(0, 5, '*') == 0);
+    CHECK(calculate(-5, -2, '*') == 10);
+    CHECK(calculate(1000000000L, 2000000000L, '*') == 2000000000000000000L);
+    CHECK(calculate(-9223372036854775807L, 1L, '*') == -9223372036854775807L);
+    CHECK(calculate(9223372036854775807L, -1L, '*') == -9223372036854775807L);
+    CHECK(calculate(0L, 9223372036854775807L, '*') == 0L);
+    CHECK(calculate(Number{-9223372036854775807L}, Number{-9223372036854775807L}, '*').to_string() == "85070591730234615847396907784232501249");
+    CHECK(calculate(Number{9223372036854775807L}, Number{-9223372036854775807L}, '*').to_string() == "-85070591730234615847396907784232501249");
+    CHECK(calculate(0L, -9223372036854775807L, '*') == 0L);
+  }
+
+  SUBCASE("Division") {
+    CHECK(calculate(10, 2, '/') == 5);
+    CHECK(calculate(0, 5, '/') == 0);
+    CHECK(calculate(-10, 2, '/') == -5);
+    CHECK(calculate(1000000000, 2000000000, '/') == 0);
+    CHECK(calculate(-9223372036854775807L, 1L, '/') == -9223372036854775807L);
+    CHECK(calculate(9223372036854775807L, -1L, '/') == -9223372036854775807L);
+    CHECK(calculate(0L, 9223372036854775807L, '/') == 0L);
+    CHECK(calculate(-9223372036854775807L, -9223372036854775807L, '/') == 1L);
+    CHECK(calculate(9223372036854775807L, -9223372036854775807L, '/') == -1L);
+    CHECK(calculate(0L, -9223372036854775807L, '/') == 0L);
+  }
+
+  SUBCASE("Modulo") {
+    CHECK(calculate(10, 3, '%') == 1);
+    CHECK(calculate(0, 5, '%') == 0);
+    CHECK(calculate(-10, 3, '%') == -1);
+    CHECK(calculate(1000000000, 2000000000, '%') == 1000000000);
+    CHECK(calculate(-9223372036854775807L, 1L, '%') == 0L);
+    CHECK(calculate(9223372036854775807L, -1L, '%') == 0L);
+    CHECK(calculate(0L, 9223372036854775807L, '%') == 0L);
+    CHECK(calculate(-9223372036854775807L, -9223372036854775807L, '%') == 0L);
+    CHECK(calculate(9223372036854775807L, -9223372036854775807L, '%') == 0L);
+    CHECK(calculate(0L, -9223372036854775807L, '%') == 0L);
+  }
+
+  SUBCASE("Unsupported Operator") {
+    CHECK_THROWS_AS(USE(calculate(2, 3, '^')), std::invalid_argument);
+    CHECK_THROWS_AS(USE(calculate(0, 0, '@')), std::invalid_argument);
+    CHECK_THROWS_AS(USE(calculate(-5, 10, '$')), std::invalid_argument);
+  }
+
+  SUBCASE("Division by Zero") {
+    CHECK_THROWS_AS(USE(calculate(5, 0, '/')), calculation_error);
+    CHECK_THROWS_AS(USE(calculate(0, 0, '/')), calculation_error);
+    CHECK_THROWS_AS(USE(calculate(-10, 0, '/')), calculation_error);
+    CHECK_THROWS_AS(USE(calculate(5, 0, '%')), calculation_error);
+    CHECK_THROWS_AS(USE(calculate(0, 0, '%')), calculation_error);
+    CHECK_THROWS_AS(USE(calculate(-10, 0, '%')), calculation_error);
+  }
+}
+
+TEST_CASE("checked_calculate") {
+  constexpr long MIN = std::numeric_limits<long>::min();
+  constexpr long MAX = std::numeric_limits<long>::max();
+
+  SUBCASE("Calculates like calculate") {
+    for (const char op : OPERATORS) {
+      CHECK(checked_calculate(-7, 3, op) == calculate(-7L, 3L, op));
+      CHECK(checked_calculate(MAX / 2, -1, op) == calculate(MAX / 2, -1L, op));
+    }
+  }
+
+  SUBCASE("Detects overflow") {
+    CHECK(!checked_calculate(MAX, 1, '+'));
+    CHECK(!checked_calculate(MIN, 1, '-'));
+    CHECK(!checked_calculate(MAX, 2, '*'));
+    CHECK(!checked_calculate(MIN, -1, '/'));
+    CHECK(checked_calculate(MIN, -1, '%') == 0);
+  }
+
+  SUBCASE("Throws like calculate") {
+    CHECK_THROWS_AS(USE(checked_calculate(1, 0, '/')), calculation_error);
+    CHECK_THROWS_AS(USE(checked_calculate(1, 0, '%')), calculation_error);
+    CHECK_THROWS_AS(USE(checked_calculate(1, 1, '^')), std::invalid_argument);
+  }
+}
+
+TEST_CASE("BigInt") {
+  const auto text = [](__int128 value) {
+    std::string digits;
+    for (auto magnitude = (value < 0) ? -static_cast<unsigned __int128>(value) : static_cast<unsigned __int128>(value); digits.empty() || magnitude != 0;
+         magnitude /= 10) {
+      digits.insert(digits.begin(), static_cast<char>('0' + static_cast<int>(magnitude % 10)));
+    }
+
+    return (value < 0) ? "-" + digits : digits;
+  };
+
+  std::mt19937_64                    rng{7};
+  std::uniform_int_distribution<int> bits{0, 126};
+
+  // Random values of random sizes, limited to avoid 128-bit overflow in the reference calculations.
+  const auto random = [&](int max_bits) {
+    const auto value = static_cast<__int128>(((static_cast<unsigned __int128>(rng()) << 64) | rng()) >> (127 - (bits(rng) % max_bits)));
+    return (rng() % 2 == 0) ? value : -value;
+  };
+
+  SUBCASE("Converts from and to 128-bit integers") {
+    for (const auto value : {__int128{0}, __int128{-1}, std::numeric_limits<__int128>::max(), std::numeric_limits<__int128>::min()}) {
+      CHECK(BigInt{value}.to_int128() == value);
+      CHECK(BigInt{value}.to_string() == text(value));
+    }
+
+    CHECK(!(BigInt{std::numeric_limits<__int128>::max()} + BigInt{1}).to_int128());
+  }
+
+  SUBCASE("Calculates like 128-bit integers") {
+    for (int i = 0; i < 10000; i++) {
+      const __int128 a = random(126);
+      const __int128 b = random(126);
+      const __int128 c = random(63);
+      const __int128 d = random(63);
+
+      CHECK(BigInt{a} + BigInt{b} == BigInt{a + b});
+      CHECK(BigInt{a} - BigInt{b} == BigInt{a - b});
+      CHECK(BigInt{c} * BigInt{d} == BigInt{c * d});
+      CHECK(BigInt{a}.to_string() == text(a));
+      if (b != 0) {
+        CHECK(BigInt{a} / BigInt{b} == BigInt{a / b});
+        CHECK(BigInt{a} % BigInt{b} == BigInt{a % b});
+      }
+    }
+  }
+
+  SUBCASE("Divides values larger than 128 bits") {
+    const auto negative = [](const BigInt& value) { return value.to_string().front() == '-'; };
+
+    for (int i = 0; i < 10000; i++) {
+      const BigInt a{random(126)};
+      const BigInt b{random(126)};
+      const BigInt r{random(126)};
+      if (b.is_zero()) {
+        continue;
+      }
+
+      // The remainder must be smaller than the divisor, with the sign of the dividend.
+      const BigInt product   = a * b;
+      BigInt       remainder = r % b;
+      if (negative(remainder) != negative(product)) {
+        remainder = BigInt{} - remainder;
+      }
+
+      const BigInt dividend = product + remainder;
+
+      CHECK(dividend / b == a);
+      CHECK(dividend % b == remainder);
+    }
+  }
+}
+
+TEST_CASE("Number") {
+  constexpr long MAX = std::numeric_limits<long>::max();
+
+  SUBCASE("Promotes on overflow and demotes when the result fits") {
+    const Number big = Number{MAX} + Number{1};
+
+    CHECK(!big.is_long());
+    CHECK(big.to_string() == "9223372036854775808");
+    CHECK((big - Number{1}).is_long());
+    CHECK(big - Number{1} == Number{MAX});
+  }
+
+  SUBCASE("Promotes beyond 128 bits") {
+    const Number cube = Number{MAX} * Number{MAX} * Number{MAX};
+
+    CHECK(cube.to_string() == "784637716923335095224261902710254454442933591094742482943");
+    CHECK(cube / Number{MAX} / Number{MAX} == Number{MAX});
+    CHECK(cube % Number{MAX} == Number{0});
+    CHECK((Number{0} - cube).to_string() == "-784637716923335095224261902710254454442933591094742482943");
+  }
+
+  SUBCASE("Divides the most negative value by minus one") {
+    const Number min{std::numeric_limits<long>::min()};
+
+    CHECK((min / Number{-1}).to_string() == "9223372036854775808");
+    CHECK(min % Number{-1} == Number{0});
+  }
+}
+
+
+TEST_CASE("evaluate_constant") {
+  SUBCASE("Classifies tokens like read_token") {
+    for (const auto input : {"123", "-456", "+", "-", "%", "abc", "1-2", "--1", "++", "12a", "\xff"}) {
+      const TokenIndex index{input};
+      std::size_t      cursor = 0;
+
+      CHECK(classify_token(input).index() == read_token(index, cursor).index());
+    }
+  }
+
+  SUBCASE("Takes tokens separated by any whitespace") {
+    std::string_view calculation = " 1\t\t-2\n+ ";
+
+    CHECK(std::get<Tokens::Operand>(take_token(calculation)).value == "1");
+    CHECK(std::get<Tokens::Operand>(take_token(calculation)).value == "-2");
+    CHECK(std::get<Tokens::Operator>(take_token(calculation)).op == '+');
+    CHECK(std::holds_alternative<Tokens::Eoc>(take_token(calculation)));
+  }
+
+  SUBCASE("Evaluates at compile time") {
+    constexpr long value = "10 2 / 3 + 4 * 5 - 2 / 3 + 1 + 8 * 10 % -100 +"_rpn;
+
+    CHECK(value == -94);
+  }
+}
+
+TEST_CASE("InfixEvaluator") {
+  const auto evaluate = [](std::string_view calculation) {
+    InfixEvaluator<> infix;
+    ResultWriter     out{nullptr};
+
+    infix.evaluate(calculation, out);
+    return std::string{out.text()};
+  };
+
+  SUBCASE("Applies operators by precedence, from left to right") {
+    CHECK(evaluate("1 + 2 * 3") == "7\n");
+    CHECK(evaluate("10 - 4 - 3") == "3\n");
+    CHECK(evaluate("100 / 10 / 5") == "2\n");
+    CHECK(evaluate("2 * 3 % 4 + 1") == "3\n");
+    CHECK(evaluate("42") == "42\n");
+  }
+
+  SUBCASE("Groups with parentheses, without whitespace") {
+    CHECK(evaluate("(1+2)*3") == "9\n");
+    CHECK(evaluate("((((7))))") == "7\n");
+    CHECK(evaluate("2*(3+(4-1)*2)%5") == "3\n");
+    CHECK(evaluate("\t(0x10 + 0b1)\n* 2 ") == "34\n");
+  }
+
+  SUBCASE("Negates where an operand is expected") {
+    CHECK(evaluate("-3 * 2") == "-6\n");
+    CHECK(evaluate("2--3") == "5\n");
+    CHECK(evaluate("-(2 + 3) * 2") == "-10\n");
+    CHECK(evaluate("- -4") == "4\n");
+    CHECK(evaluate("-9223372036854775808 - 1") == "-9223372036854775809\n");
+    CHECK(evaluate("-(-9223372036854775808)") == "9223372036854775808\n");
+  }
+
+  SUBCASE("Promotes results like RPN calculations") {
+    CHECK(evaluate("9223372036854775807 * 9223372036854775807 * 9223372036854775807")
+          == "784637716923335095224261902710254454442933591094742482943\n");
+  }
+
+  SUBCASE("Reports errors") {
+    CHECK(evaluate("") == "Error: expected operand, got end-of-calculation\n");
+    CHECK(evaluate("1 +") == "Error: expected operand, got end-of-calculation\n");
+    CHECK(evaluate("* 2") == "Error: expected operand, got operator\n");
+    CHECK(evaluate("()") == "Error: expected operand, got closing parenthesis\n");
+    CHECK(evaluate("1 2") == "Error: expected operator, got operand\n");
+    CHECK(evaluate("2 (3)") == "Error: expected operator, got opening parenthesis\n");
+    CHECK(evaluate("1 + 2x") == "Error: expected operand, got invalid token\n");
+    CHECK(evaluate("1 1.5") == "Error: expected operator, got invalid token\n");
+    CHECK(evaluate("(1 + 2") == "Error: unmatched opening parenthesis\n");
+    CHECK(evaluate("1 + 2)") == "Error: unmatched closing parenthesis\n");
+    CHECK(evaluate("1 / (2 - 2)") == "Error: division by zero\n");
+    CHECK(evaluate("99999999999999999999 + 1") == "Error: failed to parse input '99999999999999999999': parse type value overflow\n");
+  }
+
+  SUBCASE("Reuses its stacks between calculations") {
+    InfixEvaluator<long> infix;
+    ResultWriter         out{nullptr};
+
+    infix.evaluate("(1 + ", out);
+    infix.evaluate("2 * (3", out);
+    infix.evaluate("4 * 5", out);
+    CHECK(out.text() == "Error: expected operand, got end-of-calculation\nError: unmatched opening parenthesis\n20\n");
+  }
+}
+
+TEST_CASE("Calculator") {
+  SUBCASE("Evaluates a calculation") {
+    Calculator calculator;
+
+    const auto [ok, text] = calculator.evaluate("1 2 +\n3 *");
+    CHECK(ok);
+    CHECK(text == "9");
+  }
+
+  SUBCASE("Reports errors without the prefix") {
+    Calculator calculator;
+
+    const auto [ok, text] = calculator.evaluate("1 0 /");
+    CHECK_FALSE(ok);
+    CHECK(text == "division by zero");
+  }
+
+  SUBCASE("Takes operands and writes results in other bases") {
+    Calculator hex{0, 16};
+    Calculator octal{0, 8};
+    Calculator binary{8, 2};
+
+    CHECK(Calculator{}.evaluate("0xff 0b11 * 0o10 -").text == "757");
+    CHECK(hex.evaluate("0xff 1 +").text == "0x100");
+    CHECK(hex.evaluate("0 0x10 -").text == "-0x10");
+    CHECK(hex.evaluate("-9223372036854775808 2 *").text == "-0x10000000000000000");
+    CHECK(hex.evaluate("-0x8000000000000000 0 +").text == "-0x8000000000000000");
+    CHECK(octal.evaluate("8 0 +").text == "0o10");
+    CHECK(binary.evaluate("5 0 +").text == "   0b101");
+    CHECK(binary.evaluate("0 0 +").text == "     0b0");
+    CHECK_THROWS_AS(Calculator(0, 3), std::invalid_argument);
+  }
+
+  SUBCASE("Aligns results to the minimum width") {
+    Calculator calculator{6};
+
+    CHECK(calculator.evaluate("9223372036854775807 2 *").text == "18446744073709551614");
+    CHECK(calculator.evaluate("2 3 *").text == "     6");
+  }
+
+  SUBCASE("Evaluates lines like the command-line calculator") {
+    Calculator  calculator;
+    std::string output = "0\n";
+
+    CHECK(calculator.evaluate_lines("1 2 +\n\n3 0 / 4\n  5 6 *", output) == 3);
+    CHECK(output == "0\n3\nError: division by zero\n30\n");
+  }
+
+  SUBCASE("Rejects binary input like any invalid token") {
+    Calculator  calculator;
+    std::string output;
+
+    CHECK(calculator.evaluate_lines("1 2\xff +\n\x01\x02\x03 4\n3 4 *\n5 \x80", output) == 4);
+    CHECK(output == "Error: expected operand 2, got invalid token\nError: expected operand 1, got invalid token\n12\nError: expected operand 2, got invalid token\n");
+  }
+
+  SUBCASE("Evaluates infix calculations like the same RPN calculations") {
+    Calculator   calculator;
+    std::mt19937 rng{5};
+
+    for (int i = 0; i < 1000; i++) {
+      // Left to right in both, as every operator after the first is applied to the parenthesized calculation before it.
+      std::string rpn   = std::to_string(static_cast<int>(rng() % 21) - 10);
+      std::string infix = rpn;
+      for (auto n = 1 + (rng() % 6); n > 0; n--) {
+        const char op      = "+-*/%"[rng() % 5];
+        const auto operand = static_cast<int>(rng() % 21) - 10;
+
+        rpn += fmt::format(" {} {}", operand, op);
+        infix = fmt::format("({}){}{}", infix, op, operand);
+      }
+
+      const std::string expected{calculator.evaluate(rpn).text};
+      CHECK(calculator.evaluate_infix(infix).text == expected);
+    }
+  }
+
+  SUBCASE("Evaluates infix lines") {
+    Calculator  calculator;
+    std::string output;
+
+    CHECK(calculator.evaluate_infix_lines("1 + 2\n \t\n(3\n4 * (5 - 6)", output) == 3);
+    CHECK(output == "3\nError: unmatched opening parenthesis\n-4\n");
+  }
+
+  SUBCASE("Evaluates input read from a file in chunks") {
+    // Calculations and lines of several chunks.
+    std::string rpn   = "1";
+    std::string infix = "1";
+    for (int i = 0; i < 40'000; i++) {
+      rpn += " 1 +";
+      infix += " + 1";
+    }
+
+    const auto file = [](std::string_view text) {
+      std::FILE* f = std::tmpfile();
+      REQUIRE(f != nullptr);
+      REQUIRE(std::fwrite(text.data(), 1, text.size(), f) == text.size());
+      std::rewind(f);
+      return f;
+    };
+
+    Calculator calculator;
+    std::FILE* source = file(rpn);
+    CHECK(calculator.evaluate(source).text == "40001");
+    std::fclose(source);
+
+    source = file(infix);
+    CHECK(calculator.evaluate_infix(source).text == "40001");
+    std::fclose(source);
+
+    source          = file(rpn + "\n1 0 /\n\n" + rpn + " x\n2 3 *");
+    std::FILE* sink = file("");
+    CHECK(calculator.evaluate_lines(source, sink) == 4);
+    std::fclose(source);
+
+    std::string output(100, '\0');
+    std::rewind(sink);
+    output.resize(std::fread(output.data(), 1, output.size(), sink));
+    CHECK(output == "40001\nError: division by zero\nError: expected operand 2, got invalid token\n6\n");
+    std::fclose(sink);
+  }
+
+  SUBCASE("Responds to every complete line") {
+    Calculator  calculator;
+    std::string output;
+
+    CHECK(calculator.respond("1 2 +\n\n4 5", output) == 7);
+    CHECK(output == "3\nError: expected operand 1, got end-of-calculation\n");
+  }
+
+  SUBCASE("Can be used from many threads at once") {
+    constexpr std::size_t THREADS      = 8;
+    constexpr std::size_t CALCULATIONS = 10'000;
+
+    const auto calculation = [](std::size_t i) { return fmt::format("{} {} * {} % 9223372036854775807 *", i, i + 1, (i % 7) + 1); };
+
+    std::vector<std::string> expected;
+    Calculator               reference;
+    for (std::size_t i = 0; i < CALCULATIONS; i++) {
+      expected.emplace_back(reference.evaluate(calculation(i)).text);
+    }
+
+    std::vector<std::size_t> wrong(THREADS);
+    std::vector<std::thread> threads;
+    for (std::size_t t = 0; t < THREADS; t++) {
+      threads.emplace_back([&, t] {
+        Calculator calculator;
+        for (std::size_t i = t; i < CALCULATIONS; i += THREADS) {
+          wrong[t] += (calculator.evaluate(calculation(i)).text != expected[i]) ? 1 : 0;
+        }
+      });
+    }
+
+    for (auto& thread : threads) {
+      thread.join();
+    }
+
+    CHECK(std::ranges::count(wrong, 0) == THREADS);
+  }
+}
+
+#endif // ENABLE_DOCTESTS
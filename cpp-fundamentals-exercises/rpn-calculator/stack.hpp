@@ -1,3 +1,5 @@
+#pragma once
+
 #include <array>
 #include <cstddef>
 #include <deque>
@@ -7,17 +9,17 @@
 template<typename Type, std::size_t MaxSize>
 class Stack {
 public:
-  bool push(Type&& element);
-  [[nodiscard]] std::optional<Type> pop();
+  constexpr bool push(Type&& element);
+  [[nodiscard]] constexpr std::optional<Type> pop();
 
-  [[nodiscard]] std::size_t size() const noexcept;
+  [[nodiscard]] constexpr std::size_t size() const noexcept;
 
 private:
   std::deque<Type> data_;
 };
 
 template<typename Type, std::size_t MaxSize>
-bool Stack<Type, MaxSize>::push(Type&& element) {
+constexpr bool Stack<Type, MaxSize>::push(Type&& element) {
   if (data_.size() < MaxSize) {
     data_.emplace_back(std::move(element));
     return true;
@@ -27,7 +29,7 @@ bool Stack<Type, MaxSize>::push(Type&& element) {
 }
 
 template<typename Type, std::size_t MaxSize>
-std::optional<Type> Stack<Type, MaxSize>::pop() {
+constexpr std::optional<Type> Stack<Type, MaxSize>::pop() {
   std::optional<Type> result;
 
   if (data_.empty()) {
@@ -41,7 +43,7 @@ std::optional<Type> Stack<Type, MaxSize>::pop() {
 }
 
 template<typename Type, std::size_t MaxSize>
-std::size_t Stack<Type, MaxSize>::size() const noexcept {
+constexpr std::size_t Stack<Type, MaxSize>::size() const noexcept {
   return data_.size();
 }
 
@@ -49,18 +51,18 @@ std::size_t Stack<Type, MaxSize>::size() const noexcept {
 template<typename Type>
 class Stack<Type, 2> {
 public:
-  bool push(Type&& element);
-  [[nodiscard]] std::optional<Type> pop();
+  constexpr bool push(Type&& element);
+  [[nodiscard]] constexpr std::optional<Type> pop();
 
-  [[nodiscard]] std::size_t size() const noexcept;
+  [[nodiscard]] constexpr std::size_t size() const noexcept;
 
 private:
-  std::array<Type, 2> data_;
+  std::array<Type, 2> data_{};
   std::size_t sp_{};
 };
 
 template<typename Type>
-bool Stack<Type, 2>::push(Type&& element) {
+constexpr bool Stack<Type, 2>::push(Type&& element) {
   if (sp_ < 2) {
     data_.at(sp_++) = std::move(element);
     return true;
@@ -70,7 +72,7 @@ bool Stack<Type, 2>::push(Type&& element) {
 }
 
 template<typename Type>
-std::optional<Type> Stack<Type, 2>::pop() {
+constexpr std::optional<Type> Stack<Type, 2>::pop() {
   std::optional<Type> result;
 
   if (sp_ > 0) {
@@ -81,6 +83,6 @@ std::optional<Type> Stack<Type, 2>::pop() {
 }
 
 template<typename Type>
-std::size_t Stack<Type, 2>::size() const noexcept {
+constexpr std::size_t Stack<Type, 2>::size() const noexcept {
   return sp_;
 }